@@ -9,10 +9,17 @@
 #include <shared_mutex>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
 #include <mutex>
 #include <cassert>
 #include <numeric>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include "page_server_client.h"
+#include "flash_cache.h"
+#include "flush_hint_sender.h"
+#include "io_stats.h"
 #define TPCC
 using space_id_t = size_t;
 using page_id_t = size_t;
@@ -20,43 +27,20 @@ using page_size_t = size_t;
 using frame_id_t = size_t;
 using byte = char;
 
-class Status {
- public:
-  ~Status() {
-    printf("total_read: %lu\n", total_read);
-    printf("total_write: %lu\n", total_write);
-    auto total_call = read_latency.size();
-
-    std::sort(read_latency.begin(), read_latency.end());
-    auto sum_latency = std::accumulate(read_latency.begin(), read_latency.end(), (uint64_t)0);
-    auto avg_latency = sum_latency / total_call;
-    auto min_latency = read_latency[0];
-    auto max_latency = read_latency[total_call - 1];
-    printf("performed %zu pread call, min latency: %d, max latency: %d, avg latency: %lu\n",
-           total_call, min_latency, max_latency, avg_latency);
-
-    auto total_call95 = static_cast<int>((static_cast<double>(total_call) * 0.95));
-    auto sum_latency95 = std::accumulate(read_latency.begin(),
-                                         read_latency.begin() + total_call95,
-                                         (uint64_t)0);
-    auto avg_latency95 = sum_latency95 / total_call95;
-    auto min_latency95 = read_latency[0];
-    auto max_latency95 = read_latency[total_call95 - 1];
-    printf("min latency of 95%% calls: %d, max latency of 95%% calls: %d, avg latency of 95%% calls: %lu\n",
-           min_latency95, max_latency95, avg_latency95);
-
-  }
-  std::mutex lock;
-  uint64_t total_read {};
-  uint64_t total_write {};
-  std::vector<int> read_latency {};
-};
-
-Status status;
-
 static constexpr const page_size_t PAGE_SIZE = 16384;
 static constexpr const size_t BUFFER_POOL_SIZE = (8ULL * 1024 * 1024 * 1024) / (16 * 1024); // buffer pool size in page size, 8GB
 static constexpr uint32_t FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID = 34;
+static constexpr uint32_t FIL_PAGE_LSN = 16;
+// 表空间的flags，压缩表空间的page在磁盘上只占zip size
+static constexpr uint32_t FSP_SPACE_FLAGS_OFFSET = 38 + 16;
+static constexpr uint32_t FSP_FLAGS_POS_ZIP_SSIZE = 1;
+static constexpr uint32_t FSP_FLAGS_MASK_ZIP_SSIZE = 15U << FSP_FLAGS_POS_ZIP_SSIZE;
+// 第一个log文件中两个checkpoint block的位置
+static constexpr off_t LOG_CHECKPOINT_1 = 512;
+static constexpr off_t LOG_CHECKPOINT_2 = 1536;
+// checkpoint之前等待存储节点确认刷出的page，失败时重试的次数和间隔
+static constexpr int FLUSH_HINT_SYNC_RETRY_MS = 100;
+static constexpr int FLUSH_HINT_SYNC_WARN_RETRIES = 50; // 失败这么多次报告一次
 
 
 class PageAddress {
@@ -130,8 +114,9 @@ class Page {
  public:
   Page() : data_(new byte[PAGE_SIZE]), page_size_(PAGE_SIZE) {}
   ~Page() { delete[] data_; }
-  void SetData(const byte *buf) {
-    std::memcpy(data_, buf, page_size_);
+  void SetData(const byte *buf, page_size_t page_size) {
+    std::memcpy(data_, buf, page_size);
+    page_size_ = page_size;
   }
   [[nodiscard]] byte *GetData() const {return data_;}
  private:
@@ -146,6 +131,14 @@ inline uint32_t mach_read_from_4(const byte* b) {
       | static_cast<uint32_t>(b[3]);
 }
 
+inline uint64_t mach_read_from_8(const byte* b) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i) {
+    v = (v << 8) | static_cast<unsigned char>(b[i]);
+  }
+  return v;
+}
+
 class BufferPool {
  public:
   explicit BufferPool(size_t pool_size) : buffer_(pool_size) {
@@ -153,26 +146,26 @@ class BufferPool {
       free_list.emplace_back(i);
     }
   }
-  void WritePage(const PageAddress &page_address, const byte *src_buf) {
+  void WritePage(const PageAddress &page_address, const byte *src_buf, page_size_t page_size) {
     std::unique_lock<std::shared_mutex> lock(rw_lock_);
     if (auto iter = location_map_.find(page_address); iter != location_map_.end()) {
-      buffer_[iter->second].SetData(src_buf);
+      buffer_[iter->second].SetData(src_buf, page_size);
     } else {
       auto frame_id = free_list.front();
-      buffer_[frame_id].SetData(src_buf);
+      buffer_[frame_id].SetData(src_buf, page_size);
       location_map_.emplace(page_address, frame_id);
       free_list.pop_front();
     }
   }
-  void ReadPage(const PageAddress &page_address, byte *dest_buf) {
+  // 本地没有这个page时返回false，由调用方去存储节点读
+  bool ReadPage(const PageAddress &page_address, byte *dest_buf, page_size_t page_size) {
     std::shared_lock<std::shared_mutex> lock(rw_lock_);
     if (auto iter = location_map_.find(page_address); iter != location_map_.end()) {
       frame_id_t frame_id = iter->second;
-      std::memcpy(dest_buf, buffer_[frame_id].GetData(), PAGE_SIZE);
-    } else {
-      // unreachable
-      assert(false);
+      std::memcpy(dest_buf, buffer_[frame_id].GetData(), page_size);
+      return true;
     }
+    return false;
   }
  private:
   std::shared_mutex rw_lock_ {};
@@ -183,8 +176,21 @@ class BufferPool {
 
 BufferPool buffer_pool {BUFFER_POOL_SIZE};
 
+// 配置了 LOGDB_PAGE_SERVER 时，本地没有的page通过GETPAGES从存储节点批量读取
+static std::unique_ptr<PageServerClient> page_server {PageServerClient::FromEnv()};
+
+// 配置了 LOGDB_FLASH_CACHE 时，从存储节点读回的干净page再缓存到本地SSD上，
+// 需要page server来校验是否过期，所以只有两者都配置了才会启用
+static std::unique_ptr<FlashCache> flash_cache {page_server != nullptr ? FlashCache::FromEnv() : nullptr};
+
+// 配置了page server时，把刷出的page告诉存储节点，让这些page优先被apply
+static std::unique_ptr<FlushHintSender> flush_hint_sender {
+    page_server != nullptr ? new FlushHintSender(page_server.get()) : nullptr};
+
 static std::unordered_map<int, std::string> fd2filename;
 static std::unordered_map<int, space_id_t> fd2space_id;
+// 只记录压缩表空间，其它的data file是PAGE_SIZE
+static std::unordered_map<int, page_size_t> fd2page_size;
 static std::unordered_set<std::string> logfile_set {
     "./iblogfile0",
     "./iblogfile1"
@@ -245,26 +251,95 @@ static std::unordered_set<std::string> datafile_set {
     "./sbtest/sbtest40.ibd"
 };
 #endif
-static bool is_data_file(int fd) {
+// 系统表空间和undo表空间的page也由存储节点从log生成，和用户表一样只刷到本地buffer pool
+static std::unordered_set<std::string> systemfile_set {
+    "./ibdata1",
+    "./undo001",
+    "./undo002"
+};
+static std::vector<std::string> data_dirs_from_env() {
+  std::vector<std::string> dirs;
+  const char *env = std::getenv("LOGDB_DATA_DIRS");
+  if (env == nullptr) {
+    return dirs;
+  }
+  std::string value(env);
+  for (size_t start = 0; start < value.size();) {
+    auto end = std::min(value.find(':', start), value.size());
+    if (end > start) {
+      dirs.push_back(value.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return dirs;
+}
+// 设置了 LOGDB_DATA_DIRS=./sbtest/:./tpcc/ 时，这些目录下所有的.ibd文件都是data file，
+// 存储节点从MLOG_FILE_CREATE2知道新建的表，新表不用重启就由存储节点生成page
+static std::vector<std::string> datafile_dirs {data_dirs_from_env()};
+static bool is_data_file(const std::string &filename) {
 
-  if (auto iter1 = fd2filename.find(fd); iter1 != fd2filename.end()) {
-    if (auto iter2 = datafile_set.find(iter1->second); iter2 != datafile_set.end()) {
-      return true;
+  if (auto iter = datafile_set.find(filename); iter != datafile_set.end()) {
+    return true;
+  }
+  if (auto iter = systemfile_set.find(filename); iter != systemfile_set.end()) {
+    return true;
+  }
+  if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".ibd") == 0) {
+    for (const auto &dir: datafile_dirs) {
+      if (filename.compare(0, dir.size(), dir) == 0) {
+        return true;
+      }
     }
   }
 
   return false;
 }
 
-static bool is_data_file(const std::string &filename) {
+static bool is_data_file(int fd) {
 
-  if (auto iter = datafile_set.find(filename); iter != datafile_set.end()) {
-    return true;
+  if (auto iter = fd2filename.find(fd); iter != fd2filename.end()) {
+    return is_data_file(iter->second);
   }
 
   return false;
 }
 
+static FileClass file_class(int fd) {
+  if (is_data_file(fd)) {
+    return FileClass::DATA;
+  }
+  if (auto iter = fd2filename.find(fd); iter != fd2filename.end() && logfile_set.count(iter->second) != 0) {
+    return FileClass::LOG;
+  }
+  return FileClass::OTHER;
+}
+
+static void remember_page_size(int fd, const byte *first_page_buf) {
+  uint32_t zip_ssize = (mach_read_from_4(first_page_buf + FSP_SPACE_FLAGS_OFFSET) & FSP_FLAGS_MASK_ZIP_SSIZE)
+      >> FSP_FLAGS_POS_ZIP_SSIZE;
+  if (zip_ssize != 0) {
+    fd2page_size[fd] = static_cast<page_size_t>(512) << zip_ssize;
+  }
+}
+
+static page_size_t data_page_size(int fd) {
+  auto iter = fd2page_size.find(fd);
+  return iter == fd2page_size.end() ? PAGE_SIZE : iter->second;
+}
+
+// 压缩表空间上有存储节点不能apply的log，page由计算节点自己读写文件，不经过本地buffer pool和page server
+static bool is_compressed_data_file(int fd) {
+  return data_page_size(fd) != PAGE_SIZE;
+}
+
+static bool is_checkpoint_write(int fd, off_t offset) {
+  if (offset != LOG_CHECKPOINT_1 && offset != LOG_CHECKPOINT_2) {
+    return false;
+  }
+  auto iter = fd2filename.find(fd);
+  return iter != fd2filename.end() && iter->second == "./iblogfile0";
+}
+
 extern "C" {
 
 typedef int (*orig_open_f_type)(const char *pathname, int flags, ...);
@@ -274,6 +349,7 @@ typedef ssize_t (*orig_pread64_f_type)(int fd, void *buf, size_t count, off_t of
 typedef ssize_t (*orig_pwrite_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef ssize_t (*orig_pwrite64_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef int (*orig_close_f_type)(int fd);
+typedef int (*orig_fsync_f_type)(int fd);
 
 static orig_open_f_type orig_open = (orig_open_f_type)dlsym(RTLD_NEXT, "open");
 static orig_open_f_type orig_open64 = (orig_open64_f_type)dlsym(RTLD_NEXT, "open64");
@@ -282,6 +358,8 @@ static orig_pread_f_type orig_pread64 = (orig_pread64_f_type)dlsym(RTLD_NEXT, "p
 static orig_pwrite_f_type orig_pwrite = (orig_pwrite_f_type)dlsym(RTLD_NEXT, "pwrite");
 static orig_pwrite_f_type orig_pwrite64 = (orig_pwrite64_f_type)dlsym(RTLD_NEXT, "pwrite64");
 static orig_close_f_type orig_close = (orig_close_f_type)dlsym(RTLD_NEXT, "close");
+static orig_fsync_f_type orig_fsync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fsync");
+static orig_fsync_f_type orig_fdatasync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fdatasync");
 
 int open(const char *pathname, int flags, ...) {
   va_list args;
@@ -299,6 +377,7 @@ int open(const char *pathname, int flags, ...) {
     orig_pread(fd, first_page_buf, PAGE_SIZE, 0);
     space_id_t space_id = mach_read_from_4(first_page_buf + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID);
     fd2space_id[fd] = space_id;
+    remember_page_size(fd, first_page_buf);
     printf("%s -> %zu\n", pathname, space_id);
   }
 //  printf("open %s\n", pathname);
@@ -322,34 +401,190 @@ int open64(const char *pathname, int flags, ...) {
     orig_pread(fd, first_page_buf, PAGE_SIZE, 0);
     space_id_t space_id = mach_read_from_4(first_page_buf + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID);
     fd2space_id[fd] = space_id;
+    remember_page_size(fd, first_page_buf);
     printf("%s -> %zu\n", pathname, space_id);
   }
 //  printf("opened %s\n", pathname);
   return fd;
 }
 
-ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
-  auto st = std::chrono::steady_clock::now();
-#ifdef LOG__TRACE
-  printf("%-10s %-30s %-10zu %-10ld\n", "pread", fd2filename[fd].c_str(), count, offset);
-#endif
-  auto sz = orig_pread(fd, buf, count, offset);
-  if (is_data_file(fd)) {
-    space_id_t space_id = fd2space_id[fd];
-    page_id_t start_page_id = offset / PAGE_SIZE;
-    page_id_t end_page_id = (offset + count) / PAGE_SIZE;
-    size_t n_read = 0;
+/**
+ * 从文件中一次读出missing_ids[from]及之后所有缺失的page，只拷贝缺失的page，
+ * 不覆盖buf中已经从buffer pool、flash cache或者page server拿到的page
+ * @return 全部读到时返回count，读到文件末尾时返回从offset开始实际读到的长度
+ */
+static ssize_t read_missing_pages(int fd, size_t count, off_t offset, page_size_t page_size,
+                                  const std::vector<uint32_t> &missing_ids, const std::vector<byte *> &missing_bufs,
+                                  size_t from, orig_pread_f_type read_func) {
+  auto &stats = IoStats::Get();
+  page_id_t first = missing_ids[from];
+  size_t len = (static_cast<size_t>(missing_ids.back()) - first + 1) * page_size;
+  off_t first_offset = static_cast<off_t>(first) * page_size;
+  std::vector<byte> pages(len);
+  auto sz = read_func(fd, pages.data(), len, first_offset);
+  if (sz < 0) {
+    return sz;
+  }
+  for (size_t i = from; i < missing_ids.size(); ++i) {
+    size_t pos = static_cast<size_t>(missing_ids[i] - first) * page_size;
+    if (static_cast<size_t>(sz) < pos + page_size) {
+      stats.RecordPages(PageSource::FILE, i - from);
+      return first_offset - offset + sz;
+    }
+    std::memcpy(missing_bufs[i], pages.data() + pos, page_size);
+  }
+  stats.RecordPages(PageSource::FILE, missing_ids.size() - from);
+  return static_cast<ssize_t>(count);
+}
+
+/**
+ * 读取data file中的page：优先读本地buffer pool，其次是本地SSD上的flash cache，
+ * 缺失的page通过GETPAGES批量从存储节点读取，一次RPC可以带回多个不连续的page，
+ * page server不可用或者是压缩表空间时退回到原始的pread
+ */
+static ssize_t read_data_file(int fd, void *buf, size_t count, off_t offset, orig_pread_f_type read_func) {
+  space_id_t space_id = fd2space_id[fd];
+  page_size_t page_size = data_page_size(fd);
+  page_id_t start_page_id = offset / page_size;
+  page_id_t end_page_id = (offset + count) / page_size;
+  auto *dest = static_cast<byte *>(buf);
+
+  auto &stats = IoStats::Get();
+  if (page_server == nullptr || is_compressed_data_file(fd) || offset % page_size != 0 || count % page_size != 0) {
+    auto sz = read_func(fd, buf, count, offset);
+    size_t n_hit = 0;
     for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
-      buffer_pool.ReadPage({space_id, page_id}, static_cast<byte *>(buf) + n_read);
-      n_read += PAGE_SIZE;
+      n_hit += buffer_pool.ReadPage({space_id, page_id}, dest + (page_id - start_page_id) * page_size, page_size)
+          ? 1 : 0;
+    }
+    stats.RecordPages(PageSource::BUFFER_POOL, n_hit);
+    stats.RecordPages(PageSource::FILE, end_page_id - start_page_id - n_hit);
+    return sz;
+  }
+
+  std::vector<uint32_t> missing_ids;
+  std::vector<byte *> missing_bufs;
+  for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
+    auto *page_buf = dest + (page_id - start_page_id) * page_size;
+    if (!buffer_pool.ReadPage({space_id, page_id}, page_buf, page_size)) {
+      missing_ids.push_back(static_cast<uint32_t>(page_id));
+      missing_bufs.push_back(page_buf);
+    }
+  }
+  stats.RecordPages(PageSource::BUFFER_POOL, end_page_id - start_page_id - missing_ids.size());
+
+  // flash cache的slot是PAGE_SIZE大小，压缩表空间的page不缓存
+  bool use_flash_cache = flash_cache != nullptr && page_size == PAGE_SIZE;
+  if (use_flash_cache && !missing_ids.empty()) {
+    // 先看看flash cache里有没有，有的话只需要一次SPACELSN就能确认它们是否过期
+    bool any_cached = false;
+    for (auto page_id : missing_ids) {
+      if (flash_cache->Contains(static_cast<uint32_t>(space_id), page_id)) {
+        any_cached = true;
+        break;
+      }
+    }
+    uint64_t space_lsn;
+    if (any_cached && page_server->SpaceLsn(static_cast<uint32_t>(space_id), space_lsn)) {
+      size_t n_missing = 0;
+      for (size_t i = 0; i < missing_ids.size(); ++i) {
+        if (!flash_cache->Read(static_cast<uint32_t>(space_id), missing_ids[i], space_lsn, missing_bufs[i])) {
+          missing_ids[n_missing] = missing_ids[i];
+          missing_bufs[n_missing] = missing_bufs[i];
+          n_missing++;
+        }
+      }
+      stats.RecordPages(PageSource::FLASH_CACHE, missing_ids.size() - n_missing);
+      missing_ids.resize(n_missing);
+      missing_bufs.resize(n_missing);
+    }
+  }
+
+  std::vector<bool> page_ok;
+  for (size_t i = 0; i < missing_ids.size(); i += LOGDB_MAX_PAGES) {
+    auto n = std::min(LOGDB_MAX_PAGES, missing_ids.size() - i);
+    std::vector<uint32_t> batch_ids(missing_ids.begin() + i, missing_ids.begin() + i + n);
+    std::vector<byte *> batch_bufs(missing_bufs.begin() + i, missing_bufs.begin() + i + n);
+    uint64_t parsed_lsn = 0;
+    uint64_t ticket = use_flash_cache ? flash_cache->FillTicket() : 0;
+    if (!page_server->GetPages(static_cast<uint32_t>(space_id), batch_ids, 0, batch_bufs, page_ok, &parsed_lsn,
+                               page_size)) {
+      // 存储节点不负责这个表空间或者RPC失败，剩下的page不再发GETPAGES，一次pread读出来
+      return read_missing_pages(fd, count, offset, page_size, missing_ids, missing_bufs, i, read_func);
+    }
+    for (size_t j = 0; j < n; ++j) {
+      if (page_ok[j]) {
+        stats.RecordPages(PageSource::PAGE_SERVER, 1);
+        if (use_flash_cache) {
+          flash_cache->Insert(static_cast<uint32_t>(space_id), batch_ids[j], parsed_lsn, ticket, batch_bufs[j]);
+        }
+        continue;
+      }
+      // page server上没有这个page（比如超出了文件末尾），按原来的方式读
+      stats.RecordPages(PageSource::FILE, 1);
+      off_t page_offset = static_cast<off_t>(batch_ids[j]) * page_size;
+      auto sz = read_func(fd, batch_bufs[j], page_size, page_offset);
+      if (sz < static_cast<ssize_t>(page_size)) {
+        return sz < 0 ? sz : page_offset - offset + sz;
+      }
+    }
+  }
+  return static_cast<ssize_t>(count);
+}
+
+// 本地buffer pool中的page由catcher接管，写data file只更新本地的page
+static ssize_t write_data_file(int fd, const void *buf, size_t count, off_t offset) {
+  space_id_t space_id = fd2space_id[fd];
+  page_size_t page_size = data_page_size(fd);
+  page_id_t start_page_id = offset / page_size;
+  page_id_t end_page_id = (offset + count) / page_size;
+  size_t n_write = 0;
+  for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
+    buffer_pool.WritePage({space_id, page_id}, static_cast<const byte *>(buf) + n_write, page_size);
+    if (flash_cache != nullptr) {
+      flash_cache->Invalidate(static_cast<uint32_t>(space_id), static_cast<uint32_t>(page_id));
+    }
+    if (flush_hint_sender != nullptr) {
+      flush_hint_sender->Add(static_cast<uint32_t>(space_id), static_cast<uint32_t>(page_id),
+                             mach_read_from_8(static_cast<const byte *>(buf) + n_write + FIL_PAGE_LSN));
     }
+    n_write += page_size;
   }
+  return static_cast<ssize_t>(count);
+}
+
+/**
+ * 推进checkpoint之前，存储节点必须已经apply了之前刷出的page。
+ * 一直得不到确认时，自己把这些page从本地buffer pool写到data file，checkpoint之后它们不再依赖redo
+ */
+/**
+ * 等存储节点确认checkpoint之前刷出的所有page，确认之前checkpoint不能推进。
+ * 不能自己把page写到data file：存储节点上的page可能已经apply得比本地的更新，会被旧的page覆盖
+ */
+static void sync_flush_hints() {
+  for (int retry = 1; !flush_hint_sender->Sync(); ++retry) {
+    if (retry % FLUSH_HINT_SYNC_WARN_RETRIES == 0) {
+      fprintf(stderr, "LOGDB FLUSHHINTS failed %d times, the checkpoint waits for the storage node\n", retry);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_HINT_SYNC_RETRY_MS));
+  }
+}
+
+static void record_io(IoOp op, FileClass file_class, std::chrono::steady_clock::time_point st, ssize_t sz) {
   auto ed = std::chrono::steady_clock::now();
+  IoStats::Get().RecordIo(op, file_class, std::chrono::duration_cast<std::chrono::nanoseconds>(ed - st).count(),
+                          sz > 0 ? static_cast<size_t>(sz) : 0);
+}
 
-  status.lock.lock();
-  status.read_latency.emplace_back((ed - st).count());
-  status.total_read += sz;
-  status.lock.unlock();
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+  auto st = std::chrono::steady_clock::now();
+#ifdef LOG__TRACE
+  printf("%-10s %-30s %-10zu %-10ld\n", "pread", fd2filename[fd].c_str(), count, offset);
+#endif
+  auto cls = file_class(fd);
+  auto sz = cls == FileClass::DATA ? read_data_file(fd, buf, count, offset, orig_pread)
+                                   : orig_pread(fd, buf, count, offset);
+  record_io(IoOp::READ, cls, st, sz);
   return sz;
 }
 
@@ -358,75 +593,69 @@ ssize_t pread64(int fd, void *buf, size_t count, off_t offset) {
 #ifdef LOG__TRACE
   printf("%-10s %-30s %-10zu %-10ld\n", "pread64", fd2filename[fd].c_str(), count, offset);
 #endif
-  auto sz = orig_pread64(fd, buf, count, offset);
-  if (is_data_file(fd)) {
-    space_id_t space_id = fd2space_id[fd];
-    page_id_t start_page_id = offset / PAGE_SIZE;
-    page_id_t end_page_id = (offset + count) / PAGE_SIZE;
-    size_t n_read = 0;
-    for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
-      buffer_pool.ReadPage({space_id, page_id}, static_cast<byte *>(buf) + n_read);
-      n_read += PAGE_SIZE;
-    }
-  }
-  auto ed = std::chrono::steady_clock::now();
-  status.lock.lock();
-  status.read_latency.emplace_back((ed - st).count());
-  status.total_read += sz;
-  status.lock.unlock();
+  auto cls = file_class(fd);
+  auto sz = cls == FileClass::DATA ? read_data_file(fd, buf, count, offset, orig_pread64)
+                                   : orig_pread64(fd, buf, count, offset);
+  record_io(IoOp::READ, cls, st, sz);
   return sz;
 }
 
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
-  // if data page write, just return
-  if (is_data_file(fd)) {
-    space_id_t space_id = fd2space_id[fd];
-    page_id_t start_page_id = offset / PAGE_SIZE;
-    page_id_t end_page_id = (offset + count) / PAGE_SIZE;
-    size_t n_write = 0;
-    for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
-      buffer_pool.WritePage({space_id, page_id}, static_cast<const byte *>(buf) + n_write);
-      n_write += PAGE_SIZE;
-    }
-    return static_cast<ssize_t>(count);
+  auto st = std::chrono::steady_clock::now();
+  auto cls = file_class(fd);
+  // if data page write, just keep it in the local buffer pool
+  if (cls == FileClass::DATA && !is_compressed_data_file(fd)) {
+    auto sz = write_data_file(fd, buf, count, offset);
+    record_io(IoOp::WRITE, cls, st, sz);
+    return sz;
   }
   // otherwise, call the original pwrite function
 #ifdef LOG__TRACE
   printf("%-10s %-30s %-10zu %-10ld\n", "pwrite", fd2filename[fd].c_str(), count, offset);
 #endif
+  if (flush_hint_sender != nullptr && is_checkpoint_write(fd, offset)) {
+    // checkpoint之前刷出的page必须已经在存储节点上apply完，才能推进checkpoint
+    sync_flush_hints();
+  }
   auto sz = orig_pwrite(fd, buf, count, offset);
-
-  status.lock.lock();
-  status.total_write += sz;
-  status.lock.unlock();
-
+  record_io(IoOp::WRITE, cls, st, sz);
   return sz;
 }
 
 ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
-  // if data page write, just return
-  if (is_data_file(fd)) {
-    space_id_t space_id = fd2space_id[fd];
-    page_id_t start_page_id = offset / PAGE_SIZE;
-    page_id_t end_page_id = (offset + count) / PAGE_SIZE;
-    size_t n_write = 0;
-    for (page_id_t page_id = start_page_id; page_id < end_page_id; ++page_id) {
-      buffer_pool.WritePage({space_id, page_id}, static_cast<const byte *>(buf) + n_write);
-      n_write += PAGE_SIZE;
-    }
-    return static_cast<ssize_t>(count);
+  auto st = std::chrono::steady_clock::now();
+  auto cls = file_class(fd);
+  // if data page write, just keep it in the local buffer pool
+  if (cls == FileClass::DATA && !is_compressed_data_file(fd)) {
+    auto sz = write_data_file(fd, buf, count, offset);
+    record_io(IoOp::WRITE, cls, st, sz);
+    return sz;
   }
   // otherwise, call the original pwrite function
 #ifdef LOG__TRACE
   printf("%-10s %-30s %-10zu %-10ld\n", "pwrite64", fd2filename[fd].c_str(), count, offset);
 #endif
+  if (flush_hint_sender != nullptr && is_checkpoint_write(fd, offset)) {
+    // checkpoint之前刷出的page必须已经在存储节点上apply完，才能推进checkpoint
+    sync_flush_hints();
+  }
   auto sz = orig_pwrite64(fd, buf, count, offset);
+  record_io(IoOp::WRITE, cls, st, sz);
+  return sz;
+}
 
-  status.lock.lock();
-  status.total_write += sz;
-  status.lock.unlock();
+int fsync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fsync(fd);
+  record_io(IoOp::SYNC, file_class(fd), st, 0);
+  return ret;
+}
 
-  return sz;
+int fdatasync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fdatasync(fd);
+  record_io(IoOp::SYNC, file_class(fd), st, 0);
+  return ret;
 }
 
 ssize_t close(int fd) {
@@ -435,6 +664,7 @@ ssize_t close(int fd) {
 #endif
   if (is_data_file(fd)) {
     fd2space_id.erase(fd);
+    fd2page_size.erase(fd);
   }
   fd2filename.erase(fd);
 
@@ -13,6 +13,8 @@
 #include <cassert>
 #include <numeric>
 #include <algorithm>
+#include <chrono>
+#include "io_stats.h"
 #define SYSBENCH
 using space_id_t = size_t;
 using page_id_t = size_t;
@@ -20,40 +22,6 @@ using page_size_t = size_t;
 using frame_id_t = size_t;
 using byte = char;
 
-//class Status {
-// public:
-//  ~Status() {
-//    printf("total_read: %lu\n", total_read);
-//    printf("total_write: %lu\n", total_write);
-//    auto total_call = read_latency.size();
-//
-//    std::sort(read_latency.begin(), read_latency.end());
-//    auto sum_latency = std::accumulate(read_latency.begin(), read_latency.end(), (uint64_t)0);
-//    auto avg_latency = sum_latency / total_call;
-//    auto min_latency = read_latency[0];
-//    auto max_latency = read_latency[total_call - 1];
-//    printf("performed %zu pread call, min latency: %d, max latency: %d, avg latency: %lu\n",
-//           total_call, min_latency, max_latency, avg_latency);
-//
-//    auto total_call95 = static_cast<int>((static_cast<double>(total_call) * 0.95));
-//    auto sum_latency95 = std::accumulate(read_latency.begin(),
-//                                         read_latency.begin() + total_call95,
-//                                         (uint64_t)0);
-//    auto avg_latency95 = sum_latency95 / total_call95;
-//    auto min_latency95 = read_latency[0];
-//    auto max_latency95 = read_latency[total_call95 - 1];
-//    printf("min latency of 95%% calls: %d, max latency of 95%% calls: %d, avg latency of 95%% calls: %lu\n",
-//           min_latency95, max_latency95, avg_latency95);
-//
-//  }
-//  std::mutex lock;
-//  uint64_t total_read {};
-//  uint64_t total_write {};
-//  std::vector<int> read_latency {};
-//};
-
-//Status status;
-
 static constexpr const page_size_t PAGE_SIZE = 16384;
 static constexpr uint32_t FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID = 34;
 
@@ -151,6 +119,22 @@ static bool is_data_file(const std::string &filename) {
   return false;
 }
 
+static FileClass file_class(int fd) {
+  if (is_data_file(fd)) {
+    return FileClass::DATA;
+  }
+  if (auto iter = fd2filename.find(fd); iter != fd2filename.end() && logfile_set.count(iter->second) != 0) {
+    return FileClass::LOG;
+  }
+  return FileClass::OTHER;
+}
+
+static void record_io(IoOp op, FileClass file_class, std::chrono::steady_clock::time_point st, ssize_t sz) {
+  auto ed = std::chrono::steady_clock::now();
+  IoStats::Get().RecordIo(op, file_class, std::chrono::duration_cast<std::chrono::nanoseconds>(ed - st).count(),
+                          sz > 0 ? static_cast<size_t>(sz) : 0);
+}
+
 extern "C" {
 
 typedef int (*orig_open_f_type)(const char *pathname, int flags, ...);
@@ -160,6 +144,7 @@ typedef ssize_t (*orig_pread64_f_type)(int fd, void *buf, size_t count, off_t of
 typedef ssize_t (*orig_pwrite_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef ssize_t (*orig_pwrite64_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef int (*orig_close_f_type)(int fd);
+typedef int (*orig_fsync_f_type)(int fd);
 
 static orig_open_f_type orig_open = (orig_open_f_type)dlsym(RTLD_NEXT, "open");
 static orig_open_f_type orig_open64 = (orig_open64_f_type)dlsym(RTLD_NEXT, "open64");
@@ -168,6 +153,8 @@ static orig_pread_f_type orig_pread64 = (orig_pread64_f_type)dlsym(RTLD_NEXT, "p
 static orig_pwrite_f_type orig_pwrite = (orig_pwrite_f_type)dlsym(RTLD_NEXT, "pwrite");
 static orig_pwrite_f_type orig_pwrite64 = (orig_pwrite64_f_type)dlsym(RTLD_NEXT, "pwrite64");
 static orig_close_f_type orig_close = (orig_close_f_type)dlsym(RTLD_NEXT, "close");
+static orig_fsync_f_type orig_fsync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fsync");
+static orig_fsync_f_type orig_fdatasync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fdatasync");
 
 int open(const char *pathname, int flags, ...) {
   va_list args;
@@ -222,55 +209,61 @@ int open64(const char *pathname, int flags, ...) {
 }
 
 ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
-//  auto st = std::chrono::steady_clock::now();
+  auto st = std::chrono::steady_clock::now();
 #ifdef LOG__TRACE
   printf("%-10s %-30s %-10zu %-10ld\n", "pread", fd2filename[fd].c_str(), count, offset);
 #endif
+  auto cls = file_class(fd);
   //first check fromlocal buf
   if(local_buf.find(fd)!=local_buf.end()){
     std::unordered_map<off_t, char*>* tmp = local_buf[fd];
     if(tmp->find(offset)!=tmp->end()){
       char* tmp_buf = (*tmp)[offset];
       memcpy(buf,tmp_buf,count);
+      IoStats::Get().RecordPages(PageSource::BUFFER_POOL, count / PAGE_SIZE);
+      record_io(IoOp::READ, cls, st, count);
       return count;
     }
   }
 
   auto sz = orig_pread(fd, buf, count, offset);
-//  auto ed = std::chrono::steady_clock::now();
-//  status.lock.lock();
-//  status.read_latency.emplace_back((ed - st).count());
-//  status.total_read += sz;
-//  status.lock.unlock();
+  if (cls == FileClass::DATA) {
+    IoStats::Get().RecordPages(PageSource::FILE, count / PAGE_SIZE);
+  }
+  record_io(IoOp::READ, cls, st, sz);
   return sz;
 }
 
 ssize_t pread64(int fd, void *buf, size_t count, off_t offset) {
-//  auto st = std::chrono::steady_clock::now();
+  auto st = std::chrono::steady_clock::now();
 #ifdef LOG__TRACE
   printf("%-10s %-30s %-10zu %-10ld\n", "pread64", fd2filename[fd].c_str(), count, offset);
 #endif
+  auto cls = file_class(fd);
   //first check fromlocal buf
   if(local_buf.find(fd)!=local_buf.end()){
     std::unordered_map<off_t, char*>* tmp = local_buf[fd];
     if(tmp->find(offset)!=tmp->end()){
       char* tmp_buf = (*tmp)[offset];
       memcpy(buf,tmp_buf,count);
+      IoStats::Get().RecordPages(PageSource::BUFFER_POOL, count / PAGE_SIZE);
+      record_io(IoOp::READ, cls, st, count);
       return count;
     }
   }
   auto sz = orig_pread64(fd, buf, count, offset);
-//  auto ed = std::chrono::steady_clock::now();
-//  status.lock.lock();
-//  status.read_latency.emplace_back((ed - st).count());
-//  status.total_read += sz;
-//  status.lock.unlock();
+  if (cls == FileClass::DATA) {
+    IoStats::Get().RecordPages(PageSource::FILE, count / PAGE_SIZE);
+  }
+  record_io(IoOp::READ, cls, st, sz);
   return sz;
 }
 
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  auto st = std::chrono::steady_clock::now();
+  auto cls = file_class(fd);
   // if data page write, just return
-  if (is_data_file(fd)) {
+  if (cls == FileClass::DATA) {
     //insert page into lcoal buf
     if(local_buf.find(fd)==local_buf.end()){
       printf("hkc-test fd error!\n");
@@ -287,6 +280,7 @@ ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
         tmp->emplace(offset,tmp_buf);
       }
     }
+    record_io(IoOp::WRITE, cls, st, count);
     return static_cast<ssize_t>(count);
   }
   // otherwise, call the original pwrite function
@@ -294,17 +288,15 @@ ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
   printf("%-10s %-30s %-10zu %-10ld\n", "pwrite", fd2filename[fd].c_str(), count, offset);
 #endif
   auto sz = orig_pwrite(fd, buf, count, offset);
-
-//  status.lock.lock();
-//  status.total_write += sz;
-//  status.lock.unlock();
-
+  record_io(IoOp::WRITE, cls, st, sz);
   return sz;
 }
 
 ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
+  auto st = std::chrono::steady_clock::now();
+  auto cls = file_class(fd);
   // if data page write, just return
-  if (is_data_file(fd)) {
+  if (cls == FileClass::DATA) {
 
     //insert page into lcoal buf
     if(local_buf.find(fd)==local_buf.end()){
@@ -323,6 +315,7 @@ ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
       }
     }
 
+    record_io(IoOp::WRITE, cls, st, count);
     return static_cast<ssize_t>(count);
   }
   // otherwise, call the original pwrite function
@@ -330,12 +323,22 @@ ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
   printf("%-10s %-30s %-10zu %-10ld\n", "pwrite64", fd2filename[fd].c_str(), count, offset);
 #endif
   auto sz = orig_pwrite64(fd, buf, count, offset);
+  record_io(IoOp::WRITE, cls, st, sz);
+  return sz;
+}
 
-//  status.lock.lock();
-//  status.total_write += sz;
-//  status.lock.unlock();
+int fsync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fsync(fd);
+  record_io(IoOp::SYNC, file_class(fd), st, 0);
+  return ret;
+}
 
-  return sz;
+int fdatasync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fdatasync(fd);
+  record_io(IoOp::SYNC, file_class(fd), st, 0);
+  return ret;
 }
 
 ssize_t close(int fd) {
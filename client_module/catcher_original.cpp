@@ -1,4 +1,6 @@
 #include <dlfcn.h>
+#include <atomic>
+#include <string_view>
 #include <cstdarg>
 #include <cstdio>
 #include <string>
@@ -9,39 +11,43 @@
 #include <algorithm>
 #include <numeric>
 #include <thread>
-class Status {
- public:
-  ~Status() {
-    printf("total_read: %lu\n", total_read);
-    printf("total_write: %lu\n", total_write);
-    auto total_call = read_latency.size();
-
-    std::sort(read_latency.begin(), read_latency.end());
-    auto sum_latency = std::accumulate(read_latency.begin(), read_latency.end(), (uint64_t)0);
-    auto avg_latency = sum_latency / total_call;
-    auto min_latency = read_latency[0];
-    auto max_latency = read_latency[total_call - 1];
-    printf("performed %zu pread call, min latency: %d, max latency: %d, avg latency: %lu\n",
-           total_call, min_latency, max_latency, avg_latency);
-
-    auto total_call95 = static_cast<int>((static_cast<double>(total_call) * 0.95));
-    auto sum_latency95 = std::accumulate(read_latency.begin(),
-                                         read_latency.begin() + total_call95,
-                                         (uint64_t)0);
-    auto avg_latency95 = sum_latency95 / total_call95;
-    auto min_latency95 = read_latency[0];
-    auto max_latency95 = read_latency[total_call95 - 1];
-    printf("min latency of 95%% calls: %d, max latency of 95%% calls: %d, avg latency of 95%% calls: %lu\n",
-           min_latency95, max_latency95, avg_latency95);
+#include "io_stats.h"
+static constexpr int MAX_TRACKED_FD = 65536;
 
+// 这里不维护fd到文件名的映射，只在open时按文件名粗略分类，0表示没有经过open记录的fd
+static std::atomic<uint8_t> fd_class[MAX_TRACKED_FD];
+
+static FileClass classify(const char *pathname) {
+  std::string_view name(pathname);
+  if (name.size() > 4 && name.substr(name.size() - 4) == ".ibd") {
+    return FileClass::DATA;
+  }
+  if (name.find("iblogfile") != std::string_view::npos || name.find("ib_logfile") != std::string_view::npos) {
+    return FileClass::LOG;
   }
-  std::mutex lock;
-  uint64_t total_read {};
-  uint64_t total_write {};
-  std::vector<int> read_latency {};
-};
+  return FileClass::OTHER;
+}
 
-Status status;
+static void set_file_class(int fd, const char *pathname) {
+  if (fd >= 0 && fd < MAX_TRACKED_FD) {
+    fd_class[fd].store(static_cast<uint8_t>(classify(pathname)) + 1, std::memory_order_relaxed);
+  }
+}
+
+static FileClass file_class(int fd) {
+  if (fd >= 0 && fd < MAX_TRACKED_FD) {
+    if (auto cls = fd_class[fd].load(std::memory_order_relaxed); cls != 0) {
+      return static_cast<FileClass>(cls - 1);
+    }
+  }
+  return FileClass::OTHER;
+}
+
+static void record_io(IoOp op, int fd, std::chrono::steady_clock::time_point st, ssize_t sz) {
+  auto ed = std::chrono::steady_clock::now();
+  IoStats::Get().RecordIo(op, file_class(fd), std::chrono::duration_cast<std::chrono::nanoseconds>(ed - st).count(),
+                          sz > 0 ? static_cast<size_t>(sz) : 0);
+}
 
 extern "C" {
 typedef int (*orig_open_f_type)(const char *pathname, int flags, ...);
@@ -51,6 +57,7 @@ typedef ssize_t (*orig_pread64_f_type)(int fd, void *buf, size_t count, off_t of
 typedef ssize_t (*orig_pwrite_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef ssize_t (*orig_pwrite64_f_type)(int fd, const void *buf, size_t count, off_t offset);
 typedef int (*orig_close_f_type)(int fd);
+typedef int (*orig_fsync_f_type)(int fd);
 
 static orig_open_f_type orig_open = (orig_open_f_type)dlsym(RTLD_NEXT, "open");
 static orig_open_f_type orig_open64 = (orig_open64_f_type)dlsym(RTLD_NEXT, "open64");
@@ -59,6 +66,8 @@ static orig_pread_f_type orig_pread64 = (orig_pread64_f_type)dlsym(RTLD_NEXT, "p
 static orig_pwrite_f_type orig_pwrite = (orig_pwrite_f_type)dlsym(RTLD_NEXT, "pwrite");
 static orig_pwrite_f_type orig_pwrite64 = (orig_pwrite64_f_type)dlsym(RTLD_NEXT, "pwrite64");
 static orig_close_f_type orig_close = (orig_close_f_type)dlsym(RTLD_NEXT, "close");
+static orig_fsync_f_type orig_fsync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fsync");
+static orig_fsync_f_type orig_fdatasync = (orig_fsync_f_type)dlsym(RTLD_NEXT, "fdatasync");
 
 int open(const char *pathname, int flags, ...) {
   va_list args;
@@ -66,6 +75,7 @@ int open(const char *pathname, int flags, ...) {
   va_start(args, flags);
   auto fd = orig_open(pathname, flags, va_arg(args, mode_t));
   va_end(args);
+  set_file_class(fd, pathname);
   return fd;
 }
 
@@ -75,6 +85,7 @@ int open64(const char *pathname, int flags, ...) {
   va_start(args, flags);
   auto fd = orig_open64(pathname, flags, va_arg(args, mode_t));
   va_end(args);
+  set_file_class(fd, pathname);
   return fd;
 }
 
@@ -83,12 +94,7 @@ ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
 //  std::this_thread::sleep_for(std::chrono::milliseconds(8));
   auto st = std::chrono::steady_clock::now();
   auto ret_val = orig_pread(fd, buf, count, offset);
-  auto ed = std::chrono::steady_clock::now();
-
-  status.lock.lock();
-  status.total_read += count;
-  status.read_latency.emplace_back((ed - st).count());
-  status.lock.unlock();
+  record_io(IoOp::READ, fd, st, ret_val);
 
   return ret_val;
 }
@@ -98,37 +104,41 @@ ssize_t pread64(int fd, void *buf, size_t count, off_t offset) {
 //  std::this_thread::sleep_for(std::chrono::milliseconds(8));
   auto st = std::chrono::steady_clock::now();
   auto ret_val = orig_pread64(fd, buf, count, offset);
-  auto ed = std::chrono::steady_clock::now();
-
-  status.lock.lock();
-  status.total_read += count;
-  status.read_latency.emplace_back((ed - st).count());
-  status.lock.unlock();
+  record_io(IoOp::READ, fd, st, ret_val);
 
   return ret_val;
 }
 
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
-
+  auto st = std::chrono::steady_clock::now();
   auto ret_val = orig_pwrite(fd, buf, count, offset);
-
-  status.lock.lock();
-  status.total_write += count;
-  status.lock.unlock();
+  record_io(IoOp::WRITE, fd, st, ret_val);
 
   return ret_val;
 }
 
 ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
+  auto st = std::chrono::steady_clock::now();
   auto ret_val = orig_pwrite64(fd, buf, count, offset);
-
-  status.lock.lock();
-  status.total_write += count;
-  status.lock.unlock();
+  record_io(IoOp::WRITE, fd, st, ret_val);
 
   return ret_val;
 }
 
+int fsync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fsync(fd);
+  record_io(IoOp::SYNC, fd, st, 0);
+  return ret;
+}
+
+int fdatasync(int fd) {
+  auto st = std::chrono::steady_clock::now();
+  auto ret = orig_fdatasync(fd);
+  record_io(IoOp::SYNC, fd, st, 0);
+  return ret;
+}
+
 ssize_t close(int fd) {
   return orig_close(fd);
 }
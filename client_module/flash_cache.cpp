@@ -0,0 +1,190 @@
+#include "flash_cache.h"
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "page_server_client.h"
+
+namespace {
+
+constexpr size_t DEFAULT_FLASH_CACHE_MB = 4096;
+
+// 用preadv/pwritev访问缓存文件，避免进入catcher拦截的pread/pwrite
+bool read_slot(int fd, uint32_t slot_id, char *dest_buf) {
+  iovec iov {dest_buf, LOGDB_PAGE_SIZE};
+  return ::preadv(fd, &iov, 1, static_cast<off_t>(slot_id) * LOGDB_PAGE_SIZE)
+      == static_cast<ssize_t>(LOGDB_PAGE_SIZE);
+}
+
+bool write_slot(int fd, uint32_t slot_id, const char *src_buf) {
+  iovec iov {const_cast<char *>(src_buf), LOGDB_PAGE_SIZE};
+  return ::pwritev(fd, &iov, 1, static_cast<off_t>(slot_id) * LOGDB_PAGE_SIZE)
+      == static_cast<ssize_t>(LOGDB_PAGE_SIZE);
+}
+
+}  // namespace
+
+FlashCache *FlashCache::FromEnv() {
+  const char *path = std::getenv("LOGDB_FLASH_CACHE");
+  if (path == nullptr || *path == '\0') {
+    return nullptr;
+  }
+  size_t size_mb = DEFAULT_FLASH_CACHE_MB;
+  if (const char *env = std::getenv("LOGDB_FLASH_CACHE_MB"); env != nullptr && std::atol(env) > 0) {
+    size_mb = std::atol(env);
+  }
+  // 索引只在内存中，重启之后缓存文件的内容没有意义，直接截断
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    fprintf(stderr, "can not open flash cache %s\n", path);
+    return nullptr;
+  }
+  auto n_slots = size_mb * 1024 * 1024 / LOGDB_PAGE_SIZE;
+  if (::ftruncate(fd, static_cast<off_t>(n_slots * LOGDB_PAGE_SIZE)) != 0) {
+    fprintf(stderr, "can not allocate %zu MB for flash cache %s\n", size_mb, path);
+    ::close(fd);
+    return nullptr;
+  }
+  return new FlashCache(fd, n_slots);
+}
+
+FlashCache::FlashCache(int fd, size_t n_slots) : fd_(fd), slots_(n_slots) {
+  index_.reserve(n_slots);
+}
+
+FlashCache::~FlashCache() {
+  ::close(fd_);
+}
+
+bool FlashCache::Contains(uint32_t space_id, uint32_t page_id) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return index_.find(Key(space_id, page_id)) != index_.end();
+}
+
+bool FlashCache::Read(uint32_t space_id, uint32_t page_id, uint64_t space_lsn, char *dest_buf) {
+  auto key = Key(space_id, page_id);
+  uint32_t slot_id;
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto iter = index_.find(key);
+    if (iter == index_.end()) {
+      return false;
+    }
+    slot_id = iter->second;
+    auto &slot = slots_[slot_id];
+    if (slot.as_of_lsn < space_lsn) {
+      // 这个page被读回来之后，表空间上又有了新的log
+      EraseLocked(key);
+      return false;
+    }
+    slot.referenced = true;
+    slot.pin_count++;
+    generation = slot.generation;
+  }
+
+  auto ok = read_slot(fd_, slot_id, dest_buf);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  slots_[slot_id].pin_count--;
+  if (!ok) {
+    // 读取期间key可能已经被Insert换到了别的slot，不能删掉新插入的page
+    EraseSlotLocked(key, slot_id, generation);
+  }
+  return ok;
+}
+
+uint64_t FlashCache::FillTicket() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return invalidate_seq_;
+}
+
+void FlashCache::Insert(uint32_t space_id, uint32_t page_id, uint64_t as_of_lsn, uint64_t ticket,
+                        const char *src_buf) {
+  auto key = Key(space_id, page_id);
+  auto bucket = InvalidateBucket(key);
+  uint32_t slot_id;
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (invalidated_at_[bucket] > ticket) {
+      // 从存储节点读这个page之后本地又写过它，读回来的内容可能已经过期
+      return;
+    }
+    EraseLocked(key);
+    if (!PickVictim(slot_id)) {
+      return;
+    }
+    auto &slot = slots_[slot_id];
+    slot.key = key;
+    slot.as_of_lsn = as_of_lsn;
+    slot.generation = ++next_generation_;
+    slot.pin_count = 1;
+    generation = slot.generation;
+  }
+
+  auto ok = write_slot(fd_, slot_id, src_buf);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  auto &slot = slots_[slot_id];
+  slot.pin_count--;
+  // 写入期间同一个page可能已经被重新插入，以后插入的为准；也可能已经被Invalidate
+  if (!ok || slot.generation != generation || index_.find(key) != index_.end()
+      || invalidated_at_[bucket] > ticket) {
+    return;
+  }
+  slot.used = true;
+  slot.referenced = false;
+  index_.emplace(key, slot_id);
+}
+
+void FlashCache::Invalidate(uint32_t space_id, uint32_t page_id) {
+  auto key = Key(space_id, page_id);
+  std::lock_guard<std::mutex> guard(lock_);
+  invalidated_at_[InvalidateBucket(key)] = ++invalidate_seq_;
+  EraseLocked(key);
+}
+
+bool FlashCache::PickVictim(uint32_t &slot_id) {
+  // 最多扫两圈：第一圈清掉访问位，第二圈一定能找到没有被pin住的slot
+  for (size_t i = 0; i < slots_.size() * 2; ++i) {
+    auto &slot = slots_[hand_];
+    auto current = hand_;
+    hand_ = (hand_ + 1) % slots_.size();
+    if (slot.pin_count > 0) {
+      continue;
+    }
+    if (slot.used && slot.referenced) {
+      slot.referenced = false;
+      continue;
+    }
+    if (slot.used) {
+      index_.erase(slot.key);
+      slot.used = false;
+    }
+    slot_id = static_cast<uint32_t>(current);
+    return true;
+  }
+  return false;
+}
+
+void FlashCache::EraseLocked(uint64_t key) {
+  auto iter = index_.find(key);
+  if (iter == index_.end()) {
+    return;
+  }
+  auto &slot = slots_[iter->second];
+  slot.used = false;
+  slot.referenced = false;
+  index_.erase(iter);
+}
+
+void FlashCache::EraseSlotLocked(uint64_t key, uint32_t slot_id, uint64_t generation) {
+  auto iter = index_.find(key);
+  if (iter == index_.end() || iter->second != slot_id || slots_[slot_id].generation != generation) {
+    return;
+  }
+  EraseLocked(key);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 计算节点本地SSD上的二级page缓存，只缓存从存储节点读回来的干净page。
+ * 内存中只保留一个紧凑的索引 (space_id, page_id) -> slot，page内容放在SSD上的缓存文件里。
+ * 每个page记录它被读回时存储节点已经解析到的lsn，使用前要和存储节点上该表空间
+ * 最后一条log的lsn比较，过期的page不会被返回。
+ */
+class FlashCache {
+ public:
+  /**
+   * 从环境变量 LOGDB_FLASH_CACHE=/path/to/cache_file 和 LOGDB_FLASH_CACHE_MB 创建
+   * @return 没有配置时返回nullptr
+   */
+  static FlashCache *FromEnv();
+
+  FlashCache(int fd, size_t n_slots);
+  ~FlashCache();
+
+  // 是否缓存了这个page，不检查是否过期
+  bool Contains(uint32_t space_id, uint32_t page_id);
+
+  /**
+   * 读取缓存的page
+   * @param space_lsn 存储节点上该表空间最后一条log的结束lsn，早于它的page被视为过期并被删除
+   * @return 命中并且没有过期时返回true
+   */
+  bool Read(uint32_t space_id, uint32_t page_id, uint64_t space_lsn, char *dest_buf);
+
+  /**
+   * 从存储节点读page之前调用，返回值传给Insert，用来发现读取期间发生的Invalidate
+   */
+  uint64_t FillTicket();
+
+  /**
+   * @param as_of_lsn 读回这个page时存储节点已经解析到的lsn
+   * @param ticket 读这个page之前FillTicket的返回值，之后这个page被Invalidate过时放弃插入
+   */
+  void Insert(uint32_t space_id, uint32_t page_id, uint64_t as_of_lsn, uint64_t ticket, const char *src_buf);
+
+  void Invalidate(uint32_t space_id, uint32_t page_id);
+
+ private:
+  struct Slot {
+    uint64_t key {};
+    uint64_t as_of_lsn {};
+    uint64_t generation {}; // 每次分配给一个page时递增，区分slot前后装过的page
+    uint16_t pin_count {}; // 正在进行io，不能被替换
+    bool used {false};
+    bool referenced {false}; // clock替换算法的访问位
+  };
+
+  static uint64_t Key(uint32_t space_id, uint32_t page_id) {
+    return (static_cast<uint64_t>(space_id) << 32) | page_id;
+  }
+  // 用clock算法找一个可以替换的slot，调用时必须持有lock_
+  bool PickVictim(uint32_t &slot_id);
+  void EraseLocked(uint64_t key);
+  // 只有key仍然指向这个slot并且slot没有被重新分配过时才删除
+  void EraseSlotLocked(uint64_t key, uint32_t slot_id, uint64_t generation);
+  // Invalidate只记录在key所在的桶上，冲突时最多让Insert多放弃几次
+  static size_t InvalidateBucket(uint64_t key) {
+    return std::hash<uint64_t>{}(key) % INVALIDATE_BUCKETS;
+  }
+
+  static constexpr size_t INVALIDATE_BUCKETS = 4096;
+
+  int fd_;
+  std::mutex lock_ {};
+  std::unordered_map<uint64_t, uint32_t> index_ {};
+  std::vector<Slot> slots_ {};
+  size_t hand_ {0};
+  uint64_t next_generation_ {0};
+  uint64_t invalidate_seq_ {0};
+  std::vector<uint64_t> invalidated_at_ = std::vector<uint64_t>(INVALIDATE_BUCKETS); // 每个桶最后一次Invalidate的序号
+};
@@ -0,0 +1,91 @@
+#include "flush_hint_sender.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(5);
+
+}  // namespace
+
+FlushHintSender::FlushHintSender(PageServerClient *client) : client_(client), thread_(&FlushHintSender::Run, this) {}
+
+FlushHintSender::~FlushHintSender() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  cond_.notify_one();
+  thread_.join();
+}
+
+void FlushHintSender::Add(uint32_t space_id, uint32_t page_id, uint64_t lsn) {
+  bool full;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    pending_.push_back({space_id, page_id, lsn});
+    full = pending_.size() >= LOGDB_MAX_HINTS;
+  }
+  if (full) {
+    cond_.notify_one();
+  }
+}
+
+bool FlushHintSender::Sync() {
+  // 等后台线程把已经取走的hint发完，存储节点按收到的顺序等待
+  std::unique_lock<std::mutex> send_lock(send_lock_);
+  std::unique_lock<std::mutex> lock(lock_);
+  std::vector<FlushHint> hints;
+  hints.swap(failed_);
+  hints.insert(hints.end(), pending_.begin(), pending_.end());
+  pending_.clear();
+  lock.unlock();
+
+  size_t n_sent = 0;
+  while (n_sent < hints.size()) {
+    auto end = std::min(hints.size(), n_sent + LOGDB_MAX_HINTS);
+    if (!client_->FlushHints({hints.begin() + n_sent, hints.begin() + end}, false)) {
+      break;
+    }
+    n_sent = end;
+  }
+  if (n_sent == hints.size() && client_->FlushHints({}, true)) {
+    return true;
+  }
+  // 存储节点不一定收到了，包括已经发出去的，重新发送也没有关系
+  lock.lock();
+  failed_.insert(failed_.begin(), hints.begin(), hints.end());
+  return false;
+}
+
+void FlushHintSender::Run() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (!stop_) {
+    cond_.wait_for(lock, FLUSH_INTERVAL, [this] { return stop_ || pending_.size() >= LOGDB_MAX_HINTS; });
+    if (pending_.empty()) {
+      continue;
+    }
+    // Sync正在发送，它会把pending_一起带走
+    std::unique_lock<std::mutex> send_lock(send_lock_, std::try_to_lock);
+    if (!send_lock.owns_lock()) {
+      cond_.wait_for(lock, FLUSH_INTERVAL);
+      continue;
+    }
+    std::vector<FlushHint> hints;
+    if (pending_.size() > LOGDB_MAX_HINTS) {
+      hints.assign(pending_.begin(), pending_.begin() + LOGDB_MAX_HINTS);
+      pending_.erase(pending_.begin(), pending_.begin() + LOGDB_MAX_HINTS);
+    } else {
+      hints.swap(pending_);
+    }
+    lock.unlock();
+    bool ok = client_->FlushHints(hints, false);
+    // 放开send_lock_之前记下失败的hint，否则紧接着的Sync会漏掉它们
+    lock.lock();
+    if (!ok) {
+      // 留给下一次Sync重新发送，checkpoint推进之前存储节点必须收到它们
+      failed_.insert(failed_.end(), hints.begin(), hints.end());
+    }
+    send_lock.unlock();
+  }
+}
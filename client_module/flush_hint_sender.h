@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "page_server_client.h"
+
+/**
+ * 在后台把计算节点刷出的page批量发给存储节点（LOGDB FLUSHHINTS），
+ * 存储节点据此优先apply这些page，之后的读或者checkpoint不用再等待它们。
+ * 攒满 LOGDB_MAX_HINTS 个或者每隔几毫秒发送一次，不阻塞刷脏页的线程。
+ */
+class FlushHintSender {
+ public:
+  explicit FlushHintSender(PageServerClient *client);
+  ~FlushHintSender();
+
+  void Add(uint32_t space_id, uint32_t page_id, uint64_t lsn);
+
+  /**
+   * 发送所有还没发送的hint，包括之前发送失败的，并等待存储节点把它们全部apply，
+   * 在推进checkpoint之前调用
+   * @return 存储节点是否确认了所有的hint，失败时这些hint留到下一次Sync重新发送
+   */
+  bool Sync();
+
+ private:
+  void Run();
+
+  PageServerClient *client_;
+  std::mutex lock_ {};
+  // 保证Sync发出的请求在所有更早取走的hint之后到达。Sync先加send_lock_再加lock_，
+  // 后台线程拿着lock_时只try_lock它，Sync等待发送时不挡住Add
+  std::mutex send_lock_ {};
+  std::condition_variable cond_ {};
+  std::vector<FlushHint> pending_ {};
+  std::vector<FlushHint> failed_ {}; // 后台线程或者Sync发送失败的hint，下一次Sync重新发送
+  bool stop_ {false};
+  std::thread thread_;
+};
@@ -0,0 +1,322 @@
+/**
+ * 模拟InnoDB的IO模式，用来衡量catcher拦截带来的开销：
+ *   - 多个线程在多个 .ibd 文件上随机读写16KB的page，偶尔fsync
+ *   - 一个线程以512字节的block顺序追加redo log，按组提交的方式fsync，并定期写checkpoint block
+ * 结束时输出每种操作的吞吐和延迟分位数。
+ *
+ * 不加 LD_PRELOAD 运行得到基准，再分别用 libcatcher.so / libcatcher_filter.so / libcatcher_original.so
+ * 运行对比，run_io_bench.sh 会依次跑完这几种情况。
+ * 文件名和catcher中 TPCC 的 datafile_set / logfile_set 一致，这样data file会走catcher的拦截路径。
+ */
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 16384;
+constexpr size_t LOG_BLOCK_SIZE = 512;
+constexpr off_t LOG_FILE_HDR_SIZE = 2048; // 前4个block是文件头和两个checkpoint block
+constexpr off_t LOG_CHECKPOINT_1 = 512;
+constexpr off_t LOG_CHECKPOINT_2 = 1536;
+constexpr uint32_t FIL_PAGE_LSN = 16;
+constexpr uint32_t FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID = 34;
+
+const char *const DATA_FILES[] = {
+    "./tpcc/customer.ibd",
+    "./tpcc/district.ibd",
+    "./tpcc/history.ibd",
+    "./tpcc/item.ibd",
+    "./tpcc/new_orders.ibd",
+    "./tpcc/order_line.ibd",
+    "./tpcc/orders.ibd",
+    "./tpcc/stock.ibd",
+    "./tpcc/warehouse.ibd"
+};
+const char *const LOG_FILE = "./iblogfile0";
+
+enum BenchOp {
+  PAGE_READ,
+  PAGE_WRITE,
+  DATA_FSYNC,
+  LOG_WRITE,
+  LOG_FSYNC,
+  CHECKPOINT,
+  N_BENCH_OPS
+};
+constexpr const char *OP_NAMES[N_BENCH_OPS] = {
+    "page_read", "page_write", "data_fsync", "log_write", "log_fsync", "checkpoint"
+};
+
+struct Options {
+  std::string dir {"./io_bench_data"};
+  int n_threads {8};
+  int seconds {10};
+  size_t n_extra_files {0};      // 额外的 .ibd 文件，catcher不拦截它们
+  size_t pages_per_file {4096};  // 每个文件64MB
+  int read_percent {80};
+  int fsync_every {64};          // 每个线程每写多少个page做一次fsync
+  int log_sync_every {4};        // 每追加多少个redo block做一次fsync
+  size_t log_file_mb {64};
+  int checkpoint_ms {1000};
+};
+
+// 每个线程独立的统计，结束后再合并
+struct ThreadStats {
+  LatencyHistogram latency[N_BENCH_OPS];
+  uint64_t bytes[N_BENCH_OPS] {};
+};
+
+void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-d dir] [-t threads] [-s seconds] [-e extra_files] [-p pages_per_file]\n"
+          "          [-r read_percent] [-f fsync_every] [-g log_sync_every] [-l log_file_mb] [-c checkpoint_ms]\n",
+          prog);
+}
+
+bool parse_options(int argc, char *argv[], Options &opts) {
+  int c;
+  while ((c = getopt(argc, argv, "d:t:s:e:p:r:f:g:l:c:h")) != -1) {
+    switch (c) {
+      case 'd': opts.dir = optarg; break;
+      case 't': opts.n_threads = std::atoi(optarg); break;
+      case 's': opts.seconds = std::atoi(optarg); break;
+      case 'e': opts.n_extra_files = std::atol(optarg); break;
+      case 'p': opts.pages_per_file = std::atol(optarg); break;
+      case 'r': opts.read_percent = std::atoi(optarg); break;
+      case 'f': opts.fsync_every = std::atoi(optarg); break;
+      case 'g': opts.log_sync_every = std::atoi(optarg); break;
+      case 'l': opts.log_file_mb = std::atol(optarg); break;
+      case 'c': opts.checkpoint_ms = std::atoi(optarg); break;
+      default: return false;
+    }
+  }
+  return opts.n_threads > 0 && opts.seconds > 0 && opts.pages_per_file > 0
+      && opts.read_percent >= 0 && opts.read_percent <= 100 && opts.log_file_mb > 0;
+}
+
+void put_u32(char *b, uint32_t v) {
+  b[0] = static_cast<char>(v >> 24);
+  b[1] = static_cast<char>(v >> 16);
+  b[2] = static_cast<char>(v >> 8);
+  b[3] = static_cast<char>(v);
+}
+
+void put_u64(char *b, uint64_t v) {
+  put_u32(b, static_cast<uint32_t>(v >> 32));
+  put_u32(b + 4, static_cast<uint32_t>(v));
+}
+
+/**
+ * 准备文件。用pwritev写入，不经过catcher的pwrite钩子（catcher会把data file的写留在本地内存里）。
+ * 每个data file的第一个page写上space id，catcher在open时会读取它。
+ */
+bool prepare_file(const std::string &path, off_t size, uint32_t space_id) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  bool ok = ::ftruncate(fd, size) == 0;
+  if (ok && space_id != 0) {
+    std::vector<char> page(PAGE_SIZE, 0);
+    put_u32(page.data() + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID, space_id);
+    iovec iov {page.data(), PAGE_SIZE};
+    ok = ::pwritev(fd, &iov, 1, 0) == static_cast<ssize_t>(PAGE_SIZE);
+  }
+  ::close(fd);
+  if (!ok) {
+    fprintf(stderr, "can not prepare %s\n", path.c_str());
+  }
+  return ok;
+}
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point st) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - st).count();
+}
+
+void page_worker(const Options &opts, const std::vector<int> &fds, std::atomic<bool> &stop,
+                 std::atomic<uint64_t> &lsn, unsigned seed, ThreadStats &stats) {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<size_t> pick_file(0, fds.size() - 1);
+  // 第0个page保存space id，不覆盖它
+  std::uniform_int_distribution<size_t> pick_page(1, opts.pages_per_file - 1);
+  std::uniform_int_distribution<int> pick_op(0, 99);
+  std::unique_ptr<char[]> page(new char[PAGE_SIZE]);
+  std::memset(page.get(), 0, PAGE_SIZE);
+  int n_writes = 0;
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    auto fd = fds[pick_file(rng)];
+    auto offset = static_cast<off_t>(pick_page(rng) * PAGE_SIZE);
+    auto st = std::chrono::steady_clock::now();
+    if (pick_op(rng) < opts.read_percent) {
+      auto sz = ::pread(fd, page.get(), PAGE_SIZE, offset);
+      stats.latency[PAGE_READ].Record(elapsed_ns(st));
+      stats.bytes[PAGE_READ] += sz > 0 ? sz : 0;
+      continue;
+    }
+    put_u64(page.get() + FIL_PAGE_LSN, lsn.load(std::memory_order_relaxed));
+    st = std::chrono::steady_clock::now();
+    auto sz = ::pwrite(fd, page.get(), PAGE_SIZE, offset);
+    stats.latency[PAGE_WRITE].Record(elapsed_ns(st));
+    stats.bytes[PAGE_WRITE] += sz > 0 ? sz : 0;
+    if (opts.fsync_every > 0 && ++n_writes % opts.fsync_every == 0) {
+      st = std::chrono::steady_clock::now();
+      ::fsync(fd);
+      stats.latency[DATA_FSYNC].Record(elapsed_ns(st));
+    }
+  }
+}
+
+void log_writer(const Options &opts, int fd, std::atomic<bool> &stop, std::atomic<uint64_t> &lsn,
+                ThreadStats &stats) {
+  char block[LOG_BLOCK_SIZE] {};
+  off_t log_size = static_cast<off_t>(opts.log_file_mb) * 1024 * 1024;
+  off_t offset = LOG_FILE_HDR_SIZE;
+  int n_blocks = 0;
+  int n_checkpoints = 0;
+  auto last_checkpoint = std::chrono::steady_clock::now();
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    auto st = std::chrono::steady_clock::now();
+    auto sz = ::pwrite(fd, block, LOG_BLOCK_SIZE, offset);
+    stats.latency[LOG_WRITE].Record(elapsed_ns(st));
+    stats.bytes[LOG_WRITE] += sz > 0 ? sz : 0;
+    lsn.fetch_add(LOG_BLOCK_SIZE, std::memory_order_relaxed);
+    offset += LOG_BLOCK_SIZE;
+    if (offset + static_cast<off_t>(LOG_BLOCK_SIZE) > log_size) {
+      offset = LOG_FILE_HDR_SIZE;
+    }
+    if (opts.log_sync_every > 0 && ++n_blocks % opts.log_sync_every == 0) {
+      st = std::chrono::steady_clock::now();
+      ::fdatasync(fd);
+      stats.latency[LOG_FSYNC].Record(elapsed_ns(st));
+    }
+
+    if (opts.checkpoint_ms > 0 && std::chrono::steady_clock::now() - last_checkpoint
+        >= std::chrono::milliseconds(opts.checkpoint_ms)) {
+      // 和InnoDB一样轮流写两个checkpoint block，catcher会在这里等待flush hint被apply
+      st = std::chrono::steady_clock::now();
+      ::pwrite(fd, block, LOG_BLOCK_SIZE, n_checkpoints++ % 2 == 0 ? LOG_CHECKPOINT_1 : LOG_CHECKPOINT_2);
+      ::fdatasync(fd);
+      stats.latency[CHECKPOINT].Record(elapsed_ns(st));
+      last_checkpoint = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+void report(const std::vector<std::unique_ptr<ThreadStats>> &all_stats, double seconds) {
+  printf("%-11s %12s %12s %10s %10s %10s %10s %10s %10s\n",
+         "op", "ops", "ops/s", "MB/s", "avg(us)", "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+  for (int op = 0; op < N_BENCH_OPS; ++op) {
+    // 直方图比较大，放在堆上
+    auto merged = std::make_unique<HistogramSnapshot>();
+    uint64_t bytes = 0;
+    for (const auto &stats : all_stats) {
+      merged->Merge(stats->latency[op]);
+      bytes += stats->bytes[op];
+    }
+    if (merged->total == 0) {
+      continue;
+    }
+    printf("%-11s %12lu %12.0f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           OP_NAMES[op], merged->total, merged->total / seconds, bytes / seconds / (1024 * 1024),
+           merged->Average() / 1000.0, merged->Percentile(50) / 1000.0, merged->Percentile(99) / 1000.0,
+           merged->Percentile(99.9) / 1000.0, merged->max / 1000.0);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // catcher按相对路径匹配文件名，所以要在数据目录下运行
+  ::mkdir(opts.dir.c_str(), 0755);
+  if (::chdir(opts.dir.c_str()) != 0) {
+    perror(opts.dir.c_str());
+    return EXIT_FAILURE;
+  }
+  ::mkdir("./tpcc", 0755);
+
+  std::vector<std::string> data_files(std::begin(DATA_FILES), std::end(DATA_FILES));
+  for (size_t i = 0; i < opts.n_extra_files; ++i) {
+    data_files.push_back("./tpcc/extra" + std::to_string(i) + ".ibd");
+  }
+  auto data_file_size = static_cast<off_t>(opts.pages_per_file * PAGE_SIZE);
+  for (size_t i = 0; i < data_files.size(); ++i) {
+    if (!prepare_file(data_files[i], data_file_size, static_cast<uint32_t>(i + 1))) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (!prepare_file(LOG_FILE, static_cast<off_t>(opts.log_file_mb) * 1024 * 1024, 0)) {
+    return EXIT_FAILURE;
+  }
+
+  // 下面的open/pread/pwrite/fsync都会经过LD_PRELOAD的catcher
+  std::vector<int> data_fds;
+  for (const auto &path : data_files) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      perror(path.c_str());
+      return EXIT_FAILURE;
+    }
+    data_fds.push_back(fd);
+  }
+  int log_fd = ::open(LOG_FILE, O_RDWR);
+  if (log_fd < 0) {
+    perror(LOG_FILE);
+    return EXIT_FAILURE;
+  }
+
+  std::atomic<bool> stop {false};
+  std::atomic<uint64_t> lsn {8192};
+  std::vector<std::unique_ptr<ThreadStats>> all_stats;
+  for (int i = 0; i <= opts.n_threads; ++i) {
+    all_stats.push_back(std::make_unique<ThreadStats>());
+  }
+
+  auto st = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  threads.emplace_back(log_writer, std::cref(opts), log_fd, std::ref(stop), std::ref(lsn),
+                       std::ref(*all_stats[0]));
+  for (int i = 0; i < opts.n_threads; ++i) {
+    threads.emplace_back(page_worker, std::cref(opts), std::cref(data_fds), std::ref(stop), std::ref(lsn),
+                         static_cast<unsigned>(i + 1), std::ref(*all_stats[i + 1]));
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(opts.seconds));
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+  for (auto fd : data_fds) {
+    ::close(fd);
+  }
+  ::close(log_fd);
+
+  const char *preload = std::getenv("LD_PRELOAD");
+  printf("threads: %d, files: %zu, seconds: %.1f, preload: %s\n",
+         opts.n_threads, data_files.size(), seconds, preload != nullptr && *preload != '\0' ? preload : "none");
+  report(all_stats, seconds);
+  return EXIT_SUCCESS;
+}
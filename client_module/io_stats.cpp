@@ -0,0 +1,150 @@
+#include "io_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+constexpr const char *OP_NAMES[N_IO_OPS] = {"read", "write", "sync"};
+constexpr const char *CLASS_NAMES[N_FILE_CLASSES] = {"data", "log", "other"};
+constexpr const char *SOURCE_NAMES[N_PAGE_SOURCES] = {"buffer_pool", "flash_cache", "page_server", "file"};
+
+}  // namespace
+
+// 线程退出时把分片还给IoStats
+class IoStats::ShardHolder {
+ public:
+  ~ShardHolder() {
+    if (shard != nullptr) {
+      IoStats::Get().ReleaseShard(shard);
+    }
+  }
+  Shard *shard {nullptr};
+};
+
+IoStats &IoStats::Get() {
+  // 故意不释放，进程退出时其他线程可能还在记录
+  static auto *instance = new IoStats();
+  return *instance;
+}
+
+IoStats::IoStats() {
+  if (const char *env = std::getenv("LOGDB_IO_STATS_INTERVAL_MS"); env != nullptr && std::atol(env) > 0) {
+    dump_interval_ms_ = std::atol(env);
+  }
+  if (const char *env = std::getenv("LOGDB_IO_STATS"); env != nullptr && *env != '\0') {
+    dump_path_ = env;
+    std::thread(&IoStats::RunExporter, this).detach();
+  }
+}
+
+IoStats::Shard &IoStats::LocalShard() {
+  static thread_local ShardHolder holder;
+  if (holder.shard == nullptr) {
+    holder.shard = AcquireShard();
+  }
+  return *holder.shard;
+}
+
+IoStats::Shard *IoStats::AcquireShard() {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!free_shards_.empty()) {
+    // 旧线程留下的计数直接在上面继续累加，合并时结果不变
+    auto *shard = free_shards_.back();
+    free_shards_.pop_back();
+    return shard;
+  }
+  auto *shard = new Shard();
+  shards_.push_back(shard);
+  return shard;
+}
+
+void IoStats::ReleaseShard(Shard *shard) {
+  std::lock_guard<std::mutex> guard(lock_);
+  free_shards_.push_back(shard);
+}
+
+void IoStats::RecordIo(IoOp op, FileClass file_class, uint64_t latency_ns, size_t bytes) {
+  auto &shard = LocalShard();
+  auto o = static_cast<size_t>(op);
+  auto c = static_cast<size_t>(file_class);
+  shard.latency[o][c].Record(latency_ns);
+  add_relaxed(shard.bytes[o][c], bytes);
+}
+
+void IoStats::RecordPages(PageSource source, size_t n_pages) {
+  if (n_pages > 0) {
+    add_relaxed(LocalShard().pages[static_cast<size_t>(source)], n_pages);
+  }
+}
+
+void IoStats::Dump(FILE *out) {
+  // 直方图比较大，放在堆上
+  std::vector<HistogramSnapshot> latency(N_IO_OPS * N_FILE_CLASSES);
+  uint64_t bytes[N_IO_OPS][N_FILE_CLASSES] {};
+  uint64_t pages[N_PAGE_SOURCES] {};
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (auto *shard : shards_) {
+      for (size_t o = 0; o < N_IO_OPS; ++o) {
+        for (size_t c = 0; c < N_FILE_CLASSES; ++c) {
+          latency[o * N_FILE_CLASSES + c].Merge(shard->latency[o][c]);
+          bytes[o][c] += shard->bytes[o][c].load(std::memory_order_relaxed);
+        }
+      }
+      for (size_t s = 0; s < N_PAGE_SOURCES; ++s) {
+        pages[s] += shard->pages[s].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  fprintf(out, "%-6s %-6s %12s %14s %10s %10s %10s %10s %10s\n",
+          "op", "file", "calls", "bytes", "avg(us)", "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+  for (size_t o = 0; o < N_IO_OPS; ++o) {
+    for (size_t c = 0; c < N_FILE_CLASSES; ++c) {
+      const auto &h = latency[o * N_FILE_CLASSES + c];
+      if (h.total == 0) {
+        continue;
+      }
+      fprintf(out, "%-6s %-6s %12lu %14lu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+              OP_NAMES[o], CLASS_NAMES[c], h.total, bytes[o][c],
+              h.Average() / 1000.0, h.Percentile(50) / 1000.0, h.Percentile(99) / 1000.0,
+              h.Percentile(99.9) / 1000.0, h.max / 1000.0);
+    }
+  }
+  fprintf(out, "data pages read from:");
+  for (size_t s = 0; s < N_PAGE_SOURCES; ++s) {
+    fprintf(out, " %s=%lu", SOURCE_NAMES[s], pages[s]);
+  }
+  fprintf(out, "\n");
+}
+
+void IoStats::RunExporter() {
+  auto tmp_path = dump_path_ + ".tmp";
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(dump_interval_ms_));
+    // stdio内部的open/write不会经过catcher的钩子
+    FILE *out = fopen(tmp_path.c_str(), "w");
+    if (out == nullptr) {
+      continue;
+    }
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    fprintf(out, "timestamp: %ld\n", static_cast<long>(now));
+    Dump(out);
+    fclose(out);
+    std::rename(tmp_path.c_str(), dump_path_.c_str());
+  }
+}
+
+namespace {
+
+// 进程退出时打印一次汇总，代替原来的Status
+struct ExitReporter {
+  ~ExitReporter() {
+    IoStats::Get().Dump(stdout);
+  }
+} exit_reporter;
+
+}  // namespace
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "latency_histogram.h"
+
+enum class IoOp : uint8_t {
+  READ,
+  WRITE,
+  SYNC,
+  COUNT
+};
+
+enum class FileClass : uint8_t {
+  DATA,
+  LOG,
+  OTHER,
+  COUNT
+};
+
+// 读data file时page的来源
+enum class PageSource : uint8_t {
+  BUFFER_POOL, // 本地buffer pool命中
+  FLASH_CACHE, // 本地SSD上的flash cache命中
+  PAGE_SERVER, // 通过GETPAGES从存储节点读取
+  FILE,        // 退回到原始的pread
+  COUNT
+};
+
+static constexpr size_t N_IO_OPS = static_cast<size_t>(IoOp::COUNT);
+static constexpr size_t N_FILE_CLASSES = static_cast<size_t>(FileClass::COUNT);
+static constexpr size_t N_PAGE_SOURCES = static_cast<size_t>(PageSource::COUNT);
+
+/**
+ * catcher的IO统计。每个线程写自己的分片，分片在线程退出之后留给新线程复用，
+ * 读取时把所有分片合并，所以记录一次IO只有几次不竞争的内存写。
+ * 设置了 LOGDB_IO_STATS=/path/to/file 时，每隔 LOGDB_IO_STATS_INTERVAL_MS（默认1000）毫秒
+ * 把合并后的结果写到这个文件（先写临时文件再rename），进程退出时把结果打印到stdout。
+ */
+class IoStats {
+ public:
+  static IoStats &Get();
+
+  /**
+   * @param latency_ns 这次调用的耗时，包括catcher自己的开销
+   * @param bytes 实际读写的字节数，sync传0
+   */
+  void RecordIo(IoOp op, FileClass file_class, uint64_t latency_ns, size_t bytes);
+  void RecordPages(PageSource source, size_t n_pages);
+
+  // 把合并后的统计写到out
+  void Dump(FILE *out);
+
+ private:
+  struct Shard {
+    LatencyHistogram latency[N_IO_OPS][N_FILE_CLASSES];
+    std::atomic<uint64_t> bytes[N_IO_OPS][N_FILE_CLASSES] {};
+    std::atomic<uint64_t> pages[N_PAGE_SOURCES] {};
+  };
+  class ShardHolder;
+
+  IoStats();
+  Shard &LocalShard();
+  Shard *AcquireShard();
+  void ReleaseShard(Shard *shard);
+  void RunExporter();
+
+  std::mutex lock_ {};
+  std::vector<Shard *> shards_ {};      // 所有分片，永远不释放
+  std::vector<Shard *> free_shards_ {}; // 线程已经退出的分片
+  std::string dump_path_ {};
+  uint64_t dump_interval_ms_ {1000};
+};
@@ -0,0 +1,55 @@
+#include "latency_histogram.h"
+#include <algorithm>
+
+namespace {
+
+int highest_bit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+}  // namespace
+
+size_t LatencyHistogram::BucketOf(uint64_t value) {
+  if (value < 2 * SUB_BUCKETS) {
+    return static_cast<size_t>(value);
+  }
+  if (highest_bit(value) >= MAX_VALUE_BITS) {
+    return N_BUCKETS - 1;
+  }
+  int shift = highest_bit(value) - SUB_BUCKET_BITS;
+  return 2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::UpperBoundOf(size_t bucket) {
+  if (bucket < 2 * SUB_BUCKETS) {
+    return bucket;
+  }
+  auto shift = (bucket - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+  auto top = (bucket - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+  return ((top + 1) << shift) - 1;
+}
+
+void HistogramSnapshot::Merge(const LatencyHistogram &histogram) {
+  for (size_t i = 0; i < LatencyHistogram::N_BUCKETS; ++i) {
+    auto n = histogram.counts_[i].load(std::memory_order_relaxed);
+    counts[i] += n;
+    total += n;
+  }
+  sum += histogram.sum_.load(std::memory_order_relaxed);
+  max = std::max(max, histogram.max_.load(std::memory_order_relaxed));
+}
+
+uint64_t HistogramSnapshot::Percentile(double percentile) const {
+  if (total == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(static_cast<double>(total) * percentile / 100.0);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LatencyHistogram::N_BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen > rank) {
+      return std::min(LatencyHistogram::UpperBoundOf(i), max);
+    }
+  }
+  return max;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 累加到一个只有当前线程写的计数器上。不用原子的read-modify-write，
+ * relaxed的load/store只是为了让合并线程可以并发读取
+ */
+inline void add_relaxed(std::atomic<uint64_t> &counter, uint64_t n) {
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ * HDR风格的对数-线性直方图，内存大小固定。
+ * 小于 2^(SUB_BUCKET_BITS+1) 的值每个值一个桶，更大的值在每个2的幂区间内再分 2^SUB_BUCKET_BITS 个桶，
+ * 相对误差不超过 1/2^SUB_BUCKET_BITS。不小于 2^MAX_VALUE_BITS 的值记在最后一个桶里。
+ */
+class LatencyHistogram {
+ public:
+  static constexpr int SUB_BUCKET_BITS = 4;
+  static constexpr uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+  static constexpr int MAX_VALUE_BITS = 40; // 纳秒，约18分钟
+  static constexpr size_t N_BUCKETS = 2 * SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+  static size_t BucketOf(uint64_t value);
+  // 桶中最大的值，用来报告分位数
+  static uint64_t UpperBoundOf(size_t bucket);
+
+  // 每个直方图只有一个写线程
+  void Record(uint64_t value) {
+    add_relaxed(counts_[BucketOf(value)], 1);
+    add_relaxed(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  friend struct HistogramSnapshot;
+  std::atomic<uint64_t> counts_[N_BUCKETS] {};
+  std::atomic<uint64_t> sum_ {};
+  std::atomic<uint64_t> max_ {};
+};
+
+// 合并之后的直方图
+struct HistogramSnapshot {
+  void Merge(const LatencyHistogram &histogram);
+  // @param percentile 0到100之间
+  [[nodiscard]] uint64_t Percentile(double percentile) const;
+  [[nodiscard]] uint64_t Average() const { return total == 0 ? 0 : sum / total; }
+
+  uint64_t counts[LatencyHistogram::N_BUCKETS] {};
+  uint64_t total {};
+  uint64_t sum {};
+  uint64_t max {};
+};
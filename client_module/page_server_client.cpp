@@ -0,0 +1,653 @@
+#include "page_server_client.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// ONC RPC (RFC 5531) 中用到的常量
+constexpr uint32_t RPC_CALL = 0;
+constexpr uint32_t RPC_REPLY = 1;
+constexpr uint32_t RPC_VERSION = 2;
+constexpr uint32_t MSG_ACCEPTED = 0;
+constexpr uint32_t ACCEPT_SUCCESS = 0;
+constexpr uint32_t AUTH_NONE = 0;
+constexpr uint32_t AUTH_SYS = 1;
+constexpr uint32_t LAST_FRAGMENT = 0x80000000U;
+constexpr int LAGGING_RETRIES = 100;
+constexpr useconds_t SNAPSHOT_POLL_US = 100 * 1000;
+
+void put_u32(std::string &out, uint32_t v) {
+  v = htonl(v);
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void put_u64(std::string &out, uint64_t v) {
+  put_u32(out, static_cast<uint32_t>(v >> 32));
+  put_u32(out, static_cast<uint32_t>(v));
+}
+
+// 变长opaque，按4字节对齐
+void put_opaque(std::string &out, const std::string &data) {
+  put_u32(out, static_cast<uint32_t>(data.size()));
+  out.append(data);
+  out.append((4 - data.size() % 4) % 4, '\0');
+}
+
+void put_value(std::string &out, const LogdbValue &value) {
+  put_u32(out, value.null);
+  put_u32(out, value.external);
+  put_opaque(out, value.null ? std::string() : value.data);
+}
+
+void put_values(std::string &out, const std::vector<LogdbValue> &values) {
+  put_u32(out, static_cast<uint32_t>(values.size()));
+  for (const auto &value : values) {
+    put_value(out, value);
+  }
+}
+
+class XdrReader {
+ public:
+  explicit XdrReader(const std::string &buf) : buf_(buf) {}
+  bool GetU32(uint32_t &v) {
+    if (pos_ + 4 > buf_.size()) {
+      return false;
+    }
+    std::memcpy(&v, buf_.data() + pos_, 4);
+    v = ntohl(v);
+    pos_ += 4;
+    return true;
+  }
+  bool GetU64(uint64_t &v) {
+    uint32_t hi, lo;
+    if (!GetU32(hi) || !GetU32(lo)) {
+      return false;
+    }
+    v = (static_cast<uint64_t>(hi) << 32) | lo;
+    return true;
+  }
+  // 变长opaque，按4字节对齐
+  bool GetValue(LogdbValue &value) {
+    uint32_t null, external, len;
+    const char *data;
+    if (!GetU32(null) || !GetU32(external) || !GetOpaque(&data, len)) {
+      return false;
+    }
+    value.null = null != 0;
+    value.external = external != 0;
+    value.data.assign(data, len);
+    return true;
+  }
+  bool GetOpaque(const char **data, uint32_t &len) {
+    if (!GetU32(len)) {
+      return false;
+    }
+    size_t padded = (static_cast<size_t>(len) + 3) & ~static_cast<size_t>(3);
+    if (pos_ + padded > buf_.size()) {
+      return false;
+    }
+    *data = buf_.data() + pos_;
+    pos_ += padded;
+    return true;
+  }
+  [[nodiscard]] size_t Position() const { return pos_; }
+ private:
+  const std::string &buf_;
+  size_t pos_ {0};
+};
+
+bool write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    auto n = ::send(fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool read_all(int fd, char *buf, size_t len) {
+  while (len > 0) {
+    auto n = ::recv(fd, buf, len, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+// AUTH_SYS的credential（RFC 5531 附录A），存储节点按log group的export检查调用者
+std::string auth_sys_cred() {
+  char hostname[256] {};
+  gethostname(hostname, sizeof(hostname) - 1);
+  std::string body;
+  put_u32(body, 0); // stamp
+  put_opaque(body, hostname);
+  put_u32(body, static_cast<uint32_t>(geteuid()));
+  put_u32(body, static_cast<uint32_t>(getegid()));
+  put_u32(body, 0); // gids
+  std::string cred;
+  put_u32(cred, AUTH_SYS);
+  put_opaque(cred, body);
+  return cred;
+}
+
+// 毫秒，环境变量没有设置或者不合法时用默认值
+uint32_t timeout_from_env(const char *name, uint32_t default_ms) {
+  const char *env = std::getenv(name);
+  if (env == nullptr || *env == '\0') {
+    return default_ms;
+  }
+  auto value = std::atol(env);
+  if (value < 0) {
+    fprintf(stderr, "%s is invalid: %s\n", name, env);
+    return default_ms;
+  }
+  return static_cast<uint32_t>(value);
+}
+
+void set_socket_timeout(int fd, int option, uint32_t timeout_ms) {
+  timeval tv {};
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = static_cast<suseconds_t>(timeout_ms % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, option, &tv, sizeof(tv));
+}
+
+// 超过timeout_ms还没有连上时返回false，timeout_ms为0时一直等
+bool connect_with_timeout(int fd, const sockaddr *addr, socklen_t addr_len, uint32_t timeout_ms) {
+  if (timeout_ms == 0) {
+    return ::connect(fd, addr, addr_len) == 0;
+  }
+  auto flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    return false;
+  }
+  if (::connect(fd, addr, addr_len) != 0) {
+    if (errno != EINPROGRESS) {
+      return false;
+    }
+    pollfd pfd {fd, POLLOUT, 0};
+    int rc;
+    do {
+      rc = poll(&pfd, 1, static_cast<int>(timeout_ms));
+    } while (rc < 0 && errno == EINTR);
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (rc <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+      return false;
+    }
+  }
+  return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+// 读取一条完整的record（可能由多个fragment组成）
+bool read_record(int fd, std::string &record) {
+  record.clear();
+  for (;;) {
+    uint32_t marker;
+    if (!read_all(fd, reinterpret_cast<char *>(&marker), sizeof(marker))) {
+      return false;
+    }
+    marker = ntohl(marker);
+    size_t len = marker & ~LAST_FRAGMENT;
+    auto old_size = record.size();
+    record.resize(old_size + len);
+    if (!read_all(fd, record.data() + old_size, len)) {
+      return false;
+    }
+    if (marker & LAST_FRAGMENT) {
+      return true;
+    }
+  }
+}
+
+}  // namespace
+
+PageServerClient *PageServerClient::FromEnv() {
+  const char *env = std::getenv("LOGDB_PAGE_SERVER");
+  if (env == nullptr || *env == '\0') {
+    return nullptr;
+  }
+  std::string addr(env);
+  auto colon = addr.rfind(':');
+  if (colon == std::string::npos) {
+    fprintf(stderr, "LOGDB_PAGE_SERVER must be host:port, got %s\n", env);
+    return nullptr;
+  }
+  auto port = std::atoi(addr.c_str() + colon + 1);
+  if (port <= 0 || port > 65535) {
+    fprintf(stderr, "LOGDB_PAGE_SERVER has an invalid port: %s\n", env);
+    return nullptr;
+  }
+  uint32_t group = 0;
+  const char *group_env = std::getenv("LOGDB_LOG_GROUP");
+  if (group_env != nullptr && *group_env != '\0') {
+    auto value = std::atoi(group_env);
+    if (value < 0) {
+      fprintf(stderr, "LOGDB_LOG_GROUP is invalid: %s\n", group_env);
+      return nullptr;
+    }
+    group = static_cast<uint32_t>(value);
+  }
+  auto *client = new PageServerClient(addr.substr(0, colon), static_cast<uint16_t>(port), group);
+  client->connect_timeout_ms_ = timeout_from_env("LOGDB_CONNECT_TIMEOUT_MS", LOGDB_CONNECT_TIMEOUT_MS);
+  client->send_timeout_ms_ = timeout_from_env("LOGDB_SEND_TIMEOUT_MS", LOGDB_SEND_TIMEOUT_MS);
+  client->recv_timeout_ms_ = timeout_from_env("LOGDB_RECV_TIMEOUT_MS", LOGDB_RECV_TIMEOUT_MS);
+  return client;
+}
+
+PageServerClient::~PageServerClient() {
+  for (auto fd : idle_fds_) {
+    ::close(fd);
+  }
+}
+
+int PageServerClient::AcquireConnection() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!idle_fds_.empty()) {
+      auto fd = idle_fds_.back();
+      idle_fds_.pop_back();
+      return fd;
+    }
+  }
+
+  addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = nullptr;
+  auto port = std::to_string(port_);
+  if (getaddrinfo(host_.c_str(), port.c_str(), &hints, &result) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (auto *ai = result; ai != nullptr; ai = ai->ai_next) {
+    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect_with_timeout(fd, ai->ai_addr, ai->ai_addrlen, connect_timeout_ms_)) {
+      break;
+    }
+    ::close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  if (fd >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // 超时的send和recv返回EAGAIN，Call失败并关闭这个连接，里面可能还有没读完的回复
+    set_socket_timeout(fd, SO_SNDTIMEO, send_timeout_ms_);
+    set_socket_timeout(fd, SO_RCVTIMEO, recv_timeout_ms_);
+  }
+  return fd;
+}
+
+void PageServerClient::ReleaseConnection(int fd, bool healthy) {
+  if (!healthy) {
+    ::close(fd);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  idle_fds_.push_back(fd);
+}
+
+bool PageServerClient::Call(uint32_t proc, const std::string &args, std::string &results) {
+  static const std::string cred = auth_sys_cred();
+  uint32_t xid;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    xid = next_xid_++;
+  }
+
+  std::string request;
+  request.reserve(36 + cred.size() + args.size());
+  put_u32(request, 0); // record marker，最后再填
+  put_u32(request, xid);
+  put_u32(request, RPC_CALL);
+  put_u32(request, RPC_VERSION);
+  put_u32(request, LOGDB_PROGRAM);
+  put_u32(request, LOGDB_VERSION);
+  put_u32(request, proc);
+  request += cred;
+  put_u32(request, AUTH_NONE); // verf
+  put_u32(request, 0);
+  request += args;
+  uint32_t marker = htonl(LAST_FRAGMENT | static_cast<uint32_t>(request.size() - 4));
+  std::memcpy(request.data(), &marker, sizeof(marker));
+
+  auto fd = AcquireConnection();
+  if (fd < 0) {
+    return false;
+  }
+  std::string reply;
+  if (!write_all(fd, request.data(), request.size()) || !read_record(fd, reply)) {
+    ReleaseConnection(fd, false);
+    return false;
+  }
+
+  XdrReader reader(reply);
+  uint32_t reply_xid = 0, msg_type, reply_stat, verf_flavor, accept_stat;
+  const char *verf_body;
+  uint32_t verf_len;
+  auto ok = reader.GetU32(reply_xid) && reply_xid == xid
+      && reader.GetU32(msg_type) && msg_type == RPC_REPLY
+      && reader.GetU32(reply_stat) && reply_stat == MSG_ACCEPTED
+      && reader.GetU32(verf_flavor) && reader.GetOpaque(&verf_body, verf_len)
+      && reader.GetU32(accept_stat) && accept_stat == ACCEPT_SUCCESS;
+  // 连接上的数据已经被完整读出，即使RPC失败连接也可以复用
+  ReleaseConnection(fd, reply_xid == xid);
+  if (!ok) {
+    return false;
+  }
+  results = reply.substr(reader.Position());
+  return true;
+}
+
+bool PageServerClient::GetPages(uint32_t space_id, const std::vector<uint32_t> &page_ids, uint64_t min_lsn,
+                                const std::vector<char *> &dest_bufs, std::vector<bool> &page_ok,
+                                uint64_t *parsed_lsn, size_t page_size) {
+  page_ok.assign(page_ids.size(), false);
+  if (page_ids.empty() || page_ids.size() > LOGDB_MAX_PAGES || page_ids.size() != dest_bufs.size()) {
+    return false;
+  }
+
+  std::string args;
+  args.reserve(20 + page_ids.size() * 4);
+  put_u32(args, group_);
+  put_u32(args, space_id);
+  put_u32(args, static_cast<uint32_t>(page_ids.size()));
+  for (auto page_id : page_ids) {
+    put_u32(args, page_id);
+  }
+  put_u64(args, min_lsn);
+
+  for (int retry = 0; retry < LAGGING_RETRIES; ++retry) {
+    std::string results;
+    if (!Call(LOGDB_PROC_GETPAGES, args, results)) {
+      return false;
+    }
+    XdrReader reader(results);
+    uint32_t res_stat, n_pages;
+    uint64_t lsn;
+    if (!reader.GetU32(res_stat) || !reader.GetU64(lsn) || !reader.GetU32(n_pages)) {
+      return false;
+    }
+    if (static_cast<LogdbStat>(res_stat) == LogdbStat::ERR_LAGGING) {
+      // 存储节点还没有解析到min_lsn，稍后重试
+      usleep(1000);
+      continue;
+    }
+    if (static_cast<LogdbStat>(res_stat) != LogdbStat::OK || n_pages != page_ids.size()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < n_pages; ++i) {
+      uint32_t page_no, page_stat, len;
+      const char *data;
+      if (!reader.GetU32(page_no) || !reader.GetU32(page_stat) || !reader.GetOpaque(&data, len)) {
+        page_ok.assign(page_ids.size(), false);
+        return false;
+      }
+      if (page_no != page_ids[i] || static_cast<LogdbStat>(page_stat) != LogdbStat::OK
+          || len != page_size) {
+        continue;
+      }
+      std::memcpy(dest_bufs[i], data, page_size);
+      page_ok[i] = true;
+    }
+    if (parsed_lsn != nullptr) {
+      *parsed_lsn = lsn;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool PageServerClient::SpaceLsn(uint32_t space_id, uint64_t &space_lsn) {
+  std::string args;
+  put_u32(args, group_);
+  put_u32(args, space_id);
+  std::string results;
+  if (!Call(LOGDB_PROC_SPACELSN, args, results)) {
+    return false;
+  }
+  XdrReader reader(results);
+  uint32_t res_stat;
+  uint64_t parsed_lsn;
+  if (!reader.GetU32(res_stat) || static_cast<LogdbStat>(res_stat) != LogdbStat::OK
+      || !reader.GetU64(parsed_lsn) || !reader.GetU64(space_lsn)) {
+    return false;
+  }
+  return true;
+}
+
+bool PageServerClient::FlushHints(const std::vector<FlushHint> &hints, bool sync) {
+  if (hints.size() > LOGDB_MAX_HINTS) {
+    return false;
+  }
+  std::string args;
+  args.reserve(12 + hints.size() * 16);
+  put_u32(args, group_);
+  put_u32(args, static_cast<uint32_t>(hints.size()));
+  for (const auto &hint : hints) {
+    put_u32(args, hint.space_id);
+    put_u32(args, hint.page_id);
+    put_u64(args, hint.lsn);
+  }
+  put_u32(args, sync ? 1 : 0);
+  std::string results;
+  if (!Call(LOGDB_PROC_FLUSHHINTS, args, results)) {
+    return false;
+  }
+  XdrReader reader(results);
+  uint32_t res_stat;
+  return reader.GetU32(res_stat) && static_cast<LogdbStat>(res_stat) == LogdbStat::OK;
+}
+
+LogdbStat PageServerClient::Lookup(uint32_t space_id, uint32_t root_page_no, const std::vector<uint16_t> &field_lens,
+                                   const std::vector<std::string> &key, uint64_t lsn, std::string &record,
+                                   uint32_t &extra_size, uint32_t *page_no) {
+  if (field_lens.size() > LOGDB_MAX_INDEX_FIELDS || key.empty() || key.size() > LOGDB_MAX_KEY_FIELDS) {
+    return LogdbStat::ERR_BADINDEX;
+  }
+  std::string args;
+  put_u32(args, group_);
+  put_u32(args, space_id);
+  put_u32(args, root_page_no);
+  put_u32(args, static_cast<uint32_t>(key.size()));
+  put_u32(args, static_cast<uint32_t>(field_lens.size()));
+  for (auto len : field_lens) {
+    put_u32(args, len);
+  }
+  put_u32(args, static_cast<uint32_t>(key.size()));
+  for (const auto &field : key) {
+    put_opaque(args, field);
+  }
+  put_u64(args, lsn);
+
+  for (int retry = 0; retry < LAGGING_RETRIES; ++retry) {
+    std::string results;
+    if (!Call(LOGDB_PROC_LOOKUP, args, results)) {
+      return LogdbStat::ERR_IO;
+    }
+    XdrReader reader(results);
+    uint32_t res_stat, leaf_page_no, len;
+    uint64_t parsed_lsn;
+    const char *data;
+    if (!reader.GetU32(res_stat) || !reader.GetU64(parsed_lsn) || !reader.GetU32(leaf_page_no)
+        || !reader.GetU32(extra_size) || !reader.GetOpaque(&data, len)) {
+      return LogdbStat::ERR_IO;
+    }
+    auto stat = static_cast<LogdbStat>(res_stat);
+    if (stat == LogdbStat::ERR_LAGGING) {
+      usleep(1000);
+      continue;
+    }
+    if (stat == LogdbStat::OK) {
+      record.assign(data, len);
+      if (page_no != nullptr) {
+        *page_no = leaf_page_no;
+      }
+    }
+    return stat;
+  }
+  return LogdbStat::ERR_LAGGING;
+}
+
+LogdbStat PageServerClient::Scan(ScanRequest &request, std::vector<std::vector<LogdbValue>> &rows, bool &eof) {
+  rows.clear();
+  eof = false;
+  if (request.field_lens.size() > LOGDB_MAX_INDEX_FIELDS || request.columns.size() > LOGDB_MAX_INDEX_FIELDS
+      || request.start_key.size() > LOGDB_MAX_KEY_FIELDS || request.end_key.size() > LOGDB_MAX_KEY_FIELDS
+      || request.predicates.size() > LOGDB_MAX_SCAN_PREDICATES) {
+    return LogdbStat::ERR_BADINDEX;
+  }
+  std::string args;
+  put_u32(args, group_);
+  put_u32(args, request.space_id);
+  put_u32(args, request.root_page_no);
+  put_u32(args, request.n_uniq);
+  put_u32(args, static_cast<uint32_t>(request.field_lens.size()));
+  for (auto len : request.field_lens) {
+    put_u32(args, len);
+  }
+  put_values(args, request.start_key);
+  put_u32(args, request.start_inclusive);
+  put_values(args, request.end_key);
+  put_u32(args, static_cast<uint32_t>(request.predicates.size()));
+  for (const auto &predicate : request.predicates) {
+    put_u32(args, predicate.field_no);
+    put_u32(args, static_cast<uint32_t>(predicate.op));
+    put_opaque(args, predicate.value);
+  }
+  put_u32(args, static_cast<uint32_t>(request.columns.size()));
+  for (auto column : request.columns) {
+    put_u32(args, column);
+  }
+  put_u32(args, request.max_bytes);
+  put_u64(args, request.lsn);
+
+  for (int retry = 0; retry < LAGGING_RETRIES; ++retry) {
+    std::string results;
+    if (!Call(LOGDB_PROC_SCAN, args, results)) {
+      return LogdbStat::ERR_IO;
+    }
+    XdrReader reader(results);
+    uint32_t res_stat, n_columns, n_values;
+    uint64_t parsed_lsn;
+    if (!reader.GetU32(res_stat) || !reader.GetU64(parsed_lsn) || !reader.GetU32(n_columns)
+        || !reader.GetU32(n_values)) {
+      return LogdbStat::ERR_IO;
+    }
+    auto stat = static_cast<LogdbStat>(res_stat);
+    if (stat == LogdbStat::ERR_LAGGING) {
+      usleep(1000);
+      continue;
+    }
+    if (stat != LogdbStat::OK) {
+      return stat;
+    }
+    if (n_values != 0 && (n_columns == 0 || n_values % n_columns != 0)) {
+      return LogdbStat::ERR_IO;
+    }
+    rows.resize(n_values == 0 ? 0 : n_values / n_columns);
+    for (auto &row : rows) {
+      row.resize(n_columns);
+      for (auto &value : row) {
+        if (!reader.GetValue(value)) {
+          return LogdbStat::ERR_IO;
+        }
+      }
+    }
+    uint32_t res_eof, n_next_key;
+    if (!reader.GetU32(res_eof) || !reader.GetU32(n_next_key) || n_next_key > LOGDB_MAX_KEY_FIELDS) {
+      return LogdbStat::ERR_IO;
+    }
+    std::vector<LogdbValue> next_key(n_next_key);
+    for (auto &value : next_key) {
+      if (!reader.GetValue(value)) {
+        return LogdbStat::ERR_IO;
+      }
+    }
+    eof = res_eof != 0;
+    if (!next_key.empty()) {
+      request.start_key = std::move(next_key);
+      request.start_inclusive = false;
+    }
+    return stat;
+  }
+  return LogdbStat::ERR_LAGGING;
+}
+
+LogdbStat PageServerClient::Snapshot(uint64_t lsn, const std::string &name, SnapshotInfo &info) {
+  if (name.empty() || name.size() > LOGDB_MAX_SNAPSHOT_NAME) {
+    return LogdbStat::ERR_BADNAME;
+  }
+  std::string args;
+  put_u32(args, group_);
+  put_u64(args, lsn);
+  put_opaque(args, name);
+
+  for (int retry = 0; retry < LAGGING_RETRIES; ++retry) {
+    std::string results;
+    if (!Call(LOGDB_PROC_SNAPSHOT, args, results)) {
+      return LogdbStat::ERR_IO;
+    }
+    XdrReader reader(results);
+    uint32_t res_stat;
+    uint64_t job_id;
+    if (!reader.GetU32(res_stat) || !reader.GetU64(job_id)) {
+      return LogdbStat::ERR_IO;
+    }
+    if (static_cast<LogdbStat>(res_stat) != LogdbStat::OK) {
+      return static_cast<LogdbStat>(res_stat);
+    }
+
+    std::string status_args;
+    put_u32(status_args, group_);
+    put_u64(status_args, job_id);
+    uint32_t done = 0;
+    while (!done) {
+      usleep(SNAPSHOT_POLL_US);
+      if (!Call(LOGDB_PROC_SNAPSHOTSTATUS, status_args, results)) {
+        return LogdbStat::ERR_IO;
+      }
+      XdrReader status_reader(results);
+      if (!status_reader.GetU32(res_stat) || !status_reader.GetU32(done) || !status_reader.GetU64(info.lsn)
+          || !status_reader.GetU32(info.files) || !status_reader.GetU32(info.cloned_files)
+          || !status_reader.GetU64(info.patched_pages)) {
+        return LogdbStat::ERR_IO;
+      }
+      if (!done && static_cast<LogdbStat>(res_stat) != LogdbStat::OK) {
+        return static_cast<LogdbStat>(res_stat);
+      }
+    }
+    auto stat = static_cast<LogdbStat>(res_stat);
+    if (stat == LogdbStat::ERR_LAGGING) {
+      usleep(1000);
+      continue;
+    }
+    return stat;
+  }
+  return LogdbStat::ERR_LAGGING;
+}
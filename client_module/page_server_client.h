@@ -0,0 +1,195 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 与 server-module/src/Protocols/XDR/logdb.x 保持一致
+static constexpr uint32_t LOGDB_PROGRAM = 0x2000DB00;
+static constexpr uint32_t LOGDB_VERSION = 1;
+static constexpr uint32_t LOGDB_PROC_GETPAGES = 1;
+static constexpr uint32_t LOGDB_PROC_SPACELSN = 2;
+static constexpr uint32_t LOGDB_PROC_FLUSHHINTS = 3;
+static constexpr uint32_t LOGDB_PROC_LOOKUP = 6;
+static constexpr uint32_t LOGDB_PROC_SCAN = 7;
+static constexpr uint32_t LOGDB_PROC_SNAPSHOT = 8;
+static constexpr uint32_t LOGDB_PROC_SNAPSHOTSTATUS = 9;
+static constexpr size_t LOGDB_PAGE_SIZE = 16384;
+static constexpr size_t LOGDB_MAX_PAGES = 32;
+static constexpr size_t LOGDB_MAX_HINTS = 1024;
+static constexpr size_t LOGDB_MAX_INDEX_FIELDS = 1023;
+static constexpr size_t LOGDB_MAX_KEY_FIELDS = 16;
+static constexpr size_t LOGDB_MAX_SCAN_PREDICATES = 16;
+static constexpr size_t LOGDB_MAX_SNAPSHOT_NAME = 255;
+// 存储节点没有响应时，超时之后关闭连接，读page退回到普通的pread。0表示不超时
+static constexpr uint32_t LOGDB_CONNECT_TIMEOUT_MS = 1000;
+static constexpr uint32_t LOGDB_SEND_TIMEOUT_MS = 5000;
+static constexpr uint32_t LOGDB_RECV_TIMEOUT_MS = 10000; // 同步的FLUSHHINTS要等hint被apply
+
+// 计算节点刷出的一个page，lsn是page头中的FIL_PAGE_LSN
+struct FlushHint {
+  uint32_t space_id;
+  uint32_t page_id;
+  uint64_t lsn;
+};
+
+enum class LogdbStat : uint32_t {
+  OK = 0,
+  ERR_NOSPACE = 1,
+  ERR_TOOBIG = 2,
+  ERR_LAGGING = 3,
+  ERR_NOPAGE = 4,
+  ERR_IO = 5,
+  ERR_NOVIEW = 6,
+  ERR_TOOOLD = 7,
+  ERR_NOGROUP = 8,
+  ERR_NOTFOUND = 9,
+  ERR_BADINDEX = 10,
+  ERR_EXIST = 11,
+  ERR_BADNAME = 12,
+  ERR_BUSY = 13,
+};
+
+enum class ScanOp : uint32_t {
+  EQ = 0,
+  NE = 1,
+  LT = 2,
+  LE = 3,
+  GT = 4,
+  GE = 5,
+  IS_NULL = 6,
+  IS_NOT_NULL = 7,
+};
+
+struct SnapshotInfo {
+  uint64_t lsn {0};           // 快照中的page都是这个lsn上的版本
+  uint32_t files {0};
+  uint32_t cloned_files {0};  // 用reflink克隆的文件，其余的是拷贝的
+  uint64_t patched_pages {0}; // 改写成lsn上的版本的page
+};
+
+// 一列的值，和它在记录中保存的格式一样
+struct LogdbValue {
+  bool null {false};
+  bool external {false}; // 列存在外部的BLOB page上，data最后20字节是BLOB指针
+  std::string data {};
+};
+
+// field_no op value，比较只能用在定长列上，value的长度等于列的长度，按字节比较
+struct ScanPredicate {
+  uint32_t field_no;
+  ScanOp op;
+  std::string value;
+};
+
+struct ScanRequest {
+  uint32_t space_id {0};
+  uint32_t root_page_no {0};
+  std::vector<uint16_t> field_lens {}; // 和Lookup一样
+  uint32_t n_uniq {0};
+  std::vector<LogdbValue> start_key {}; // 前n_uniq列的前缀，为空表示从第一条记录开始
+  bool start_inclusive {true};
+  std::vector<LogdbValue> end_key {};   // 扫描到不大于end_key的记录，为空表示扫描到最后
+  std::vector<ScanPredicate> predicates {};
+  std::vector<uint32_t> columns {};     // 返回的列，为空表示所有的列
+  uint32_t max_bytes {0};               // 一批最多返回的字节数，0表示服务端的上限
+  uint64_t lsn {0};                     // 和Lookup一样
+};
+
+/**
+ * 通过 LOGDB page server 协议（ONC RPC over TCP）批量读取存储节点上已经apply过的page。
+ * 一次 GETPAGES 可以读取同一个表空间中最多 LOGDB_MAX_PAGES 个不连续的page，
+ * 用来代替每个page一次的 NFS READ。
+ */
+class PageServerClient {
+ public:
+  /**
+   * 从环境变量 LOGDB_PAGE_SERVER=host:port 创建client，
+   * 存储节点上有多个MySQL实例时用 LOGDB_LOG_GROUP 指定本实例的log group，默认为0。
+   * LOGDB_CONNECT_TIMEOUT_MS、LOGDB_SEND_TIMEOUT_MS、LOGDB_RECV_TIMEOUT_MS 覆盖默认的超时
+   * @return 没有配置page server时返回nullptr，此时调用方应该退回到普通的pread
+   */
+  static PageServerClient *FromEnv();
+
+  PageServerClient(std::string host, uint16_t port, uint32_t group = 0)
+      : host_(std::move(host)), port_(port), group_(group) {}
+  ~PageServerClient();
+
+  /**
+   * @param space_id 表空间id
+   * @param page_ids 要读取的page，数量不超过 LOGDB_MAX_PAGES
+   * @param min_lsn 存储节点至少要解析到的lsn，0表示不限制
+   * @param dest_bufs 每一个page对应的目标buf，大小为 page_size
+   * @param page_ok 返回每一个page是否读取成功
+   * @param parsed_lsn 不为nullptr时返回这些page包含的log已经解析到的lsn
+   * @param page_size page在磁盘上的大小，压缩表空间是zip size
+   * @return RPC本身是否成功，RPC失败或者存储节点不负责这个表空间（ERR_NOSPACE）时返回false，page_ok 全部为 false
+   */
+  bool GetPages(uint32_t space_id, const std::vector<uint32_t> &page_ids, uint64_t min_lsn,
+                const std::vector<char *> &dest_bufs, std::vector<bool> &page_ok,
+                uint64_t *parsed_lsn = nullptr, size_t page_size = LOGDB_PAGE_SIZE);
+
+  /**
+   * 查询表空间最后一条log的结束lsn，在这之后读到的page都是最新的
+   * @return RPC是否成功
+   */
+  bool SpaceLsn(uint32_t space_id, uint64_t &space_lsn);
+
+  /**
+   * 把刷出的page告诉存储节点，让这些page优先被apply
+   * @param hints 数量不超过 LOGDB_MAX_HINTS
+   * @param sync 为true时等到存储节点把目前为止收到的hint全部apply之后才返回
+   * @return RPC是否成功
+   */
+  bool FlushHints(const std::vector<FlushHint> &hints, bool sync);
+
+  /**
+   * 在存储节点上沿B-tree查找key对应的叶子记录，代替逐层读page
+   * @param root_page_no 索引的根page
+   * @param field_lens 索引的列描述，和InnoDB写到redo中的一样（mlog_open_and_write_index）
+   * @param key 前n_uniq列，每一列是它在记录中保存的格式，存储节点按字节比较
+   * @param lsn 0表示读最新的page，否则需要先登记不晚于它的read view
+   * @param record 返回物理记录，记录的origin在extra_size处
+   * @param page_no 不为nullptr时返回记录所在的叶子page
+   * @return 存储节点返回的状态，RPC失败时返回ERR_IO
+   */
+  LogdbStat Lookup(uint32_t space_id, uint32_t root_page_no, const std::vector<uint16_t> &field_lens,
+                   const std::vector<std::string> &key, uint64_t lsn, std::string &record,
+                   uint32_t &extra_size, uint32_t *page_no = nullptr);
+
+  /**
+   * 在存储节点上按key的顺序扫描索引的叶子page，只返回满足所有条件的行中需要的列，
+   * 标记删除的记录被跳过。一次返回一批，eof为false时用同一个request再调用一次取下一批
+   * @param request 成功时start_key被推进到下一批开始的位置
+   * @param rows 返回这一批的行，每一行是request.columns中的列
+   * @param eof 返回是否已经扫描到了end_key或者最后一条记录
+   * @return 存储节点返回的状态，RPC失败时返回ERR_IO
+   */
+  LogdbStat Scan(ScanRequest &request, std::vector<std::vector<LogdbValue>> &rows, bool &eof);
+
+  /**
+   * 在存储节点的Snapshot_Path/name下生成所有表空间在lsn上的一致的快照，apply不停。
+   * 快照在存储节点的后台生成，这里轮询到它完成为止
+   * @param lsn 0表示存储节点现在解析到的lsn，否则不能早于它
+   * @param info 成功时返回快照的lsn和生成的文件
+   * @return 存储节点返回的状态，已经有快照在生成时返回ERR_BUSY，RPC失败时返回ERR_IO
+   */
+  LogdbStat Snapshot(uint64_t lsn, const std::string &name, SnapshotInfo &info);
+
+ private:
+  int AcquireConnection();
+  void ReleaseConnection(int fd, bool healthy);
+  // 发送一次RPC，results 中是去掉了reply header之后的结果
+  bool Call(uint32_t proc, const std::string &args, std::string &results);
+
+  std::string host_;
+  uint16_t port_;
+  uint32_t group_; // 每个请求都带上log group
+  uint32_t connect_timeout_ms_ {LOGDB_CONNECT_TIMEOUT_MS};
+  uint32_t send_timeout_ms_ {LOGDB_SEND_TIMEOUT_MS};
+  uint32_t recv_timeout_ms_ {LOGDB_RECV_TIMEOUT_MS};
+  std::mutex lock_ {};
+  std::vector<int> idle_fds_ {}; // 每个连接同一时间只给一个线程使用
+  uint32_t next_xid_ {1};
+};
@@ -0,0 +1,16 @@
+#!/bin/bash
+# 依次在不加LD_PRELOAD和加载每一种catcher的情况下运行io_bench，参数原样传给io_bench
+# usage: ./run_io_bench.sh <build_dir> [io_bench options]
+set -e
+
+BUILD_DIR=$(cd "${1:?usage: $0 <build_dir> [io_bench options]}" && pwd)
+shift
+
+for variant in none catcher_original catcher_filter catcher; do
+  echo "==== ${variant}"
+  if [ "${variant}" = "none" ]; then
+    "${BUILD_DIR}/io_bench" "$@"
+  else
+    LD_PRELOAD="${BUILD_DIR}/lib${variant}.so" "${BUILD_DIR}/io_bench" "$@"
+  fi
+done
@@ -608,17 +608,19 @@ void mdcache_read2(struct fsal_obj_handle *obj_hdl,
 		   void *caller_arg,
            bool dummy)
 {
-    int space_id = is_ibd_file_in_handle(obj_hdl);
+    int group = mdc_log_group();
+    int space_id = is_ibd_file_in_handle(group, obj_hdl);
     if (space_id >= 0) {
         // read ibd file
         size_t io_amount = 0;
         for (int i = 0; i < read_arg->iov_count; ++i) {
             io_amount += read_arg->iov[i].iov_len;
         }
-        wait_until_apply_done(space_id, read_arg->offset, io_amount);
+        // 压缩表空间的page在磁盘上只占zip size
+        uint32_t page_size = get_space_page_size(group, space_id);
+        wait_until_apply_done(group, space_id, read_arg->offset, io_amount);
         char *buf = malloc(io_amount);
-#define DATA_PAGE_SIZE 16384
-        copy_page_to_buf(buf, space_id, read_arg->offset / DATA_PAGE_SIZE, io_amount / DATA_PAGE_SIZE);
+        copy_page_to_buf(group, buf, space_id, read_arg->offset / page_size, io_amount / page_size);
         char *written_ptr = buf;
         for (int i = 0; i < read_arg->iov_count; ++i) {
             memcpy(read_arg->iov[i].iov_base, written_ptr, read_arg->iov[i].iov_len);
@@ -627,7 +629,6 @@ void mdcache_read2(struct fsal_obj_handle *obj_hdl,
         free(buf);
         read_arg->io_amount = io_amount;
         read_arg->end_of_file = false;
-#undef DATA_PAGE_SIZE
 //        return;
     }
 	mdcache_entry_t *entry =
@@ -747,10 +748,11 @@ void mdcache_write2(struct fsal_obj_handle *obj_hdl,
 		    struct fsal_io_arg *write_arg,
 		    void *caller_arg)
 {
-    int index = is_log_file_in_handle(obj_hdl);
+    int group = mdc_log_group();
+    int index = is_log_file_in_handle(group, obj_hdl);
     if (index >= 0) { //hkc-debug-point-1
 //        LogEvent(COMPONENT_FSAL, "thread[%ld] log writer start write to ib_logfile%d, offset %ld", pthread_self(), index, write_arg->offset);
-        copy_log_to_buf(index, write_arg->offset, write_arg->iov, write_arg->iov_count);
+        copy_log_to_buf(group, index, write_arg->offset, write_arg->iov, write_arg->iov_count);
 //        LogEvent(COMPONENT_FSAL, "thread[%ld] log writer end write to ib_logfile%d, offset %ld", pthread_self(), index, write_arg->offset);
     }
 	mdcache_entry_t *entry =
@@ -175,16 +175,17 @@ static fsal_status_t mdcache_lookup(struct fsal_obj_handle *parent,
 	status = mdc_lookup(mdc_parent, name, true, &entry, attrs_out);
 	if (entry) {
         *handle = &entry->obj_handle;
-        int index = is_log_file_in_name(name);
+        int group = mdc_log_group();
+        int index = is_log_file_in_name(group, name);
         if (index >= 0) {
             // log file
-            register_log_file_handle(index, *handle);
+            register_log_file_handle(group, index, *handle);
         }
 
-        int space_id = is_ibd_file_in_name(name);
+        int space_id = is_ibd_file_in_name(group, name);
         if (space_id >= 0) {
             // ibd file
-            register_ibd_file_handle(*handle, space_id);
+            register_ibd_file_handle(group, *handle, space_id);
         }
     }
 
@@ -41,6 +41,8 @@
 #include "fsal_up.h"
 #include "fsal_convert.h"
 #include "display.h"
+#include "export_mgr.h"
+#include "applier/interface.h"
 
 typedef struct mdcache_fsal_obj_handle mdcache_entry_t;
 
@@ -570,6 +572,14 @@ static inline struct mdcache_fsal_export *mdc_cur_export(void)
 	return mdc_export(op_ctx->fsal_export);
 }
 
+/* log group of the MySQL instance behind the current export, -1 if none */
+static inline int mdc_log_group(void)
+{
+	if (op_ctx == NULL || op_ctx->ctx_export == NULL)
+		return -1;
+	return get_export_log_group(op_ctx->ctx_export->export_id);
+}
+
 void mdc_clean_entry(mdcache_entry_t *entry);
 fsal_status_t mdc_check_mapping(mdcache_entry_t *entry);
 void _mdcache_kill_entry(mdcache_entry_t *entry,
@@ -692,6 +692,7 @@ static struct gsh_dbus_interface admin_interface = {
 static struct gsh_dbus_interface *admin_interfaces[] = {
 	&admin_interface,
 	&log_interface,
+	&logdb_interface,
 	NULL
 };
 
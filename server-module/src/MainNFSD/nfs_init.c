@@ -146,6 +146,8 @@ char *nfs_pidfile_path = GANESHA_PIDFILE_PATH;
  * LOG { FORMAT {} }
  * EXPORT {}
  * EXPORT { CLIENT {} }
+ * LOGDB {} (apply threads, buffer pool and apply index memory only)
+ * LOGDB { Log_Group {} } (same)
  *
  */
 
@@ -189,6 +191,11 @@ void reread_config(void)
 	if (status < 0)
 		LogCrit(COMPONENT_CONFIG, "Error while parsing EXPORT entries");
 
+	/* Update the applier resources */
+	status = reread_logdb_config(config_struct, &err_type);
+	if (status < 0)
+		LogCrit(COMPONENT_CONFIG, "Error while parsing LOGDB entries");
+
 	report_config_errors(&err_type, NULL, config_errs_to_log);
 	config_Free(config_struct);
 }
@@ -446,6 +453,9 @@ int nfs_set_param_from_conf(config_file_t parse_tree,
 	if (mdcache_set_param_from_conf(parse_tree, err_type) < 0)
 		return -1;
 
+	if (logdb_set_param_from_conf(parse_tree, err_type) < 0)
+		return -1;
+
 	if (load_recovery_param_from_conf(parse_tree, err_type) < 0)
 		return -1;
 
@@ -56,6 +56,7 @@
 #include "nlm4.h"
 #include "rquota.h"
 #include "nfsacl.h"
+#include "logdb.h"
 #include "nfs_init.h"
 #include "nfs_core.h"
 #include "nfs_exports.h"
@@ -138,6 +139,9 @@ const char *tags[P_COUNT] = {
 #ifdef USE_NFSACL3
 	"NFSACL",
 #endif
+#ifdef _USE_LOGDB
+	"LOGDB",
+#endif
 #ifdef RPC_VSOCK
 	"NFS_VSOCK",
 #endif
@@ -224,6 +228,11 @@ static void unregister_rpc(void)
 		unregister(NFS_program[P_NFSACL], NFSACL_V3, NFSACL_V3);
 	}
 #endif
+
+#ifdef _USE_LOGDB
+	if (nfs_param.core_param.enable_LOGDB)
+		unregister(NFS_program[P_LOGDB], LOGDB_V1, LOGDB_V1);
+#endif
 }
 
 static inline bool nfs_protocol_enabled(protos p)
@@ -265,6 +274,13 @@ static inline bool nfs_protocol_enabled(protos p)
 		break;
 #endif
 
+#ifdef _USE_LOGDB
+	case P_LOGDB:
+		if (nfs_param.core_param.enable_LOGDB)
+			return true;
+		break;
+#endif
+
 	default:
 		break;
 	}
@@ -390,6 +406,9 @@ const svc_xprt_fun_t udp_dispatch[] = {
 #ifdef USE_NFSACL3
 	nfs_rpc_dispatch_udp_NFSACL,
 #endif
+#ifdef _USE_LOGDB
+	NULL,
+#endif
 #ifdef RPC_VSOCK
 	NULL,
 #endif
@@ -451,6 +470,17 @@ static enum xprt_stat nfs_rpc_dispatch_tcp_NFSACL(SVCXPRT *xprt)
 }
 #endif
 
+#ifdef _USE_LOGDB
+static enum xprt_stat nfs_rpc_dispatch_tcp_LOGDB(SVCXPRT *xprt)
+{
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "LOGDB TCP request on SVCXPRT %p fd %d",
+		     xprt, xprt->xp_fd);
+	xprt->xp_dispatch.process_cb = nfs_rpc_valid_LOGDB;
+	return nfs_rpc_tcp_user_data(xprt);
+}
+#endif
+
 #ifdef RPC_VSOCK
 static enum xprt_stat nfs_rpc_dispatch_tcp_VSOCK(SVCXPRT *xprt)
 {
@@ -476,6 +506,9 @@ const svc_xprt_fun_t tcp_dispatch[P_COUNT] = {
 #ifdef USE_NFSACL3
 	nfs_rpc_dispatch_tcp_NFSACL,
 #endif
+#ifdef _USE_LOGDB
+	nfs_rpc_dispatch_tcp_LOGDB,
+#endif
 #ifdef RPC_VSOCK
 	nfs_rpc_dispatch_tcp_VSOCK,
 #endif
@@ -1024,6 +1057,11 @@ static int alloc_socket_setopts(int p)
 
 static bool enable_udp_listener(protos prot)
 {
+#ifdef _USE_LOGDB
+	/* GETPAGES replies are far larger than a datagram, TCP only */
+	if (prot == P_LOGDB)
+		return false;
+#endif
 	if (nfs_param.core_param.enable_UDP & UDP_LISTENER_ALL)
 		return true;
 #ifdef _USE_NFS3
@@ -1482,6 +1520,13 @@ void nfs_Init_svc(void)
 		Register_program(P_RQUOTA, EXT_RQUOTAVERS);
 	}
 #endif
+
+	/* compute nodes reach the page server on its configured port,
+	 * so rpcbind registration is best effort */
+#ifdef _USE_LOGDB
+	if (nfs_param.core_param.enable_LOGDB)
+		__Register_program(P_LOGDB, LOGDB_V1);
+#endif
 #endif	/* RPCBIND */
 }
 
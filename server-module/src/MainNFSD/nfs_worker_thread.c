@@ -49,6 +49,7 @@
 #include "log.h"
 #include "fsal.h"
 #include "rquota.h"
+#include "logdb.h"
 #include "nfs_init.h"
 #include "nfs_convert.h"
 #include "nfs_core.h"
@@ -61,6 +62,7 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "applier/interface.h"
 
 #ifdef USE_LTTNG
 #include "gsh_lttng/nfs_rpc.h"
@@ -695,6 +697,101 @@ const nfs_function_desc_t nfsacl_func_desc[] = {
 };
 #endif
 
+#ifdef _USE_LOGDB
+const nfs_function_desc_t logdb1_func_desc[] = {
+	[LOGDBPROC_NULL] = {
+	       .service_function = logdb_Null,
+	       .free_function = logdb_Null_Free,
+	       .xdr_decode_func = (xdrproc_t) xdr_void,
+	       .xdr_encode_func = (xdrproc_t) xdr_void,
+	       .funcname = "LOGDB_NULL",
+	       .dispatch_behaviour = NOTHING_SPECIAL},
+	[LOGDBPROC_GETPAGES] = {
+				 .service_function = logdb_getpages,
+				 .free_function = logdb_getpages_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_getpages_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_getpages_res,
+				 .funcname = "LOGDB_GETPAGES",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_SPACELSN] = {
+				 .service_function = logdb_spacelsn,
+				 .free_function = logdb_spacelsn_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_spacelsn_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_spacelsn_res,
+				 .funcname = "LOGDB_SPACELSN",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_FLUSHHINTS] = {
+				 .service_function = logdb_flushhints,
+				 .free_function = logdb_flushhints_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_flushhints_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_flushhints_res,
+				 .funcname = "LOGDB_FLUSHHINTS",
+				 .dispatch_behaviour =
+				 (MAKES_WRITE | NEEDS_CRED | SUPPORTS_GSS)},
+	[LOGDBPROC_READVIEW] = {
+				 .service_function = logdb_readview,
+				 .free_function = logdb_readview_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_readview_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_readview_res,
+				 .funcname = "LOGDB_READVIEW",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_GETPAGESASOF] = {
+				 .service_function = logdb_getpagesasof,
+				 .free_function = logdb_getpagesasof_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_getpages_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_getpages_res,
+				 .funcname = "LOGDB_GETPAGESASOF",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_LOOKUP] = {
+				 .service_function = logdb_lookup,
+				 .free_function = logdb_lookup_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_lookup_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_lookup_res,
+				 .funcname = "LOGDB_LOOKUP",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_SCAN] = {
+				 .service_function = logdb_scan,
+				 .free_function = logdb_scan_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_scan_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_scan_res,
+				 .funcname = "LOGDB_SCAN",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS},
+	[LOGDBPROC_SNAPSHOT] = {
+				 .service_function = logdb_snapshot,
+				 .free_function = logdb_snapshot_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_snapshot_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_snapshot_res,
+				 .funcname = "LOGDB_SNAPSHOT",
+				 .dispatch_behaviour =
+				 (MAKES_WRITE | NEEDS_CRED | SUPPORTS_GSS)},
+	[LOGDBPROC_SNAPSHOTSTATUS] = {
+				 .service_function = logdb_snapshotstatus,
+				 .free_function = logdb_snapshotstatus_Free,
+				 .xdr_decode_func =
+				 (xdrproc_t) xdr_logdb_snapshotstatus_args,
+				 .xdr_encode_func =
+				 (xdrproc_t) xdr_logdb_snapshotstatus_res,
+				 .funcname = "LOGDB_SNAPSHOTSTATUS",
+				 .dispatch_behaviour = NEEDS_CRED | SUPPORTS_GSS}
+};
+#endif
+
 void auth_failure(nfs_request_t *reqdata, enum auth_stat auth_rc)
 {
 	svcerr_auth(&reqdata->svc, auth_rc);
@@ -1270,11 +1367,47 @@ retry_after_drc_suspend:
 	} else if (reqdata->svc.rq_msg.cb_prog == NFS_program[P_MNT]) {
 		progname = "MNT";
 #endif /* _USE_NFS3 */
+#ifdef _USE_LOGDB
+	} else if (reqdata->svc.rq_msg.cb_prog == NFS_program[P_LOGDB]) {
+		/* The arguments of every LOGDB procedure but NULL begin with
+		 * the log group, which is served to the clients of its export.
+		 * A log group matching any export has no client list to check.
+		 */
+		u_int group = arg_nfs->arg_logdb_spacelsn.group;
+		int logdb_export = get_log_group_export(group);
+
+		progname = "LOGDB";
+
+		if (logdb_export == LOGDB_ANY_EXPORT) {
+			LogInfo(COMPONENT_DISPATCH,
+				"LOGDB Request from client %s for log group %u without an Export_Id",
+				client_ip, group);
+
+			auth_failure(reqdata, AUTH_TOOWEAK);
+			goto freeargs;
+		}
+
+		/* no such log group, the procedure answers LOGDB_ERR_NOGROUP */
+		if (logdb_export >= 0) {
+			set_op_context_export(get_gsh_export(logdb_export));
+
+			if (op_ctx->ctx_export == NULL) {
+				LogInfoAlt(COMPONENT_DISPATCH, COMPONENT_EXPORT,
+					"LOGDB Request from client %s for log group %u has invalid export %d",
+					client_ip, group, logdb_export);
+
+				auth_failure(reqdata, AUTH_TOOWEAK);
+				goto freeargs;
+			}
+		}
+#endif /* _USE_LOGDB */
 	}
 
 	/* Only do access check if we have an export. */
 	if (op_ctx->ctx_export != NULL) {
-		/* We ONLY get here for NFS v3 or NLM requests with a handle */
+		/* We ONLY get here for NFS v3 or NLM requests with a handle,
+		 * or for LOGDB requests of a log group bound to an export
+		 */
 		xprt_type_t xprt_type = svc_get_xprt_type(xprt);
 
 		LogMidDebugAlt(COMPONENT_DISPATCH, COMPONENT_EXPORT,
@@ -1299,7 +1432,11 @@ retry_after_drc_suspend:
 		}
 
 		if ((op_ctx->export_perms.options &
-		     EXPORT_OPTION_NFSV3) == 0) {
+		     EXPORT_OPTION_NFSV3) == 0
+#ifdef _USE_LOGDB
+		    && reqdata->svc.rq_msg.cb_prog != NFS_program[P_LOGDB]
+#endif
+		    ) {
 			LogInfoAlt(COMPONENT_DISPATCH, COMPONENT_EXPORT,
 				"%s Version %" PRIu32
 				" not allowed on Export_Id %d %s for client %s",
@@ -1862,3 +1999,26 @@ enum xprt_stat nfs_rpc_valid_NFSACL(struct svc_req *req)
 	return nfs_rpc_noprog(reqdata);
 }
 #endif
+
+#ifdef _USE_LOGDB
+enum xprt_stat nfs_rpc_valid_LOGDB(struct svc_req *req)
+{
+	nfs_request_t *reqdata =
+			container_of(req, struct nfs_request, svc);
+
+	reqdata->funcdesc = &invalid_funcdesc;
+
+	if (req->rq_msg.cb_prog == NFS_program[P_LOGDB]) {
+		if (req->rq_msg.cb_vers == LOGDB_V1) {
+			if (req->rq_msg.cb_proc <= LOGDBPROC_SNAPSHOTSTATUS) {
+				reqdata->funcdesc =
+					&logdb1_func_desc[req->rq_msg.cb_proc];
+				return nfs_rpc_process_request(reqdata, false);
+			}
+			return nfs_rpc_noproc(reqdata);
+		}
+		return nfs_rpc_novers(reqdata, LOGDB_V1, LOGDB_V1);
+	}
+	return nfs_rpc_noprog(reqdata);
+}
+#endif
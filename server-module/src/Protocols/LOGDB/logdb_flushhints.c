@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB FLUSHHINTS function.
+ *
+ * Compute nodes report the pages they flush together with the page lsn.
+ * The applier materialises those pages ahead of the segment scheduler,
+ * so that a later read or checkpoint does not have to wait for them.
+ * With sync set, the reply is held until every hint queued so far has
+ * been applied.
+ *
+ * @param[in]  arg    hints and sync flag
+ * @param[in]  req    Ignored
+ * @param[out] res    parsed lsn after the hints were queued
+ */
+int logdb_flushhints(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_flushhints_args *args = &arg->arg_logdb_flushhints;
+	logdb_flushhints_res *fres = &res->res_logdb_flushhints;
+	struct page_flush_hint *hints;
+	uint64_t seq;
+	u_int i, n = args->hints.hints_len;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_FLUSHHINTS group=%u n=%u sync=%d",
+		     args->group, n, args->sync);
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		fres->status = LOGDB_ERR_NOGROUP;
+		fres->parsed_lsn = 0;
+		return NFS_REQ_OK;
+	}
+
+	if (n > LOGDB_MAX_HINTS) {
+		fres->status = LOGDB_ERR_TOOBIG;
+		fres->parsed_lsn = 0;
+		return NFS_REQ_OK;
+	}
+
+	hints = gsh_calloc(n + 1, sizeof(*hints));
+	for (i = 0; i < n; i++) {
+		hints[i].space_id = args->hints.hints_val[i].space_id;
+		hints[i].page_id = args->hints.hints_val[i].page_no;
+		hints[i].lsn = args->hints.hints_val[i].lsn;
+	}
+	seq = push_flush_hints(args->group, hints, n);
+	gsh_free(hints);
+
+	if (args->sync)
+		wait_flush_hints_done(args->group, seq);
+
+	fres->parsed_lsn = wait_until_parse_done(args->group);
+	fres->status = LOGDB_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_flushhints
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_flushhints_Free(nfs_res_t *res)
+{
+	/* Nothing to do */
+}
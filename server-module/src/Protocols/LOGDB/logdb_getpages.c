@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/**
+ * @file  logdb_getpages.c
+ * @brief Batched page reads for compute nodes.
+ *
+ * A compute node that misses its local buffer pool asks for up to
+ * LOGDB_MAX_PAGES pages of one tablespace in a single round trip instead
+ * of issuing one NFS READ per page.  Every requested page is brought up
+ * to date with the redo that has been parsed so far before it is copied
+ * into the reply.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "abstract_mem.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB GETPAGES function.
+ *
+ * @param[in]  arg    page numbers of one tablespace and the lowest LSN the
+ *                    caller is willing to see
+ * @param[in]  req    Ignored
+ * @param[out] res    per page status and contents
+ */
+int logdb_getpages(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_getpages_args *args = &arg->arg_logdb_getpages;
+	logdb_getpages_res *gres = &res->res_logdb_getpages;
+	u_int n_pages = args->page_nos.page_nos_len;
+	u_int i;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_GETPAGES group=%u space_id=%u n_pages=%u min_lsn=%"
+		     PRIu64, args->group, args->space_id, n_pages, args->min_lsn);
+
+	memset(gres, 0, sizeof(*gres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		gres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	if (n_pages == 0 || n_pages > LOGDB_MAX_PAGES) {
+		gres->status = LOGDB_ERR_TOOBIG;
+		return NFS_REQ_OK;
+	}
+
+	/* the caller reads the whole batch from the file instead */
+	if (!is_space_regenerated(args->group, args->space_id)) {
+		gres->status = LOGDB_ERR_NOSPACE;
+		return NFS_REQ_OK;
+	}
+
+	/* one wait for the whole batch instead of one per page */
+	gres->parsed_lsn = wait_until_parse_done(args->group);
+	if (gres->parsed_lsn < args->min_lsn) {
+		/* the redo the caller depends on has not reached us yet */
+		gres->status = LOGDB_ERR_LAGGING;
+		return NFS_REQ_OK;
+	}
+
+	gres->pages.pages_val = gsh_calloc(n_pages, sizeof(logdb_page));
+	gres->pages.pages_len = n_pages;
+
+	for (i = 0; i < n_pages; i++) {
+		logdb_page *page = &gres->pages.pages_val[i];
+
+		page->page_no = args->page_nos.page_nos_val[i];
+		page->data.data_val = gsh_malloc(LOGDB_PAGE_SIZE);
+
+		if (apply_and_copy_page(args->group, page->data.data_val,
+					args->space_id, page->page_no) != 0) {
+			gsh_free(page->data.data_val);
+			page->data.data_val = NULL;
+			page->status = LOGDB_ERR_NOPAGE;
+			continue;
+		}
+		page->data.data_len = get_space_page_size(args->group,
+							  args->space_id);
+		page->status = LOGDB_OK;
+	}
+
+	gres->status = LOGDB_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_getpages
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_getpages_Free(nfs_res_t *res)
+{
+	logdb_getpages_res *gres = &res->res_logdb_getpages;
+	u_int i;
+
+	for (i = 0; i < gres->pages.pages_len; i++)
+		gsh_free(gres->pages.pages_val[i].data.data_val);
+	gsh_free(gres->pages.pages_val);
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/**
+ * @file  logdb_getpagesasof.c
+ * @brief Batched page reads at a given lsn for read-only compute nodes.
+ *
+ * Same as GETPAGES, except that every page is returned as it was at
+ * min_lsn instead of at the latest parsed redo.  The caller must hold a
+ * read view at or below min_lsn, otherwise the version may already have
+ * been purged and LOGDB_ERR_TOOOLD is returned for that page.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "abstract_mem.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB GETPAGESASOF function.
+ *
+ * @param[in]  arg    page numbers of one tablespace and the lsn to read at
+ * @param[in]  req    Ignored
+ * @param[out] res    per page status and contents
+ */
+int logdb_getpagesasof(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_getpages_args *args = &arg->arg_logdb_getpages;
+	logdb_getpages_res *gres = &res->res_logdb_getpages;
+	u_int n_pages = args->page_nos.page_nos_len;
+	u_int i;
+	int rc;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_GETPAGESASOF group=%u space_id=%u n_pages=%u lsn=%"
+		     PRIu64, args->group, args->space_id, n_pages, args->min_lsn);
+
+	memset(gres, 0, sizeof(*gres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		gres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	if (n_pages == 0 || n_pages > LOGDB_MAX_PAGES) {
+		gres->status = LOGDB_ERR_TOOBIG;
+		return NFS_REQ_OK;
+	}
+
+	gres->parsed_lsn = wait_until_parse_done(args->group);
+	if (gres->parsed_lsn < args->min_lsn) {
+		gres->status = LOGDB_ERR_LAGGING;
+		return NFS_REQ_OK;
+	}
+
+	gres->pages.pages_val = gsh_calloc(n_pages, sizeof(logdb_page));
+	gres->pages.pages_len = n_pages;
+
+	for (i = 0; i < n_pages; i++) {
+		logdb_page *page = &gres->pages.pages_val[i];
+
+		page->page_no = args->page_nos.page_nos_val[i];
+		page->data.data_val = gsh_malloc(LOGDB_PAGE_SIZE);
+
+		rc = apply_and_copy_page_as_of(args->group,
+					       page->data.data_val,
+					       args->space_id, page->page_no,
+					       args->min_lsn);
+		if (rc != 0) {
+			gsh_free(page->data.data_val);
+			page->data.data_val = NULL;
+			page->status = rc == -2 ? LOGDB_ERR_TOOOLD
+						: LOGDB_ERR_NOPAGE;
+			continue;
+		}
+		page->data.data_len = get_space_page_size(args->group,
+							  args->space_id);
+		page->status = LOGDB_OK;
+	}
+
+	gres->status = LOGDB_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_getpagesasof
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_getpagesasof_Free(nfs_res_t *res)
+{
+	logdb_getpages_Free(res);
+}
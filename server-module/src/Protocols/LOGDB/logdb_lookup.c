@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file  logdb_lookup.c
+ * @brief Primary key point lookups on the storage node.
+ *
+ * A point select on the compute node reads one page per B-tree level.
+ * LOOKUP walks the tree here instead and returns only the leaf record,
+ * one round trip and a few hundred bytes instead of a 16K page per
+ * level.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "abstract_mem.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB LOOKUP function.
+ *
+ * @param[in]  arg    index root, index description, key and lsn
+ * @param[in]  req    Ignored
+ * @param[out] res    the leaf record and the page it is on
+ */
+int logdb_lookup(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_lookup_args *args = &arg->arg_logdb_lookup;
+	logdb_lookup_res *lres = &res->res_logdb_lookup;
+	u_int n_fields = args->field_lens.field_lens_len;
+	u_int n_uniq = args->key.key_len;
+	uint16_t field_lens[LOGDB_MAX_INDEX_FIELDS];
+	struct lookup_key_field key[LOGDB_MAX_KEY_FIELDS];
+	struct lookup_result result;
+	u_int i;
+	int rc;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_LOOKUP group=%u space_id=%u root=%u lsn=%"
+		     PRIu64, args->group, args->space_id, args->root_page_no,
+		     args->lsn);
+
+	memset(lres, 0, sizeof(*lres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		lres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	if (n_uniq == 0 || n_uniq != args->n_uniq || n_uniq > n_fields) {
+		lres->status = LOGDB_ERR_BADINDEX;
+		return NFS_REQ_OK;
+	}
+	for (i = 0; i < n_fields; i++) {
+		if (args->field_lens.field_lens_val[i] > UINT16_MAX) {
+			lres->status = LOGDB_ERR_BADINDEX;
+			return NFS_REQ_OK;
+		}
+		field_lens[i] = args->field_lens.field_lens_val[i];
+	}
+	for (i = 0; i < n_uniq; i++) {
+		key[i].data = args->key.key_val[i].data.data_val;
+		key[i].len = args->key.key_val[i].data.data_len;
+	}
+
+	lres->parsed_lsn = wait_until_parse_done(args->group);
+	if (lres->parsed_lsn < args->lsn) {
+		lres->status = LOGDB_ERR_LAGGING;
+		return NFS_REQ_OK;
+	}
+
+	lres->record.record_val = gsh_malloc(LOGDB_PAGE_SIZE);
+	rc = lookup_record(args->group, args->space_id, args->root_page_no,
+			   field_lens, n_fields, n_uniq, key, args->lsn,
+			   lres->record.record_val, &result);
+	switch (rc) {
+	case 0:
+		lres->status = LOGDB_OK;
+		lres->page_no = result.page_no;
+		lres->extra_size = result.extra_size;
+		lres->record.record_len = result.rec_len;
+		return NFS_REQ_OK;
+	case -2:
+		lres->status = LOGDB_ERR_TOOOLD;
+		break;
+	case -3:
+		lres->status = LOGDB_ERR_NOTFOUND;
+		break;
+	case -4:
+		lres->status = LOGDB_ERR_BADINDEX;
+		break;
+	default:
+		lres->status = LOGDB_ERR_NOPAGE;
+		break;
+	}
+	gsh_free(lres->record.record_val);
+	lres->record.record_val = NULL;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_lookup
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_lookup_Free(nfs_res_t *res)
+{
+	gsh_free(res->res_logdb_lookup.record.record_val);
+}
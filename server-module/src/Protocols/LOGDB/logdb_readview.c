@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB READVIEW function.
+ *
+ * A read-only compute node registers the lsn it has replayed to, and
+ * keeps advancing it.  While the view exists the applier retains the
+ * page versions the node may still ask for with GETPAGESASOF.  Views
+ * that are not advanced for a while expire.
+ *
+ * @param[in]  arg    view id (0 to register) and lsn (0 to release)
+ * @param[in]  req    Ignored
+ * @param[out] res    view id and parsed lsn
+ */
+int logdb_readview(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_readview_args *args = &arg->arg_logdb_readview;
+	logdb_readview_res *vres = &res->res_logdb_readview;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_READVIEW group=%u view_id=%"
+		     PRIu64 " lsn=%" PRIu64, args->group, args->view_id,
+		     args->lsn);
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		vres->status = LOGDB_ERR_NOGROUP;
+		vres->view_id = 0;
+		vres->parsed_lsn = 0;
+		return NFS_REQ_OK;
+	}
+
+	vres->status = LOGDB_OK;
+	vres->view_id = args->view_id;
+
+	if (args->view_id == 0) {
+		vres->view_id = register_read_view(args->group, args->lsn);
+		/* versions before lsn are already gone, retry later */
+		if (vres->view_id == 0)
+			vres->status = LOGDB_ERR_TOOOLD;
+	} else if (args->lsn == 0) {
+		release_read_view(args->group, args->view_id);
+	} else if (update_read_view(args->group, args->view_id,
+				    args->lsn) != 0) {
+		vres->status = LOGDB_ERR_NOVIEW;
+	}
+
+	vres->parsed_lsn = wait_until_parse_done(args->group);
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_readview
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_readview_Free(nfs_res_t *res)
+{
+	/* Nothing to do */
+}
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file  logdb_scan.c
+ * @brief Filtered index scans on the storage node.
+ *
+ * A scan on the compute node reads every leaf page of the index and
+ * throws most of the rows away. SCAN walks the leaves here instead,
+ * evaluates the predicates pushed down with it and returns only the
+ * matching rows, and only the columns asked for, a batch per call.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "abstract_mem.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/* XDR size of a logdb_value besides its data: null, external, length */
+#define LOGDB_VALUE_OVERHEAD (3 * BYTES_PER_XDR_UNIT)
+/* a row is at most a page of data plus the overhead of its columns */
+#define LOGDB_SCAN_MIN_BYTES (2 * LOGDB_PAGE_SIZE)
+
+struct logdb_scan_batch {
+	logdb_scan_res *res;
+	u_int values_size;	/* allocated entries of res->values */
+	char *data;		/* column data of every row in the batch */
+	u_int data_used;
+	u_int xdr_used;		/* encoded size of the rows so far */
+	u_int max_bytes;
+};
+
+/* scan_row_callback, copies a matching row into the reply */
+static int logdb_scan_row(void *arg, const struct scan_value *values,
+			  uint32_t n_values)
+{
+	struct logdb_scan_batch *batch = arg;
+	logdb_scan_res *sres = batch->res;
+	u_int size = 0;
+	uint32_t i;
+
+	for (i = 0; i < n_values; i++) {
+		size += LOGDB_VALUE_OVERHEAD;
+		if (values[i].len != LOOKUP_SQL_NULL)
+			size += RNDUP(values[i].len);
+	}
+	if (batch->xdr_used + size > batch->max_bytes ||
+	    sres->values.values_len + n_values > LOGDB_MAX_SCAN_VALUES)
+		return -1;
+
+	if (sres->values.values_len + n_values > batch->values_size) {
+		batch->values_size = MAX(2 * batch->values_size,
+					 sres->values.values_len + n_values);
+		sres->values.values_val =
+			gsh_realloc(sres->values.values_val,
+				    batch->values_size * sizeof(logdb_value));
+	}
+
+	for (i = 0; i < n_values; i++) {
+		logdb_value *value =
+			&sres->values.values_val[sres->values.values_len++];
+
+		value->null = values[i].len == LOOKUP_SQL_NULL;
+		value->external = values[i].external != 0;
+		value->data.data_val = batch->data + batch->data_used;
+		value->data.data_len = value->null ? 0 : values[i].len;
+		memcpy(value->data.data_val, values[i].data,
+		       value->data.data_len);
+		batch->data_used += value->data.data_len;
+	}
+	batch->xdr_used += size;
+	return 0;
+}
+
+static void logdb_scan_key(const logdb_value *values, u_int n_values,
+			   struct lookup_key_field *key)
+{
+	u_int i;
+
+	for (i = 0; i < n_values; i++) {
+		key[i].data = values[i].data.data_val;
+		key[i].len = values[i].null ? LOOKUP_SQL_NULL
+					    : values[i].data.data_len;
+	}
+}
+
+/**
+ * @brief The LOGDB SCAN function.
+ *
+ * @param[in]  arg    index, key range, predicates, columns and lsn
+ * @param[in]  req    Ignored
+ * @param[out] res    a batch of matching rows and where to go on from
+ */
+int logdb_scan(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_scan_args *args = &arg->arg_logdb_scan;
+	logdb_scan_res *sres = &res->res_logdb_scan;
+	u_int n_fields = args->field_lens.field_lens_len;
+	uint16_t field_lens[LOGDB_MAX_INDEX_FIELDS];
+	struct lookup_key_field start_key[LOGDB_MAX_KEY_FIELDS];
+	struct lookup_key_field end_key[LOGDB_MAX_KEY_FIELDS];
+	struct scan_predicate predicates[LOGDB_MAX_SCAN_PREDICATES];
+	struct scan_request request;
+	struct scan_result result;
+	struct logdb_scan_batch batch;
+	u_int i;
+	int rc;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_SCAN group=%u space_id=%u root=%u lsn=%"
+		     PRIu64, args->group, args->space_id, args->root_page_no,
+		     args->lsn);
+
+	memset(sres, 0, sizeof(*sres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		sres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	if (args->n_uniq == 0 || args->n_uniq > n_fields) {
+		sres->status = LOGDB_ERR_BADINDEX;
+		return NFS_REQ_OK;
+	}
+	for (i = 0; i < n_fields; i++) {
+		if (args->field_lens.field_lens_val[i] > UINT16_MAX) {
+			sres->status = LOGDB_ERR_BADINDEX;
+			return NFS_REQ_OK;
+		}
+		field_lens[i] = args->field_lens.field_lens_val[i];
+	}
+	logdb_scan_key(args->start_key.start_key_val,
+		       args->start_key.start_key_len, start_key);
+	logdb_scan_key(args->end_key.end_key_val, args->end_key.end_key_len,
+		       end_key);
+	for (i = 0; i < args->predicates.predicates_len; i++) {
+		logdb_scan_predicate *predicate =
+			&args->predicates.predicates_val[i];
+
+		predicates[i].field_no = predicate->field_no;
+		predicates[i].op = (enum scan_op)predicate->op;
+		predicates[i].value.data = predicate->value.value_val;
+		predicates[i].value.len = predicate->value.value_len;
+	}
+
+	memset(&request, 0, sizeof(request));
+	request.space_id = args->space_id;
+	request.root_page_no = args->root_page_no;
+	request.field_lens = field_lens;
+	request.n_fields = n_fields;
+	request.n_uniq = args->n_uniq;
+	request.start_key = start_key;
+	request.n_start_key = args->start_key.start_key_len;
+	request.start_inclusive = args->start_inclusive;
+	request.end_key = end_key;
+	request.n_end_key = args->end_key.end_key_len;
+	request.predicates = predicates;
+	request.n_predicates = args->predicates.predicates_len;
+	request.columns = args->columns.columns_val;
+	request.n_columns = args->columns.columns_len;
+	request.lsn = args->lsn;
+
+	sres->parsed_lsn = wait_until_parse_done(args->group);
+	if (sres->parsed_lsn < args->lsn) {
+		sres->status = LOGDB_ERR_LAGGING;
+		return NFS_REQ_OK;
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.res = sres;
+	batch.max_bytes = args->max_bytes;
+	if (batch.max_bytes == 0 || batch.max_bytes > LOGDB_MAX_SCAN_BYTES)
+		batch.max_bytes = LOGDB_MAX_SCAN_BYTES;
+	if (batch.max_bytes < LOGDB_SCAN_MIN_BYTES)
+		batch.max_bytes = LOGDB_SCAN_MIN_BYTES;
+	batch.data = gsh_malloc(batch.max_bytes);
+	result.key_buf = gsh_malloc(LOGDB_PAGE_SIZE);
+
+	rc = scan_index(args->group, &request, logdb_scan_row, &batch,
+			&result);
+	if (rc != 0) {
+		gsh_free(batch.data);
+		gsh_free(result.key_buf);
+		gsh_free(sres->values.values_val);
+		memset(sres, 0, sizeof(*sres));
+		switch (rc) {
+		case -2:
+			sres->status = LOGDB_ERR_TOOOLD;
+			break;
+		case -4:
+			sres->status = LOGDB_ERR_BADINDEX;
+			break;
+		default:
+			sres->status = LOGDB_ERR_NOPAGE;
+			break;
+		}
+		return NFS_REQ_OK;
+	}
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "LOGDB_SCAN read %u pages, returned %u values",
+		     result.n_pages, sres->values.values_len);
+
+	sres->status = LOGDB_OK;
+	sres->n_columns = request.n_columns != 0 ? request.n_columns
+						 : n_fields;
+	sres->eof = result.eof != 0;
+	/* the data of the first value and the first key column starts
+	 * each buffer, logdb_scan_Free finds them there
+	 */
+	if (sres->values.values_len == 0)
+		gsh_free(batch.data);
+	if (result.n_next_key == 0) {
+		gsh_free(result.key_buf);
+		return NFS_REQ_OK;
+	}
+	sres->next_key.next_key_len = result.n_next_key;
+	sres->next_key.next_key_val =
+		gsh_calloc(result.n_next_key, sizeof(logdb_value));
+	for (i = 0; i < result.n_next_key; i++) {
+		logdb_value *value = &sres->next_key.next_key_val[i];
+
+		value->null = result.next_key[i].len == LOOKUP_SQL_NULL;
+		value->data.data_val = (char *)result.next_key[i].data;
+		value->data.data_len = value->null ? 0
+						   : result.next_key[i].len;
+	}
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_scan
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_scan_Free(nfs_res_t *res)
+{
+	logdb_scan_res *sres = &res->res_logdb_scan;
+
+	if (sres->values.values_len != 0)
+		gsh_free(sres->values.values_val[0].data.data_val);
+	gsh_free(sres->values.values_val);
+	if (sres->next_key.next_key_len != 0)
+		gsh_free(sres->next_key.next_key_val[0].data.data_val);
+	gsh_free(sres->next_key.next_key_val);
+}
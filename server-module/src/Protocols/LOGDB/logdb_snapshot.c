@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file  logdb_snapshot.c
+ * @brief Consistent snapshots of the regenerated tablespaces.
+ *
+ * SNAPSHOT clones every tablespace of a log group as of one lsn into a
+ * directory under Snapshot_Path, while redo keeps being applied and
+ * ingested.  The clone can seed a new replica or a backup.  It is taken
+ * in the background; SNAPSHOT only starts it and SNAPSHOTSTATUS reports
+ * how it went.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB SNAPSHOT function.
+ *
+ * @param[in]  arg    lsn (0 for the parsed lsn) and snapshot name
+ * @param[in]  req    Ignored
+ * @param[out] res    job id to poll with SNAPSHOTSTATUS
+ */
+int logdb_snapshot(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_snapshot_args *args = &arg->arg_logdb_snapshot;
+	logdb_snapshot_res *sres = &res->res_logdb_snapshot;
+	int rc;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_SNAPSHOT group=%u lsn=%"
+		     PRIu64 " name=%s", args->group, args->lsn, args->name);
+
+	memset(sres, 0, sizeof(*sres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		sres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	rc = start_snapshot(args->group, args->lsn, args->name,
+			    &sres->job_id);
+	switch (rc) {
+	case 0:
+		sres->status = LOGDB_OK;
+		break;
+	case -5:
+		sres->status = LOGDB_ERR_BADNAME;
+		break;
+	case -6:
+		sres->status = LOGDB_ERR_BUSY;
+		break;
+	default:
+		sres->status = LOGDB_ERR_IO;
+		break;
+	}
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_snapshot
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_snapshot_Free(nfs_res_t *res)
+{
+	/* Nothing to do */
+}
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file  logdb_snapshotstatus.c
+ * @brief Progress of the snapshots started by SNAPSHOT.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB SNAPSHOTSTATUS function.
+ *
+ * @param[in]  arg    job id returned by SNAPSHOT
+ * @param[in]  req    Ignored
+ * @param[out] res    whether it is done, then its outcome, lsn and what
+ *                    it took
+ */
+int logdb_snapshotstatus(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_snapshotstatus_args *args = &arg->arg_logdb_snapshotstatus;
+	logdb_snapshotstatus_res *sres = &res->res_logdb_snapshotstatus;
+	struct snapshot_result result;
+	int rc;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_SNAPSHOTSTATUS group=%u job=%"
+		     PRIu64, args->group, args->job_id);
+
+	memset(sres, 0, sizeof(*sres));
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		sres->status = LOGDB_ERR_NOGROUP;
+		return NFS_REQ_OK;
+	}
+
+	rc = get_snapshot_status(args->group, args->job_id, &result);
+	sres->done = rc != 1;
+	switch (rc) {
+	case 1:
+		sres->status = LOGDB_OK;
+		break;
+	case 0:
+		sres->status = LOGDB_OK;
+		sres->lsn = result.lsn;
+		sres->files = result.n_files;
+		sres->cloned_files = result.n_cloned;
+		sres->patched_pages = result.n_patched;
+		break;
+	case -2:
+		sres->status = LOGDB_ERR_TOOOLD;
+		break;
+	case -3:
+		sres->status = LOGDB_ERR_LAGGING;
+		break;
+	case -4:
+		sres->status = LOGDB_ERR_EXIST;
+		break;
+	case -5:
+		sres->status = LOGDB_ERR_BADNAME;
+		break;
+	case -7:
+		sres->status = LOGDB_ERR_NOTFOUND;
+		break;
+	default:
+		sres->status = LOGDB_ERR_IO;
+		break;
+	}
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_snapshotstatus
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_snapshotstatus_Free(nfs_res_t *res)
+{
+	/* Nothing to do */
+}
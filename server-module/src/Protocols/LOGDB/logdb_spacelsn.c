@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+#include "config.h"
+#include "log.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+#include "nfs_proto_functions.h"
+#include "applier/interface.h"
+
+/**
+ * @brief The LOGDB SPACELSN function.
+ *
+ * Compute nodes keep clean pages in a local cache and use this call to
+ * check whether a tablespace received redo after those pages were
+ * fetched.  A cached page fetched when the server had parsed up to L is
+ * current as long as the returned space_lsn is not beyond L.
+ *
+ * @param[in]  arg    log group and tablespace id
+ * @param[in]  req    Ignored
+ * @param[out] res    parsed lsn and end lsn of the last redo of the space
+ */
+int logdb_spacelsn(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
+{
+	logdb_spacelsn_args *args = &arg->arg_logdb_spacelsn;
+	logdb_spacelsn_res *sres = &res->res_logdb_spacelsn;
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "REQUEST PROCESSING: Calling LOGDB_SPACELSN group=%u space_id=%u",
+		     args->group, args->space_id);
+
+	if (args->group >= (u_int)get_log_group_number()) {
+		sres->status = LOGDB_ERR_NOGROUP;
+		sres->parsed_lsn = 0;
+		sres->space_lsn = 0;
+		return NFS_REQ_OK;
+	}
+
+	/* redo already written to us must be visible in space_lsn */
+	sres->parsed_lsn = wait_until_parse_done(args->group);
+	sres->space_lsn = get_space_lsn(args->group, args->space_id);
+	sres->status = LOGDB_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free the result structure allocated for logdb_spacelsn
+ *
+ * @param[in,out] res Pointer to the result structure.
+ */
+void logdb_spacelsn_Free(nfs_res_t *res)
+{
+	/* Nothing to do */
+}
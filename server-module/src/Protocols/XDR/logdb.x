@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* LOGDB page server definitions */
+
+const LOGDB_PAGE_SIZE = 16384;
+const LOGDB_MAX_PAGES = 32;
+const LOGDB_MAX_HINTS = 1024;
+const LOGDB_MAX_INDEX_FIELDS = 1023;
+const LOGDB_MAX_KEY_FIELDS = 16;
+const LOGDB_MAX_KEY_LEN = 3072;
+const LOGDB_MAX_SCAN_PREDICATES = 16;
+const LOGDB_MAX_SCAN_VALUES = 65536;
+const LOGDB_MAX_SCAN_BYTES = 524288;
+const LOGDB_MAX_SNAPSHOT_NAME = 255;
+
+enum logdb_stat {
+	LOGDB_OK = 0,
+	LOGDB_ERR_NOSPACE = 1,	/* space_id is not regenerated here */
+	LOGDB_ERR_TOOBIG = 2,	/* more than LOGDB_MAX_PAGES requested */
+	LOGDB_ERR_LAGGING = 3,	/* redo up to min_lsn is not parsed yet */
+	LOGDB_ERR_NOPAGE = 4,	/* page does not exist on disk */
+	LOGDB_ERR_IO = 5,
+	LOGDB_ERR_NOVIEW = 6,	/* read view expired or was never registered */
+	LOGDB_ERR_TOOOLD = 7,	/* page version at lsn is no longer retained */
+	LOGDB_ERR_NOGROUP = 8,	/* no such log group on this server */
+	LOGDB_ERR_NOTFOUND = 9,	/* no record with this key */
+	LOGDB_ERR_BADINDEX = 10,	/* index description does not match the pages */
+	LOGDB_ERR_EXIST = 11,	/* a snapshot with this name already exists */
+	LOGDB_ERR_BADNAME = 12,	/* snapshot name is not a plain file name */
+	LOGDB_ERR_BUSY = 13	/* another snapshot is being taken */
+};
+
+/* every call names the log group (MySQL instance) it is about */
+struct logdb_getpages_args {
+	unsigned int group;
+	unsigned int space_id;
+	unsigned int page_nos<LOGDB_MAX_PAGES>;
+	unsigned hyper min_lsn;
+};
+
+struct logdb_page {
+	unsigned int page_no;
+	logdb_stat status;
+	opaque data<LOGDB_PAGE_SIZE>;
+};
+
+struct logdb_getpages_res {
+	logdb_stat status;
+	unsigned hyper parsed_lsn;
+	logdb_page pages<LOGDB_MAX_PAGES>;
+};
+
+struct logdb_spacelsn_args {
+	unsigned int group;
+	unsigned int space_id;
+};
+
+/* a cached page of space_id is current if it is not older than space_lsn */
+struct logdb_spacelsn_res {
+	logdb_stat status;
+	unsigned hyper parsed_lsn;
+	unsigned hyper space_lsn;
+};
+
+/* page (space_id, page_no) was flushed by the compute node at lsn */
+struct logdb_flush_hint {
+	unsigned int space_id;
+	unsigned int page_no;
+	unsigned hyper lsn;
+};
+
+struct logdb_flushhints_args {
+	unsigned int group;
+	logdb_flush_hint hints<LOGDB_MAX_HINTS>;
+	bool sync;		/* reply once every hint sent so far is applied */
+};
+
+struct logdb_flushhints_res {
+	logdb_stat status;
+	unsigned hyper parsed_lsn;
+};
+
+/*
+ * view_id 0 registers a read view at lsn, lsn 0 releases view_id,
+ * anything else advances view_id to lsn
+ */
+struct logdb_readview_args {
+	unsigned int group;
+	unsigned hyper view_id;
+	unsigned hyper lsn;
+};
+
+struct logdb_readview_res {
+	logdb_stat status;
+	unsigned hyper view_id;
+	unsigned hyper parsed_lsn;
+};
+
+/* a key column, encoded as it is stored in the record */
+struct logdb_key_field {
+	opaque data<LOGDB_MAX_KEY_LEN>;
+};
+
+/*
+ * field_lens describes the index the way redo does
+ * (mlog_open_and_write_index): 0x8000 is NOT NULL, the rest is 0 or
+ * 0x7fff for variable-length columns, the length of fixed-length ones.
+ * key holds the first n_uniq columns, compared bytewise.
+ * lsn 0 reads the latest pages, anything else needs a read view.
+ */
+struct logdb_lookup_args {
+	unsigned int group;
+	unsigned int space_id;
+	unsigned int root_page_no;
+	unsigned int n_uniq;
+	unsigned int field_lens<LOGDB_MAX_INDEX_FIELDS>;
+	logdb_key_field key<LOGDB_MAX_KEY_FIELDS>;
+	unsigned hyper lsn;
+};
+
+/* the physical leaf record, its origin is extra_size bytes in */
+struct logdb_lookup_res {
+	logdb_stat status;
+	unsigned hyper parsed_lsn;
+	unsigned int page_no;
+	unsigned int extra_size;
+	opaque record<LOGDB_PAGE_SIZE>;
+};
+
+enum logdb_scan_op {
+	LOGDB_SCAN_EQ = 0,
+	LOGDB_SCAN_NE = 1,
+	LOGDB_SCAN_LT = 2,
+	LOGDB_SCAN_LE = 3,
+	LOGDB_SCAN_GT = 4,
+	LOGDB_SCAN_GE = 5,
+	LOGDB_SCAN_IS_NULL = 6,
+	LOGDB_SCAN_IS_NOT_NULL = 7
+};
+
+/* a column, encoded as it is stored in the record */
+struct logdb_value {
+	bool null;
+	bool external;	/* stored off-page, data ends with the BLOB reference */
+	opaque data<LOGDB_PAGE_SIZE>;
+};
+
+/*
+ * field_no op value. Comparisons need a fixed-length column and a value
+ * of that length, compared bytewise; IS_NULL and IS_NOT_NULL ignore it.
+ */
+struct logdb_scan_predicate {
+	unsigned int field_no;
+	logdb_scan_op op;
+	opaque value<LOGDB_MAX_KEY_LEN>;
+};
+
+/*
+ * Scan the leaf records of an index in key order, from start_key up to
+ * end_key (inclusive), both prefixes of the first n_uniq columns and
+ * empty meaning unbounded. Delete-marked records are skipped. Records
+ * matching every predicate come back with the fields in columns, or
+ * all of them when columns is empty. field_lens and lsn are as for
+ * LOOKUP.
+ */
+struct logdb_scan_args {
+	unsigned int group;
+	unsigned int space_id;
+	unsigned int root_page_no;
+	unsigned int n_uniq;
+	unsigned int field_lens<LOGDB_MAX_INDEX_FIELDS>;
+	logdb_value start_key<LOGDB_MAX_KEY_FIELDS>;
+	bool start_inclusive;
+	logdb_value end_key<LOGDB_MAX_KEY_FIELDS>;
+	logdb_scan_predicate predicates<LOGDB_MAX_SCAN_PREDICATES>;
+	unsigned int columns<LOGDB_MAX_INDEX_FIELDS>;
+	unsigned int max_bytes;	/* 0 means LOGDB_MAX_SCAN_BYTES */
+	unsigned hyper lsn;
+};
+
+/*
+ * values holds n_columns values per row. Unless eof is set, scan on
+ * with next_key as start_key and start_inclusive false.
+ */
+struct logdb_scan_res {
+	logdb_stat status;
+	unsigned hyper parsed_lsn;
+	unsigned int n_columns;
+	logdb_value values<LOGDB_MAX_SCAN_VALUES>;
+	bool eof;
+	logdb_value next_key<LOGDB_MAX_KEY_FIELDS>;
+};
+
+/*
+ * Clone every regenerated tablespace as of lsn into Snapshot_Path/name.
+ * lsn 0 means the parsed lsn; otherwise it must not be older than it,
+ * and the call waits for redo up to lsn to be parsed.
+ */
+struct logdb_snapshot_args {
+	unsigned int group;
+	unsigned hyper lsn;
+	string name<LOGDB_MAX_SNAPSHOT_NAME>;
+};
+
+/* the snapshot is taken in the background, poll job_id with SNAPSHOTSTATUS */
+struct logdb_snapshot_res {
+	logdb_stat status;
+	unsigned hyper job_id;
+};
+
+struct logdb_snapshotstatus_args {
+	unsigned int group;
+	unsigned hyper job_id;
+};
+
+/* status is the outcome of the snapshot once done is set */
+struct logdb_snapshotstatus_res {
+	logdb_stat status;
+	bool done;
+	unsigned hyper lsn;
+	unsigned int files;
+	unsigned int cloned_files;	/* reflinked, the others were copied */
+	unsigned hyper patched_pages;	/* rewritten to their version at lsn */
+};
+
+program LOGDBPROG {
+	version LOGDB_V1 {
+		void LOGDBPROC_NULL(void) = 0;
+		logdb_getpages_res LOGDBPROC_GETPAGES(logdb_getpages_args) = 1;
+		logdb_spacelsn_res LOGDBPROC_SPACELSN(logdb_spacelsn_args) = 2;
+		logdb_flushhints_res LOGDBPROC_FLUSHHINTS(logdb_flushhints_args) = 3;
+		logdb_readview_res LOGDBPROC_READVIEW(logdb_readview_args) = 4;
+		/* min_lsn is the lsn the pages are read at */
+		logdb_getpages_res LOGDBPROC_GETPAGESASOF(logdb_getpages_args) = 5;
+		logdb_lookup_res LOGDBPROC_LOOKUP(logdb_lookup_args) = 6;
+		logdb_scan_res LOGDBPROC_SCAN(logdb_scan_args) = 7;
+		logdb_snapshot_res LOGDBPROC_SNAPSHOT(logdb_snapshot_args) = 8;
+		logdb_snapshotstatus_res
+			LOGDBPROC_SNAPSHOTSTATUS(logdb_snapshotstatus_args) = 9;
+	} = 1;
+} = 0x2000DB00;
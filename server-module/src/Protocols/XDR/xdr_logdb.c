@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * The content of this file is a mix of rpcgen-generated
+ * and hand-edited program text.  It is not automatically
+ * generated by, e.g., build processes.
+ *
+ * This file is under version control.
+ */
+
+#include "config.h"
+#include "gsh_rpc.h"
+#include "logdb.h"
+
+bool xdr_logdb_stat(XDR *xdrs, logdb_stat *objp)
+{
+	if (!xdr_enum(xdrs, (enum_t *) objp))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_getpages_args(XDR *xdrs, logdb_getpages_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->space_id))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->page_nos.page_nos_val,
+		       &objp->page_nos.page_nos_len, LOGDB_MAX_PAGES,
+		       sizeof(u_int), (xdrproc_t) xdr_u_int))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->min_lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_page(XDR *xdrs, logdb_page *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->page_no))
+		return false;
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_bytes(xdrs, &objp->data.data_val, &objp->data.data_len,
+		       LOGDB_PAGE_SIZE))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_getpages_res(XDR *xdrs, logdb_getpages_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->pages.pages_val,
+		       &objp->pages.pages_len, LOGDB_MAX_PAGES,
+		       sizeof(logdb_page), (xdrproc_t) xdr_logdb_page))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_spacelsn_args(XDR *xdrs, logdb_spacelsn_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->space_id))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_spacelsn_res(XDR *xdrs, logdb_spacelsn_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->space_lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_flush_hint(XDR *xdrs, logdb_flush_hint *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->space_id))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->page_no))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_flushhints_args(XDR *xdrs, logdb_flushhints_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->hints.hints_val,
+		       &objp->hints.hints_len, LOGDB_MAX_HINTS,
+		       sizeof(logdb_flush_hint),
+		       (xdrproc_t) xdr_logdb_flush_hint))
+		return false;
+	if (!xdr_bool(xdrs, &objp->sync))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_flushhints_res(XDR *xdrs, logdb_flushhints_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_readview_args(XDR *xdrs, logdb_readview_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->view_id))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_readview_res(XDR *xdrs, logdb_readview_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->view_id))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_key_field(XDR *xdrs, logdb_key_field *objp)
+{
+	if (!xdr_bytes(xdrs, &objp->data.data_val, &objp->data.data_len,
+		       LOGDB_MAX_KEY_LEN))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_lookup_args(XDR *xdrs, logdb_lookup_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->space_id))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->root_page_no))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->n_uniq))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->field_lens.field_lens_val,
+		       &objp->field_lens.field_lens_len, LOGDB_MAX_INDEX_FIELDS,
+		       sizeof(u_int), (xdrproc_t) xdr_u_int))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->key.key_val,
+		       &objp->key.key_len, LOGDB_MAX_KEY_FIELDS,
+		       sizeof(logdb_key_field),
+		       (xdrproc_t) xdr_logdb_key_field))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_lookup_res(XDR *xdrs, logdb_lookup_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->page_no))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->extra_size))
+		return false;
+	if (!xdr_bytes(xdrs, &objp->record.record_val,
+		       &objp->record.record_len, LOGDB_PAGE_SIZE))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_scan_op(XDR *xdrs, logdb_scan_op *objp)
+{
+	if (!xdr_enum(xdrs, (enum_t *) objp))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_value(XDR *xdrs, logdb_value *objp)
+{
+	if (!xdr_bool(xdrs, &objp->null))
+		return false;
+	if (!xdr_bool(xdrs, &objp->external))
+		return false;
+	if (!xdr_bytes(xdrs, &objp->data.data_val, &objp->data.data_len,
+		       LOGDB_PAGE_SIZE))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_scan_predicate(XDR *xdrs, logdb_scan_predicate *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->field_no))
+		return false;
+	if (!xdr_logdb_scan_op(xdrs, &objp->op))
+		return false;
+	if (!xdr_bytes(xdrs, &objp->value.value_val, &objp->value.value_len,
+		       LOGDB_MAX_KEY_LEN))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_scan_args(XDR *xdrs, logdb_scan_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->space_id))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->root_page_no))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->n_uniq))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->field_lens.field_lens_val,
+		       &objp->field_lens.field_lens_len, LOGDB_MAX_INDEX_FIELDS,
+		       sizeof(u_int), (xdrproc_t) xdr_u_int))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->start_key.start_key_val,
+		       &objp->start_key.start_key_len, LOGDB_MAX_KEY_FIELDS,
+		       sizeof(logdb_value), (xdrproc_t) xdr_logdb_value))
+		return false;
+	if (!xdr_bool(xdrs, &objp->start_inclusive))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->end_key.end_key_val,
+		       &objp->end_key.end_key_len, LOGDB_MAX_KEY_FIELDS,
+		       sizeof(logdb_value), (xdrproc_t) xdr_logdb_value))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->predicates.predicates_val,
+		       &objp->predicates.predicates_len,
+		       LOGDB_MAX_SCAN_PREDICATES,
+		       sizeof(logdb_scan_predicate),
+		       (xdrproc_t) xdr_logdb_scan_predicate))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->columns.columns_val,
+		       &objp->columns.columns_len, LOGDB_MAX_INDEX_FIELDS,
+		       sizeof(u_int), (xdrproc_t) xdr_u_int))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->max_bytes))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_scan_res(XDR *xdrs, logdb_scan_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->parsed_lsn))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->n_columns))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->values.values_val,
+		       &objp->values.values_len, LOGDB_MAX_SCAN_VALUES,
+		       sizeof(logdb_value), (xdrproc_t) xdr_logdb_value))
+		return false;
+	if (!xdr_bool(xdrs, &objp->eof))
+		return false;
+	if (!xdr_array(xdrs, (char **)&objp->next_key.next_key_val,
+		       &objp->next_key.next_key_len, LOGDB_MAX_KEY_FIELDS,
+		       sizeof(logdb_value), (xdrproc_t) xdr_logdb_value))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_snapshot_args(XDR *xdrs, logdb_snapshot_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	if (!xdr_string(xdrs, &objp->name, LOGDB_MAX_SNAPSHOT_NAME))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_snapshot_res(XDR *xdrs, logdb_snapshot_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->job_id))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_snapshotstatus_args(XDR *xdrs, logdb_snapshotstatus_args *objp)
+{
+	if (!xdr_u_int(xdrs, &objp->group))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->job_id))
+		return false;
+	return true;
+}
+
+bool xdr_logdb_snapshotstatus_res(XDR *xdrs, logdb_snapshotstatus_res *objp)
+{
+	if (!xdr_logdb_stat(xdrs, &objp->status))
+		return false;
+	if (!xdr_bool(xdrs, &objp->done))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->lsn))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->files))
+		return false;
+	if (!xdr_u_int(xdrs, &objp->cloned_files))
+		return false;
+	if (!xdr_uint64_t(xdrs, &objp->patched_pages))
+		return false;
+	return true;
+}
@@ -0,0 +1,33 @@
+#include "applier/applier_instance.h"
+
+std::vector<std::unique_ptr<ApplierInstance>> appliers;
+
+ApplierInstance::ApplierInstance(int group_no, const LogGroupConfig &config) :
+        group_no(group_no),
+        config(config),
+        copy_buf(new unsigned char[COPY_BUF_SIZE]),
+        apply_index(config.apply_index_memory_budget, config.apply_batch_size),
+        log_appliers(APPLIER_THREADS_MAX),
+        applier_threads(config.applier_threads),
+        buffer_pool(config, &data_page_group, &page_lsn_map),
+        page_version_store(&apply_index),
+        change_feed(config),
+        redo_archive(config) {
+    pthread_mutex_init(&log_group_mutex, nullptr);
+    pthread_cond_init(&log_parse_condition, nullptr);
+    pthread_cond_init(&log_write_condition, nullptr);
+    pthread_cond_init(&log_parsed_condition, nullptr);
+    pthread_mutex_init(&log_writer_mutex, nullptr);
+    for (size_t i = 0; i < log_appliers.size(); ++i) {
+        log_appliers[i].applier = this;
+        log_appliers[i].index = static_cast<int>(i);
+    }
+}
+
+ApplierInstance::~ApplierInstance() {
+    pthread_mutex_destroy(&log_group_mutex);
+    pthread_cond_destroy(&log_parse_condition);
+    pthread_cond_destroy(&log_write_condition);
+    pthread_cond_destroy(&log_parsed_condition);
+    pthread_mutex_destroy(&log_writer_mutex);
+}
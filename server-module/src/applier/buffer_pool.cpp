@@ -2,8 +2,23 @@
 #include <random>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <future>
+#include <unistd.h>
 #include "applier/buffer_pool.h"
 #include "applier/log_log.h"
+#include "applier/page_lsn_map.h"
+#include "applier/applier_instance.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
 Page::Page() :
         data_(new unsigned char[DATA_PAGE_SIZE]),
         state_(State::INVALID) {
@@ -25,67 +40,336 @@ void Page::WriteCheckSum(uint32_t checksum) {
 
 Page::Page(const Page &other) :
         data_(new unsigned char[DATA_PAGE_SIZE]),
+        physical_size_(other.physical_size_),
         state_(other.state_) {
 
     std::memcpy(data_, other.data_, DATA_PAGE_SIZE);
 }
 
-BufferPool::BufferPool() :
+// 所有log group的buffer pool一共能分配多少个frame，由LOGDB {}中的Buffer_Pool_Size决定
+static std::atomic<uint32_t> buffer_pool_total_frames {0};
+// 所有log group的buffer pool一共已经分配了多少个frame，不超过buffer_pool_total_frames
+static std::atomic<uint32_t> buffer_pool_allocated_frames {0};
+
+static bool buffer_pool_reserve_frames(uint32_t n) {
+    auto allocated = buffer_pool_allocated_frames.load();
+    do {
+        if (allocated + n > buffer_pool_total_frames) {
+            return false;
+        }
+    } while (!buffer_pool_allocated_frames.compare_exchange_weak(allocated, allocated + n));
+    return true;
+}
+
+BufferPool::BufferPool(const LogGroupConfig &config, DataPageGroup *data_page_group, PageLsnMap *page_lsn_map) :
         lru_list_(),
         hash_map_(),
-        buffer_(new Page[BUFFER_POOL_SIZE]),
-        data_path_(DATA_FILE_PREFIX),
+        buffer_(),
+        max_frames_(config.buffer_pool_pages),
+        data_path_(config.data_file_prefix),
+        system_file_path_(config.system_file_prefix),
+        data_page_group_(data_page_group),
+        page_lsn_map_(page_lsn_map),
         space_id_2_file_name_(),
-        free_list_(), frame_id_2_page_address_(BUFFER_POOL_SIZE), lock_() {
+        free_list_(), frame_id_2_page_address_(), lock_() {
 
     pthread_mutex_init(&lock_, nullptr);
+    pthread_rwlock_init(&catalog_lock_, nullptr);
+
+    // 表空间目录由LoadTablespaces()建立，构造时不读文件
+    // 先拿到一些frame，保证淘汰之后总有frame可用
+    auto n_frames = std::min(Capacity(), BUFFER_POOL_MIN_PAGES);
+    if (!buffer_pool_reserve_frames(n_frames)) {
+        LogFatal(COMPONENT_INIT, "Buffer_Pool_Size %u is too small for all log groups",
+                 buffer_pool_total_frames.load());
+    }
+    for (uint32_t i = 0; i < n_frames; ++i) {
+        buffer_.emplace_back();
+        free_list_.emplace_back(i);
+    }
+    allocated_frames_ = n_frames;
+    frame_id_2_page_address_.resize(buffer_.size());
+}
+
+uint32_t BufferPool::Capacity() const {
+    auto max_frames = max_frames_.load();
+    return max_frames == 0 ? buffer_pool_total_frames.load() : max_frames;
+}
+
+uint32_t BufferPool::AllocatedFrames() {
+    PthreadMutexGuard guard(lock_);
+    return allocated_frames_;
+}
+
+bool BufferPool::GrowLocked() {
+    auto capacity = Capacity();
+    if (allocated_frames_ >= capacity) {
+        return false;
+    }
+    auto n_frames = std::min(BUFFER_POOL_GROW_PAGES, capacity - allocated_frames_);
+    if (!buffer_pool_reserve_frames(n_frames)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < n_frames; ++i) {
+        if (!retired_frames_.empty()) {
+            auto frame_id = retired_frames_.back();
+            retired_frames_.pop_back();
+            buffer_[frame_id].AllocateData();
+            free_list_.push_back(frame_id);
+            continue;
+        }
+        free_list_.emplace_back(static_cast<frame_id_t>(buffer_.size()));
+        buffer_.emplace_back();
+    }
+    allocated_frames_ += n_frames;
+    frame_id_2_page_address_.resize(buffer_.size());
+    return true;
+}
 
-    // 1. 构建映射表
+void BufferPool::ShrinkLocked(uint32_t frames) {
+    frames = std::max(frames, BUFFER_POOL_MIN_PAGES);
+    uint32_t n_released = 0;
+    while (allocated_frames_ > frames) {
+        if (free_list_.empty()) {
+            Evict(static_cast<int>(std::min(BUFFER_POOL_GROW_PAGES, allocated_frames_ - frames)));
+            // 剩下的page都在被使用
+            if (free_list_.empty()) {
+                break;
+            }
+        }
+        auto frame_id = free_list_.back();
+        free_list_.pop_back();
+        buffer_[frame_id].ReleaseData();
+        retired_frames_.push_back(frame_id);
+        allocated_frames_--;
+        n_released++;
+    }
+    buffer_pool_allocated_frames -= n_released;
+    if (n_released > 0) {
+        LogEvent(COMPONENT_FSAL, "buffer pool released %u frames, %u frames left", n_released, allocated_frames_);
+    }
+}
+
+void BufferPool::Resize(uint32_t max_frames) {
+    PthreadMutexGuard guard(lock_);
+    max_frames_ = max_frames == 0 ? 0 : std::max(max_frames, BUFFER_POOL_MIN_PAGES);
+    ShrinkLocked(Capacity());
+}
+
+void BufferPool::Shrink(uint32_t frames) {
+    PthreadMutexGuard guard(lock_);
+    ShrinkLocked(frames);
+}
+
+// space id和表空间的flags保存在文件的第一个page中，最小的page也有UNIV_ZIP_SIZE_MIN，只读这么多
+static bool read_tablespace_header(const std::string &filename, space_id_t *space_id, uint32_t *page_size) {
+    byte page_buf[UNIV_ZIP_SIZE_MIN];
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    auto res = pread(fd, page_buf, sizeof(page_buf), 0);
+    close(fd);
+    if (res != static_cast<ssize_t>(sizeof(page_buf))) {
+        return false;
+    }
+    *space_id = mach_read_from_4(page_buf + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID);
+    *page_size = fsp_flags_get_page_size(mach_read_from_4(page_buf + FSP_HEADER_OFFSET + FSP_SPACE_FLAGS));
+    return true;
+}
+
+void BufferPool::LoadTablespaces() {
     std::vector<std::string> filenames;
     TravelDirectory(data_path_, ".ibd", filenames);
-    byte page_buf[DATA_PAGE_SIZE];
-    std::ifstream ifs;
-    for (auto & filename : filenames) {
-        ifs.open(filename, std::ios::binary | std::ios::in);
-        ifs.read(reinterpret_cast<char *>(page_buf), DATA_PAGE_SIZE);
-        uint32_t space_id = mach_read_from_4(page_buf + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID);
-        ifs.close();
-        std::cout << filename << "-> space_id: " << space_id << std::endl;
-        space_id_2_file_name_.insert({space_id, PageReaderWriter(filename)});
-
-        std::string ibd_name = filename;
-        ibd_name = ibd_name.substr(ibd_name.rfind('/') + 1);
-        DataPageGroup::Get().Insert(ibd_name, space_id);
-    }
-
-    // 2. 初始化free_list_
-    for (int i = 0; i < static_cast<int>(BUFFER_POOL_SIZE); ++i) {
-        free_list_.emplace_back(i);
+    // 系统表空间和undo表空间
+    for (auto system_file : SYSTEM_FILES) {
+        std::string filename = system_file_path_ + system_file;
+        if (access(filename.c_str(), F_OK) == 0) {
+            filenames.push_back(filename);
+        }
+    }
+
+    struct TablespaceHeader {
+        bool valid {false};
+        space_id_t space_id {0};
+        uint32_t page_size {DATA_PAGE_SIZE};
+    };
+    std::vector<TablespaceHeader> headers(filenames.size());
+    // 每个线程读连续的一段文件，文件很多时不用一个一个地等磁盘
+    auto per_thread = (filenames.size() + TABLESPACE_LOAD_THREADS - 1) / TABLESPACE_LOAD_THREADS;
+    std::vector<std::future<void>> readers;
+    for (size_t start = 0; start < filenames.size(); start += per_thread) {
+        auto end = std::min(start + per_thread, filenames.size());
+        readers.push_back(std::async(std::launch::async, [&filenames, &headers, start, end]() {
+            for (size_t i = start; i < end; ++i) {
+                headers[i].valid = read_tablespace_header(filenames[i], &headers[i].space_id, &headers[i].page_size);
+            }
+        }));
     }
+    for (auto &reader: readers) {
+        reader.wait();
+    }
+
+    size_t n_loaded = 0;
+    PthreadMutexGuard guard(lock_);
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        if (!headers[i].valid) {
+            LogCrit(COMPONENT_INIT, "can not read the first page of %s, skip it", filenames[i].c_str());
+            continue;
+        }
+        RegisterTablespaceLocked(headers[i].space_id, filenames[i], headers[i].page_size);
+        n_loaded++;
+    }
+    LogEvent(COMPONENT_INIT, "loaded %zu tablespaces from %zu data files", n_loaded, filenames.size());
 }
 
+void BufferPool::RegisterTablespaceLocked(space_id_t space_id, const std::string &filename, uint32_t page_size) {
+    LogDebug(COMPONENT_FSAL, "%s -> space_id: %u, page size: %u", filename.c_str(), space_id, page_size);
+    pthread_rwlock_wrlock(&catalog_lock_);
+    auto iter = space_id_2_file_name_.find(space_id);
+    if (iter == space_id_2_file_name_.end()) {
+        space_id_2_file_name_.emplace(space_id, PageReaderWriter(filename));
+    } else {
+        // recovery时会再解析一次MLOG_FILE_CREATE2，已经打开的文件继续用
+        iter->second.file_name_ = filename;
+    }
+    // 压缩表空间的page在磁盘上只占zip size
+    if (page_size != DATA_PAGE_SIZE) {
+        space_id_2_page_size_[space_id] = page_size;
+    } else {
+        space_id_2_page_size_.erase(space_id);
+    }
+    pthread_rwlock_unlock(&catalog_lock_);
+
+    // 压缩page上按记录修改的log要用page_zip解压、修改再重新压缩，这部分没有移植。
+    // 压缩表空间不由存储节点生成，它的log都被跳过，文件由计算节点自己读写
+    if (page_size != DATA_PAGE_SIZE) {
+        data_page_group_->Erase(space_id);
+        LogEvent(COMPONENT_FSAL, "tablespace %u (%s) is compressed, left to the compute node",
+                 space_id, filename.c_str());
+        return;
+    }
+    data_page_group_->Rename(space_id, filename.substr(filename.rfind('/') + 1));
+}
 
-BufferPool::~BufferPool() {
-    if (buffer_ != nullptr) {
-        delete[] buffer_;
-        buffer_ = nullptr;
+void BufferPool::CreateTablespace(space_id_t space_id, const std::string &filename, uint32_t page_size) {
+    PthreadMutexGuard guard(lock_);
+    RegisterTablespaceLocked(space_id, filename, page_size);
+    LogEvent(COMPONENT_FSAL, "tablespace %u created: %s", space_id, filename.c_str());
+}
+
+void BufferPool::RenameTablespace(space_id_t space_id, const std::string &filename) {
+    PthreadMutexGuard guard(lock_);
+    pthread_rwlock_wrlock(&catalog_lock_);
+    auto iter = space_id_2_file_name_.find(space_id);
+    if (iter == space_id_2_file_name_.end()) {
+        pthread_rwlock_unlock(&catalog_lock_);
+        return;
+    }
+    LogEvent(COMPONENT_FSAL, "tablespace %u renamed: %s -> %s", space_id, iter->second.file_name_.c_str(),
+             filename.c_str());
+    iter->second.file_name_ = filename;
+    auto compressed = space_id_2_page_size_.find(space_id) != space_id_2_page_size_.end();
+    pthread_rwlock_unlock(&catalog_lock_);
+
+    if (!compressed) {
+        data_page_group_->Rename(space_id, filename.substr(filename.rfind('/') + 1));
+    }
+}
+
+bool BufferPool::DiscardTablespacePagesLocked(space_id_t space_id) {
+    auto space = hash_map_.find(space_id);
+    if (space == hash_map_.end()) {
+        return true;
+    }
+    bool discarded_all = true;
+    for (auto iter = space->second.begin(); iter != space->second.end();) {
+        frame_id_t frame_id = *iter->second;
+        Page &page = buffer_[frame_id];
+        // 正在被apply或者读取，等它用完
+        if (!page.TryPageLock()) {
+            discarded_all = false;
+            ++iter;
+            continue;
+        }
+        page.SetDirty(false);
+        page.SetState(Page::State::INVALID);
+        page.PageUnLock();
+        lru_list_.erase(iter->second);
+        assert(frame_id_2_page_address_[frame_id].in_lru_ == true);
+        frame_id_2_page_address_[frame_id].in_lru_ = false;
+        free_list_.push_back(frame_id);
+        iter = space->second.erase(iter);
+    }
+    if (space->second.empty()) {
+        hash_map_.erase(space);
+    }
+    return discarded_all;
+}
+
+void BufferPool::DiscardTablespacePages(space_id_t space_id) {
+    for (;;) {
+        {
+            PthreadMutexGuard guard(lock_);
+            if (DiscardTablespacePagesLocked(space_id)) {
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void BufferPool::DropTablespace(space_id_t space_id) {
+    // 先让log apply跳过这个表空间，不会再有新的page被读进来
+    data_page_group_->Erase(space_id);
+    for (;;) {
+        {
+            PthreadMutexGuard guard(lock_);
+            if (DiscardTablespacePagesLocked(space_id)) {
+                pthread_rwlock_wrlock(&catalog_lock_);
+                space_id_2_file_name_.erase(space_id);
+                space_id_2_page_size_.erase(space_id);
+                pthread_rwlock_unlock(&catalog_lock_);
+                break;
+            }
+        }
+        std::this_thread::yield();
     }
+    LogEvent(COMPONENT_FSAL, "tablespace %u dropped", space_id);
+}
+
+BufferPool::~BufferPool() {
+    buffer_pool_allocated_frames -= allocated_frames_;
     pthread_mutex_unlock(&lock_);
+    pthread_rwlock_destroy(&catalog_lock_);
 }
 
 Page *BufferPool::NewPage(space_id_t space_id, page_id_t page_id) {
-    PthreadMutexGuard guard(lock_);
-    if (hash_map_.find(space_id) != hash_map_.end()
-        && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
-        std::cerr << "the page(space_id = " << space_id
-                  << ", page_id = " << page_id << ") was already in buffer pool"
-                  << std::endl;
-        return nullptr;
-    }
-    if (free_list_.empty()) {
-        // buffer pool 空间不够
-        Evict(64);
+    for (;;) {
+        {
+            PthreadMutexGuard guard(lock_);
+            if (hash_map_.find(space_id) != hash_map_.end()
+                && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
+                std::cerr << "the page(space_id = " << space_id
+                          << ", page_id = " << page_id << ") was already in buffer pool"
+                          << std::endl;
+                return nullptr;
+            }
+            if (ReserveFrameLocked()) {
+                return NewPageLocked(space_id, page_id);
+            }
+        }
+        // 所有的page都在被使用，放开lock_等它们被释放
+        std::this_thread::yield();
     }
+}
+
+bool BufferPool::ReserveFrameLocked() {
+    // buffer pool 空间不够时淘汰一些页面
+    return !free_list_.empty() || GrowLocked() || Evict(64);
+}
+
+Page *BufferPool::NewPageLocked(space_id_t space_id, page_id_t page_id) {
     // 从free list申请一个buffer frame
     frame_id_t frame_id = free_list_.front();
     free_list_.pop_front();
@@ -95,6 +379,7 @@ Page *BufferPool::NewPage(space_id_t space_id, page_id_t page_id) {
     // 初始化申请到的buffer frame
     buffer_[frame_id].Reset();
     buffer_[frame_id].SetState(Page::State::FROM_BUFFER);
+    buffer_[frame_id].physical_size_ = GetPageSize(space_id);
 
     // 新创建的page加入lru list
     lru_list_.emplace_front(frame_id);
@@ -110,22 +395,29 @@ Page *BufferPool::NewPage(space_id_t space_id, page_id_t page_id) {
     return page;
 }
 
-void BufferPool::Evict(int n) {
-    for (int i = 0; i < n; ++i) {
-        if (lru_list_.empty()) return;
-        // 把 buffer frame 从 LRU List 中移除
-        frame_id_t frame_id = lru_list_.back();
+bool BufferPool::Evict(int n) {
+    auto victim = lru_list_.end();
+    int i = 0;
+    for (; i < n; ++i) {
+        // 跳过正在被apply的page，不拿着lock_等它们
+        while (victim != lru_list_.begin() && !buffer_[*std::prev(victim)].TryPageLock()) {
+            --victim;
+        }
+        if (victim == lru_list_.begin()) {
+            break;
+        }
+        frame_id_t frame_id = *std::prev(victim);
         space_id_t space_id = frame_id_2_page_address_[frame_id].space_id_;
         page_id_t page_id = frame_id_2_page_address_[frame_id].page_id_;
 
         // 写回
         Page &page = buffer_[frame_id];
-        page.PageLock();
         if (page.dirty_) {
             WriteBack(space_id, page_id);
         }
         page.PageUnLock();
-        lru_list_.pop_back();
+        // 把 buffer frame 从 LRU List 中移除
+        victim = lru_list_.erase(std::prev(victim));
         assert(frame_id_2_page_address_[frame_id].in_lru_ == true);
         frame_id_2_page_address_[frame_id].in_lru_ = false;
 
@@ -136,50 +428,63 @@ void BufferPool::Evict(int n) {
 
         page.SetState(Page::State::INVALID);
     }
+    return i > 0;
 }
 
 Page *BufferPool::GetPage(space_id_t space_id, page_id_t page_id) {
-    PthreadMutexGuard guard(lock_);
-    if (space_id_2_file_name_.find(space_id) == space_id_2_file_name_.end()) {
-        std::cerr << "invalid space_id(" << space_id << ")" << std::endl;
-        return nullptr;
-    }
-
-    // 该 page 已经被lru缓存了
-    if (hash_map_.find(space_id) != hash_map_.end()
-        && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
-        auto iter = hash_map_[space_id][page_id];
-        auto frame_id = *hash_map_[space_id][page_id];
-
-        // 提升到lru list的队头
-        lru_list_.erase(iter);
-        lru_list_.emplace_front(frame_id);
-        hash_map_[space_id][page_id] = lru_list_.begin();
-
-        auto *page = &buffer_[frame_id];
-        page->PageLock();
-        return page;
+    for (;;) {
+        {
+            PthreadMutexGuard guard(lock_);
+            if (space_id_2_file_name_.find(space_id) == space_id_2_file_name_.end()) {
+                std::cerr << "invalid space_id(" << space_id << ")" << std::endl;
+                return nullptr;
+            }
+
+            // 该 page 已经被lru缓存了
+            if (hash_map_.find(space_id) == hash_map_.end()
+                || hash_map_[space_id].find(page_id) == hash_map_[space_id].end()) {
+                // 不在buffer pool中，从磁盘读；所有的page都在被使用时放开lock_等它们被释放
+                // TODO 假定所有的Page在磁盘上都是存在的
+                if (ReserveFrameLocked()) {
+                    return ReadPageFromDisk(space_id, page_id);
+                }
+            } else {
+                auto iter = hash_map_[space_id][page_id];
+                auto frame_id = *hash_map_[space_id][page_id];
+                auto *page = &buffer_[frame_id];
+
+                // page正在被别的线程apply时不能拿着lock_等待，否则所有访问buffer pool的线程都会被挡住
+                if (page->TryPageLock()) {
+                    // 提升到lru list的队头
+                    lru_list_.erase(iter);
+                    lru_list_.emplace_front(frame_id);
+                    hash_map_[space_id][page_id] = lru_list_.begin();
+                    return page;
+                }
+            }
+        }
+        // 放开lock_之后page可能被淘汰或者被别的线程读进来，重新查找
+        std::this_thread::yield();
     }
-
-    // 不在buffer pool中，从磁盘读
-    // TODO 假定所有的Page在磁盘上都是存在的
-    return ReadPageFromDisk(space_id, page_id);
 }
 
 Page *BufferPool::ReadPageFromDisk(space_id_t space_id, page_id_t page_id) {
-
-    if (free_list_.empty()) {
-        // buffer pool 空间不够
-        Evict(64);
-    }
-
+    assert(!free_list_.empty());
     // 从free list中分配一个frame，从磁盘读取page，填充这个frame
     frame_id_t frame_id = free_list_.front();
-    auto fs = space_id_2_file_name_[space_id].stream_;
+    auto file = space_id_2_file_name_.find(space_id);
+    if (file == space_id_2_file_name_.end()) {
+        return nullptr;
+    }
+    auto fs = file->second.Stream();
+    auto page_size = GetPageSize(space_id);
 
-    assert(fs->is_open());
+    // 文件可能已经被删掉了
+    if (!fs->is_open()) {
+        return nullptr;
+    }
     fs->seekg(0, std::ios_base::end);
-    auto max_page_id = (fs->tellg() / DATA_PAGE_SIZE) - 1;
+    auto max_page_id = (fs->tellg() / page_size) - 1;
 
     // 磁盘上还没有这个page
     if (page_id > max_page_id) {
@@ -187,9 +492,14 @@ Page *BufferPool::ReadPageFromDisk(space_id_t space_id, page_id_t page_id) {
         return nullptr;
     }
 
-    fs->seekg(static_cast<std::streamoff>(page_id * DATA_PAGE_SIZE), std::ios::beg);
-    fs->read(reinterpret_cast<char *>(buffer_[frame_id].GetData()), DATA_PAGE_SIZE);
+    fs->seekg(static_cast<std::streamoff>(page_id) * page_size, std::ios::beg);
+    if (page_size < DATA_PAGE_SIZE) {
+        std::memset(buffer_[frame_id].GetData() + page_size, 0, DATA_PAGE_SIZE - page_size);
+    }
+    fs->read(reinterpret_cast<char *>(buffer_[frame_id].GetData()), page_size);
     buffer_[frame_id].SetState(Page::State::FROM_DISK);
+    buffer_[frame_id].physical_size_ = page_size;
+    page_lsn_map_->Update(space_id, page_id, buffer_[frame_id].GetLSN());
     free_list_.pop_front();
 
     assert(frame_id_2_page_address_[frame_id].in_lru_ == false);
@@ -209,11 +519,21 @@ bool BufferPool::WriteBack(space_id_t space_id, page_id_t page_id) {
     // 找找看是不是在buffer pool中
     if (hash_map_.find(space_id) != hash_map_.end() && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
         frame_id_t frame_id = *(hash_map_[space_id][page_id]);
-        auto fs = space_id_2_file_name_[space_id].stream_;
+        auto file = space_id_2_file_name_.find(space_id);
+        if (file == space_id_2_file_name_.end()) {
+            return false;
+        }
+        auto fs = file->second.Stream();
+        if (!fs->is_open()) {
+            return false;
+        }
         auto *page_data = buffer_[frame_id].GetData();
         assert(mach_read_from_4(page_data + FIL_PAGE_OFFSET) == page_id);
-        fs->seekp(static_cast<std::streamoff>(page_id * DATA_PAGE_SIZE));
-        fs->write(reinterpret_cast<char *>(page_data), DATA_PAGE_SIZE);
+        auto page_size = buffer_[frame_id].GetPhysicalSize();
+        fs->seekp(static_cast<std::streamoff>(page_id) * page_size);
+        fs->write(reinterpret_cast<char *>(page_data), page_size);
+        page_lsn_map_->Update(space_id, page_id, mach_read_from_8(page_data + FIL_PAGE_LSN));
+        CaptureLocked(space_id, page_id);
         return true;
     }
     return false;
@@ -224,11 +544,21 @@ bool BufferPool::WriteBackLock(space_id_t space_id, page_id_t page_id) {
     // 找找看是不是在buffer pool中
     if (hash_map_.find(space_id) != hash_map_.end() && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
         frame_id_t frame_id = *(hash_map_[space_id][page_id]);
-        auto fs = space_id_2_file_name_[space_id].stream_;
+        auto file = space_id_2_file_name_.find(space_id);
+        if (file == space_id_2_file_name_.end()) {
+            return false;
+        }
+        auto fs = file->second.Stream();
+        if (!fs->is_open()) {
+            return false;
+        }
         auto *page_data = buffer_[frame_id].GetData();
         assert(mach_read_from_4(page_data + FIL_PAGE_OFFSET) == page_id);
-        fs->seekp(static_cast<std::streamoff>(page_id * DATA_PAGE_SIZE));
-        fs->write(reinterpret_cast<char *>(buffer_[frame_id].GetData()), DATA_PAGE_SIZE);
+        auto page_size = buffer_[frame_id].GetPhysicalSize();
+        fs->seekp(static_cast<std::streamoff>(page_id) * page_size);
+        fs->write(reinterpret_cast<char *>(buffer_[frame_id].GetData()), page_size);
+        page_lsn_map_->Update(space_id, page_id, mach_read_from_8(page_data + FIL_PAGE_LSN));
+        CaptureLocked(space_id, page_id);
         return true;
     }
     return false;
@@ -236,9 +566,241 @@ bool BufferPool::WriteBackLock(space_id_t space_id, page_id_t page_id) {
 
 void BufferPool::CopyPage(void *dest_buf, space_id_t space_id, page_id_t page_id) {
     Page *page = GetPage(space_id, page_id);
-    std::memcpy(dest_buf, page->data_, DATA_PAGE_SIZE);
+    std::memcpy(dest_buf, page->data_, page->GetPhysicalSize());
     ReleasePage(page);
 }
 
-BufferPool buffer_pool;
+std::vector<std::pair<space_id_t, std::string>> BufferPool::Tablespaces() {
+    std::vector<std::pair<space_id_t, std::string>> res;
+    pthread_rwlock_rdlock(&catalog_lock_);
+    res.reserve(space_id_2_file_name_.size());
+    for (const auto &[space_id, file]: space_id_2_file_name_) {
+        res.emplace_back(space_id, file.file_name_);
+    }
+    pthread_rwlock_unlock(&catalog_lock_);
+    return res;
+}
+
+std::string BufferPool::BeginCapture(space_id_t space_id) {
+    PthreadMutexGuard guard(lock_);
+    auto file = space_id_2_file_name_.find(space_id);
+    if (file == space_id_2_file_name_.end()) {
+        return "";
+    }
+    // 写回的page可能还在fstream的缓冲区里，拷贝文件时看不到
+    if (file->second.stream_ != nullptr) {
+        file->second.stream_->flush();
+    }
+    captures_[space_id].clear();
+    return file->second.file_name_;
+}
+
+std::vector<page_id_t> BufferPool::EndCapture(space_id_t space_id) {
+    PthreadMutexGuard guard(lock_);
+    std::vector<page_id_t> res;
+    if (auto iter = captures_.find(space_id); iter != captures_.end()) {
+        res.assign(iter->second.begin(), iter->second.end());
+        captures_.erase(iter);
+    }
+    return res;
+}
+
+void BufferPool::SyncDataFiles() {
+    PthreadMutexGuard guard(lock_);
+    for (auto &[space_id, file]: space_id_2_file_name_) {
+        // 没有打开过的文件没有被写过
+        if (file.stream_ == nullptr) {
+            continue;
+        }
+        file.stream_->flush();
+        // fstream拿不到fd，另外打开一次，fsync会把这个文件所有的脏数据刷下去
+        int fd = open(file.file_name_.c_str(), O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        fsync(fd);
+        close(fd);
+    }
+}
+
+std::vector<std::pair<space_id_t, page_id_t>> BufferPool::ResidentPages() {
+    PthreadMutexGuard guard(lock_);
+    std::vector<std::pair<space_id_t, page_id_t>> res;
+    res.reserve(lru_list_.size());
+    for (auto frame_id: lru_list_) {
+        res.emplace_back(frame_id_2_page_address_[frame_id].space_id_, frame_id_2_page_address_[frame_id].page_id_);
+    }
+    return res;
+}
+
+bool BufferPool::LoadPage(space_id_t space_id, page_id_t page_id, const byte *data) {
+    PthreadMutexGuard guard(lock_);
+    if (free_list_.empty() && !GrowLocked()) {
+        return false;
+    }
+    if (hash_map_.find(space_id) != hash_map_.end()
+        && hash_map_[space_id].find(page_id) != hash_map_[space_id].end()) {
+        return false;
+    }
+    // 读盘之后这个page可能被读进来、apply、再被淘汰写回，这时读到的是旧的内容
+    if (page_lsn_map_->Get(space_id, page_id) > mach_read_from_8(data + FIL_PAGE_LSN)) {
+        return false;
+    }
+    frame_id_t frame_id = free_list_.front();
+    free_list_.pop_front();
+    assert(frame_id_2_page_address_[frame_id].in_lru_ == false);
+    auto page_size = GetPageSize(space_id);
+    if (page_size < DATA_PAGE_SIZE) {
+        std::memset(buffer_[frame_id].GetData() + page_size, 0, DATA_PAGE_SIZE - page_size);
+    }
+    std::memcpy(buffer_[frame_id].GetData(), data, page_size);
+    buffer_[frame_id].SetState(Page::State::FROM_DISK);
+    buffer_[frame_id].physical_size_ = page_size;
+    buffer_[frame_id].SetDirty(false);
+
+    // 预热的page比真正被访问过的page冷，放在LRU的尾部
+    frame_id_2_page_address_[frame_id].space_id_ = space_id;
+    frame_id_2_page_address_[frame_id].page_id_ = page_id;
+    frame_id_2_page_address_[frame_id].in_lru_ = true;
+    lru_list_.emplace_back(frame_id);
+    hash_map_[space_id][page_id] = std::prev(lru_list_.end());
+    return true;
+}
+
+bool buffer_pool_dump(BufferPool *buffer_pool, const char *dump_path) {
+    auto pages = buffer_pool->ResidentPages();
+    // 先写临时文件再rename，dump到一半崩溃也不会留下不完整的文件
+    std::string tmp_path = dump_path;
+    tmp_path += ".incomplete";
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if (file == nullptr) {
+        LogCrit(COMPONENT_FSAL, "can not open %s to dump buffer pool", tmp_path.c_str());
+        return false;
+    }
+    for (const auto &[space_id, page_id]: pages) {
+        fprintf(file, "%u,%u\n", space_id, page_id);
+    }
+    if (fclose(file) != 0 || rename(tmp_path.c_str(), dump_path) != 0) {
+        LogCrit(COMPONENT_FSAL, "dump buffer pool to %s failed", dump_path);
+        return false;
+    }
+    LogEvent(COMPONENT_FSAL, "dumped %zu pages of buffer pool to %s", pages.size(), dump_path);
+    return true;
+}
+
+static pthread_t buffer_pool_dump_thread_id;
+
+static void *buffer_pool_dump_routine(void *) {
+    for (;;) {
+        sleep(BUFFER_POOL_DUMP_INTERVAL_S);
+        for (auto &applier: appliers) {
+            buffer_pool_dump(&applier->buffer_pool, applier->config.buffer_pool_dump_path.c_str());
+        }
+    }
+}
+
+void buffer_pool_set_total_frames(uint32_t total_frames) {
+    auto old_total = buffer_pool_total_frames.exchange(total_frames);
+    auto allocated = buffer_pool_allocated_frames.load();
+    if (allocated > total_frames) {
+        // 各个log group按比例淘汰page
+        for (auto &applier: appliers) {
+            auto &buffer_pool = applier->buffer_pool;
+            auto frames = static_cast<uint64_t>(buffer_pool.AllocatedFrames()) * total_frames / allocated;
+            buffer_pool.Shrink(static_cast<uint32_t>(frames));
+        }
+    }
+    if (old_total != 0 && old_total != total_frames) {
+        LogEvent(COMPONENT_FSAL, "buffer pool size %u -> %u frames, %u frames allocated",
+                 old_total, total_frames, buffer_pool_allocated_frames.load());
+    }
+}
+
+void buffer_pool_dump_thread_start() {
+    START_THREAD("buffer pool dump", &buffer_pool_dump_thread_id, buffer_pool_dump_routine, nullptr);
+}
+
+using page_list = std::vector<std::pair<space_id_t, page_id_t>>;
+
+struct buffer_pool_load_t {
+    BufferPool *buffer_pool;
+    page_list pages;
+};
+
+// 读一段按(space id, page id)排好序的page，连续的page合并成一次大的读
+static void *buffer_pool_load_routine(void *arg) {
+    std::unique_ptr<buffer_pool_load_t> load(static_cast<buffer_pool_load_t *>(arg));
+    auto *buffer_pool = load->buffer_pool;
+    auto *pages = &load->pages;
+    std::unique_ptr<byte[]> buf(new byte[BUFFER_POOL_LOAD_READ_PAGES * DATA_PAGE_SIZE]);
+    std::unordered_map<space_id_t, int> fds;
+    size_t n_loaded = 0;
+    for (size_t i = 0; i < pages->size();) {
+        auto [space_id, first_page_id] = (*pages)[i];
+        size_t n = 1;
+        while (i + n < pages->size() && n < BUFFER_POOL_LOAD_READ_PAGES
+               && (*pages)[i + n].first == space_id && (*pages)[i + n].second == first_page_id + n) {
+            n++;
+        }
+        i += n;
+
+        if (fds.find(space_id) == fds.end()) {
+            auto filename = buffer_pool->GetFilename(space_id);
+            fds[space_id] = filename.empty() ? -1 : open(filename.c_str(), O_RDONLY);
+        }
+        auto fd = fds[space_id];
+        if (fd < 0) {
+            continue;
+        }
+        size_t page_size = buffer_pool->GetPageSize(space_id);
+        auto res = pread(fd, buf.get(), n * page_size, static_cast<off_t>(first_page_id) * page_size);
+        if (res <= 0) {
+            continue;
+        }
+        // 文件末尾之后的page不存在
+        auto n_read = static_cast<size_t>(res) / page_size;
+        for (size_t j = 0; j < n_read; ++j) {
+            if (buffer_pool->LoadPage(space_id, first_page_id + j, buf.get() + j * page_size)) {
+                n_loaded++;
+            }
+        }
+    }
+    for (const auto &[space_id, fd]: fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    LogEvent(COMPONENT_FSAL, "buffer pool load thread loaded %zu of %zu pages", n_loaded, pages->size());
+    return nullptr;
+}
+
+void buffer_pool_load_start(BufferPool *buffer_pool, const char *dump_path) {
+    FILE *file = fopen(dump_path, "r");
+    if (file == nullptr) {
+        return;
+    }
+    page_list pages;
+    space_id_t space_id;
+    page_id_t page_id;
+    // 最近访问的在前，超过buffer pool大小的部分读回来也会被淘汰
+    while (pages.size() < buffer_pool->Capacity() && fscanf(file, "%u,%u", &space_id, &page_id) == 2) {
+        pages.emplace_back(space_id, page_id);
+    }
+    fclose(file);
+    if (pages.empty()) {
+        return;
+    }
+    LogEvent(COMPONENT_INIT, "loading %zu pages of buffer pool from %s in background", pages.size(), dump_path);
+
+    // 按磁盘上的顺序读，每个线程负责连续的一段
+    std::sort(pages.begin(), pages.end());
+    auto per_thread = (pages.size() + BUFFER_POOL_LOAD_THREADS - 1) / BUFFER_POOL_LOAD_THREADS;
+    for (size_t start = 0; start < pages.size(); start += per_thread) {
+        auto end = std::min(start + per_thread, pages.size());
+        auto *part = new buffer_pool_load_t {buffer_pool, page_list(pages.begin() + start, pages.begin() + end)};
+        pthread_t thread_id;
+        START_THREAD("buffer pool load", &thread_id, buffer_pool_load_routine, part);
+        pthread_detach(thread_id);
+    }
+}
 
@@ -0,0 +1,840 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include "applier/change_feed.h"
+#include "applier/applier_instance.h"
+#include "applier/interface.h"
+#include "applier/log_apply.h"
+#include "applier/log_parse.h"
+#include "applier/record.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+static constexpr const char *CHANGE_FEED_SOCKET_NAME = "feed.sock";
+static constexpr const char *CHANGE_FEED_SEGMENT_SUFFIX = ".feed";
+// len之后至少有lsn和type
+static constexpr uint32_t CHANGE_FEED_EVENT_MIN_LEN = 9;
+// 两条记录、列描述和固定的字段
+static constexpr uint32_t CHANGE_FEED_EVENT_MAX_LEN = 2 * (4 + DATA_PAGE_SIZE) + 2 * REC_MAX_N_FIELDS + 32;
+static constexpr size_t CHANGE_FEED_READ_SIZE = 64 * 1024;
+
+struct ChangeFeedClient {
+    ChangeFeed *feed;
+    int fd;
+};
+
+static bool change_feed_is_row_log(LOG_TYPE type) {
+    return type == MLOG_COMP_REC_INSERT
+           || type == MLOG_COMP_REC_UPDATE_IN_PLACE
+           || type == MLOG_COMP_REC_CLUST_DELETE_MARK
+           || type == MLOG_COMP_REC_DELETE;
+}
+
+// 列描述在log body的开头，格式见ParseRecInfoFromLog
+static void change_feed_field_lens(const LogEntry &log, ChangeEvent *event) {
+    const byte *ptr = log.log_body_start_ptr_;
+    uint32_t n_fields = mach_read_from_2(ptr);
+    event->n_uniq = mach_read_from_2(ptr + 2);
+    event->field_lens.resize(n_fields);
+    for (uint32_t i = 0; i < n_fields; ++i) {
+        event->field_lens[i] = mach_read_from_2(ptr + 4 + 2 * i);
+    }
+}
+
+static void change_feed_rec_info(const ChangeEvent &event, RecordInfo *rec_info) {
+    rec_info->SetNFields(event.field_lens.size());
+    rec_info->SetNUnique(event.n_uniq);
+    rec_info->SetIndexType(DICT_CLUSTERED);
+    for (auto len: event.field_lens) {
+        rec_info->AddField(((len + 1) & 0x7fff) <= 1 ? DATA_BINARY : DATA_FIXBINARY,
+                           len & 0x8000 ? DATA_NOT_NULL : 0,
+                           len & 0x7fff);
+    }
+}
+
+// 叶子page上没有被标记删除的用户记录才是一行
+static void change_feed_copy_row(RecordInfo &rec_info, uint32_t n_uniq, const byte *page, byte *rec,
+                                 ChangeRow *row) {
+    if (rec == nullptr || rec < page + PAGE_NEW_SUPREMUM_END || rec >= page + DATA_PAGE_SIZE - PAGE_DIR) {
+        return;
+    }
+    if (rec_get_status(rec) != REC_STATUS_ORDINARY || rec_get_deleted_flag(rec)) {
+        return;
+    }
+    rec_info.SetRecPtr(rec);
+    rec_info.CalculateOffsets(ULINT_UNDEFINED);
+    auto extra_size = rec_info.GetExtraSize();
+    auto data_size = rec_info.GetDataSize();
+    if (rec - extra_size < page + PAGE_NEW_SUPREMUM_END || rec + data_size > page + DATA_PAGE_SIZE - PAGE_DIR) {
+        return;
+    }
+    uint32_t len;
+    row->rec.assign(rec - extra_size, rec + data_size);
+    row->extra_size = extra_size;
+    row->key_len = rec_get_nth_field_offs(rec_info, n_uniq, &len);
+}
+
+static bool change_feed_same_key(const ChangeRow &a, const ChangeRow &b) {
+    return a.key_len == b.key_len
+           && std::memcmp(a.rec.data() + a.extra_size, b.rec.data() + b.extra_size, a.key_len) == 0;
+}
+
+// 搬动记录时拷贝的是整条记录，只有记录头中的next、heap no和n owned会变
+static std::string change_feed_row_image(const ChangeRow &row) {
+    std::string image(reinterpret_cast<const char *>(row.rec.data()), row.extra_size - REC_N_NEW_EXTRA_BYTES);
+    image.append(reinterpret_cast<const char *>(row.rec.data() + row.extra_size), row.rec.size() - row.extra_size);
+    return image;
+}
+
+static void change_feed_put(std::vector<byte> *buf, uint64_t value, uint32_t n) {
+    for (uint32_t i = n; i > 0; --i) {
+        buf->push_back(static_cast<byte>(value >> (8 * (i - 1))));
+    }
+}
+
+static void change_feed_put_row(std::vector<byte> *buf, const ChangeRow &row) {
+    change_feed_put(buf, row.extra_size, 2);
+    change_feed_put(buf, row.rec.size(), 2);
+    buf->insert(buf->end(), row.rec.begin(), row.rec.end());
+}
+
+// 事件的格式见change_feed.h
+static void change_feed_encode(const ChangeEvent &event, std::vector<byte> *buf) {
+    auto start = buf->size();
+    change_feed_put(buf, 0, 4);
+    change_feed_put(buf, event.lsn, 8);
+    change_feed_put(buf, static_cast<uint8_t>(event.type), 1);
+    if (event.type != ChangeType::GAP) {
+        change_feed_put(buf, event.space_id, 4);
+        change_feed_put(buf, event.page_no, 4);
+        change_feed_put(buf, event.field_lens.size(), 2);
+        change_feed_put(buf, event.n_uniq, 2);
+        for (auto len: event.field_lens) {
+            change_feed_put(buf, len, 2);
+        }
+        change_feed_put_row(buf, event.before);
+        change_feed_put_row(buf, event.after);
+    }
+    mach_write_to_4(buf->data() + start, buf->size() - start - 4);
+}
+
+// 返回buf开头一个完整的事件的长度，事件不完整时返回0，格式不对时返回-1
+static ssize_t change_feed_event_len(const byte *buf, size_t size) {
+    if (size < 4) {
+        return 0;
+    }
+    auto len = mach_read_from_4(buf);
+    if (len < CHANGE_FEED_EVENT_MIN_LEN || len > CHANGE_FEED_EVENT_MAX_LEN) {
+        return -1;
+    }
+    return size < 4 + len ? 0 : 4 + len;
+}
+
+static bool change_feed_write_all(int fd, const byte *buf, size_t size) {
+    while (size > 0) {
+        auto n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool change_feed_send_all(int fd, const byte *buf, size_t size) {
+    while (size > 0) {
+        auto n = send(fd, buf, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool change_feed_recv_all(int fd, byte *buf, size_t size) {
+    while (size > 0) {
+        auto n = recv(fd, buf, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+// 消费者只发送一次游标，之后能读到东西说明连接已经关闭
+static bool change_feed_peer_closed(int fd) {
+    byte c;
+    auto n = recv(fd, &c, 1, MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+ChangeFeed::ChangeFeed(const LogGroupConfig &config) :
+        path_(config.change_feed_path),
+        tables_(config.change_feed_tables.begin(), config.change_feed_tables.end()),
+        max_size_(config.change_feed_max_size),
+        page_buf_(DATA_PAGE_SIZE) {
+    pthread_mutex_init(&queue_mutex_, nullptr);
+    pthread_cond_init(&queue_cond_, nullptr);
+    pthread_mutex_init(&segment_mutex_, nullptr);
+    pthread_cond_init(&appended_cond_, nullptr);
+}
+
+ChangeFeed::~ChangeFeed() {
+    if (segment_fd_ >= 0) {
+        close(segment_fd_);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+    }
+    pthread_mutex_destroy(&queue_mutex_);
+    pthread_cond_destroy(&queue_cond_);
+    pthread_mutex_destroy(&segment_mutex_);
+    pthread_cond_destroy(&appended_cond_);
+}
+
+void ChangeFeed::Start(ApplierInstance *applier) {
+    applier_ = applier;
+    if (!Enabled()) {
+        return;
+    }
+    LoadSegments();
+
+    // 从checkpoint开始解析的每一条log都要能读到它之前的page
+    auto start_lsn = applier->log_group.checkpoint_lsn;
+    view_id_ = applier->page_version_store.RegisterView(start_lsn);
+    safe_lsn_ = start_lsn;
+
+    auto socket_path = path_ + "/" + CHANGE_FEED_SOCKET_NAME;
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        LogFatal(COMPONENT_INIT, "change feed socket path %s is too long", socket_path.c_str());
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    unlink(socket_path.c_str());
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0
+        || listen(listen_fd_, SOMAXCONN) != 0) {
+        LogFatal(COMPONENT_INIT, "can not listen on change feed socket %s: %s", socket_path.c_str(),
+                 strerror(errno));
+    }
+
+    START_THREAD("change feed", &feed_thread_id_, FeedRoutine, this);
+    START_THREAD("change feed listener", &listen_thread_id_, ListenRoutine, this);
+    LogEvent(COMPONENT_INIT, "log group %d: change feed of %zu tables in %s from lsn %" PRIu64 ", last event %" PRIu64,
+             applier->group_no, tables_.size(), path_.c_str(), start_lsn, last_lsn_);
+}
+
+bool ChangeFeed::Selected(space_id_t space_id) {
+    auto iter = selected_.find(space_id);
+    if (iter == selected_.end()) {
+        // 压缩表空间的page在buffer pool中是压缩之后的格式，读不出记录
+        bool selected = tables_.count(applier_->buffer_pool.GetFilename(space_id)) != 0
+                        && applier_->buffer_pool.GetPageSize(space_id) == DATA_PAGE_SIZE;
+        iter = selected_.emplace(space_id, selected).first;
+    }
+    return iter->second;
+}
+
+void ChangeFeed::SpaceChanged(space_id_t space_id) {
+    selected_.erase(space_id);
+}
+
+void ChangeFeed::Capture(const LogEntry &log) {
+    if (!Enabled() || !Selected(log.space_id_)) {
+        return;
+    }
+    if (pending_.pages.empty()) {
+        pending_.start_lsn = log.log_start_lsn_;
+    }
+    PageAddress page_address(log.space_id_, log.page_id_);
+    if (std::find(pending_.pages.begin(), pending_.pages.end(), page_address) == pending_.pages.end()) {
+        pending_.pages.push_back(page_address);
+    }
+    if (change_feed_is_row_log(log.type_)) {
+        // log body可能指向parse buffer，拷贝一份
+        pending_.logs.emplace_back(log.type_, log.space_id_, log.page_id_, log.log_start_lsn_, log.log_len_,
+                                   log.log_body_start_ptr_, log.log_body_end_ptr_);
+        pending_.memory_usage += pending_.logs.back().MemorySize();
+    }
+}
+
+void ChangeFeed::CommitMtr(lsn_t lsn) {
+    if (!Enabled()) {
+        return;
+    }
+    if (!pending_.logs.empty()) {
+        PthreadMutexGuard guard(queue_mutex_);
+        if (lost_lsn_ != 0 && queue_bytes_ <= CHANGE_FEED_QUEUE_BYTES / 2) {
+            ChangeMtr gap;
+            gap.start_lsn = lost_lsn_;
+            gap.gap = true;
+            queue_.push_back(std::move(gap));
+            lost_lsn_ = 0;
+        }
+        if (lost_lsn_ == 0 && !queue_.empty() && queue_bytes_ + pending_.memory_usage > CHANGE_FEED_QUEUE_BYTES) {
+            // 不能让解析等feed线程，丢掉这些变更，消费者收到GAP之后重新做快照
+            lost_lsn_ = pending_.start_lsn;
+            LogCrit(COMPONENT_FSAL, "change feed of log group %d is %zu bytes behind, dropping changes from lsn %"
+                    PRIu64, applier_->group_no, queue_bytes_, lost_lsn_);
+        }
+        if (lost_lsn_ == 0) {
+            queue_bytes_ += pending_.memory_usage;
+            queue_.push_back(std::move(pending_));
+            pthread_cond_signal(&queue_cond_);
+        }
+    }
+    pending_ = ChangeMtr();
+    // 在上面的mtr入队之后，feed线程看到空队列时用它推进read view
+    safe_lsn_.store(lsn);
+}
+
+void ChangeFeed::RefreshView(lsn_t lsn) {
+    auto &page_version_store = applier_->page_version_store;
+    if (view_id_ != 0 && page_version_store.UpdateView(view_id_, lsn)) {
+        return;
+    }
+    // read view太久没有推进或者保留的版本太多被回收了，早于lsn的page读不到了，会变成GAP。
+    // 这期间apply过的page没有镜像，lsn可能登记不上，从解析到的lsn重新开始
+    auto lost = view_id_ != 0;
+    auto view_lsn = std::max<lsn_t>(lsn, applier_->log_parser.parsed_lsn);
+    view_id_ = page_version_store.RegisterView(view_lsn);
+    if (lost) {
+        LogWarn(COMPONENT_FSAL, "change feed of log group %d lost its read view, registered again at lsn %" PRIu64,
+                applier_->group_no, view_lsn);
+    }
+}
+
+void ChangeFeed::Materialise(const ChangeMtr &mtr, std::vector<ChangeEvent> *events) {
+    auto first = events->size();
+    auto group = applier_->group_no;
+    for (const auto &log: mtr.logs) {
+        RecordInfo rec_info;
+        uint32_t offset;
+        // 只有聚簇索引上的记录是一行
+        if (!ParseCompRecOffset(log, rec_info, offset) || rec_info.Type() != DICT_CLUSTERED) {
+            continue;
+        }
+        byte *before = page_buf_.data();
+        auto rc = apply_and_copy_page_as_of(group, reinterpret_cast<char *>(before), log.space_id_, log.page_id_,
+                                            log.log_start_lsn_);
+        if (rc == -2) {
+            events->erase(events->begin() + first, events->end());
+            ChangeEvent gap;
+            gap.lsn = log.log_start_lsn_;
+            events->push_back(std::move(gap));
+            return;
+        }
+        // 表空间已经被删除了
+        if (rc != 0 || mach_read_from_2(before + PAGE_HEADER + PAGE_LEVEL) != 0) {
+            continue;
+        }
+        byte *after = after_page_.GetData();
+        std::memcpy(after, before, DATA_PAGE_SIZE);
+        if (!log_apply_apply_one_log(&after_page_, log)) {
+            continue;
+        }
+
+        ChangeEvent event;
+        change_feed_field_lens(log, &event);
+        byte *before_rec = before + offset;
+        byte *after_rec = after + offset;
+        if (log.type_ == MLOG_COMP_REC_INSERT) {
+            // offset是新记录前面的那一条
+            before_rec = nullptr;
+            after_rec = rec_get_next_ptr(after, after + offset);
+        } else if (log.type_ == MLOG_COMP_REC_DELETE) {
+            after_rec = nullptr;
+        }
+        change_feed_copy_row(rec_info, event.n_uniq, before, before_rec, &event.before);
+        change_feed_copy_row(rec_info, event.n_uniq, after, after_rec, &event.after);
+        if (event.before.Exists() && event.after.Exists()) {
+            if (event.before.rec == event.after.rec) {
+                continue;
+            }
+            event.type = ChangeType::UPDATE;
+        } else if (event.after.Exists()) {
+            event.type = ChangeType::INSERT;
+        } else if (event.before.Exists()) {
+            event.type = ChangeType::DELETE;
+        } else {
+            continue;
+        }
+        event.lsn = log.log_start_lsn_;
+        event.space_id = log.space_id_;
+        event.page_no = log.page_id_;
+        event.index_id = mach_read_from_8(before + PAGE_HEADER + PAGE_INDEX_ID);
+        events->push_back(std::move(event));
+    }
+
+    // 同一个mtr中先删除再插入同一个主键：悲观更新，或者更新之后记录变长，原来的位置放不下
+    for (size_t i = first; i < events->size(); ++i) {
+        auto &deleted = (*events)[i];
+        if (deleted.type != ChangeType::DELETE) {
+            continue;
+        }
+        for (size_t j = i + 1; j < events->size(); ++j) {
+            auto &inserted = (*events)[j];
+            if (inserted.type != ChangeType::INSERT || inserted.index_id != deleted.index_id
+                || !change_feed_same_key(deleted.before, inserted.after)) {
+                continue;
+            }
+            inserted.type = ChangeType::UPDATE;
+            inserted.before = std::move(deleted.before);
+            // lsn为0的事件在下面被去掉
+            if (inserted.before.rec == inserted.after.rec) {
+                inserted.lsn = 0;
+            }
+            deleted.lsn = 0;
+            break;
+        }
+    }
+    DropMovedRows(mtr, events, first);
+    events->erase(std::remove_if(events->begin() + first, events->end(), [](const ChangeEvent &event) {
+        return event.lsn == 0;
+    }), events->end());
+}
+
+void ChangeFeed::DropMovedRows(const ChangeMtr &mtr, std::vector<ChangeEvent> *events, size_t first) {
+    // 只修改了一个page的mtr不会搬动记录
+    if (mtr.pages.size() < 2) {
+        return;
+    }
+    std::unordered_map<uint64_t, std::pair<RecordInfo, uint32_t>> indexes;
+    for (size_t i = first; i < events->size(); ++i) {
+        const auto &event = (*events)[i];
+        if (event.lsn != 0 && event.type == ChangeType::INSERT && indexes.count(event.index_id) == 0) {
+            RecordInfo rec_info;
+            change_feed_rec_info(event, &rec_info);
+            indexes.emplace(event.index_id, std::make_pair(rec_info, event.n_uniq));
+        }
+    }
+    if (indexes.empty()) {
+        return;
+    }
+
+    std::unordered_set<std::string> rows;
+    byte *page = page_buf_.data();
+    for (const auto &page_address: mtr.pages) {
+        if (apply_and_copy_page_as_of(applier_->group_no, reinterpret_cast<char *>(page), page_address.SpaceId(),
+                                      page_address.PageId(), mtr.start_lsn) != 0) {
+            continue;
+        }
+        if (mach_read_from_2(page + FIL_PAGE_TYPE) != FIL_PAGE_INDEX
+            || mach_read_from_2(page + PAGE_HEADER + PAGE_LEVEL) != 0) {
+            continue;
+        }
+        auto iter = indexes.find(mach_read_from_8(page + PAGE_HEADER + PAGE_INDEX_ID));
+        if (iter == indexes.end()) {
+            continue;
+        }
+        auto &[rec_info, n_uniq] = iter->second;
+        uint32_t n_heap = mach_read_from_2(page + PAGE_HEADER + PAGE_N_HEAP) & 0x7fff;
+        byte *rec = page + PAGE_NEW_INFIMUM;
+        for (uint32_t i = 0; i < n_heap; ++i) {
+            rec = rec_get_next_ptr(page, rec);
+            if (rec == nullptr || rec == page + PAGE_NEW_SUPREMUM) {
+                break;
+            }
+            ChangeRow row;
+            change_feed_copy_row(rec_info, n_uniq, page, rec, &row);
+            if (row.Exists()) {
+                rows.insert(change_feed_row_image(row));
+            }
+        }
+    }
+    for (size_t i = first; i < events->size(); ++i) {
+        auto &event = (*events)[i];
+        if (event.lsn != 0 && event.type == ChangeType::INSERT && rows.count(change_feed_row_image(event.after)) != 0) {
+            event.lsn = 0;
+        }
+    }
+}
+
+void *ChangeFeed::FeedRoutine(void *arg) {
+    auto *feed = static_cast<ChangeFeed *>(arg);
+    std::deque<ChangeMtr> batch;
+    std::vector<ChangeEvent> events;
+    for (;;) {
+        lsn_t next_lsn;
+        {
+            PthreadMutexGuard guard(feed->queue_mutex_);
+            if (feed->queue_.empty()) {
+                struct timespec deadline {};
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                auto nsec = deadline.tv_nsec + static_cast<long>(CHANGE_FEED_VIEW_REFRESH_MS) * 1000 * 1000;
+                deadline.tv_sec += nsec / 1000000000L;
+                deadline.tv_nsec = nsec % 1000000000L;
+                pthread_cond_timedwait(&feed->queue_cond_, &feed->queue_mutex_, &deadline);
+            }
+            // 还没有处理的mtr都不早于next_lsn
+            next_lsn = feed->queue_.empty() ? feed->safe_lsn_.load() : feed->queue_.front().start_lsn;
+            batch.swap(feed->queue_);
+            feed->queue_bytes_ = 0;
+        }
+        feed->RefreshView(next_lsn);
+
+        auto refreshed = std::chrono::steady_clock::now();
+        for (const auto &mtr: batch) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - refreshed > std::chrono::milliseconds(CHANGE_FEED_VIEW_REFRESH_MS)) {
+                feed->RefreshView(mtr.start_lsn);
+                refreshed = now;
+            }
+            if (mtr.gap) {
+                ChangeEvent gap;
+                gap.lsn = mtr.start_lsn;
+                events.push_back(std::move(gap));
+                continue;
+            }
+            feed->Materialise(mtr, &events);
+        }
+        batch.clear();
+        feed->Append(events);
+        events.clear();
+    }
+    return nullptr;
+}
+
+std::string ChangeFeed::SegmentPath(lsn_t first_lsn) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%020" PRIu64 "%s", first_lsn, CHANGE_FEED_SEGMENT_SUFFIX);
+    return path_ + "/" + name;
+}
+
+void ChangeFeed::LoadSegments() {
+    if (mkdir(path_.c_str(), 0755) != 0 && errno != EEXIST) {
+        LogFatal(COMPONENT_INIT, "can not create change feed directory %s: %s", path_.c_str(), strerror(errno));
+    }
+    DIR *dir = opendir(path_.c_str());
+    if (dir == nullptr) {
+        LogFatal(COMPONENT_INIT, "can not open change feed directory %s: %s", path_.c_str(), strerror(errno));
+    }
+    size_t suffix_len = std::strlen(CHANGE_FEED_SEGMENT_SUFFIX);
+    while (auto *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() <= suffix_len
+            || name.compare(name.size() - suffix_len, suffix_len, CHANGE_FEED_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        char *end;
+        lsn_t first_lsn = strtoull(name.c_str(), &end, 10);
+        struct stat st {};
+        if (end != name.c_str() + name.size() - suffix_len || stat(SegmentPath(first_lsn).c_str(), &st) != 0) {
+            continue;
+        }
+        segments_[first_lsn] = st.st_size;
+    }
+    closedir(dir);
+
+    // 最后一个segment的结尾可能是写了一半的事件，截掉它，重新解析出来的事件从之后开始写
+    while (!segments_.empty()) {
+        auto last = std::prev(segments_.end());
+        auto path = SegmentPath(last->first);
+        int fd = open(path.c_str(), O_RDWR);
+        std::vector<byte> data(last->second);
+        if (fd < 0 || pread(fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+            LogFatal(COMPONENT_INIT, "can not read change feed segment %s: %s", path.c_str(), strerror(errno));
+        }
+        size_t offset = 0;
+        for (;;) {
+            auto len = change_feed_event_len(data.data() + offset, data.size() - offset);
+            if (len <= 0) {
+                break;
+            }
+            last_lsn_ = mach_read_from_8(data.data() + offset + 4);
+            offset += len;
+        }
+        if (offset != data.size()) {
+            LogWarn(COMPONENT_INIT, "change feed segment %s: truncated %zu bytes of an incomplete event",
+                    path.c_str(), data.size() - offset);
+            if (ftruncate(fd, offset) != 0) {
+                LogFatal(COMPONENT_INIT, "can not truncate %s: %s", path.c_str(), strerror(errno));
+            }
+        }
+        close(fd);
+        if (offset != 0) {
+            last->second = offset;
+            break;
+        }
+        unlink(path.c_str());
+        segments_.erase(last);
+    }
+}
+
+void ChangeFeed::OpenSegment(lsn_t first_lsn) {
+    if (segment_fd_ >= 0) {
+        close(segment_fd_);
+    }
+    auto path = SegmentPath(first_lsn);
+    segment_fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    struct stat st {};
+    if (segment_fd_ < 0 || fstat(segment_fd_, &st) != 0) {
+        LogCrit(COMPONENT_FSAL, "can not create change feed segment %s: %s", path.c_str(), strerror(errno));
+        if (segment_fd_ >= 0) {
+            close(segment_fd_);
+            segment_fd_ = -1;
+        }
+        return;
+    }
+    segment_lsn_ = first_lsn;
+    segment_size_ = st.st_size;
+    // 新的segment出现之后，读到上一个segment结尾的连接就可以换过来了
+    PthreadMutexGuard guard(segment_mutex_);
+    segments_[first_lsn] = segment_size_;
+    pthread_cond_broadcast(&appended_cond_);
+}
+
+void ChangeFeed::Flush(std::vector<byte> *buf, lsn_t first_lsn, lsn_t last_lsn) {
+    if (buf->empty()) {
+        return;
+    }
+    if (segment_fd_ < 0 || !change_feed_write_all(segment_fd_, buf->data(), buf->size())
+        || fdatasync(segment_fd_) != 0) {
+        LogCrit(COMPONENT_FSAL, "can not write change feed segment %s: %s, events from lsn %" PRIu64 " are lost",
+                SegmentPath(segment_lsn_).c_str(), strerror(errno), first_lsn);
+        if (segment_fd_ >= 0 && ftruncate(segment_fd_, segment_size_) != 0) {
+            close(segment_fd_);
+            segment_fd_ = -1;
+        }
+        if (gap_lsn_ == 0) {
+            gap_lsn_ = first_lsn;
+        }
+        buf->clear();
+        return;
+    }
+    segment_size_ += buf->size();
+    buf->clear();
+
+    PthreadMutexGuard guard(segment_mutex_);
+    segments_[segment_lsn_] = segment_size_;
+    last_lsn_ = last_lsn;
+    size_t total_size = 0;
+    for (const auto &[lsn, size]: segments_) {
+        total_size += size;
+    }
+    // 正在读被删掉的segment的连接还可以读完它
+    while (total_size > max_size_ && segments_.size() > 1) {
+        auto oldest = segments_.begin();
+        unlink(SegmentPath(oldest->first).c_str());
+        total_size -= oldest->second;
+        segments_.erase(oldest);
+    }
+    pthread_cond_broadcast(&appended_cond_);
+}
+
+void ChangeFeed::Append(const std::vector<ChangeEvent> &events) {
+    std::vector<byte> buf;
+    lsn_t first_lsn = 0;
+    // 重启之后从checkpoint重新解析，已经写出的事件不再写
+    lsn_t last_lsn = last_lsn_;
+    for (const auto &event: events) {
+        if (event.lsn <= last_lsn) {
+            continue;
+        }
+        // 重启之后page比log新的时候每个mtr都是GAP，只保留第一个
+        if (event.type == ChangeType::GAP && last_gap_) {
+            continue;
+        }
+        last_gap_ = event.type == ChangeType::GAP;
+        if (segment_fd_ < 0 || segment_size_ + buf.size() >= CHANGE_FEED_SEGMENT_SIZE) {
+            Flush(&buf, first_lsn, last_lsn);
+            OpenSegment(gap_lsn_ != 0 ? gap_lsn_ : event.lsn);
+        }
+        if (gap_lsn_ != 0) {
+            ChangeEvent gap;
+            gap.lsn = gap_lsn_;
+            if (buf.empty()) {
+                first_lsn = gap.lsn;
+            }
+            change_feed_encode(gap, &buf);
+            gap_lsn_ = 0;
+        }
+        if (buf.empty()) {
+            first_lsn = event.lsn;
+        }
+        change_feed_encode(event, &buf);
+        last_lsn = event.lsn;
+    }
+    Flush(&buf, first_lsn, last_lsn);
+}
+
+void *ChangeFeed::ListenRoutine(void *arg) {
+    auto *feed = static_cast<ChangeFeed *>(arg);
+    for (;;) {
+        int fd = accept(feed->listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno != EINTR) {
+                LogCrit(COMPONENT_FSAL, "change feed accept failed: %s", strerror(errno));
+                sleep(1);
+            }
+            continue;
+        }
+        auto *client = new ChangeFeedClient {feed, fd};
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, nullptr, ClientRoutine, client) != 0) {
+            LogCrit(COMPONENT_FSAL, "can not start a change feed connection: %s", strerror(errno));
+            close(fd);
+            delete client;
+            continue;
+        }
+        pthread_detach(thread_id);
+    }
+    return nullptr;
+}
+
+void *ChangeFeed::ClientRoutine(void *arg) {
+    std::unique_ptr<ChangeFeedClient> client(static_cast<ChangeFeedClient *>(arg));
+    byte cursor[8];
+    if (change_feed_recv_all(client->fd, cursor, sizeof(cursor))) {
+        client->feed->Serve(client->fd, mach_read_from_8(cursor));
+    }
+    close(client->fd);
+    return nullptr;
+}
+
+void ChangeFeed::Serve(int fd, lsn_t cursor) {
+    std::vector<byte> buf;
+    lsn_t segment_lsn = 0;
+    bool first = true;
+    for (;;) {
+        bool gap = false;
+        {
+            PthreadMutexGuard guard(segment_mutex_);
+            while (segments_.empty()) {
+                pthread_cond_wait(&appended_cond_, &segment_mutex_);
+            }
+            if (first) {
+                // 包含游标之后第一个事件的segment
+                auto iter = segments_.upper_bound(cursor);
+                if (iter == segments_.begin()) {
+                    // 游标对应的事件所在的segment已经被删掉了
+                    gap = cursor != 0;
+                } else {
+                    --iter;
+                }
+                segment_lsn = iter->first;
+                first = false;
+            } else {
+                // 读完的segment之后一定还有segment
+                segment_lsn = segments_.upper_bound(segment_lsn)->first;
+            }
+        }
+
+        int segment_fd = open(SegmentPath(segment_lsn).c_str(), O_RDONLY);
+        if (segment_fd < 0) {
+            // 还没有读到就被删掉了
+            gap = true;
+        }
+        if (gap) {
+            ChangeEvent event;
+            event.lsn = cursor + 1;
+            buf.clear();
+            change_feed_encode(event, &buf);
+            if (!change_feed_send_all(fd, buf.data(), buf.size())) {
+                if (segment_fd >= 0) {
+                    close(segment_fd);
+                }
+                return;
+            }
+            cursor = event.lsn;
+        }
+        if (segment_fd < 0) {
+            continue;
+        }
+
+        buf.clear();
+        bool last_read = false;
+        for (;;) {
+            auto size = buf.size();
+            buf.resize(size + CHANGE_FEED_READ_SIZE);
+            auto n = read(segment_fd, buf.data() + size, CHANGE_FEED_READ_SIZE);
+            buf.resize(size + std::max<ssize_t>(n, 0));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                close(segment_fd);
+                return;
+            }
+
+            size_t offset = 0;
+            for (;;) {
+                auto len = change_feed_event_len(buf.data() + offset, buf.size() - offset);
+                if (len < 0) {
+                    LogCrit(COMPONENT_FSAL, "change feed segment %s is corrupted",
+                            SegmentPath(segment_lsn).c_str());
+                    close(segment_fd);
+                    return;
+                }
+                if (len == 0) {
+                    break;
+                }
+                auto lsn = mach_read_from_8(buf.data() + offset + 4);
+                if (lsn > cursor) {
+                    if (!change_feed_send_all(fd, buf.data() + offset, len)) {
+                        close(segment_fd);
+                        return;
+                    }
+                    cursor = lsn;
+                }
+                offset += len;
+            }
+            buf.erase(buf.begin(), buf.begin() + offset);
+            if (n > 0) {
+                continue;
+            }
+            if (last_read) {
+                break;
+            }
+
+            // 读到了segment的结尾，等新的事件，或者换到下一个segment
+            {
+                PthreadMutexGuard guard(segment_mutex_);
+                // feed线程写完一个segment之后才创建下一个，看到下一个segment之后再读一次就读完了这个segment
+                last_read = segments_.upper_bound(segment_lsn) != segments_.end();
+                if (!last_read) {
+                    struct timespec deadline {};
+                    clock_gettime(CLOCK_REALTIME, &deadline);
+                    deadline.tv_sec += 1;
+                    pthread_cond_timedwait(&appended_cond_, &segment_mutex_, &deadline);
+                }
+            }
+            if (change_feed_peer_closed(fd)) {
+                close(segment_fd);
+                return;
+            }
+        }
+        close(segment_fd);
+    }
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cstring>
+#include "applier/index_cursor.h"
+#include "applier/record.h"
+#include "applier/utility.h"
+
+// 列描述和page对不上时，计算偏移量会从记录往前读null位图和变长列的长度，page前面留出这么多空间
+static constexpr size_t LOOKUP_PAGE_PADDING = REC_N_NEW_EXTRA_BYTES + (REC_MAX_N_FIELDS + 7) / 8
+                                              + 2 * REC_MAX_N_FIELDS;
+// 一个slot最多拥有PAGE_DIR_SLOT_MAX_N_OWNED条记录，slot内顺序查找超过这么多步说明page不对
+static constexpr uint32_t LOOKUP_MAX_SLOT_STEPS = 2 * PAGE_DIR_SLOT_MAX_N_OWNED;
+
+// 按字节比较，SQL NULL比其它值都小，前缀相同时短的小
+static int lookup_cmp_field(const lookup_key_field &key, const byte *data, uint32_t len) {
+    if (key.len == LOOKUP_SQL_NULL || len == UNIV_SQL_NULL) {
+        return (len == UNIV_SQL_NULL) - (key.len == LOOKUP_SQL_NULL);
+    }
+    int cmp = std::memcmp(key.data, data, std::min(key.len, len));
+    if (cmp != 0) {
+        return cmp;
+    }
+    return key.len < len ? -1 : (key.len > len ? 1 : 0);
+}
+
+IndexCursor::IndexCursor(int group, space_id_t space_id, page_id_t root_page_no, lsn_t lsn) :
+        group_(group),
+        space_id_(space_id),
+        root_page_no_(root_page_no),
+        lsn_(lsn),
+        buf_(LOOKUP_PAGE_PADDING + DATA_PAGE_SIZE) {
+    page_ = buf_.data() + LOOKUP_PAGE_PADDING;
+}
+
+// 列描述的格式见mlog_open_and_write_index，和ParseRecInfoFromLog的检查一样
+bool IndexCursor::Init(const uint16_t *field_lens, uint32_t n_fields, uint32_t n_uniq) {
+    if (n_fields == 0 || n_fields > REC_MAX_N_FIELDS || n_uniq == 0 || n_uniq > n_fields) {
+        return false;
+    }
+    // 压缩表空间的page在buffer pool中是压缩之后的格式
+    if (get_space_page_size(group_, space_id_) != DATA_PAGE_SIZE) {
+        return false;
+    }
+    rec_info_.SetNFields(n_fields);
+    rec_info_.SetNUnique(n_uniq);
+    rec_info_.SetIndexType(0);
+    if (n_uniq != n_fields) {
+        // 聚簇索引在主键之后是DB_TRX_ID和DB_ROLL_PTR
+        if (n_uniq + DATA_ROLL_PTR > n_fields
+            || (field_lens[n_uniq + DATA_TRX_ID - 1] & 0x7fff) != DATA_TRX_ID_LEN
+            || (field_lens[n_uniq + DATA_ROLL_PTR - 1] & 0x7fff) != DATA_ROLL_PTR_LEN) {
+            return false;
+        }
+        rec_info_.SetIndexType(DICT_CLUSTERED);
+    }
+    for (uint32_t i = 0; i < n_fields; ++i) {
+        uint32_t len = field_lens[i];
+        rec_info_.AddField(((len + 1) & 0x7fff) <= 1 ? DATA_BINARY : DATA_FIXBINARY,
+                           len & 0x8000 ? DATA_NOT_NULL : 0,
+                           len & 0x7fff);
+    }
+    n_fields_ = n_fields;
+    n_uniq_ = n_uniq;
+    return true;
+}
+
+int IndexCursor::ReadPage(page_id_t page_no, uint32_t expected_level) {
+    auto *dest_buf = reinterpret_cast<char *>(page_);
+    int rc = lsn_ == 0 ? apply_and_copy_page(group_, dest_buf, space_id_, page_no)
+                       : apply_and_copy_page_as_of(group_, dest_buf, space_id_, page_no, lsn_);
+    if (rc != 0) {
+        return rc;
+    }
+    ++n_pages_read_;
+    // 读到的page必须属于同一个COMPACT格式的索引，并且层数和期望的一样
+    if (mach_read_from_2(page_ + FIL_PAGE_TYPE) != FIL_PAGE_INDEX
+        || !(mach_read_from_2(page_ + PAGE_HEADER + PAGE_N_HEAP) & 0x8000)) {
+        return BAD_INDEX;
+    }
+    auto index_id = mach_read_from_8(page_ + PAGE_HEADER + PAGE_INDEX_ID);
+    uint32_t level = mach_read_from_2(page_ + PAGE_HEADER + PAGE_LEVEL);
+    if (n_pages_read_ == 1) {
+        index_id_ = index_id;
+    } else if (index_id != index_id_ || (expected_level != ANY_LEVEL && level != expected_level)) {
+        return BAD_INDEX;
+    }
+    page_no_ = page_no;
+    level_ = level;
+    rec_ = page_ + PAGE_NEW_INFIMUM;
+    n_steps_ = 0;
+    return 0;
+}
+
+// 记录的null位图、变长列长度和数据都必须在page的记录区内
+bool IndexCursor::RecInPage(const byte *rec) const {
+    return rec - rec_info_.GetExtraSize() >= page_ + PAGE_NEW_SUPREMUM_END
+           && rec + rec_info_.GetDataSize() <= page_ + DATA_PAGE_SIZE - PAGE_DIR;
+}
+
+bool IndexCursor::CalculateOffsets(byte *rec) {
+    rec_info_.SetRecPtr(rec);
+    rec_info_.CalculateOffsets(ULINT_UNDEFINED);
+    return RecInPage(rec);
+}
+
+int IndexCursor::Compare(const lookup_key_field *key, uint32_t n_key) const {
+    int cmp = 0;
+    for (uint32_t i = 0; i < n_key && cmp == 0; ++i) {
+        uint32_t len;
+        auto offs = rec_get_nth_field_offs(rec_info_, i, &len);
+        cmp = lookup_cmp_field(key[i], rec_info_.GetRecPtr() + offs, len);
+    }
+    return cmp;
+}
+
+/**
+ * 比较key和page上的一条记录
+ * @param leaf page是否是叶子page，决定记录应该是普通记录还是node pointer
+ * @param cmp 返回key和记录比较的结果，infimum和每一层最左边的node pointer比任何key都小，supremum比任何key都大
+ * @return 记录和列描述对不上时返回false
+ */
+bool IndexCursor::CmpRec(byte *rec, bool leaf, int *cmp) {
+    auto status = rec_get_status(rec);
+    if (status == REC_STATUS_INFIMUM) {
+        *cmp = 1;
+        return true;
+    }
+    if (status == REC_STATUS_SUPREMUM) {
+        *cmp = -1;
+        return true;
+    }
+    if (status != (leaf ? REC_STATUS_ORDINARY : REC_STATUS_NODE_PTR)) {
+        return false;
+    }
+    if (!leaf && (rec_get_info_bits(rec, true) & REC_INFO_MIN_REC_FLAG)) {
+        *cmp = 1;
+        return true;
+    }
+    if (!CalculateOffsets(rec)) {
+        return false;
+    }
+    *cmp = Compare(key_, n_key_);
+    return true;
+}
+
+byte *IndexCursor::SlotRec(uint32_t slot_no) const {
+    uint32_t offs = mach_read_from_2(page_ + DATA_PAGE_SIZE - PAGE_DIR - PAGE_DIR_SLOT_SIZE * (slot_no + 1));
+    if (offs < PAGE_NEW_INFIMUM || offs >= DATA_PAGE_SIZE - PAGE_DIR) {
+        return nullptr;
+    }
+    return page_ + offs;
+}
+
+/**
+ * 在当前page上找到不大于(strict时是小于)key的最后一条记录，放到rec_
+ * @param cmp 返回key和这条记录比较的结果
+ * @return page和列描述对不上时返回false
+ */
+bool IndexCursor::SearchPage(bool leaf, bool strict, int *cmp) {
+    uint32_t n_slots = mach_read_from_2(page_ + PAGE_HEADER + PAGE_N_DIR_SLOTS);
+    if (n_slots < 2 || n_slots > DATA_PAGE_SIZE / (PAGE_DIR_SLOT_SIZE * PAGE_DIR_SLOT_MIN_N_OWNED)) {
+        return false;
+    }
+
+    // slot 0拥有infimum，最后一个slot拥有supremum
+    uint32_t low = 0, high = n_slots - 1;
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        byte *mid_rec = SlotRec(mid);
+        int mid_cmp;
+        if (mid_rec == nullptr || !CmpRec(mid_rec, leaf, &mid_cmp)) {
+            return false;
+        }
+        if (strict ? mid_cmp > 0 : mid_cmp >= 0) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    byte *low_rec = SlotRec(low);
+    byte *high_rec = SlotRec(high);
+    if (low_rec == nullptr || high_rec == nullptr || !CmpRec(low_rec, leaf, cmp)) {
+        return false;
+    }
+    rec_ = low_rec;
+    for (uint32_t steps = 0;; ++steps) {
+        uint32_t next_offs = rec_get_next_offs(page_, rec_);
+        if (steps >= LOOKUP_MAX_SLOT_STEPS || next_offs < PAGE_NEW_INFIMUM || next_offs >= DATA_PAGE_SIZE - PAGE_DIR) {
+            return false;
+        }
+        byte *next = page_ + next_offs;
+        if (next == high_rec) {
+            break;
+        }
+        int next_cmp;
+        if (!CmpRec(next, leaf, &next_cmp)) {
+            return false;
+        }
+        if (strict ? next_cmp <= 0 : next_cmp < 0) {
+            break;
+        }
+        rec_ = next;
+        *cmp = next_cmp;
+    }
+    return true;
+}
+
+int IndexCursor::Search(const lookup_key_field *key, uint32_t n_key, bool strict, int *cmp) {
+    if (n_key > n_uniq_) {
+        return BAD_INDEX;
+    }
+    key_ = key;
+    n_key_ = n_key;
+    int rc = ReadPage(root_page_no_, ANY_LEVEL);
+    for (uint32_t depth = 0; rc == 0; ++depth) {
+        if (depth >= BTR_MAX_LEVELS || !SearchPage(level_ == 0, strict, cmp)) {
+            return BAD_INDEX;
+        }
+        if (IsInfimum()) {
+            // 非叶子page最左边的node pointer比任何key都小，只有叶子page会落到infimum上
+            return level_ == 0 ? 0 : BAD_INDEX;
+        }
+        // CmpRec不会为最左边的node pointer计算偏移量，这里重新算一次
+        if (!CalculateOffsets(rec_)) {
+            return BAD_INDEX;
+        }
+        if (level_ == 0) {
+            return 0;
+        }
+
+        uint32_t len;
+        auto offs = rec_get_nth_field_offs(rec_info_, rec_info_.Type() & DICT_CLUSTERED ? n_uniq_ : n_fields_,
+                                           &len);
+        if (len != REC_NODE_PTR_SIZE) {
+            return BAD_INDEX;
+        }
+        rc = ReadPage(mach_read_from_4(rec_ + offs), level_ - 1);
+    }
+    return rc;
+}
+
+int IndexCursor::Next() {
+    if (IsSupremum()) {
+        return 0;
+    }
+    uint32_t n_heap = mach_read_from_2(page_ + PAGE_HEADER + PAGE_N_HEAP) & 0x7fff;
+    uint32_t next_offs = rec_get_next_offs(page_, rec_);
+    if (++n_steps_ > n_heap || next_offs < PAGE_NEW_INFIMUM || next_offs >= DATA_PAGE_SIZE - PAGE_DIR) {
+        return BAD_INDEX;
+    }
+    rec_ = page_ + next_offs;
+    auto status = rec_get_status(rec_);
+    if (status == REC_STATUS_SUPREMUM) {
+        return 0;
+    }
+    if (status != REC_STATUS_ORDINARY || !CalculateOffsets(rec_)) {
+        return BAD_INDEX;
+    }
+    return 0;
+}
+
+int IndexCursor::NextPage(bool *last) {
+    page_id_t next_page_no = mach_read_from_4(page_ + FIL_PAGE_NEXT);
+    *last = next_page_no == FIL_NULL;
+    if (*last) {
+        return 0;
+    }
+    return ReadPage(next_page_no, 0);
+}
+
+bool IndexCursor::IsSupremum() const {
+    return rec_get_status(rec_) == REC_STATUS_SUPREMUM;
+}
+
+bool IndexCursor::IsInfimum() const {
+    return rec_get_status(rec_) == REC_STATUS_INFIMUM;
+}
+
+int lookup_record(int group, uint32_t space_id, uint32_t root_page_no,
+                  const uint16_t *field_lens, uint32_t n_fields, uint32_t n_uniq,
+                  const struct lookup_key_field *key, uint64_t lsn,
+                  char *dest_buf, struct lookup_result *result) {
+    IndexCursor cursor(group, space_id, root_page_no, lsn);
+    if (!cursor.Init(field_lens, n_fields, n_uniq)) {
+        return IndexCursor::BAD_INDEX;
+    }
+    int cmp;
+    int rc = cursor.Search(key, n_uniq, false, &cmp);
+    if (rc != 0) {
+        return rc;
+    }
+    if (cursor.IsInfimum() || cmp != 0) {
+        return IndexCursor::NOT_FOUND;
+    }
+    const auto &rec_info = cursor.RecInfo();
+    auto extra_size = rec_info.GetExtraSize();
+    auto rec_len = extra_size + rec_info.GetDataSize();
+    std::memcpy(dest_buf, cursor.Rec() - extra_size, rec_len);
+    result->page_no = cursor.PageNo();
+    result->rec_len = rec_len;
+    result->extra_size = extra_size;
+    return 0;
+}
@@ -0,0 +1,318 @@
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "applier/index_cursor.h"
+#include "applier/record.h"
+
+/*
+ * 存储节点上的过滤扫描：沿着叶子page的链表逐个page处理，先把一个page上所有记录中条件用到的列
+ * 取出来按列放在一起，再对整列做比较得到每条记录是否满足条件，最后只把满足条件的记录中需要的列交给回调。
+ * 不超过8字节的定长列按大端读成无符号整数，和按字节比较的顺序一样，整数、DATE/DATETIME/TIMESTAMP、
+ * DECIMAL都是这样保存的；FLOAT和DOUBLE按小端保存，不能用来做比较条件
+ */
+
+// 不超过这么长的定长列读成整数后比较，更长的按字节比较
+static constexpr uint32_t SCAN_INT_COLUMN_LEN = 8;
+// 不超过这么长的列放在32位的数组里，SSE2没有64位整数的比较指令，32位一次能比较4条记录
+static constexpr uint32_t SCAN_INT32_COLUMN_LEN = 4;
+
+struct ScanFilter {
+    const scan_predicate *predicate;
+    uint32_t len {0};               // 比较的列的长度，IS_NULL和IS_NOT_NULL是0
+    uint64_t value {0};             // 比较条件的常量，读成整数
+    std::vector<uint32_t> values32; // 一个page上所有记录的这一列
+    std::vector<uint64_t> values64;
+    std::vector<uint8_t> nulls;
+};
+
+static uint64_t scan_read_int(const byte *data, uint32_t len) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
+
+static bool scan_cmp_holds(scan_op op, int cmp) {
+    switch (op) {
+        case SCAN_OP_EQ:
+            return cmp == 0;
+        case SCAN_OP_NE:
+            return cmp != 0;
+        case SCAN_OP_LT:
+            return cmp < 0;
+        case SCAN_OP_LE:
+            return cmp <= 0;
+        case SCAN_OP_GT:
+            return cmp > 0;
+        case SCAN_OP_GE:
+            return cmp >= 0;
+        default:
+            return false;
+    }
+}
+
+/*
+ * 对一整列做比较，循环中没有分支和函数调用，编译器会把它向量化，一条SIMD指令比较多条记录。
+ * SQL NULL和任何值比较都不成立
+ */
+template<typename T, typename Cmp>
+static void scan_filter_kernel(const T *values, const uint8_t *nulls, size_t n, T value, Cmp cmp, uint8_t *mask) {
+    for (size_t i = 0; i < n; ++i) {
+        mask[i] &= static_cast<uint8_t>(cmp(values[i], value)) & static_cast<uint8_t>(nulls[i] ^ 1);
+    }
+}
+
+static void scan_null_kernel(const uint8_t *nulls, size_t n, uint8_t expected, uint8_t *mask) {
+    for (size_t i = 0; i < n; ++i) {
+        mask[i] &= static_cast<uint8_t>(nulls[i] == expected);
+    }
+}
+
+template<typename T>
+static void scan_filter_values(scan_op op, const T *values, const uint8_t *nulls, size_t n, T value, uint8_t *mask) {
+    switch (op) {
+        case SCAN_OP_EQ:
+            scan_filter_kernel(values, nulls, n, value, std::equal_to<T>(), mask);
+            break;
+        case SCAN_OP_NE:
+            scan_filter_kernel(values, nulls, n, value, std::not_equal_to<T>(), mask);
+            break;
+        case SCAN_OP_LT:
+            scan_filter_kernel(values, nulls, n, value, std::less<T>(), mask);
+            break;
+        case SCAN_OP_LE:
+            scan_filter_kernel(values, nulls, n, value, std::less_equal<T>(), mask);
+            break;
+        case SCAN_OP_GT:
+            scan_filter_kernel(values, nulls, n, value, std::greater<T>(), mask);
+            break;
+        case SCAN_OP_GE:
+            scan_filter_kernel(values, nulls, n, value, std::greater_equal<T>(), mask);
+            break;
+        default:
+            break;
+    }
+}
+
+static void scan_filter(const ScanFilter &filter, size_t n, uint8_t *mask) {
+    auto op = filter.predicate->op;
+    const auto *nulls = filter.nulls.data();
+    if (op == SCAN_OP_IS_NULL || op == SCAN_OP_IS_NOT_NULL) {
+        scan_null_kernel(nulls, n, op == SCAN_OP_IS_NULL, mask);
+    } else if (filter.len <= SCAN_INT32_COLUMN_LEN) {
+        scan_filter_values(op, filter.values32.data(), nulls, n, static_cast<uint32_t>(filter.value), mask);
+    } else if (filter.len <= SCAN_INT_COLUMN_LEN) {
+        scan_filter_values(op, filter.values64.data(), nulls, n, filter.value, mask);
+    } else {
+        // 比较已经在scan_gather中做完了，这里只排除SQL NULL
+        scan_null_kernel(nulls, n, 0, mask);
+    }
+}
+
+/**
+ * 取出一条记录中条件用到的列，第i条记录的值放在每个filter的第i个位置；
+ * 超过SCAN_INT_COLUMN_LEN的定长列在这里直接按字节比较，结果写到mask上
+ */
+static void scan_gather(std::vector<ScanFilter> *filters, const RecordInfo &rec_info, size_t i, uint8_t *mask) {
+    for (auto &filter : *filters) {
+        const auto *predicate = filter.predicate;
+        uint32_t len;
+        auto offs = rec_get_nth_field_offs(rec_info, predicate->field_no, &len);
+        const byte *data = rec_info.GetRecPtr() + offs;
+        bool null = len == UNIV_SQL_NULL;
+        filter.nulls[i] = null;
+        if (null || filter.len == 0) {
+            continue;
+        }
+        if (filter.len <= SCAN_INT32_COLUMN_LEN) {
+            filter.values32[i] = static_cast<uint32_t>(scan_read_int(data, len));
+        } else if (filter.len <= SCAN_INT_COLUMN_LEN) {
+            filter.values64[i] = scan_read_int(data, len);
+        } else {
+            mask[i] &= scan_cmp_holds(predicate->op, std::memcmp(data, predicate->value.data, len));
+        }
+    }
+}
+
+// 定长列的长度，变长列返回0
+static uint32_t scan_fixed_len(const scan_request *req, uint32_t field_no) {
+    uint32_t len = req->field_lens[field_no] & 0x7fff;
+    return len == 0x7fff ? 0 : len;
+}
+
+static bool scan_init_filters(const scan_request *req, std::vector<ScanFilter> *filters) {
+    for (uint32_t i = 0; i < req->n_predicates; ++i) {
+        const auto *predicate = &req->predicates[i];
+        if (predicate->field_no >= req->n_fields || predicate->op > SCAN_OP_IS_NOT_NULL) {
+            return false;
+        }
+        ScanFilter filter;
+        filter.predicate = predicate;
+        if (predicate->op != SCAN_OP_IS_NULL && predicate->op != SCAN_OP_IS_NOT_NULL) {
+            auto len = scan_fixed_len(req, predicate->field_no);
+            if (len == 0 || predicate->value.len != len) {
+                return false;
+            }
+            filter.len = len;
+            if (len <= SCAN_INT_COLUMN_LEN) {
+                filter.value = scan_read_int(static_cast<const byte *>(predicate->value.data), len);
+            }
+        }
+        filters->push_back(std::move(filter));
+    }
+    return true;
+}
+
+// 把记录的前n_uniq列拷贝到result->key_buf，作为下一次扫描的start_key
+static void scan_save_key(const RecordInfo &rec_info, uint32_t n_uniq, scan_result *result) {
+    size_t used = 0;
+    for (uint32_t i = 0; i < n_uniq; ++i) {
+        uint32_t len;
+        auto offs = rec_get_nth_field_offs(rec_info, i, &len);
+        result->next_key[i].data = result->key_buf + used;
+        result->next_key[i].len = len;
+        if (len != UNIV_SQL_NULL) {
+            std::memcpy(result->key_buf + used, rec_info.GetRecPtr() + offs, len);
+            used += len;
+        }
+    }
+    result->n_next_key = n_uniq;
+}
+
+/**
+ * 把满足条件的记录交给回调
+ * @param n_done 返回处理完的记录数，回调放不下某一行时是这一行之前的记录数
+ * @return 回调放不下时返回false
+ */
+static bool scan_emit(const std::vector<byte *> &recs, const uint8_t *mask, RecordInfo *rec_info,
+                      const std::vector<uint32_t> &columns, scan_row_callback callback, void *arg, size_t *n_done) {
+    std::vector<scan_value> values(columns.size());
+    for (size_t i = 0; i < recs.size(); ++i) {
+        if (!mask[i]) {
+            continue;
+        }
+        rec_info->SetRecPtr(recs[i]);
+        rec_info->CalculateOffsets(ULINT_UNDEFINED);
+        for (size_t j = 0; j < columns.size(); ++j) {
+            uint32_t len;
+            auto offs = rec_get_nth_field_offs(*rec_info, columns[j], &len);
+            values[j].data = recs[i] + offs;
+            values[j].len = len;
+            values[j].external = len != UNIV_SQL_NULL
+                                 && (rec_info->GetNOffset(REC_OFFS_HEADER_SIZE + columns[j] + 1) & REC_OFFS_EXTERNAL);
+        }
+        if (callback(arg, values.data(), static_cast<uint32_t>(values.size())) != 0) {
+            *n_done = i;
+            return false;
+        }
+    }
+    *n_done = recs.size();
+    return true;
+}
+
+int scan_index(int group, const struct scan_request *req, scan_row_callback callback, void *arg,
+               struct scan_result *result) {
+    result->n_next_key = 0;
+    result->n_pages = 0;
+    result->eof = 0;
+
+    IndexCursor cursor(group, req->space_id, req->root_page_no, req->lsn);
+    if (!cursor.Init(req->field_lens, req->n_fields, req->n_uniq) || req->n_uniq > LOOKUP_MAX_KEY_FIELDS
+        || req->n_start_key > req->n_uniq || req->n_end_key > req->n_uniq) {
+        return IndexCursor::BAD_INDEX;
+    }
+    std::vector<ScanFilter> filters;
+    if (!scan_init_filters(req, &filters)) {
+        return IndexCursor::BAD_INDEX;
+    }
+    std::vector<uint32_t> columns;
+    for (uint32_t i = 0; i < req->n_columns; ++i) {
+        if (req->columns[i] >= req->n_fields) {
+            return IndexCursor::BAD_INDEX;
+        }
+        columns.push_back(req->columns[i]);
+    }
+    for (uint32_t i = 0; columns.empty() && i < req->n_fields; ++i) {
+        columns.push_back(i);
+    }
+
+    // 从start_key开始时定位到小于它的最后一条记录，否则定位到不大于它的最后一条记录
+    int cmp;
+    int rc = cursor.Search(req->start_key, req->n_start_key, req->n_start_key == 0 || req->start_inclusive, &cmp);
+    if (rc != 0) {
+        return rc;
+    }
+
+    RecordInfo rec_info = cursor.RecInfo();
+    std::vector<byte *> recs;
+    std::vector<uint8_t> mask;
+    for (uint32_t n_leaf_pages = 1;; ++n_leaf_pages) {
+        // 取出当前page上剩下的记录和条件用到的列
+        recs.clear();
+        byte *last_rec = nullptr;
+        bool end = false;
+        while ((rc = cursor.Next()) == 0 && !cursor.IsSupremum()) {
+            if (req->n_end_key != 0 && cursor.Compare(req->end_key, req->n_end_key) < 0) {
+                end = true;
+                break;
+            }
+            last_rec = cursor.Rec();
+            if (rec_get_deleted_flag(last_rec)) {
+                continue;
+            }
+            recs.push_back(last_rec);
+            mask.resize(recs.size());
+            mask.back() = 1;
+            for (auto &filter : filters) {
+                if (filter.len <= SCAN_INT32_COLUMN_LEN) {
+                    filter.values32.resize(recs.size());
+                } else if (filter.len <= SCAN_INT_COLUMN_LEN) {
+                    filter.values64.resize(recs.size());
+                }
+                filter.nulls.resize(recs.size());
+            }
+            scan_gather(&filters, cursor.RecInfo(), recs.size() - 1, mask.data());
+        }
+        if (rc != 0) {
+            return rc;
+        }
+
+        for (const auto &filter : filters) {
+            scan_filter(filter, recs.size(), mask.data());
+        }
+        size_t n_done;
+        if (!scan_emit(recs, mask.data(), &rec_info, columns, callback, arg, &n_done)) {
+            // 回调放不下时下一次从放不下的那一行开始，这个page上没有处理完的记录时沿用上一个page保存的key
+            if (n_done > 0) {
+                rec_info.SetRecPtr(recs[n_done - 1]);
+                rec_info.CalculateOffsets(ULINT_UNDEFINED);
+                scan_save_key(rec_info, req->n_uniq, result);
+            }
+            break;
+        }
+        if (last_rec != nullptr) {
+            rec_info.SetRecPtr(last_rec);
+            rec_info.CalculateOffsets(ULINT_UNDEFINED);
+            scan_save_key(rec_info, req->n_uniq, result);
+        }
+        if (end) {
+            result->eof = 1;
+            break;
+        }
+        if (n_leaf_pages >= SCAN_MAX_LEAF_PAGES) {
+            break;
+        }
+        bool last;
+        rc = cursor.NextPage(&last);
+        if (rc != 0) {
+            return rc;
+        }
+        if (last) {
+            result->eof = 1;
+            break;
+        }
+    }
+    result->n_pages = cursor.NPagesRead();
+    return 0;
+}
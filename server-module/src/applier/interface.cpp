@@ -1,13 +1,18 @@
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <fcntl.h>
+#include <unistd.h>
 #include <cerrno>
+#include <future>
 #include "applier/interface.h"
 #include "applier/log_parse.h"
 #include "applier/applier_config.h"
 #include "applier/log_log.h"
 #include "applier/log_apply.h"
-#include "rocksdb/db.h"
+#include "applier/log_recovery.h"
+#include "applier/log_restore.h"
+#include "applier/applier_instance.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -17,66 +22,264 @@ extern "C" {
 }
 #endif
 
-void init_applier_module(void) {
+static struct cleanup_list_element applier_cleanup_element;
 
+static void applier_cleanup(void) {
+    for (auto &applier: appliers) {
+        buffer_pool_dump(&applier->buffer_pool, applier->config.buffer_pool_dump_path.c_str());
+    }
+}
+
+// 调用者已经确认group存在
+static ApplierInstance *applier_of(int group) {
+    auto *applier = get_applier(group);
+    assert(applier != nullptr);
+    return applier;
+}
+
+// 等待log parser解析到isn，不占着CPU自旋
+static void wait_until_parsed(ApplierInstance *applier, size_t isn) {
+    auto &log_group = applier->log_group;
+    if (log_group.parsed_isn >= isn) {
+        return;
+    }
+    PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+    while (log_group.parsed_isn < isn) {
+        pthread_cond_wait(&applier->log_parsed_condition, &applier->log_group_mutex);
+    }
+    PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
+}
 
-    //test rocksdb
-    rocksdb::DB* db;
-    rocksdb::Options options;
-    options.create_if_missing = true;
-    rocksdb::Status status = rocksdb::DB::Open(options,"/home/hkc/testrdb",&db);
-    std::cout<<"create and open db ok, status " <<status.code()<<"\n";
-    std::string test_key1("key1");
-    std::string test_value1("value1");
-    rocksdb::Status s1 = db->Put(rocksdb::WriteOptions(),test_key1,test_value1);
-    std::string test_key2("key2");
-    std::string test_value2("value2");
-    rocksdb::Status s2 = db->Put(rocksdb::WriteOptions(),test_key2,test_value2);
-    std::string test_key3("key3");
-    std::string test_value3("value3");
-    rocksdb::Status s3 = db->Put(rocksdb::WriteOptions(),test_key3,test_value3);
-    if(s1.ok() && s2.ok() && s3.ok()){
-        std::cout<<"Put Key OK \n";
-        std::string saved_val1;
-        rocksdb::Status s = db->Get(rocksdb::ReadOptions(), test_key1, &saved_val1);
-
-        if(s.ok()){
-            std::cout<<"read ok, value is "<<saved_val1<<" \n";
-        }else{
-            std::cout<<"failed. \n";
+static_assert(APPLIER_THREADS_MAX == LOGDB_MAX_APPLIER_THREADS, "APPLIER_THREADS_MAX must match the config block");
+static_assert(ANY_EXPORT == LOGDB_ANY_EXPORT, "ANY_EXPORT must match the config block");
+
+static size_t physical_memory() {
+    return static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// 配置为0时，所有log group一共用APPLIER_THREADS_AUTO_CPU_RATIO的CPU核
+static int logdb_applier_threads(const struct logdb_param *param, uint32_t threads) {
+    if (threads == 0) {
+        threads = param->applier_threads;
+    }
+    if (threads == 0) {
+        auto n_cpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+        threads = static_cast<uint32_t>(n_cpus * APPLIER_THREADS_AUTO_CPU_RATIO / param->n_groups);
+    }
+    return std::clamp(static_cast<int>(threads), 1, APPLIER_THREADS_MAX);
+}
+
+// 配置为0时用物理内存的BUFFER_POOL_AUTO_MEMORY_RATIO，每个log group最少BUFFER_POOL_MIN_PAGES
+static uint32_t logdb_buffer_pool_size(const struct logdb_param *param, uint32_t pages) {
+    if (pages == 0) {
+        pages = static_cast<uint32_t>(std::min<size_t>(physical_memory() * BUFFER_POOL_AUTO_MEMORY_RATIO / DATA_PAGE_SIZE,
+                                                       UINT32_MAX));
+    }
+    return std::max(pages, param->n_groups * BUFFER_POOL_MIN_PAGES);
+}
+
+// 配置为0时，所有log group一共用物理内存的APPLY_INDEX_AUTO_MEMORY_RATIO
+static size_t logdb_apply_index_memory_budget(const struct logdb_param *param, uint64_t budget) {
+    if (budget == 0) {
+        budget = param->apply_index_memory_budget;
+    }
+    if (budget == 0) {
+        budget = static_cast<size_t>(physical_memory() * APPLY_INDEX_AUTO_MEMORY_RATIO / param->n_groups);
+    }
+    return budget;
+}
+
+static std::string logdb_dir(const char *path, const char *fallback, bool trailing_slash) {
+    std::string dir = path != nullptr ? path : fallback;
+    while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+    }
+    if (trailing_slash) {
+        dir += '/';
+    }
+    return dir;
+}
+
+// "sbtest/sbtest1, sbtest/sbtest2"中的每个表名对应数据目录下的一个.ibd文件
+static std::vector<std::string> logdb_change_feed_tables(const std::string &system_file_prefix, const char *tables) {
+    std::vector<std::string> paths;
+    std::string list = tables != nullptr ? tables : "";
+    size_t start = 0;
+    while (start < list.size()) {
+        auto end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
         }
-        std::string saved_val2;
-        rocksdb::Status s4 = db->DeleteRange(rocksdb::WriteOptions(), db->DefaultColumnFamily(),test_key1,test_key3);
-        if(s4.ok()){
-            std::cout<<"delete range ok \n";
-            rocksdb::Status s5 = db->Get(rocksdb::ReadOptions(), test_key2, &saved_val2);
-            if(s5.ok()){
-                std::cout<<"read: "<<saved_val2<<" status " <<s.code()<<"\n";
-            }else{
-                std::cout<<"read no value \n ";
+        auto first = list.find_first_not_of(" \t", start);
+        auto last = list.find_last_not_of(" \t", end - 1);
+        if (first < end && last != std::string::npos && last >= first) {
+            auto name = list.substr(first, last - first + 1);
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".ibd") != 0) {
+                name += ".ibd";
             }
-            
+            paths.push_back(system_file_prefix + name);
         }
+        start = end + 1;
     }
-    db->Close();
+    return paths;
+}
 
-    //end of test rocksdb
+// Log_Group中没有配置的路径和大小使用LOGDB块中的值
+static LogGroupConfig logdb_group_config(const struct logdb_param *param, int group) {
+    const auto &group_param = param->groups[group];
+    auto path = [](const char *value, const char *fallback) -> std::string {
+        return value != nullptr ? value : fallback;
+    };
+    LogGroupConfig config;
+    config.export_id = group_param.export_id;
+    config.log_path_prefix = logdb_dir(group_param.log_path, param->log_path, true);
+    config.system_file_prefix = logdb_dir(group_param.system_file_path, param->system_file_path, true);
+    config.data_file_prefix = logdb_dir(group_param.data_file_path, param->data_file_path, false);
+    config.page_lsn_map_path = path(group_param.page_lsn_map_path, param->page_lsn_map_path);
+    config.apply_index_spill_path = path(group_param.apply_index_spill_path, param->apply_index_spill_path);
+    config.buffer_pool_dump_path = path(group_param.buffer_pool_dump_path, param->buffer_pool_dump_path);
+    config.snapshot_path = logdb_dir(group_param.snapshot_path, param->snapshot_path, false);
+    config.log_file_number = static_cast<int>(group_param.log_file_number != 0 ? group_param.log_file_number
+                                                                                : param->log_file_number);
+    config.apply_batch_size = param->apply_batch_size;
+    config.log_buf_window_size = param->log_buf_window_size;
+    config.applier_threads = logdb_applier_threads(param, group_param.applier_threads);
+    config.buffer_pool_pages = group_param.buffer_pool_pages;
+    config.apply_index_memory_budget = logdb_apply_index_memory_budget(param, group_param.apply_index_memory_budget);
+    config.change_feed_path = logdb_dir(group_param.change_feed_path, param->change_feed_path, false);
+    config.change_feed_tables = logdb_change_feed_tables(config.system_file_prefix,
+                                                         group_param.change_feed_tables != nullptr
+                                                         ? group_param.change_feed_tables
+                                                         : param->change_feed_tables);
+    config.change_feed_max_size = param->change_feed_max_size;
+    config.redo_archive_path = logdb_dir(group_param.redo_archive_path, param->redo_archive_path, false);
+    config.redo_archive_max_size = param->redo_archive_max_size;
+    config.restore_snapshot = group_param.restore_snapshot != nullptr
+                              ? logdb_dir(group_param.restore_snapshot, nullptr, false) : "";
+    config.restore_lsn = group_param.restore_lsn;
+    // 恢复的log group只apply归档，不生成变更流，也不再归档
+    config.redo_archive = param->redo_archive && config.restore_snapshot.empty();
+    if (!config.restore_snapshot.empty()) {
+        config.change_feed_tables.clear();
+    }
+    return config;
+}
 
-    PTHREAD_MUTEX_init(&log_group_mutex, NULL);
-    PTHREAD_COND_init(&log_parse_condition, NULL);
-    PTHREAD_COND_init(&log_apply_condition, NULL);
+// 只有apply线程数、buffer pool和ApplyIndex的上限可以在运行时修改
+static bool logdb_need_restart(const LogGroupConfig &a, const LogGroupConfig &b) {
+    return a.export_id != b.export_id
+           || a.log_path_prefix != b.log_path_prefix
+           || a.system_file_prefix != b.system_file_prefix
+           || a.data_file_prefix != b.data_file_prefix
+           || a.page_lsn_map_path != b.page_lsn_map_path
+           || a.apply_index_spill_path != b.apply_index_spill_path
+           || a.buffer_pool_dump_path != b.buffer_pool_dump_path
+           || a.snapshot_path != b.snapshot_path
+           || a.log_file_number != b.log_file_number
+           || a.apply_batch_size != b.apply_batch_size
+           || a.log_buf_window_size != b.log_buf_window_size
+           || a.change_feed_path != b.change_feed_path
+           || a.change_feed_tables != b.change_feed_tables
+           || a.change_feed_max_size != b.change_feed_max_size
+           || a.redo_archive != b.redo_archive
+           || a.redo_archive_path != b.redo_archive_path
+           || a.redo_archive_max_size != b.redo_archive_max_size
+           || a.restore_snapshot != b.restore_snapshot
+           || a.restore_lsn != b.restore_lsn;
+}
 
+// 两个log group不能共用ib_logfile和存储节点为它保存的状态，恢复的log group不读ib_logfile
+static void logdb_check_group_configs(const std::vector<LogGroupConfig> &configs) {
+    for (size_t i = 0; i < configs.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            const auto &a = configs[i];
+            const auto &b = configs[j];
+            bool follow_logs = a.restore_snapshot.empty() && b.restore_snapshot.empty();
+            if (a.export_id == b.export_id || (follow_logs && a.log_path_prefix == b.log_path_prefix)
+                || (!follow_logs && a.data_file_prefix == b.data_file_prefix)
+                || a.page_lsn_map_path == b.page_lsn_map_path || a.apply_index_spill_path == b.apply_index_spill_path
+                || a.buffer_pool_dump_path == b.buffer_pool_dump_path
+                || (!a.change_feed_tables.empty() && !b.change_feed_tables.empty()
+                    && a.change_feed_path == b.change_feed_path)
+                || (a.redo_archive && b.redo_archive && a.redo_archive_path == b.redo_archive_path)) {
+                LogFatal(COMPONENT_INIT, "LOGDB Log_Group %zu and %zu share an export, a log path or a state file",
+                         j, i);
+            }
+        }
+    }
+}
+
+// 环的大小要按页对齐才能首尾相连地映射，窗口里至少要放得下两批log，否则攒不满一批
+static size_t log_ring_size_of(const LogGroupConfig &config) {
+    if (config.log_buf_window_size < 2 * config.apply_batch_size) {
+        LogFatal(COMPONENT_INIT, "Log_Buf_Window_Size must be at least twice Apply_Batch_Size. "
+                                 "Log_Buf_Window_Size is %zu, but Apply_Batch_Size is %zu",
+                 config.log_buf_window_size, config.apply_batch_size);
+    }
+    auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (config.log_buf_window_size + page_size - 1) / page_size * page_size;
+}
+
+// 恢复快照的log group没有ib_logfile，log buf只由log_restore写入
+static void init_restore_group(ApplierInstance *applier) {
+    auto &log_group = applier->log_group;
+    const auto &config = applier->config;
+
+    // 快照中的文件要在加载表空间之前拷贝到数据目录
+    bool need_replay = false;
+    auto start_lsn = log_restore_prepare(applier, &need_replay);
+    applier->apply_index.OpenSpillStore(config.apply_index_spill_path);
+    applier->page_lsn_map.Open(config.page_lsn_map_path);
+    applier->buffer_pool.LoadTablespaces();
+
+    log_group.log_file_number = 0;
+    log_group.batch_size = config.apply_batch_size;
+    log_group.log_ring_size = log_ring_size_of(config);
+    log_group.log_buf = log_ring_map(log_group.log_ring_size);
+    if (log_group.log_buf == nullptr) {
+        LogFatal(COMPONENT_INIT, "start nfs-ganesha failed, malloc failed %s", strerror(errno));
+    }
+    log_group.log_buf_size = log_group.log_ring_size;
+    log_group.written_capacity = log_group.log_ring_size;
+    log_group.checkpoint_lsn = start_lsn;
+
+    log_parse_thread_start(applier);
+    log_apply_thread_start(applier);
+    if (need_replay) {
+        LogEvent(COMPONENT_INIT, "log group %d restoring snapshot %s from lsn %" PRIu64 " to %s",
+                 applier->group_no, config.restore_snapshot.c_str(), start_lsn,
+                 config.restore_lsn != 0 ? std::to_string(config.restore_lsn).c_str() : "the end of redo archive");
+        log_restore(applier, start_lsn);
+    }
+    buffer_pool_load_start(&applier->buffer_pool, config.buffer_pool_dump_path.c_str());
+}
+
+// 打开一个log group的ib_logfile，找到checkpoint，启动它的log parser和log applier，需要时做崩溃恢复
+static void init_log_group(ApplierInstance *applier) {
+    auto &log_group = applier->log_group;
+    const auto &config = applier->config;
+    if (!config.restore_snapshot.empty()) {
+        init_restore_group(applier);
+        return;
+    }
+
+    // ApplyIndex超出内存上限时把冷的log链溢出到这里
+    applier->apply_index.OpenSpillStore(config.apply_index_spill_path);
+    // 恢复之前先加载，已经落盘的log链可以直接跳过
+    applier->page_lsn_map.Open(config.page_lsn_map_path);
+    // 解析log之前建立表空间目录，之后的变化由MLOG_FILE_*维护
+    applier->buffer_pool.LoadTablespaces();
 
     std::vector<int> fds;
     // init log group
-    log_group.log_file_number = LOG_FILE_NUMBER;
+    log_group.log_file_number = config.log_file_number;
     for (int i = 0; i < log_group.log_file_number; ++i) {
         std::string filename;
         filename += LOG_FILES_BASE_NAME;
         filename += std::to_string(i);
         log_group.log_filenames.push_back(filename);
         log_group.file_handles.push_back(nullptr);
-        std::string full_path = LOG_PATH_PREFIX;
+        std::string full_path = config.log_path_prefix;
         full_path += filename;
         log_group.log_file_full_paths.push_back(full_path);
         int fd = open(full_path.c_str(), O_RDONLY);
@@ -89,13 +292,13 @@ void init_applier_module(void) {
         assert(log_group.per_file_size == lseek(fd, 0, SEEK_END));// 保证所有的log file是一样大小的
     }
 
-    log_group.batch_size = APPLY_BATCH_SIZE;
+    log_group.batch_size = config.apply_batch_size;
 
     // APPLY_BATCH_SIZE必须能被log_group.per_file_size整除
     if (log_group.per_file_size % log_group.batch_size != 0) {
-        LogFatal(COMPONENT_INIT, "APPLY_BATCH_SIZE must be divisible by log per file size. "
-                                 "APPLY_BATCH_SIZE is %zu, but log per file size is %zu",
-                                 APPLY_BATCH_SIZE, log_group.per_file_size);
+        LogFatal(COMPONENT_INIT, "Apply_Batch_Size must be divisible by log per file size. "
+                                 "Apply_Batch_Size is %zu, but log per file size is %zu",
+                                 log_group.batch_size, log_group.per_file_size);
     }
     // init apply_pointer
     log_group.checkpoint_no = 0;
@@ -108,6 +311,7 @@ void init_applier_module(void) {
     log_group.applied_offset = 0;
     log_group.need_to_parse = 0;
     log_group.written_isn = 0;
+    log_group.filled_isn = 0;
     log_group.parsed_isn = 0;
     log_group.applied_isn = 0;
     log_group.log_buf = nullptr;
@@ -120,7 +324,9 @@ void init_applier_module(void) {
     auto log_blocks = log_group.per_file_size / LOG_BLOCK_SIZE - N_LOG_METADATA_BLOCKS;
     log_group.log_buf_size_per_file = log_data_per_block * log_blocks;
     log_group.log_buf_size = (sizeof(unsigned char) * log_group.log_buf_size_per_file * log_group.log_file_number);
-    log_group.log_buf = (unsigned char *) malloc(log_group.log_buf_size);
+    // 窗口的大小和ib_logfile的大小无关，超出的部分溢出到ib_logfile
+    log_group.log_ring_size = log_ring_size_of(config);
+    log_group.log_buf = log_ring_map(log_group.log_ring_size);
 
     log_group.log_meta_buf = nullptr;
     log_group.log_meta_buf_size = N_LOG_METADATA_BLOCKS * LOG_BLOCK_SIZE;
@@ -147,8 +353,8 @@ void init_applier_module(void) {
                         &checkpoint_no,
                         &checkpoint_offset);
 
-    LogEvent(COMPONENT_INIT, "checkpoint_no %zu, checkpoint_offset %zu, checkpoint_lsn %zu",
-             checkpoint_no, checkpoint_offset, checkpoint_lsn);
+    LogEvent(COMPONENT_INIT, "log group %d checkpoint_no %zu, checkpoint_offset %zu, checkpoint_lsn %zu",
+             applier->group_no, checkpoint_no, checkpoint_offset, checkpoint_lsn);
     log_group.checkpoint_lsn = checkpoint_lsn;
     log_group.checkpoint_no = checkpoint_no;
     log_group.checkpoint_offset = checkpoint_offset;
@@ -171,33 +377,166 @@ void init_applier_module(void) {
 
     auto data_len = mach_read_from_2(log_block_buf + LOG_BLOCK_HDR_DATA_LEN);
 
+    // 在log file 中有尚未被恢复的log，启动log parser和log applier之后自己恢复
+    bool need_recovery = (off_in_block != data_len);
+
+    log_group.written_offset = log_group.parsed_offset = log_group_off_to_log_buf_off(log_group, checkpoint_offset);
+    log_group.need_to_parse = 0;
+    // 还没有apply的log不能被覆盖
+    log_group.written_capacity = log_group.log_ring_size;
+
+    // log file保持打开，log parser要从中读回溢出的log
+    log_group.log_fds = fds;
 
 
+    // 在log parser之前登记read view，feed线程要读到checkpoint之后每一条log之前的page
+    applier->change_feed.Start(applier);
+    applier->redo_archive.Start(applier);
+    log_parse_thread_start(applier);
+    log_apply_thread_start(applier);
 
-    if (off_in_block != data_len) {
-        //off_in_block = data_len; //hkc-debug
-        // 在log file 中有尚未被恢复的log
-        LogFatal(COMPONENT_INIT, "start nfs-ganesha failed, there are logs that have not been recovered in log file");
+    if (need_recovery) {
+        LogEvent(COMPONENT_INIT, "log group %d has logs after checkpoint lsn %zu, start recovery",
+                 applier->group_no, checkpoint_lsn);
+        log_recovery(applier, fds);
+        applier->page_lsn_map.Checkpoint(&applier->buffer_pool);
     }
 
-    log_group.written_offset = log_group.parsed_offset = log_group_off_to_log_buf_off(checkpoint_offset);
-    log_group.need_to_parse = 0;
-    log_group.written_capacity = log_group.log_buf_size;
+    // 重启之后buffer pool是空的，在后台把上次dump的page读回来，同时已经可以接收请求
+    buffer_pool_load_start(&applier->buffer_pool, config.buffer_pool_dump_path.c_str());
+}
 
-    log_group.written_capacity = log_group.log_file_number * log_group.per_file_size;
+// apply policy的阈值只能从配置中修改
+static void logdb_set_apply_policy(const struct logdb_param *param) {
+    set_apply_policy(param->apply_policy);
+    apply_hybrid_chain_logs = param->apply_hybrid_chain_logs;
+    apply_hybrid_chain_bytes = param->apply_hybrid_chain_bytes;
+    apply_lazy_memory_percent = param->apply_lazy_memory_percent;
+    LogEvent(COMPONENT_CONFIG, "apply policy %u, hybrid chains of %u logs or %" PRIu64 " bytes, "
+             "lazy apply index memory %u%%", param->apply_policy, param->apply_hybrid_chain_logs,
+             param->apply_hybrid_chain_bytes, param->apply_lazy_memory_percent);
+}
 
-    for (int i = 0; i < log_group.log_file_number; ++i) {
-        // 关闭 log file
-        res = close(fds[i]);
-        assert(res == 0);
+void init_applier_module(void) {
+    logdb_set_apply_policy(&logdb_param);
+    std::vector<LogGroupConfig> configs;
+    for (uint32_t i = 0; i < logdb_param.n_groups; ++i) {
+        configs.push_back(logdb_group_config(&logdb_param, static_cast<int>(i)));
+    }
+    logdb_check_group_configs(configs);
+    // log group从共享的frame中分配buffer pool，先定下总数
+    buffer_pool_set_total_frames(logdb_buffer_pool_size(&logdb_param, logdb_param.buffer_pool_size));
+    for (const auto &config: configs) {
+        LogEvent(COMPONENT_INIT, "log group %zu: export %u, log path %s, %d apply threads, "
+                 "apply index memory budget %zu", appliers.size(), config.export_id, config.log_path_prefix.c_str(),
+                 config.applier_threads, config.apply_index_memory_budget);
+        appliers.push_back(std::make_unique<ApplierInstance>(static_cast<int>(appliers.size()), config));
+    }
+    // log group之间没有依赖，各自恢复
+    std::vector<std::future<void>> inits;
+    for (auto &applier: appliers) {
+        inits.push_back(std::async(std::launch::async, init_log_group, applier.get()));
+    }
+    for (auto &init: inits) {
+        init.wait();
+    }
+    LogEvent(COMPONENT_INIT, "started %zu log groups", appliers.size());
+
+    page_lsn_map_thread_start();
+    page_version_purge_thread_start();
+    buffer_pool_dump_thread_start();
+    applier_cleanup_element.clean = applier_cleanup;
+    RegisterCleanup(&applier_cleanup_element);
+}
+
+void update_applier_param(const struct logdb_param *param) {
+    if (param->n_groups != appliers.size()) {
+        LogWarn(COMPONENT_CONFIG, "LOGDB has %u log groups, %zu are running, restart to add or remove log groups",
+                param->n_groups, appliers.size());
+    }
+    set_buffer_pool_size(param->buffer_pool_size);
+    logdb_set_apply_policy(param);
+    for (size_t i = 0; i < std::min<size_t>(param->n_groups, appliers.size()); ++i) {
+        auto *applier = appliers[i].get();
+        auto config = logdb_group_config(param, static_cast<int>(i));
+        if (logdb_need_restart(config, applier->config)) {
+            LogWarn(COMPONENT_CONFIG, "LOGDB log group %zu changed paths, export, log files, batch size, "
+                    "change feed, redo archive or restore, restart to apply them", i);
+        }
+        applier->applier_threads = config.applier_threads;
+        applier->buffer_pool.Resize(config.buffer_pool_pages);
+        applier->apply_index.SetMemoryBudget(config.apply_index_memory_budget);
+        LogEvent(COMPONENT_CONFIG, "log group %zu: %d apply threads, buffer pool %u frames, "
+                 "apply index memory budget %zu", i, config.applier_threads, applier->buffer_pool.Capacity(),
+                 config.apply_index_memory_budget);
+    }
+}
+
+int set_applier_threads(int group, uint32_t threads) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr) {
+        return -1;
     }
+    applier->applier_threads = std::clamp(static_cast<int>(threads), 1, APPLIER_THREADS_MAX);
+    return 0;
+}
+
+int set_log_group_buffer_pool(int group, uint32_t pages) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr) {
+        return -1;
+    }
+    applier->buffer_pool.Resize(pages);
+    return 0;
+}
 
+void set_buffer_pool_size(uint32_t pages) {
+    buffer_pool_set_total_frames(logdb_buffer_pool_size(&logdb_param, pages));
+}
+
+int set_apply_policy(uint32_t policy) {
+    switch (policy) {
+        case LOGDB_APPLY_EAGER:
+        case LOGDB_APPLY_LAZY:
+        case LOGDB_APPLY_HYBRID:
+            apply_policy = static_cast<ApplyPolicy>(policy);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int get_export_log_group(uint16_t export_id) {
+    int any = -1;
+    for (const auto &applier: appliers) {
+        if (applier->config.export_id == export_id) {
+            return applier->group_no;
+        }
+        if (applier->config.export_id == ANY_EXPORT && any < 0) {
+            any = applier->group_no;
+        }
+    }
+    return any;
+}
+
+int get_log_group_export(int group) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr) {
+        return -1;
+    }
+    return applier->config.export_id;
+}
 
-    log_parse_thread_start();
-    log_apply_thread_start(APPLIER_THREAD);
+int get_log_group_number(void) {
+    return static_cast<int>(appliers.size());
 }
 
-int is_log_file_in_name(const char *filename) {
+int is_log_file_in_name(int group, const char *filename) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr) {
+        return -1;
+    }
+    auto &log_group = applier->log_group;
     assert(log_group.log_file_number == log_group.log_filenames.size());
     for (int i = 0; i < log_group.log_file_number; ++i) {
         if (log_group.log_filenames[i] == filename) {
@@ -207,10 +546,16 @@ int is_log_file_in_name(const char *filename) {
 
     return -1;
 }
-int is_ibd_file_in_name(const char *filename) {
-    return DataPageGroup::Get().Exist(filename);
+int is_ibd_file_in_name(int group, const char *filename) {
+    auto *applier = get_applier(group);
+    return applier == nullptr ? -1 : applier->data_page_group.Exist(filename);
 }
-int is_log_file_in_handle(const struct fsal_obj_handle *handle) {
+int is_log_file_in_handle(int group, const struct fsal_obj_handle *handle) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr) {
+        return -1;
+    }
+    auto &log_group = applier->log_group;
     assert(log_group.log_file_number == log_group.log_filenames.size());
     for (int i = 0; i < log_group.log_file_number; ++i) {
         if (log_group.file_handles[i] == handle) {
@@ -220,23 +565,25 @@ int is_log_file_in_handle(const struct fsal_obj_handle *handle) {
 
     return -1;
 }
-int is_ibd_file_in_handle(const struct fsal_obj_handle *handle) {
-    return DataPageGroup::Get().Exist(handle);
+int is_ibd_file_in_handle(int group, const struct fsal_obj_handle *handle) {
+    auto *applier = get_applier(group);
+    return applier == nullptr ? -1 : applier->data_page_group.Exist(handle);
 }
-void register_log_file_handle(int index, struct fsal_obj_handle *handle) {
+void register_log_file_handle(int group, int index, struct fsal_obj_handle *handle) {
+    auto &log_group = applier_of(group)->log_group;
     assert(0 <= index && index < log_group.log_file_number);
     log_group.file_handles[index] = handle;
 }
-void register_ibd_file_handle(struct fsal_obj_handle *handle, int space_id) {
-    DataPageGroup::Get().Insert(handle, space_id);
+void register_ibd_file_handle(int group, struct fsal_obj_handle *handle, int space_id) {
+    applier_of(group)->data_page_group.Insert(handle, space_id);
 }
-const auto copy_buf_size = 8 << 10 << 10; // 8M
-unsigned char* const copy_buf = new unsigned char[copy_buf_size] ;
 
-pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-void copy_log_to_buf(int log_file_index, size_t offset, struct iovec iov[], int iov_count) {
-    PthreadMutexGuard guard(log_writer_mutex);
+void copy_log_to_buf(int group, int log_file_index, size_t offset, struct iovec iov[], int iov_count) {
+    auto *applier = applier_of(group);
+    auto &log_group = applier->log_group;
+    auto &log_group_mutex = applier->log_group_mutex;
+    auto *copy_buf = applier->copy_buf.get();
+    PthreadMutexGuard guard(applier->log_writer_mutex);
     //hkc-debug-opoint-2
     assert(offset % LOG_BLOCK_SIZE == 0); // offset必须是block对齐的
 
@@ -244,7 +591,7 @@ void copy_log_to_buf(int log_file_index, size_t offset, struct iovec iov[], int
     size_t total_len = 0;
     auto *dest_buf = copy_buf;
     for (int i = 0; i < iov_count; ++i) {
-        assert(total_len + iov[i].iov_len <= copy_buf_size); // 一次log write不能写超过8M
+        assert(total_len + iov[i].iov_len <= ApplierInstance::COPY_BUF_SIZE); // 一次log write不能写超过8M
         std::memcpy(dest_buf, iov[i].iov_base, iov[i].iov_len);
         total_len += iov[i].iov_len;
         dest_buf += iov[i].iov_len;
@@ -274,123 +621,174 @@ void copy_log_to_buf(int log_file_index, size_t offset, struct iovec iov[], int
 //    auto actual_len = write_end - write_start + 1;
 
     auto blocks = total_len / LOG_BLOCK_SIZE;
-    size_t actual_len = 0; // 掐头去尾之后，真正需要写log buf中的长度
     size_t log_group_offset = log_file_index * log_group.per_file_size + offset;
-    for (auto [buf, i] = std::pair<unsigned char *, int>(dest_buf, 0);
-            i < blocks;
-            ++i, buf += LOG_BLOCK_SIZE) {
-        auto data_len = mach_read_from_2(buf + LOG_BLOCK_HDR_DATA_LEN);
-        if (data_len == 0) {
-            break;
-        }
-        // FIXME 切换日志的时候，会写meta block，一次io是4k为单位，meta block是2k，为什么meta block之后的block的data_len是0？
-        assert(data_len >= LOG_BLOCK_HDR_SIZE);
-        assert(data_len == 512 || data_len < LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE);
-
-        data_len = (data_len == LOG_BLOCK_SIZE ? data_len - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE : data_len - LOG_BLOCK_HDR_SIZE);
-        auto log_buf_offset_start = log_group_off_to_log_buf_off(log_group_offset + LOG_BLOCK_HDR_SIZE);
-        auto log_buf_offset_end = log_buf_offset_start + data_len;
-        if (log_buf_offset_end > log_group.written_offset) {
-            actual_len += log_buf_offset_end - std::max(log_group.written_offset, log_buf_offset_start);
-            assert(actual_len >= 0);
-        }
-        log_group_offset += LOG_BLOCK_SIZE;
-
-        if (data_len != LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE) {
-            break;
-        }
+    size_t n_used = 0;
+    // 掐头去尾之后，真正需要写log buf中的长度
+    size_t actual_len = strip_log_blocks(log_group, dest_buf, blocks, log_group_offset, log_group.written_offset,
+                                         nullptr, SIZE_MAX, &n_used);
+    if (actual_len == 0) {
+        return;
+    }
+    assert((log_group.written_offset + actual_len) <= log_group.log_buf_size); // 每次log writer写不会出现跨文件的情况
+
+    // 窗口快满的时候按使用比例延迟log writer，让apply有机会追上来，而不是等到满了再完全停住
+    PTHREAD_MUTEX_lock(&log_group_mutex);
+    auto used = log_group.log_ring_size - log_group.written_capacity;
+    PTHREAD_MUTEX_unlock(&log_group_mutex);
+    auto high_water = static_cast<size_t>(log_group.log_ring_size * LOG_BUF_BACKPRESSURE_RATIO);
+    if (used > high_water) {
+        auto delay = LOG_BUF_BACKPRESSURE_MAX_DELAY_US * (used - high_water) / (log_group.log_ring_size - high_water);
+        usleep(static_cast<useconds_t>(delay));
     }
 
-    if (actual_len > 0) {
-        assert((log_group.written_offset + actual_len) <= log_group.log_buf_size); // 每次log writer写不会出现跨文件的情况
-        // 等待log buffer有足够的空间
-        PTHREAD_MUTEX_lock(&log_group_mutex);
-        while (log_group.written_capacity < actual_len) {
-            LogEvent(COMPONENT_FSAL, "log writer waiting for a enough space\n");
-            pthread_cond_wait(&log_write_condition, &log_group_mutex);
-        }
-        PTHREAD_MUTEX_unlock(&log_group_mutex);
-
-//    auto start_ptr = log_group.log_buf + log_group.written_offset;
-//    auto end_ptr = start_ptr + actual_len;
-        // 把掐头去尾之后的日志拷贝到log buf
-        log_group_offset = log_file_index * log_group.per_file_size + offset;
-        for (auto [buf, i] = std::pair<unsigned char *, int>(dest_buf, 0);
-             i < blocks;
-             ++i, buf += LOG_BLOCK_SIZE) {
-            auto data_len = mach_read_from_2(buf + LOG_BLOCK_HDR_DATA_LEN);
-
-            assert(data_len >= LOG_BLOCK_HDR_SIZE);
-            assert(data_len == 512 || data_len < LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE);
-
-            data_len = (data_len == LOG_BLOCK_SIZE ? data_len - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE : data_len - LOG_BLOCK_HDR_SIZE);
-            auto log_buf_offset_start = log_group_off_to_log_buf_off(log_group_offset + LOG_BLOCK_HDR_SIZE);
-            auto log_buf_offset_end = log_buf_offset_start + data_len;
-            if (log_buf_offset_end > log_group.written_offset) {
-                assert(log_buf_offset_start <= log_group.written_offset); // 写log必须是挨个写，不能出现空洞
-                auto actual_data_len = log_buf_offset_end - std::max(log_group.written_offset, log_buf_offset_start);
-                auto actual_start_buf = buf + LOG_BLOCK_HDR_SIZE + data_len - actual_data_len;
-                std::memcpy(log_group.log_buf + log_group.written_offset, actual_start_buf, actual_data_len);
-
-                log_group.written_offset = (log_group.written_offset + actual_data_len) % log_group.log_buf_size;
-            }
-            log_group_offset += LOG_BLOCK_SIZE;
-            if (data_len != LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE) {
-                break;
-            }
+    PTHREAD_MUTEX_lock(&log_group_mutex);
+    if (log_group.filled_isn != log_group.written_isn || log_group.written_capacity < actual_len) {
+        // 窗口满了，或者前面还有没读回的log：不拷贝，记下位置，之后由log parser从ib_logfile读回
+        if (log_group.spilled_logs.empty()) {
+            LogEvent(COMPONENT_FSAL, "log buf window is full, spilling log at written isn %zu",
+                     log_group.written_isn.load());
         }
-
-//    while (start_ptr < end_ptr) {
-//        LOG_TYPE type;
-//        space_id_t space_id;
-//        page_id_t page_id;
-//        byte *body;
-//        auto len = ParseSingleLogRecord(type, start_ptr, end_ptr, space_id, page_id, &body);
-//        assert(len != 0);
-//        start_ptr += len;
-//        LogEvent(COMPONENT_FSAL, "%s", GetLogString(type));
-//    }
-
-        // 更新log group的状态
-        PTHREAD_MUTEX_lock(&log_group_mutex);
-        log_group.written_capacity -= actual_len;
-        log_group.need_to_parse += actual_len;
+        log_group.spilled_logs.push_back({log_file_index, offset, n_used,
+                                          log_group.written_offset, actual_len,
+                                          mach_read_from_4(dest_buf + LOG_BLOCK_HDR_NO) & ~LOG_BLOCK_FLUSH_BIT_MASK});
+        log_group.written_offset = (log_group.written_offset + actual_len) % log_group.log_buf_size;
         log_group.written_isn += actual_len;
-        pthread_cond_signal(&log_parse_condition);
+        pthread_cond_signal(&applier->log_parse_condition);
         PTHREAD_MUTEX_unlock(&log_group_mutex);
+        return;
     }
+    PTHREAD_MUTEX_unlock(&log_group_mutex);
+
+    // 把掐头去尾之后的日志拷贝到log buf，环是首尾相连映射的，写过环尾也不用拆开
+    auto *ring_ptr = log_group.log_buf + log_group.written_isn % log_group.log_ring_size;
+    strip_log_blocks(log_group, dest_buf, blocks, log_group_offset, log_group.written_offset, ring_ptr, actual_len, nullptr);
+    log_group.written_offset = (log_group.written_offset + actual_len) % log_group.log_buf_size;
+
+    // 更新log group的状态
+    PTHREAD_MUTEX_lock(&log_group_mutex);
+    log_group.written_capacity -= actual_len;
+    log_group.need_to_parse += actual_len;
+    log_group.written_isn += actual_len;
+    log_group.filled_isn += actual_len;
+    pthread_cond_signal(&applier->log_parse_condition);
+    PTHREAD_MUTEX_unlock(&log_group_mutex);
 }
 
-void wait_until_apply_done(int space_id, uint64_t offset, size_t io_amount) {
-    assert(offset % DATA_PAGE_SIZE == 0);
-    assert(io_amount % DATA_PAGE_SIZE == 0);
-    page_id_t start_page_id = offset / DATA_PAGE_SIZE;
-    page_id_t end_page_id = start_page_id + io_amount / DATA_PAGE_SIZE;
+void wait_until_apply_done(int group, int space_id, uint64_t offset, size_t io_amount) {
+    auto *applier = applier_of(group);
+    auto &log_group = applier->log_group;
+    auto &apply_index = applier->apply_index;
+    auto page_size = applier->buffer_pool.GetPageSize(space_id);
+    assert(offset % page_size == 0);
+    assert(io_amount % page_size == 0);
+    page_id_t start_page_id = offset / page_size;
+    page_id_t end_page_id = start_page_id + io_amount / page_size;
     auto current_written_isn = log_group.written_isn.load();
 
+    std::vector<PageAddress> pages;
     for (page_id_t page_id = start_page_id; page_id < end_page_id; page_id++) {
-        PageAddress page_address(space_id, page_id);
-        // 自旋等待log parser解析到当前已经写入的最大isn
-//        LogEvent(COMPONENT_FSAL, "data page reader start reading space id = %d, page_id = %u", space_id, page_id);
-        while (log_group.parsed_isn < current_written_isn);
+        pages.emplace_back(space_id, page_id);
+    }
+    // 从这里开始log apply worker不会再拿走这些page，由当前线程自己apply
+    apply_index.BeginRead(pages);
 
+    // 等待log parser解析到当前已经写入的最大isn
+    wait_until_parsed(applier, current_written_isn);
+    for (const auto &page_address: pages) {
 //     主动提取相关的log进行apply
 //        LogEvent(COMPONENT_FSAL, "data page reader start applying space id = %d, page_id = %u", space_id, page_id);
-        auto log_vector = apply_index.Search(page_address);
-//        int count = 0;
-        for (const auto &item: log_vector) {
-            log_apply_do_apply(page_address, item.get());
-//            count += item.get()->size();
-        }
-//        if (count > 0) {
-//            LogEvent(COMPONENT_FSAL, "data page reader end applying space id = %d, page_id = %u, applied %d logs", space_id, page_id, count);
-//        }
+        log_apply_read_page(applier, page_address);
     }
+    apply_index.EndRead(pages);
 }
 
-void copy_page_to_buf(char *dest_buf, space_id_t space_id, page_id_t start_page_id, int n_pages) {
+void copy_page_to_buf(int group, char *dest_buf, space_id_t space_id, page_id_t start_page_id, int n_pages) {
+    auto &buffer_pool = applier_of(group)->buffer_pool;
+    auto page_size = buffer_pool.GetPageSize(space_id);
     for (int i = 0; i < n_pages; ++i) {
-        buffer_pool.CopyPage(dest_buf + (i * DATA_PAGE_SIZE), space_id, start_page_id + i);
+        buffer_pool.CopyPage(dest_buf + (i * page_size), space_id, start_page_id + i);
+    }
+
+}
+
+uint32_t get_space_page_size(int group, uint32_t space_id) {
+    return applier_of(group)->buffer_pool.GetPageSize(space_id);
+}
+
+int is_space_regenerated(int group, uint32_t space_id) {
+    return applier_of(group)->data_page_group.Exist(space_id) ? 1 : 0;
+}
+
+uint64_t wait_until_parse_done(int group) {
+    auto *applier = applier_of(group);
+    wait_until_parsed(applier, applier->log_group.written_isn.load());
+    return applier->log_parser.parsed_lsn;
+}
+
+int apply_and_copy_page(int group, char *dest_buf, uint32_t space_id, uint32_t page_id) {
+    auto *applier = applier_of(group);
+    if (!applier->data_page_group.Exist(space_id)) {
+        return -1;
+    }
+    PageAddress page_address(space_id, page_id);
+    log_apply_read_page(applier, page_address);
+
+    // 没有log的page也可能在磁盘上不存在
+    Page *page = applier->buffer_pool.GetPage(space_id, page_id);
+    if (page == nullptr) {
+        return -1;
+    }
+    std::memcpy(dest_buf, page->GetData(), page->GetPhysicalSize());
+    BufferPool::ReleasePage(page);
+    return 0;
+}
+
+int apply_and_copy_page_as_of(int group, char *dest_buf, uint32_t space_id, uint32_t page_id, uint64_t lsn) {
+    auto *applier = applier_of(group);
+    if (!applier->data_page_group.Exist(space_id)) {
+        return -1;
+    }
+    // 先把已经解析的log全部apply，apply时会保留read view需要的镜像
+    PageAddress page_address(space_id, page_id);
+    log_apply_read_page(applier, page_address);
+
+    Page *page = applier->buffer_pool.GetPage(space_id, page_id);
+    if (page == nullptr) {
+        return -1;
+    }
+    auto res = applier->page_version_store.Read(page_address, *page, lsn, reinterpret_cast<byte *>(dest_buf));
+    if (res == PageVersionStore::ReadResult::CURRENT) {
+        std::memcpy(dest_buf, page->GetData(), page->GetPhysicalSize());
+    }
+    BufferPool::ReleasePage(page);
+    return res == PageVersionStore::ReadResult::TOO_OLD ? -2 : 0;
+}
+
+uint64_t register_read_view(int group, uint64_t lsn) {
+    return applier_of(group)->page_version_store.RegisterView(lsn);
+}
+
+int update_read_view(int group, uint64_t view_id, uint64_t lsn) {
+    return applier_of(group)->page_version_store.UpdateView(view_id, lsn) ? 0 : -1;
+}
+
+void release_read_view(int group, uint64_t view_id) {
+    applier_of(group)->page_version_store.ReleaseView(view_id);
+}
+
+uint64_t get_space_lsn(int group, uint32_t space_id) {
+    return applier_of(group)->apply_index.SpaceLsn(space_id);
+}
+
+uint64_t push_flush_hints(int group, const struct page_flush_hint *hints, int n_hints) {
+    std::vector<FlushHint> batch;
+    batch.reserve(n_hints);
+    for (int i = 0; i < n_hints; ++i) {
+        batch.push_back({hints[i].space_id, hints[i].page_id, hints[i].lsn});
     }
+    return applier_of(group)->flush_hint_queue.Push(batch);
+}
 
+void wait_flush_hints_done(int group, uint64_t seq) {
+    applier_of(group)->flush_hint_queue.WaitDone(seq);
 }
\ No newline at end of file
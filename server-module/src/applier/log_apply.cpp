@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <unordered_set>
 #include "applier/log_apply.h"
 #include "applier/log_log.h"
 #include "applier/utility.h"
 #include "applier/buffer_pool.h"
 #include "applier/log_parse.h"
 #include "applier/interface.h"
+#include "applier/applier_instance.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,15 +20,25 @@ extern "C" {
 }
 #endif
 
+static_assert(static_cast<int>(ApplyPolicy::EAGER) == LOGDB_APPLY_EAGER
+              && static_cast<int>(ApplyPolicy::LAZY) == LOGDB_APPLY_LAZY
+              && static_cast<int>(ApplyPolicy::HYBRID) == LOGDB_APPLY_HYBRID,
+              "ApplyPolicy must match the config block");
+
+std::atomic<ApplyPolicy> apply_policy {APPLY_POLICY};
+std::atomic<uint32_t> apply_hybrid_chain_logs {APPLY_HYBRID_CHAIN_LOGS};
+std::atomic<size_t> apply_hybrid_chain_bytes {APPLY_HYBRID_CHAIN_BYTES};
+std::atomic<uint32_t> apply_lazy_memory_percent {APPLY_LAZY_MEMORY_PERCENT};
+
 // 检查是不是所有的log_applier都是空闲的
-static bool log_apply_all_idle() {
+static bool log_apply_all_idle(const std::vector<log_applier_t> &log_appliers) {
     return std::all_of(log_appliers.cbegin(), log_appliers.cend(), [](const auto &log_applier) -> bool {
         return log_applier.is_running == false;
     });
 }
 
 // 从index上摘下task请求，并且等待所有log worker变成空闲状态
-static std::vector<PageAddress> log_apply_scheduler_acquire(size_t *total_log_len) {
+static std::vector<PageAddress> log_apply_scheduler_acquire(ApplierInstance *applier, size_t *total_log_len) {
 //    PTHREAD_MUTEX_lock(&log_apply_task_mutex);
 //    while (apply_task_requests.empty()) {
 //        pthread_cond_wait(&log_apply_condition, &log_apply_task_mutex);
@@ -33,12 +48,54 @@ static std::vector<PageAddress> log_apply_scheduler_acquire(size_t *total_log_le
 //    PTHREAD_MUTEX_unlock(&log_apply_task_mutex);
 
     // 自旋等待所有log apply worker变成空闲状态
-    while (!log_apply_all_idle());
+    while (!log_apply_all_idle(applier->log_appliers));
+
+    return applier->apply_index.ExtractFrontHint(total_log_len);
+}
+
+std::vector<PageAddress> log_apply_policy_filter(ApplyIndex &apply_index, std::vector<PageAddress> pages,
+                                                 std::vector<PageAddress> *drain) {
+    auto policy = apply_policy.load();
+    auto memory_limit = static_cast<size_t>(apply_index.MemoryBudget() / 100 * apply_lazy_memory_percent.load());
+    // 切回EAGER，或者ApplyIndex内存紧张的时候，把推迟的page也apply掉
+    if (policy == ApplyPolicy::EAGER || apply_index.MemoryUsage() > memory_limit) {
+        *drain = apply_index.DeferredPages(APPLY_LAZY_DRAIN_PAGES);
+        return pages;
+    }
+
+    std::vector<PageAddress> res;
+    std::vector<PageAddress> deferred;
+    if (policy == ApplyPolicy::HYBRID) {
+        // log链很长的page读的时候apply代价太大，还是提前apply
+        auto stats = apply_index.ChainStats(pages);
+        auto chain_logs = apply_hybrid_chain_logs.load();
+        auto chain_bytes = apply_hybrid_chain_bytes.load();
+        for (size_t i = 0; i < pages.size(); ++i) {
+            if (stats[i].n_logs >= chain_logs || stats[i].log_bytes >= chain_bytes) {
+                res.push_back(pages[i]);
+            } else {
+                deferred.push_back(pages[i]);
+            }
+        }
+    } else {
+        deferred = std::move(pages);
+    }
+    apply_index.DeferFront(deferred);
+    return res;
+}
 
-    return apply_index.ExtractFrontHint(total_log_len);
+// 有data page reader正在apply page时让出CPU，最多等APPLY_READER_YIELD_US
+static void log_apply_yield_to_readers(ApplyIndex &apply_index) {
+    if (apply_index.ActiveReaders() == 0) {
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(APPLY_READER_YIELD_US);
+    while (apply_index.ActiveReaders() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
 }
 
-static bool log_apply_apply_one_log(Page *page, const LogEntry &log) {
+bool log_apply_apply_one_log(Page *page, const LogEntry &log) {
     byte *ret;
     switch (log.type_) {
         case MLOG_1BYTE:
@@ -78,20 +135,52 @@ static bool log_apply_apply_one_log(Page *page, const LogEntry &log) {
             return ApplyCompListDelete(log, page);
         case MLOG_IBUF_BITMAP_INIT:
             return ApplyIBufBitmapInit(log, page);
+        case MLOG_UNDO_INSERT:
+            return ApplyUndoInsert(log, page);
+        case MLOG_UNDO_ERASE_END:
+            return ApplyUndoEraseEnd(log, page);
+        case MLOG_UNDO_INIT:
+            return ApplyUndoInit(log, page);
+        case MLOG_UNDO_HDR_DISCARD:
+            return ApplyUndoHdrDiscard(log, page);
+        case MLOG_UNDO_HDR_CREATE:
+        case MLOG_UNDO_HDR_REUSE:
+            return ApplyUndoHdrCreateOrReuse(log, page);
+        case MLOG_REC_MIN_MARK:
+        case MLOG_COMP_REC_MIN_MARK:
+            return ApplyRecMinMark(log, page);
+        case MLOG_ZIP_WRITE_NODE_PTR:
+            return ApplyZipWriteNodePtr(log, page);
+        case MLOG_ZIP_WRITE_BLOB_PTR:
+            return ApplyZipWriteBlobPtr(log, page);
+        case MLOG_ZIP_WRITE_HEADER:
+            return ApplyZipWriteHeader(log, page);
+        case MLOG_ZIP_PAGE_COMPRESS:
+            return ApplyZipPageCompress(log, page);
         default:
             return false;
     }
 }
 
-void log_apply_do_apply(const PageAddress &page_address, std::list<LogEntry> *log_entry_list) {
+void log_apply_do_apply(ApplierInstance *applier, const PageAddress &page_address,
+                        std::list<LogEntry> *log_entry_list) {
+    auto &buffer_pool = applier->buffer_pool;
     auto space_id = page_address.SpaceId();
 
     // skip!
-    if (!(DataPageGroup::Get().Exist(space_id))) {
+    if (!(applier->data_page_group.Exist(space_id))) {
+        applier->apply_index.EndApply(page_address);
         return;
     }
 
     auto page_id = page_address.PageId();
+    // 磁盘上的page已经包含了整条log链，不需要读page；有read view时还要读出page，给这条log链保留镜像
+    if (!log_entry_list->empty() && !applier->page_version_store.ViewsEnabled()
+        && applier->page_lsn_map.Get(space_id, page_id) > log_entry_list->back().log_start_lsn_) {
+        applier->apply_index.EndApply(page_address);
+        return;
+    }
+
     // 获取需要的page
     Page *page = buffer_pool.GetPage(space_id, page_id);
 
@@ -101,6 +190,8 @@ void log_apply_do_apply(const PageAddress &page_address, std::list<LogEntry> *lo
     }
 
     lsn_t page_lsn = page->GetLSN();
+    // 只读节点可能还要读这条log链之前的版本
+    applier->page_version_store.Retain(page_address, *page, *log_entry_list);
     for (const auto &log: (*log_entry_list)) {
         lsn_t log_lsn = log.log_start_lsn_;
 //        std::cout << "space id = " << space_id << ", page id = " << page_id << ", log type = " << GetLogString(log.type_);
@@ -119,65 +210,128 @@ void log_apply_do_apply(const PageAddress &page_address, std::list<LogEntry> *lo
     }
     buffer_pool.WriteBackLock(space_id, page_id);
     BufferPool::ReleasePage(page);
+    applier->apply_index.EndApply(page_address);
 }
 
-static void log_apply_worker_work(int worker_index) {
+void log_apply_read_page(ApplierInstance *applier, const PageAddress &page_address) {
+    auto &apply_index = applier->apply_index;
+    std::vector<PageAddress> pages {page_address};
+    apply_index.BeginRead(pages);
+    auto log_vector = apply_index.Search(page_address);
+    for (const auto &item: log_vector) {
+        log_apply_do_apply(applier, page_address, item.get());
+    }
+    apply_index.EndRead(pages);
+}
+
+// 处理一批分配给这个worker的log，worker需要退出时返回false
+static bool log_apply_worker_work(ApplierInstance *applier, int worker_index) {
+    auto &log_appliers = applier->log_appliers;
+    auto &apply_index = applier->apply_index;
     PTHREAD_MUTEX_lock(&(log_appliers[worker_index].mutex));
-    while (!(log_appliers[worker_index].need_process)) {
+    while (!(log_appliers[worker_index].need_process) && !(log_appliers[worker_index].need_exit)) {
         pthread_cond_wait(&(log_appliers[worker_index].need_process_cond), &(log_appliers[worker_index].mutex));
     }
+    if (!log_appliers[worker_index].need_process) {
+        PTHREAD_MUTEX_unlock(&(log_appliers[worker_index].mutex));
+        return false;
+    }
 
     log_appliers[worker_index].is_running = true;
 
     // do apply
     for (const auto &page_address: log_appliers[worker_index].logs) {
+        log_apply_yield_to_readers(apply_index);
         auto log_entry_list = apply_index.ExtractFront(page_address);
         if (log_entry_list == nullptr) {
             // 这条log可能已经被其它的data page reader线程抽走了
             continue;
         }
-        log_apply_do_apply(page_address, log_entry_list.get());
+        log_apply_do_apply(applier, page_address, log_entry_list.get());
+    }
+    for (const auto &page_address: log_appliers[worker_index].deferred_logs) {
+        log_apply_yield_to_readers(apply_index);
+        auto log_entry_list = apply_index.ExtractDeferred(page_address);
+        if (log_entry_list == nullptr) {
+            continue;
+        }
+        log_apply_do_apply(applier, page_address, log_entry_list.get());
     }
 
 
     // 放掉lock
     log_appliers[worker_index].logs.clear();
+    log_appliers[worker_index].deferred_logs.clear();
     log_appliers[worker_index].need_process = false;
     log_appliers[worker_index].is_running = false;
     PTHREAD_MUTEX_unlock(&(log_appliers[worker_index].mutex));
+    return true;
 }
 
-static void *log_apply_worker_routine(void *worker_index) {
-    int *index_ptr = static_cast<int *>(worker_index);
-    int index = *(index_ptr);
-    delete index_ptr;
-    for (;;) {
-        log_apply_worker_work(index);
+static void *log_apply_worker_routine(void *arg) {
+    auto *worker = static_cast<log_applier_t *>(arg);
+    while (log_apply_worker_work(worker->applier, worker->index));
+    return nullptr;
+}
+
+// 按applier_threads增减worker，调用时所有worker都是空闲的
+// n_workers是正在工作的线程数，包括scheduler自己
+static void log_apply_resize_workers(ApplierInstance *applier, int *n_workers) {
+    auto &log_appliers = applier->log_appliers;
+    auto target = std::clamp(applier->applier_threads.load(), 1, static_cast<int>(log_appliers.size()));
+    if (target == *n_workers) {
+        return;
+    }
+    for (int i = *n_workers; i < target; ++i) {
+        log_appliers[i].need_exit = false;
+        std::string thread_name = "log apply worker";
+        thread_name += std::to_string(i);
+        START_THREAD(thread_name.c_str(), &log_appliers[i].thread_id, log_apply_worker_routine, &log_appliers[i]);
     }
+    for (int i = target; i < *n_workers; ++i) {
+        PTHREAD_MUTEX_lock(&(log_appliers[i].mutex));
+        log_appliers[i].need_exit = true;
+        pthread_cond_signal(&(log_appliers[i].need_process_cond));
+        PTHREAD_MUTEX_unlock(&(log_appliers[i].mutex));
+        pthread_join(log_appliers[i].thread_id, nullptr);
+    }
+    LogEvent(COMPONENT_FSAL, "log group %d log apply threads %d -> %d", applier->group_no, *n_workers, target);
+    *n_workers = target;
 }
 
-static void *log_apply_scheduler_routine(void *scheduler_index) {
-    int *index_ptr = static_cast<int *>(scheduler_index);
-    int index = *(index_ptr);
-    delete index_ptr;
+static void *log_apply_scheduler_routine(void *arg) {
+    auto *scheduler = static_cast<log_applier_t *>(arg);
+    auto *applier = scheduler->applier;
+    auto &log_appliers = applier->log_appliers;
+    auto &log_group = applier->log_group;
+    int n_workers = 1;
+    log_apply_resize_workers(applier, &n_workers);
     for (;;) {
 
         size_t total_log_len = 0;
-        auto task = log_apply_scheduler_acquire(&total_log_len);
+        std::vector<PageAddress> drain;
+        auto task = log_apply_policy_filter(applier->apply_index, log_apply_scheduler_acquire(applier, &total_log_len),
+                                            &drain);
+        log_apply_resize_workers(applier, &n_workers);
 
-        LogEvent(COMPONENT_FSAL, "log applier starting apply %zu bytes log", total_log_len);
+        LogEvent(COMPONENT_FSAL, "log group %d log applier starting apply %zu bytes log",
+                 applier->group_no, total_log_len);
         auto need_to_apply = total_log_len;
 
         // 把每一个task分配给相应的worker
         size_t next_applier = 0;
         for (const auto &item: task) {
             log_appliers[next_applier].logs.push_back(item);
-            next_applier = (next_applier + 1) % log_appliers.size();
+            next_applier = (next_applier + 1) % n_workers;
+        }
+        for (const auto &item: drain) {
+            log_appliers[next_applier].deferred_logs.push_back(item);
+            next_applier = (next_applier + 1) % n_workers;
         }
 
         // 唤醒相应的worker
-        for (auto & log_applier : log_appliers) {
-
+        for (int i = 0; i < n_workers; ++i) {
+            auto &log_applier = log_appliers[i];
             PTHREAD_MUTEX_lock(&(log_applier.mutex));
             log_applier.need_process = true;
             pthread_cond_signal(&(log_applier.need_process_cond));
@@ -186,39 +340,56 @@ static void *log_apply_scheduler_routine(void *scheduler_index) {
         }
 
         // 自己变成worker进行工作
-        log_apply_worker_work(index);
+        log_apply_worker_work(applier, scheduler->index);
 
-        LogEvent(COMPONENT_FSAL, "applied %zu bytes log", need_to_apply);
+        LogEvent(COMPONENT_FSAL, "log group %d applied %zu bytes log", applier->group_no, need_to_apply);
         // 自旋等待所有log worker变成空闲状态
-        while (!log_apply_all_idle());
+        while (!log_apply_all_idle(log_appliers));
 
-        PTHREAD_MUTEX_lock(&(log_group_mutex));
+        PTHREAD_MUTEX_lock(&(applier->log_group_mutex));
 
         log_group.applied_isn += need_to_apply;
         log_group.written_capacity += need_to_apply;
 
-        // 唤醒log writer
-        pthread_cond_signal(&log_write_condition);
+        // 唤醒log writer，以及等待空间读回溢出log的log parser
+        pthread_cond_signal(&applier->log_write_condition);
+        pthread_cond_signal(&applier->log_parse_condition);
+
+        PTHREAD_MUTEX_unlock(&(applier->log_group_mutex));
+    }
+}
 
-        PTHREAD_MUTEX_unlock(&(log_group_mutex));
+// 优先materialise计算节点刷过的page
+static void *log_apply_hint_routine(void *arg) {
+    auto *applier = static_cast<ApplierInstance *>(arg);
+    for (;;) {
+        uint64_t seq = 0;
+        auto hints = applier->flush_hint_queue.PopAll(&seq);
+
+        // hint中的lsn对应的log在page被刷之前已经写过来了，等log parser把它们解析完
+        wait_until_parse_done(applier->group_no);
+
+        // 同一个page可能被刷了多次，只需要materialise一次
+        std::unordered_set<PageAddress> done_pages;
+        for (const auto &hint: hints) {
+            PageAddress page_address(hint.space_id_, hint.page_id_);
+            if (!done_pages.insert(page_address).second) {
+                continue;
+            }
+            log_apply_read_page(applier, page_address);
+        }
+        applier->flush_hint_queue.Done(seq);
     }
 }
 
-void log_apply_thread_start(int n_thread) {
-    assert(APPLIER_THREAD >= 1); // 最少要有一个log apply线程
-    assert(log_appliers.size() == APPLIER_THREAD);
+void log_apply_thread_start(ApplierInstance *applier) {
+    auto &log_appliers = applier->log_appliers;
+    assert(!log_appliers.empty()); // 最少要有一个log apply线程
 
-    // 首先启动scheduler
-    int *scheduler_index = new int(0);
-    START_THREAD("log apply scheduler", &log_appliers[0].thread_id, log_apply_scheduler_routine, (void *)(scheduler_index));
-    n_thread -= 1;
+    // scheduler自己也是log_appliers[0]的worker，剩下的apply worker由它按applier_threads启动
+    START_THREAD("log apply scheduler", &log_appliers[0].thread_id, log_apply_scheduler_routine, &log_appliers[0]);
 
-    // 启动剩下的apply worker
-    for (int i = 0; i < n_thread; ++i) {
-        std::string thread_name = "log apply scheduler";
-        thread_name += std::to_string(i);
-        int *work_index = new int(i);
-        START_THREAD(thread_name.c_str(), &log_appliers[i].thread_id, log_apply_worker_routine, (void *)(work_index));
-        n_thread--;
-    }
+    pthread_t hint_thread_id;
+    START_THREAD("log apply hint", &hint_thread_id, log_apply_hint_routine, applier);
+    pthread_detach(hint_thread_id);
 }
\ No newline at end of file
@@ -1,28 +1,20 @@
 #include <unistd.h>
+#include <sys/mman.h>
 #include <cassert>
+#include <cstring>
 #include "applier/log_log.h"
 #include "applier/applier_config.h"
 #include "applier/utility.h"
+#include "rocksdb/db.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 #include "common_utils.h"
+#include "log.h"
 
 #ifdef __cplusplus
 }
 #endif
-log_group_t log_group;
-
-//pthread_mutex_t log_apply_task_mutex;
-pthread_cond_t log_apply_condition; // 每次log parser 解析之后产生apply task，就会产生这个条件变量来唤醒log applier
-//std::list<std::unique_ptr<apply_task>> apply_task_requests;
-ApplyIndex apply_index;
-pthread_mutex_t log_group_mutex;
-pthread_cond_t log_parse_condition; // 每次log writer 写入，导致产生足够多的log，就会产生这个条件变量来唤醒log parser
-pthread_cond_t log_write_condition;
-log_parser_t log_parser {};
-std::vector<log_applier_t> log_appliers {APPLIER_THREAD};
-
 void find_max_checkpoint(const unsigned char *log_meta_buf, size_t *checkpoint_lsn, size_t *checkpoint_no, size_t *checkpoint_offset) {
 
     size_t checkpoint_lsn1 = mach_read_from_8(log_meta_buf + LOG_CHECKPOINT_1 + LOG_CHECKPOINT_LSN);
@@ -48,7 +40,7 @@ void find_max_checkpoint(const unsigned char *log_meta_buf, size_t *checkpoint_l
     }
 }
 
-size_t log_group_off_to_log_buf_off(size_t log_group_off) {
+size_t log_group_off_to_log_buf_off(const log_group_t &log_group, size_t log_group_off) {
     auto n_file = log_group_off / log_group.per_file_size; // 这是第几个文件
     auto off_in_file = log_group_off % log_group.per_file_size; // 在文件内的偏移量
 
@@ -67,6 +59,292 @@ size_t log_group_off_to_log_buf_off(size_t log_group_off) {
     return log_buf_off;
 }
 
+unsigned char *log_ring_map(size_t size) {
+    int fd = memfd_create("logdb_log_buf", MFD_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    // 先保留2倍大小的地址空间，再把memfd固定映射到前后两半
+    auto *base = static_cast<unsigned char *>(mmap(nullptr, 2 * size, PROT_NONE,
+                                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (mmap(base + i * size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(base, 2 * size);
+            close(fd);
+            return nullptr;
+        }
+    }
+    // 映射会持有memfd的引用，fd本身不再需要
+    close(fd);
+    return base;
+}
+
+size_t strip_log_blocks(const log_group_t &log_group, const unsigned char *blocks, size_t n_blocks,
+                        size_t log_group_offset, size_t written_offset, unsigned char *dest, size_t max_len, size_t *n_used) {
+    size_t len = 0;
+    size_t i = 0;
+    for (auto buf = blocks; i < n_blocks && len < max_len; ++i, buf += LOG_BLOCK_SIZE) {
+        size_t data_len = mach_read_from_2(buf + LOG_BLOCK_HDR_DATA_LEN);
+        if (data_len == 0) {
+            break;
+        }
+        // FIXME 切换日志的时候，会写meta block，一次io是4k为单位，meta block是2k，为什么meta block之后的block的data_len是0？
+        assert(data_len >= LOG_BLOCK_HDR_SIZE);
+        assert(data_len == 512 || data_len < LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE);
+
+        data_len = (data_len == LOG_BLOCK_SIZE ? data_len - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE : data_len - LOG_BLOCK_HDR_SIZE);
+        auto log_buf_offset_start = log_group_off_to_log_buf_off(log_group, log_group_offset + i * LOG_BLOCK_SIZE + LOG_BLOCK_HDR_SIZE);
+        auto log_buf_offset_end = log_buf_offset_start + data_len;
+        if (log_buf_offset_end > written_offset) {
+            assert(log_buf_offset_start <= written_offset); // 写log必须是挨个写，不能出现空洞
+            auto actual_data_len = std::min(log_buf_offset_end - written_offset, max_len - len);
+            if (dest != nullptr) {
+                std::memcpy(dest + len, buf + LOG_BLOCK_HDR_SIZE + (written_offset - log_buf_offset_start), actual_data_len);
+            }
+            len += actual_data_len;
+            written_offset = (written_offset + actual_data_len) % log_group.log_buf_size;
+        }
+        if (data_len != LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE) {
+            ++i;
+            break;
+        }
+    }
+    if (n_used != nullptr) {
+        *n_used = i;
+    }
+    return len;
+}
+
+int log_refill_spilled(const log_group_t &log_group, const spilled_log_t &spilled) {
+    // 只有log parser线程会读回溢出的log，每个log group有自己的log parser
+    static thread_local std::unique_ptr<unsigned char[]> read_buf;
+    static thread_local size_t read_buf_size = 0;
+    auto size = spilled.n_blocks * LOG_BLOCK_SIZE;
+    if (read_buf_size < size) {
+        read_buf.reset(new unsigned char[size]);
+        read_buf_size = size;
+    }
+    auto res = pread(log_group.log_fds[spilled.log_file_index], read_buf.get(), size, spilled.offset);
+    if (res != static_cast<ssize_t>(size)) {
+        return 1;
+    }
+    // ib_logfile是循环写的，block号比期望的小说明这里还是上一轮的log，比期望的大说明已经被下一轮覆盖了。
+    // block号在1到0x40000000之间回绕，差值按回绕之后的距离比较
+    for (size_t i = 0; i < spilled.n_blocks; ++i) {
+        auto block_no = mach_read_from_4(read_buf.get() + i * LOG_BLOCK_SIZE + LOG_BLOCK_HDR_NO) & ~LOG_BLOCK_FLUSH_BIT_MASK;
+        auto expected = ((spilled.first_block_no - 1 + i) & 0x3FFFFFFFUL) + 1;
+        if (block_no != expected) {
+            auto ahead = (block_no - expected) & 0x3FFFFFFFUL;
+            return ahead < 0x20000000UL ? -1 : 1;
+        }
+    }
+    auto log_group_offset = spilled.log_file_index * log_group.per_file_size + spilled.offset;
+    auto *dest = log_group.log_buf + log_group.filled_isn % log_group.log_ring_size;
+    auto len = strip_log_blocks(log_group, read_buf.get(), spilled.n_blocks, log_group_offset,
+                                spilled.written_offset, dest, spilled.len, nullptr);
+    return len == spilled.len ? 0 : 1;
+}
+
+LogSpillStore::~LogSpillStore() {
+    if (db_ != nullptr) {
+        db_->Close();
+        delete db_;
+    }
+}
+
+bool LogSpillStore::Open(const std::string &path) {
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    // 上一次运行留下的内容已经没有意义
+    rocksdb::DestroyDB(path, options);
+    auto status = rocksdb::DB::Open(options, path, &db_);
+    if (!status.ok()) {
+        LogCrit(COMPONENT_INIT, "can not open apply index spill store %s: %s", path.c_str(), status.ToString().c_str());
+        db_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// key是大端的(space id, page id, lsn)，同一个page的log在RocksDB中按lsn有序并且连续
+static std::string spill_key(space_id_t space_id, page_id_t page_id, lsn_t lsn) {
+    std::string key(16, '\0');
+    auto *buf = reinterpret_cast<byte *>(key.data());
+    mach_write_to_4(buf, space_id);
+    mach_write_to_4(buf + 4, page_id);
+    mach_write_to_8(buf + 8, lsn);
+    return key;
+}
+
+bool LogSpillStore::Put(const std::list<LogEntry> &logs) {
+    rocksdb::WriteBatch batch;
+    std::string value;
+    for (const auto &log: logs) {
+        // value是 type(1) + log_len(8) + log body
+        auto body_len = static_cast<size_t>(log.log_body_end_ptr_ - log.log_body_start_ptr_);
+        value.resize(9 + body_len);
+        auto *buf = reinterpret_cast<byte *>(value.data());
+        mach_write_to_1(buf, static_cast<byte>(log.type_));
+        mach_write_to_8(buf + 1, log.log_len_);
+        if (body_len > 0) {
+            std::memcpy(buf + 9, log.log_body_start_ptr_, body_len);
+        }
+        batch.Put(spill_key(log.space_id_, log.page_id_, log.log_start_lsn_), value);
+    }
+    // 崩溃之后index会从redo log重新构建，不需要WAL
+    rocksdb::WriteOptions write_options;
+    write_options.disableWAL = true;
+    auto status = db_->Write(write_options, &batch);
+    if (!status.ok()) {
+        LogCrit(COMPONENT_FSAL, "apply index spill failed: %s", status.ToString().c_str());
+        return false;
+    }
+    return true;
+}
+
+void LogSpillStore::Take(const PageAddress &page_address, lsn_t first_lsn, lsn_t last_lsn, std::list<LogEntry> *logs) {
+    auto space_id = page_address.SpaceId();
+    auto page_id = page_address.PageId();
+    auto start_key = spill_key(space_id, page_id, first_lsn);
+    auto end_key = spill_key(space_id, page_id, last_lsn + 1);
+    rocksdb::Slice upper_bound(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+    std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(read_options));
+    for (iter->Seek(start_key); iter->Valid(); iter->Next()) {
+        auto key = iter->key();
+        auto value = iter->value();
+        auto *key_buf = reinterpret_cast<const byte *>(key.data());
+        auto *buf = reinterpret_cast<byte *>(const_cast<char *>(value.data()));
+        logs->emplace_back(static_cast<LOG_TYPE>(mach_read_from_1(buf)), space_id, page_id,
+                           mach_read_from_8(key_buf + 8), mach_read_from_8(buf + 1),
+                           buf + 9, buf + value.size());
+    }
+    assert(iter->status().ok());
+    rocksdb::WriteOptions write_options;
+    write_options.disableWAL = true;
+    db_->DeleteRange(write_options, db_->DefaultColumnFamily(), start_key, end_key);
+}
+
+// 按字节写的log写的page区间[start, end)，其它的log返回false
+static bool log_write_range(const LogEntry &log, uint32_t *start, uint32_t *end) {
+    const byte *body = log.log_body_start_ptr_;
+    auto body_len = log.log_body_end_ptr_ - log.log_body_start_ptr_;
+    uint32_t len;
+    switch (log.type_) {
+        case MLOG_1BYTE:
+            len = 1;
+            break;
+        case MLOG_2BYTES:
+            len = 2;
+            break;
+        case MLOG_4BYTES:
+            len = 4;
+            break;
+        case MLOG_8BYTES:
+            len = 8;
+            break;
+        case MLOG_WRITE_STRING:
+            if (body_len < 4) {
+                return false;
+            }
+            len = mach_read_from_2(body + 2);
+            break;
+        default:
+            return false;
+    }
+    if (body_len < 2) {
+        return false;
+    }
+    *start = mach_read_from_2(body);
+    *end = *start + len;
+    return true;
+}
+
+// 只修改index page的page header和record区域的log
+static bool is_index_record_log(LOG_TYPE type) {
+    switch (type) {
+        case MLOG_COMP_PAGE_CREATE:
+        case MLOG_COMP_REC_INSERT:
+        case MLOG_COMP_REC_CLUST_DELETE_MARK:
+        case MLOG_REC_SEC_DELETE_MARK:
+        case MLOG_COMP_REC_SEC_DELETE_MARK:
+        case MLOG_COMP_REC_UPDATE_IN_PLACE:
+        case MLOG_COMP_REC_DELETE:
+        case MLOG_COMP_LIST_END_COPY_CREATED:
+        case MLOG_COMP_PAGE_REORGANIZE:
+        case MLOG_COMP_LIST_START_DELETE:
+        case MLOG_COMP_LIST_END_DELETE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// [start, end)是否完全落在page_create_low重写的区域内
+static bool page_create_overwrites(uint32_t start, uint32_t end) {
+    return (start >= FIL_PAGE_TYPE && end <= FIL_PAGE_TYPE + 2)
+           || (start >= PAGE_HEADER && end <= PAGE_HEADER + PAGE_HEADER_PRIV_END)
+           || (start >= PAGE_DATA && end <= DATA_PAGE_SIZE - PAGE_DIR);
+}
+
+size_t compact_log_chain(std::list<LogEntry> *chain, const LogEntry &next) {
+    size_t freed = 0;
+    uint32_t start, end;
+    if (next.type_ == MLOG_COMP_PAGE_CREATE) {
+        for (auto iter = chain->begin(); iter != chain->end();) {
+            if (is_index_record_log(iter->type_)
+                || (log_write_range(*iter, &start, &end) && page_create_overwrites(start, end))) {
+                freed += iter->MemorySize();
+                iter = chain->erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        return freed;
+    }
+
+    uint32_t next_start, next_end;
+    if (!log_write_range(next, &next_start, &next_end)) {
+        return 0;
+    }
+    for (auto iter = chain->end(); iter != chain->begin();) {
+        --iter;
+        if (!log_write_range(*iter, &start, &end)) {
+            break;
+        }
+        if (next_start <= start && end <= next_end) {
+            freed += iter->MemorySize();
+            iter = chain->erase(iter);
+        }
+    }
+    return freed;
+}
+
+void ApplyIndex::SpillCold() {
+    auto low_water = static_cast<size_t>(memory_budget_.load() * APPLY_INDEX_SPILL_LOW_WATER);
+    if (!spill_store_.Opened() || memory_usage_ <= low_water || (index_.size() < 2 && deferred_.Empty())) {
+        return;
+    }
+    auto before = memory_usage_;
+    // 推迟apply的log只有被读到的时候才会用到，最先溢出
+    memory_usage_ -= deferred_.Spill(&spill_store_, recent_reads_, memory_usage_ - low_water);
+    for (auto iter = index_.rbegin(); std::next(iter) != index_.rend() && memory_usage_ > low_water; ++iter) {
+        memory_usage_ -= (*iter)->Spill(&spill_store_, recent_reads_, memory_usage_ - low_water);
+    }
+    next_spill_usage_ = memory_usage_ > low_water ? memory_usage_ + batch_size_ : 0;
+    LogEvent(COMPONENT_FSAL, "apply index spilled %zu bytes to rocksdb, %zu bytes left in memory",
+             before - memory_usage_, memory_usage_);
+}
+
 log_applier_t::log_applier_t() {
     PTHREAD_MUTEX_init(&mutex, NULL);
     PTHREAD_COND_init(&need_process_cond, NULL);
@@ -79,11 +357,6 @@ void DataPageGroup::Insert(const std::string &filename, space_id_t space_id) {
     pthread_rwlock_unlock(&rw_lock_);
 }
 
-DataPageGroup &DataPageGroup::Get() {
-    static DataPageGroup data_page_group;
-    return data_page_group;
-}
-
 void DataPageGroup::Insert(const struct fsal_obj_handle *handle, space_id_t space_id) {
     pthread_rwlock_wrlock(&rw_lock_);
     handle2space_id_[handle] = space_id;
@@ -112,5 +385,34 @@ int DataPageGroup::Exist(const struct fsal_obj_handle *handle) {
 }
 
 bool DataPageGroup::Exist(space_id_t space_id) {
-    return space_id_.find(space_id) != space_id_.end();
+    pthread_rwlock_rdlock(&rw_lock_);
+    bool res = space_id_.find(space_id) != space_id_.end();
+    pthread_rwlock_unlock(&rw_lock_);
+    return res;
+}
+
+void DataPageGroup::Rename(space_id_t space_id, const std::string &filename) {
+    pthread_rwlock_wrlock(&rw_lock_);
+    for (auto iter = filename2space_id_.begin(); iter != filename2space_id_.end();) {
+        if (iter->second == space_id && iter->first != filename) {
+            iter = filename2space_id_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    filename2space_id_[filename] = space_id;
+    space_id_.insert(space_id);
+    pthread_rwlock_unlock(&rw_lock_);
+}
+
+void DataPageGroup::Erase(space_id_t space_id) {
+    pthread_rwlock_wrlock(&rw_lock_);
+    for (auto iter = filename2space_id_.begin(); iter != filename2space_id_.end();) {
+        iter = iter->second == space_id ? filename2space_id_.erase(iter) : std::next(iter);
+    }
+    for (auto iter = handle2space_id_.begin(); iter != handle2space_id_.end();) {
+        iter = iter->second == space_id ? handle2space_id_.erase(iter) : std::next(iter);
+    }
+    space_id_.erase(space_id);
+    pthread_rwlock_unlock(&rw_lock_);
 }
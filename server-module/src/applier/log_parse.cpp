@@ -6,6 +6,7 @@
 #include "applier/record.h"
 #include "applier/interface.h"
 #include "applier/log_log.h"
+#include "applier/applier_instance.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -17,30 +18,63 @@ extern "C" {
 #endif
 
 // 从log buf中获取size大小的log，如果没有，就一直等待，直到log writer写入足够的log
-static size_t log_parse_acquire(size_t size) {
+static size_t log_parse_acquire(ApplierInstance *applier, size_t size) {
+    auto &log_group = applier->log_group;
     size_t need_to_parse = 0;
-    PTHREAD_MUTEX_lock(&log_group_mutex);
+    uint32_t refill_retries = 0;
+    PTHREAD_MUTEX_lock(&applier->log_group_mutex);
     while (log_group.need_to_parse <= size) {
-        pthread_cond_wait(&log_parse_condition, &log_group_mutex);
+        // 内存中的log已经解析完了，窗口有空间时从ib_logfile读回溢出的log
+        if (!log_group.spilled_logs.empty()
+            && log_group.written_capacity >= log_group.spilled_logs.front().len) {
+            auto spilled = log_group.spilled_logs.front();
+            log_group.spilled_logs.pop_front();
+            PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
+            auto res = log_refill_spilled(log_group, spilled);
+            if (res < 0) {
+                // apply落后了整整一圈ib_logfile，这段log已经丢了，继续下去生成的page是错的
+                LogFatal(COMPONENT_FSAL,
+                         "spilled redo log in %s at offset %zu (first block no = %u) was overwritten before it "
+                         "was read back, the applier fell behind by more than the whole ib_logfile",
+                         log_group.log_filenames[spilled.log_file_index].c_str(), spilled.offset,
+                         spilled.first_block_no);
+            }
+            PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+            if (res > 0) {
+                // log writer的这次写入还没有落到ib_logfile，稍后再读
+                if (++refill_retries >= LOG_REFILL_MAX_RETRIES) {
+                    LogFatal(COMPONENT_FSAL,
+                             "spilled redo log in %s at offset %zu (first block no = %u) did not reach the "
+                             "ib_logfile after %u retries",
+                             log_group.log_filenames[spilled.log_file_index].c_str(), spilled.offset,
+                             spilled.first_block_no, refill_retries);
+                }
+                log_group.spilled_logs.push_front(spilled);
+                PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
+                usleep(LOG_REFILL_RETRY_US);
+                PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+                continue;
+            }
+            refill_retries = 0;
+            log_group.written_capacity -= spilled.len;
+            log_group.filled_isn += spilled.len;
+            log_group.need_to_parse += spilled.len;
+            continue;
+        }
+        pthread_cond_wait(&applier->log_parse_condition, &applier->log_group_mutex);
     }
     need_to_parse = log_group.need_to_parse; //hkc-debug-point-3
 //    log_parser.parse_buf = log_group.log_buf + log_group.parsed_offset;
-    PTHREAD_MUTEX_unlock(&log_group_mutex);
+    PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
     return need_to_parse;
 }
 
-// 保证log parse buf是连续的
-static void log_parse_init_parse_buf(size_t need_to_parse) {
-    auto size_remain = log_group.log_buf_size - log_group.parsed_offset;
-    if (size_remain >= need_to_parse) {
-        log_parser.parse_buf = log_group.log_buf + log_group.parsed_offset;
-    } else {
-        // 把首尾数据拼接，拷贝到log parser buf back中
-        memcpy(log_parser.parse_buf_back.get(), log_group.log_buf + log_group.parsed_offset, size_remain);
-        memcpy(log_parser.parse_buf_back.get() + size_remain, log_group.log_buf, need_to_parse - size_remain);
-        log_parser.parse_buf = log_parser.parse_buf_back.get();
-        LogEvent(COMPONENT_FSAL, "parsed log which cross 2 files");
-    }
+// log buf是首尾相连映射的，need_to_parse不会超过环的大小，从parsed_isn开始的这一段总是连续的
+static void log_parse_init_parse_buf(ApplierInstance *applier, size_t need_to_parse) {
+    auto &log_group = applier->log_group;
+    auto &log_parser = applier->log_parser;
+    assert(need_to_parse <= log_group.log_ring_size);
+    log_parser.parse_buf = log_group.log_buf + log_group.parsed_isn % log_group.log_ring_size;
 }
 
 // 解析完成日志
@@ -53,7 +87,7 @@ static void log_parse_complete() {
 // 也就是说每次分配log的时候，优先分配给当前拥有log数量最少的log applier
 // 同时使用hash表来保证，具有相同PageAddress（space id，page id）的log被分配到同一个线程
 // 返回的int类型指示该log应该被分配给哪一个log applier
-static int log_parse_log_dispatch(const LogEntry& log) {
+static int log_parse_log_dispatch(log_parser_t &log_parser, const LogEntry& log) {
     auto address = PageAddress(log.space_id_, log.page_id_);
     if (auto iter = log_parser.log_dispatch_trace_table.find(address);
         iter != log_parser.log_dispatch_trace_table.end()) {
@@ -76,20 +110,123 @@ static int log_parse_log_dispatch(const LogEntry& log) {
     return min_thread;
 }
 // 开启新的一轮parse，要先做一些清理工作
-static void log_parse_init() {
+static void log_parse_init(log_parser_t &log_parser) {
     log_parser.round++;
     std::memset(log_parser.log_dispatch_number_table, 0,
                 sizeof(log_parser.log_dispatch_number_table));
     log_parser.log_dispatch_trace_table.clear();
 }
 
-void* log_parse_thread_routine_wrong(void*) {
+// 修改page的log，其余的是表空间和mtr的log
+static bool log_parse_is_page_log(LOG_TYPE type) {
+    return type != MLOG_FILE_NAME
+           && type != MLOG_FILE_DELETE
+           && type != MLOG_FILE_CREATE2
+           && type != MLOG_FILE_RENAME2
+           && type != MLOG_SINGLE_REC_FLAG
+           && type != MLOG_MULTI_REC_END
+           && type != MLOG_DUMMY_RECORD
+           && type != MLOG_CHECKPOINT
+           && type != MLOG_TRUNCATE
+           && type != MLOG_INDEX_LOAD;
+}
+
+// 会改变表空间目录的log
+static bool log_parse_is_tablespace_log(LOG_TYPE type) {
+    return type == MLOG_FILE_CREATE2
+           || type == MLOG_FILE_RENAME2
+           || type == MLOG_FILE_DELETE
+           || type == MLOG_TRUNCATE;
+}
+
+// log中的文件名是相对数据目录的路径，比如./sbtest/sbtest1.ibd，len包括结尾的'\0'
+static std::string log_parse_file_path(const LogGroupConfig &config, const byte *name, uint16_t len) {
+    std::string path(reinterpret_cast<const char *>(name), len);
+    while (!path.empty() && path.back() == '\0') {
+        path.pop_back();
+    }
+    if (path.compare(0, 2, "./") == 0) {
+        path.erase(0, 2);
+    }
+    return std::string(config.system_file_prefix) + path;
+}
+
+// 和启动时一样，只有data_file_prefix下的.ibd文件由存储节点生成
+static bool log_parse_is_data_file(const LogGroupConfig &config, const std::string &path) {
+    std::string prefix = std::string(config.data_file_prefix) + "/";
+    std::string suffix = ".ibd";
+    return path.size() > prefix.size() + suffix.size()
+           && path.compare(0, prefix.size(), prefix) == 0
+           && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 表空间被删除或者truncate，之前的log和page都没有用了，回收它们占用的内存
+static void log_parse_drop_tablespace(ApplierInstance *applier, space_id_t space_id, bool truncate) {
+    auto n_chains = applier->apply_index.DropSpace(space_id);
+    if (truncate) {
+        applier->buffer_pool.DiscardTablespacePages(space_id);
+    } else {
+        applier->buffer_pool.DropTablespace(space_id);
+    }
+    applier->page_lsn_map.DropSpace(space_id);
+    applier->page_version_store.DropSpace(space_id);
+    LogEvent(COMPONENT_FSAL, "tablespace %u %s, dropped %zu log chains",
+             space_id, truncate ? "truncated" : "deleted", n_chains);
+}
+
+// 按MLOG_FILE_CREATE2、MLOG_FILE_RENAME2、MLOG_FILE_DELETE、MLOG_TRUNCATE修改表空间目录，log body还在parse buffer中
+static void log_parse_apply_tablespace_log(ApplierInstance *applier, const LogEntry &log) {
+    const auto &config = applier->config;
+    const byte *ptr = log.log_body_start_ptr_;
+    auto space_id = log.space_id_;
+    applier->change_feed.SpaceChanged(space_id);
+    switch (log.type_) {
+        case MLOG_FILE_CREATE2: {
+            auto flags = mach_read_from_4(ptr);
+            auto path = log_parse_file_path(config, ptr + 6, mach_read_from_2(ptr + 4));
+            if (log_parse_is_data_file(config, path)) {
+                applier->buffer_pool.CreateTablespace(space_id, path, fsp_flags_get_page_size(flags));
+            }
+            break;
+        }
+        case MLOG_FILE_RENAME2: {
+            if (!applier->data_page_group.Exist(space_id)) {
+                break;
+            }
+            auto old_len = mach_read_from_2(ptr);
+            auto *new_name = ptr + 2 + old_len;
+            auto path = log_parse_file_path(config, new_name + 2, mach_read_from_2(new_name));
+            if (log_parse_is_data_file(config, path)) {
+                applier->buffer_pool.RenameTablespace(space_id, path);
+            } else {
+                // 移出了数据目录，不再由存储节点生成，文件留给计算节点
+                log_parse_drop_tablespace(applier, space_id, false);
+            }
+            break;
+        }
+        case MLOG_FILE_DELETE:
+        case MLOG_TRUNCATE:
+            if (applier->data_page_group.Exist(space_id)) {
+                log_parse_drop_tablespace(applier, space_id, log.type_ == MLOG_TRUNCATE);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void* log_parse_thread_routine_wrong(void *arg) {
+    auto *applier = static_cast<ApplierInstance *>(arg);
+    auto &log_group = applier->log_group;
+    auto &log_parser = applier->log_parser;
+    auto &apply_index = applier->apply_index;
+    auto &data_page_group = applier->data_page_group;
     std::queue<LogEntry> m_q;
     for (;;) {
 //        log_parse_init();
-        auto need_to_parse = log_parse_acquire(0);
+        auto need_to_parse = log_parse_acquire(applier, 0);
         assert(need_to_parse > 0);
-        log_parse_init_parse_buf(need_to_parse);
+        log_parse_init_parse_buf(applier, need_to_parse);
 
         // 从parse buffer中循环解析日志，放到哈希表中
         unsigned char *end_ptr = log_parser.parse_buf + need_to_parse;
@@ -111,7 +248,7 @@ void* log_parse_thread_routine_wrong(void*) {
             PageAddress page_address(space_id, page_id);
             auto log_entry = LogEntry(type, space_id, page_id, log_parser.parsed_lsn, len, log_body_ptr, start_ptr + len);
             //将日志加入索引
-            if (DataPageGroup::Get().Exist(space_id)) {
+            if (data_page_group.Exist(space_id)) {
                 if(m_q.size()>10){
                     int x=1;
                 }
@@ -150,7 +287,7 @@ void* log_parse_thread_routine_wrong(void*) {
                     }else if (!is_single){
                         while (!m_q.empty()) {
                         // 将日志加入索引
-                        if (DataPageGroup::Get().Exist(space_id)) {
+                        if (data_page_group.Exist(space_id)) {
                          if (type != MLOG_FILE_NAME
                            && type != MLOG_FILE_DELETE
                            && type != MLOG_FILE_CREATE2
@@ -209,13 +346,18 @@ void* log_parse_thread_routine_wrong(void*) {
 
 
 
-void* log_parse_thread_routine_ori(void*) {
+void* log_parse_thread_routine_ori(void *arg) {
+    auto *applier = static_cast<ApplierInstance *>(arg);
+    auto &log_group = applier->log_group;
+    auto &log_parser = applier->log_parser;
+    auto &apply_index = applier->apply_index;
+    auto &data_page_group = applier->data_page_group;
     std::queue<LogEntry> m_q;
     for (;;) {
 //        log_parse_init();
-        auto need_to_parse = log_parse_acquire(0);
+        auto need_to_parse = log_parse_acquire(applier, 0);
         assert(need_to_parse > 0);
-        log_parse_init_parse_buf(need_to_parse);
+        log_parse_init_parse_buf(applier, need_to_parse);
 
         // 从parse buffer中循环解析日志，放到哈希表中
         unsigned char *end_ptr = log_parser.parse_buf + need_to_parse;
@@ -237,7 +379,7 @@ void* log_parse_thread_routine_ori(void*) {
             PageAddress page_address(space_id, page_id);
             auto log_entry = LogEntry(type, space_id, page_id, log_parser.parsed_lsn, len, log_body_ptr, start_ptr + len);
             // 将日志加入索引
-            if (DataPageGroup::Get().Exist(space_id)) {
+            if (data_page_group.Exist(space_id)) {
                 if (type != MLOG_FILE_NAME
                     && type != MLOG_FILE_DELETE
                     && type != MLOG_FILE_CREATE2
@@ -362,17 +504,25 @@ void* log_parse_thread_routine_ori(void*) {
 }
 
 
-void* log_parse_thread_routine(void*) {
+void* log_parse_thread_routine(void *arg) {
+    auto *applier = static_cast<ApplierInstance *>(arg);
+    auto &log_group = applier->log_group;
+    auto &log_parser = applier->log_parser;
+    auto &apply_index = applier->apply_index;
+    auto &data_page_group = applier->data_page_group;
     std::queue<LogEntry> m_q;
     for (;;) {
 //        log_parse_init();
-        auto need_to_parse = log_parse_acquire(0);
+        auto need_to_parse = log_parse_acquire(applier, 0);
         assert(need_to_parse > 0);
-        log_parse_init_parse_buf(need_to_parse);
+        log_parse_init_parse_buf(applier, need_to_parse);
 
         // 从parse buffer中循环解析日志，放到哈希表中
         unsigned char *end_ptr = log_parser.parse_buf + need_to_parse;
         unsigned char *start_ptr = log_parser.parse_buf;
+        // 还没有交给redo归档的解析过的log
+        unsigned char *archive_ptr = start_ptr;
+        lsn_t archive_lsn = log_parser.parsed_lsn;
         size_t total_len = 0;
         int single_cnt=0;
         int multi_cnt=0;
@@ -401,54 +551,40 @@ void* log_parse_thread_routine(void*) {
                         multi_end_cnt++;
                         int pop_cnt=0;
                         while (!m_q.empty()) {
-                            // 将日志加入索引
-                                apply_index.InsertBack(std::move(m_q.front()));
-                                m_q.pop();
-                                pop_cnt++;   
+                            auto &front = m_q.front();
+                            if (log_parse_is_tablespace_log(front.type_)) {
+                                log_parse_apply_tablespace_log(applier, front);
+                            } else if (data_page_group.Exist(front.space_id_)) {
+                                applier->change_feed.Capture(front);
+                                // 将日志加入索引
+                                apply_index.InsertBack(std::move(front));
+                            }
+                            m_q.pop();
+                            pop_cnt++;   
                         }
+                        applier->change_feed.CommitMtr(log_parser.parsed_lsn);
                         if(pop_cnt!=q_size){
                             int x=1;
                         }
-            }else if (DataPageGroup::Get().Exist(space_id)) {
-                if (type != MLOG_FILE_NAME
-                    && type != MLOG_FILE_DELETE
-                    && type != MLOG_FILE_CREATE2
-                    && type != MLOG_FILE_RENAME2
-                    && type != MLOG_SINGLE_REC_FLAG
-                    && type != MLOG_MULTI_REC_END
-                    && type != MLOG_DUMMY_RECORD
-                    && type != MLOG_CHECKPOINT
-                    && type != MLOG_TRUNCATE
-                    && type != MLOG_INDEX_LOAD) {
-                    if(is_single){
+            } else if (log_parse_is_tablespace_log(type)) {
+                if (is_single) {
+                    log_parse_apply_tablespace_log(applier, log_entry);
+                } else {
+                    m_q.push(std::move(log_entry));
+                }
+            } else if (log_parse_is_page_log(type)) {
+                if (is_single) {
+                    if (data_page_group.Exist(space_id)) {
                         single_cnt++;
+                        applier->change_feed.Capture(log_entry);
                         apply_index.InsertBack(std::move(log_entry));
-                        assert(type == MLOG_1BYTE
-                            || type == MLOG_2BYTES
-                            || type == MLOG_4BYTES
-                            || type == MLOG_8BYTES
-                            || type == MLOG_WRITE_STRING
-                            || type == MLOG_COMP_PAGE_CREATE
-                            || type == MLOG_INIT_FILE_PAGE2
-                            || type == MLOG_COMP_REC_INSERT
-                            || type == MLOG_COMP_REC_CLUST_DELETE_MARK
-                            || type == MLOG_REC_SEC_DELETE_MARK
-                            || type == MLOG_COMP_REC_SEC_DELETE_MARK
-                            || type == MLOG_COMP_REC_UPDATE_IN_PLACE
-                            || type == MLOG_COMP_REC_DELETE
-                            || type == MLOG_COMP_LIST_END_COPY_CREATED
-                            || type == MLOG_COMP_PAGE_REORGANIZE
-                            || type == MLOG_COMP_LIST_START_DELETE
-                            || type == MLOG_COMP_LIST_END_DELETE
-                            || type == MLOG_IBUF_BITMAP_INIT);
-                    }else{
-                        multi_cnt++;
-                        m_q.push(std::move(log_entry));
                     }
-                    
-                    
+                    applier->change_feed.CommitMtr(log_parser.parsed_lsn);
+                } else {
+                    // 同一个mtr中可能先创建表空间，mtr结束时再判断要不要apply
+                    multi_cnt++;
+                    m_q.push(std::move(log_entry));
                 }
-
             }
 //            if (is_single) {
 //                // 将日志加入索引
@@ -536,16 +672,25 @@ void* log_parse_thread_routine(void*) {
             log_group.need_to_parse -= len;
             start_ptr += len;
             log_parser.parsed_lsn = recv_calc_lsn_on_data_add(log_parser.parsed_lsn, len);
+            if (static_cast<size_t>(start_ptr - archive_ptr) >= REDO_ARCHIVE_FRAME_SIZE) {
+                applier->redo_archive.Append(archive_lsn, log_parser.parsed_lsn, archive_ptr, start_ptr - archive_ptr);
+                archive_ptr = start_ptr;
+                archive_lsn = log_parser.parsed_lsn;
+            }
         }
+        applier->redo_archive.Append(archive_lsn, log_parser.parsed_lsn, archive_ptr, start_ptr - archive_ptr);
+        PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+        pthread_cond_broadcast(&applier->log_parsed_condition);
+        PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
 //        LogEvent(COMPONENT_FSAL, "log parser parsed a batch log %zu bytes", total_len);
     }
 }
 
 
 
-void log_parse_thread_start(void ) {
-    log_parser.parsed_lsn = log_group.checkpoint_lsn;
-    START_THREAD("log parser", &log_parser.thread_id, log_parse_thread_routine, NULL);
+void log_parse_thread_start(ApplierInstance *applier) {
+    applier->log_parser.parsed_lsn = applier->log_group.checkpoint_lsn;
+    START_THREAD("log parser", &applier->log_parser.thread_id, log_parse_thread_routine, applier);
 }
 
 
@@ -1225,15 +1370,126 @@ ParseOrApplySetMinRecMark(byte*	ptr, const byte* end_ptr, bool comp, byte*	page)
     // 下面是Apply的逻辑
     if (page) {
         rec = page + mach_read_from_2(ptr);
+        uint32_t info_bits = rec_get_info_bits(rec, comp);
         if (comp) {
-            uint32_t info_bits = rec_get_info_bits(rec, true);
             rec_set_info_bits_new(rec, info_bits | REC_INFO_MIN_REC_FLAG);
+        } else {
+            rec_set_info_bits_old(rec, info_bits | REC_INFO_MIN_REC_FLAG);
         }
     }
 
     return ptr + 2;
 }
 
+/**
+MLOG_ZIP_WRITE_NODE_PTR和MLOG_ZIP_WRITE_BLOB_PTR。既可以解析（page == nullptr），也可以Apply(page != nullptr)。
+Apply时page是压缩之后的page，只修改压缩page上未压缩保存的字段，非压缩page上的那份由解压得到
+@param field_size REC_NODE_PTR_SIZE或者BTR_EXTERN_FIELD_REF_SIZE
+@param zip_size 压缩page的大小
+@return end of log record or nullptr */
+static byte* ParseOrApplyZipWriteField(byte* ptr, const byte* end_ptr, uint32_t field_size,
+                                       byte* page, uint32_t zip_size) {
+    if (end_ptr < ptr + (2 + 2 + field_size)) {
+        return nullptr;
+    }
+
+    // 非压缩page上字段的位置，解析时用不到
+    uint16_t offset = mach_read_from_2(ptr);
+    // 压缩page上字段的位置
+    uint16_t z_offset = mach_read_from_2(ptr + 2);
+
+    if (offset < PAGE_NEW_SUPREMUM_END || offset >= DATA_PAGE_SIZE) {
+        assert(false);
+        return nullptr;
+    }
+
+    // 下面是Apply的逻辑
+    if (page) {
+        if (z_offset + field_size > zip_size) {
+            return nullptr;
+        }
+        std::memcpy(page + z_offset, ptr + 4, field_size);
+    }
+
+    return ptr + (2 + 2 + field_size);
+}
+
+/**
+MLOG_ZIP_WRITE_HEADER。page header在压缩page上不压缩，和非压缩page的位置相同
+@return end of log record or nullptr */
+static byte* ParseOrApplyZipWriteHeader(byte* ptr, const byte* end_ptr, byte* page) {
+    if (end_ptr < ptr + (1 + 1)) {
+        return nullptr;
+    }
+
+    uint32_t offset = mach_read_from_1(ptr);
+    uint32_t len = mach_read_from_1(ptr + 1);
+    ptr += 2;
+
+    if (len == 0 || offset + len >= PAGE_DATA) {
+        assert(false);
+        return nullptr;
+    }
+
+    if (end_ptr < ptr + len) {
+        return nullptr;
+    }
+
+    // 下面是Apply的逻辑
+    if (page) {
+        std::memcpy(page + offset, ptr, len);
+    }
+
+    return ptr + len;
+}
+
+/**
+MLOG_ZIP_PAGE_COMPRESS。log中带着整个压缩之后的page，Apply时直接替换掉压缩page
+@return end of log record or nullptr */
+static byte* ParseOrApplyZipPageCompress(byte* ptr, const byte* end_ptr, byte* page, uint32_t zip_size) {
+    if (end_ptr < ptr + (2 + 2)) {
+        return nullptr;
+    }
+
+    // 从FIL_PAGE_TYPE开始的压缩数据的长度
+    uint32_t size = mach_read_from_2(ptr);
+    // 压缩page尾部的未压缩字段和dense page directory的长度
+    uint32_t trailer_size = mach_read_from_2(ptr + 2);
+    ptr += 4;
+
+    if (end_ptr < ptr + 8 + size + trailer_size) {
+        return nullptr;
+    }
+
+    // 下面是Apply的逻辑
+    if (page) {
+        if (FIL_PAGE_TYPE + size + trailer_size > zip_size) {
+            return nullptr;
+        }
+        std::memcpy(page + FIL_PAGE_PREV, ptr, 4);
+        std::memcpy(page + FIL_PAGE_NEXT, ptr + 4, 4);
+        std::memcpy(page + FIL_PAGE_TYPE, ptr + 8, size);
+        std::memset(page + FIL_PAGE_TYPE + size, 0, zip_size - trailer_size - (FIL_PAGE_TYPE + size));
+        std::memcpy(page + zip_size - trailer_size, ptr + 8 + size, trailer_size);
+    }
+
+    return ptr + 8 + size + trailer_size;
+}
+
+/**
+MLOG_ZIP_PAGE_COMPRESS_NO_DATA的log body，前面是mlog_parse_index解析的索引信息
+@return end of log record or nullptr */
+static byte* ParseZipPageCompressNoData(byte* ptr, const byte* end_ptr) {
+    if (ptr == end_ptr) {
+        return nullptr;
+    }
+
+    // 压缩级别
+    uint8_t level = mach_read_from_1(ptr);
+    assert(level <= 9);
+    return ptr + 1;
+}
+
 
 static inline uint32_t page_header_get_field(
     const byte*	page,	/*!< in: page */
@@ -2826,6 +3082,40 @@ bool ApplyCompRecDelete(const LogEntry &log, Page *page) {
     return true;
 }
 
+bool ParseCompRecOffset(const LogEntry &log, RecordInfo &rec_info, uint32_t &offset) {
+    const byte *ptr = log.log_body_start_ptr_;
+    const byte *end_ptr = log.log_body_end_ptr_;
+    ptr = ParseRecInfoFromLog(ptr, end_ptr, rec_info, true);
+    if (ptr == nullptr) {
+        return false;
+    }
+    switch (log.type_) {
+        case MLOG_COMP_REC_INSERT:
+        case MLOG_COMP_REC_DELETE:
+            break;
+        case MLOG_COMP_REC_CLUST_DELETE_MARK:
+            // flags和val之后是DB_TRX_ID和DB_ROLL_PTR
+            if (end_ptr < ptr + 2) {
+                return false;
+            }
+            ptr = row_upd_parse_sys_vals(ptr + 2, end_ptr);
+            break;
+        case MLOG_COMP_REC_UPDATE_IN_PLACE:
+            if (end_ptr < ptr + 1) {
+                return false;
+            }
+            ptr = row_upd_parse_sys_vals(ptr + 1, end_ptr);
+            break;
+        default:
+            return false;
+    }
+    if (ptr == nullptr || end_ptr < ptr + 2) {
+        return false;
+    }
+    offset = mach_read_from_2(ptr);
+    return offset < DATA_PAGE_SIZE;
+}
+
 /************************************************************//**
 Returns the sum of the sizes of the records in the record list, excluding
 the infimum and supremum records.
@@ -3279,6 +3569,51 @@ bool ApplyCompListDelete(const LogEntry &log, Page *page) {
 }
 
 
+bool ApplyUndoInsert(const LogEntry &log, Page *page) {
+    return PARSE_OR_APPLY_ADD_UNDO_REC(log.log_body_start_ptr_, log.log_body_end_ptr_, page->GetData()) != nullptr;
+}
+
+bool ApplyUndoEraseEnd(const LogEntry &log, Page *page) {
+    return PARSE_OR_APPLY_UNDO_ERASE_PAGE_END(log.log_body_start_ptr_, log.log_body_end_ptr_, page->GetData()) != nullptr;
+}
+
+bool ApplyUndoInit(const LogEntry &log, Page *page) {
+    return PARSE_OR_APPLY_UNDO_PAGE_INIT(log.log_body_start_ptr_, log.log_body_end_ptr_, page->GetData()) != nullptr;
+}
+
+bool ApplyUndoHdrDiscard(const LogEntry &log, Page *page) {
+    return ParseOrApplyTrxUndoDiscardLatest(log.log_body_start_ptr_, log.log_body_end_ptr_, page->GetData()) != nullptr;
+}
+
+bool ApplyUndoHdrCreateOrReuse(const LogEntry &log, Page *page) {
+    return ParseOrApplyTrxUndoPageHeader(log.type_, log.log_body_start_ptr_, log.log_body_end_ptr_,
+                                         page->GetData()) != nullptr;
+}
+
+bool ApplyRecMinMark(const LogEntry &log, Page *page) {
+    return ParseOrApplySetMinRecMark(log.log_body_start_ptr_, log.log_body_end_ptr_,
+                                     log.type_ == MLOG_COMP_REC_MIN_MARK, page->GetData()) != nullptr;
+}
+
+bool ApplyZipWriteNodePtr(const LogEntry &log, Page *page) {
+    return ParseOrApplyZipWriteField(log.log_body_start_ptr_, log.log_body_end_ptr_, REC_NODE_PTR_SIZE,
+                                     page->GetData(), page->GetPhysicalSize()) != nullptr;
+}
+
+bool ApplyZipWriteBlobPtr(const LogEntry &log, Page *page) {
+    return ParseOrApplyZipWriteField(log.log_body_start_ptr_, log.log_body_end_ptr_, BTR_EXTERN_FIELD_REF_SIZE,
+                                     page->GetData(), page->GetPhysicalSize()) != nullptr;
+}
+
+bool ApplyZipWriteHeader(const LogEntry &log, Page *page) {
+    return ParseOrApplyZipWriteHeader(log.log_body_start_ptr_, log.log_body_end_ptr_, page->GetData()) != nullptr;
+}
+
+bool ApplyZipPageCompress(const LogEntry &log, Page *page) {
+    return ParseOrApplyZipPageCompress(log.log_body_start_ptr_, log.log_body_end_ptr_,
+                                       page->GetData(), page->GetPhysicalSize()) != nullptr;
+}
+
 bool ApplyIBufBitmapInit(const LogEntry &log, Page *page) {
     byte *ptr = log.log_body_start_ptr_;
     byte *end_ptr = log.log_body_end_ptr_;
@@ -3287,7 +3622,8 @@ bool ApplyIBufBitmapInit(const LogEntry &log, Page *page) {
 
     /* Write all zeros to the bitmap */
 
-    uint32_t byte_offset = ((DATA_PAGE_SIZE * IBUF_BITS_PER_PAGE) + 7) / 8;
+    // 压缩表空间的bitmap按压缩之后的page大小计算
+    uint32_t byte_offset = ((page->GetPhysicalSize() * IBUF_BITS_PER_PAGE) + 7) / 8;
 
     std::memset(page->GetData() + IBUF_BITMAP, 0, byte_offset);
 
@@ -3511,12 +3847,22 @@ static byte* ParseSingleLogRecordBody(LOG_TYPE	type,
         case MLOG_WRITE_STRING:
             ptr = ParseOrApplyString(ptr, end_ptr, nullptr);
             break;
-            // ZIP页不管它
         case MLOG_ZIP_WRITE_NODE_PTR:
+            ptr = ParseOrApplyZipWriteField(ptr, end_ptr, REC_NODE_PTR_SIZE, nullptr, 0);
+            break;
         case MLOG_ZIP_WRITE_BLOB_PTR:
+            ptr = ParseOrApplyZipWriteField(ptr, end_ptr, BTR_EXTERN_FIELD_REF_SIZE, nullptr, 0);
+            break;
         case MLOG_ZIP_WRITE_HEADER:
+            ptr = ParseOrApplyZipWriteHeader(ptr, end_ptr, nullptr);
+            break;
         case MLOG_ZIP_PAGE_COMPRESS:
+            ptr = ParseOrApplyZipPageCompress(ptr, end_ptr, nullptr, 0);
+            break;
         case MLOG_ZIP_PAGE_COMPRESS_NO_DATA:
+            if (nullptr != (ptr = mlog_parse_index(ptr, end_ptr, true))) {
+                ptr = ParseZipPageCompressNoData(ptr, end_ptr);
+            }
             break;
         default:
             ptr = nullptr;
@@ -0,0 +1,108 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include "applier/log_recovery.h"
+#include "applier/log_log.h"
+#include "applier/applier_instance.h"
+#include "applier/interface.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+// 一次读8M，和log writer一次最多写的大小一样，copy_log_to_buf不能超过它
+static constexpr size_t RECOVERY_READ_SIZE = 8 << 10 << 10;
+
+// 从log group的group_off处读一段log，不跨文件，返回读到的字节数
+static size_t log_recovery_read(const log_group_t &log_group, const std::vector<int> &fds, size_t group_off,
+                                unsigned char *buf) {
+    auto n_file = group_off / log_group.per_file_size;
+    auto off_in_file = group_off % log_group.per_file_size;
+    auto len = std::min(RECOVERY_READ_SIZE, log_group.per_file_size - off_in_file);
+    auto res = pread(fds[n_file], buf, len, off_in_file);
+    return res == static_cast<ssize_t>(len) ? len : 0;
+}
+
+size_t log_recovery(ApplierInstance *applier, const std::vector<int> &fds) {
+    auto &log_group = applier->log_group;
+    auto start_time = std::chrono::steady_clock::now();
+    auto start_isn = log_group.written_isn.load();
+    for (auto fd: fds) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    auto group_size = log_group.per_file_size * log_group.log_file_number;
+    std::unique_ptr<unsigned char[]> bufs[2] {std::make_unique<unsigned char[]>(RECOVERY_READ_SIZE),
+                                              std::make_unique<unsigned char[]>(RECOVERY_READ_SIZE)};
+    int current = 0;
+    size_t group_off = log_group.start_offset;
+    auto pending = std::async(std::launch::async, log_recovery_read, std::cref(log_group), std::cref(fds), group_off, bufs[current].get());
+    uint32_t expected_block_no = 0; // 第一个block的号不用检查
+    bool end = false;
+    while (!end) {
+        auto len = pending.get();
+        if (len == 0) {
+            LogFatal(COMPONENT_INIT, "start nfs-ganesha failed, can not read log file for recovery, %s", strerror(errno));
+        }
+        auto *buf = bufs[current].get();
+        auto n_file = group_off / log_group.per_file_size;
+        auto off_in_file = group_off % log_group.per_file_size;
+
+        // 解析和apply这一段的同时，读下一段
+        auto next_off = (group_off + len) % group_size;
+        current ^= 1;
+        pending = std::async(std::launch::async, log_recovery_read, std::cref(log_group), std::cref(fds), next_off, bufs[current].get());
+
+        // 找到有效log的结尾：block号不连续说明是上一轮的log，data_len不满说明是最后一个block
+        size_t first = (off_in_file == 0 ? N_LOG_METADATA_BLOCKS : 0);
+        size_t n_valid = first;
+        for (size_t i = first; i < len / LOG_BLOCK_SIZE; ++i) {
+            auto *block = buf + i * LOG_BLOCK_SIZE;
+            auto block_no = mach_read_from_4(block + LOG_BLOCK_HDR_NO) & ~LOG_BLOCK_FLUSH_BIT_MASK;
+            auto data_len = mach_read_from_2(block + LOG_BLOCK_HDR_DATA_LEN);
+            if ((expected_block_no != 0 && block_no != expected_block_no) || data_len < LOG_BLOCK_HDR_SIZE) {
+                end = true;
+                break;
+            }
+            expected_block_no = (block_no & 0x3FFFFFFFUL) + 1;
+            n_valid = i + 1;
+            if (data_len < LOG_BLOCK_SIZE) {
+                end = true;
+                break;
+            }
+        }
+        if (n_valid > first) {
+            // 和log writer写进来的log走同一条路径
+            iovec iov {buf, n_valid * LOG_BLOCK_SIZE};
+            copy_log_to_buf(applier->group_no, static_cast<int>(n_file), off_in_file, &iov, 1);
+        }
+
+        group_off = next_off;
+        if (group_off == log_group.start_offset) {
+            // 整个log group都是有效的log
+            end = true;
+        }
+    }
+    pending.wait();
+
+    auto recovered = log_group.written_isn - start_isn;
+    auto scanned_time = std::chrono::steady_clock::now();
+    wait_until_parse_done(applier->group_no);
+    applier->apply_index.SealAndWaitApplied();
+    auto end_time = std::chrono::steady_clock::now();
+
+    auto ms = [](auto duration) {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    };
+    LogEvent(COMPONENT_INIT, "log group %d recovered %zu bytes log up to lsn %zu, scan %ld ms, total %ld ms",
+             applier->group_no, recovered, applier->log_parser.parsed_lsn, ms(scanned_time - start_time), ms(end_time - start_time));
+    return recovered;
+}
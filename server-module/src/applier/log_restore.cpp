@@ -0,0 +1,325 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+#include "applier/log_restore.h"
+#include "applier/applier_instance.h"
+#include "applier/interface.h"
+#include "applier/log_log.h"
+#include "applier/log_parse.h"
+#include "applier/redo_archive.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+// 在数据目录中记录恢复进度，只有一行：状态 lsn
+static constexpr const char *RESTORE_MARKER_FILE = "logdb_restore";
+// 一次交给log parser这么多，等log applier腾出空间
+static constexpr size_t RESTORE_FEED_SIZE = 8 << 10 << 10; // 8M
+
+enum class RestoreState {
+    NONE,       // 还没有开始
+    COPYING,    // 正在拷贝快照中的文件，数据目录中的文件都是这次拷贝的
+    COPIED,     // 快照已经拷贝完成，lsn是快照的lsn
+    RESTORED,   // 归档已经apply完成，lsn是恢复到的lsn
+};
+static constexpr const char *RESTORE_STATE_NAMES[] = {"none", "copying", "copied", "restored"};
+
+static std::string log_restore_marker_path(const LogGroupConfig &config) {
+    return config.data_file_prefix + "/" + RESTORE_MARKER_FILE;
+}
+
+static RestoreState log_restore_read_marker(const LogGroupConfig &config, lsn_t *lsn) {
+    auto path = log_restore_marker_path(config);
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp == nullptr) {
+        if (errno != ENOENT) {
+            LogFatal(COMPONENT_INIT, "can not open %s: %s", path.c_str(), strerror(errno));
+        }
+        return RestoreState::NONE;
+    }
+    char name[16];
+    uint64_t value = 0;
+    auto n = fscanf(fp, "%15s %" SCNu64, name, &value);
+    fclose(fp);
+    for (int state = static_cast<int>(RestoreState::COPYING); n == 2 && state <= static_cast<int>(RestoreState::RESTORED);
+         ++state) {
+        if (strcmp(name, RESTORE_STATE_NAMES[state]) == 0) {
+            *lsn = value;
+            return static_cast<RestoreState>(state);
+        }
+    }
+    LogFatal(COMPONENT_INIT, "restore progress file %s is damaged", path.c_str());
+    return RestoreState::NONE;
+}
+
+// 先写临时文件再rename，崩溃之后读到的要么是之前的状态，要么是新的状态
+static void log_restore_write_marker(const LogGroupConfig &config, RestoreState state, lsn_t lsn) {
+    auto path = log_restore_marker_path(config);
+    auto tmp_path = path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "w");
+    if (fp == nullptr || fprintf(fp, "%s %" PRIu64 "\n", RESTORE_STATE_NAMES[static_cast<int>(state)], lsn) < 0
+        || fflush(fp) != 0 || fsync(fileno(fp)) != 0 || fclose(fp) != 0
+        || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        LogFatal(COMPONENT_INIT, "can not write restore progress file %s: %s", path.c_str(), strerror(errno));
+    }
+}
+
+// 读出快照的lsn和其中每个文件相对于快照目录的位置，格式见create_snapshot
+static lsn_t log_restore_read_snapshot(const std::string &snapshot, std::vector<std::string> *files) {
+    auto path = snapshot + "/" + SNAPSHOT_INFO_FILE;
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp == nullptr) {
+        LogFatal(COMPONENT_INIT, "can not open snapshot %s: %s", path.c_str(), strerror(errno));
+    }
+    uint64_t lsn = 0;
+    if (fscanf(fp, "lsn %" SCNu64 "\n", &lsn) != 1) {
+        LogFatal(COMPONENT_INIT, "snapshot %s has no lsn", path.c_str());
+    }
+    char line[PATH_MAX + 32];
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        line[strcspn(line, "\n")] = '\0';
+        // space_id和文件的位置，位置中可能有空格
+        auto *relative_path = strchr(line, ' ');
+        if (relative_path == nullptr || relative_path[1] == '\0') {
+            LogFatal(COMPONENT_INIT, "snapshot %s is damaged", path.c_str());
+        }
+        files->emplace_back(relative_path + 1);
+    }
+    fclose(fp);
+    return lsn;
+}
+
+// 系统表空间和undo表空间拷贝到System_File_Path，其它文件按相对位置拷贝到数据目录
+static std::string log_restore_destination(const LogGroupConfig &config, const std::string &relative_path) {
+    for (auto system_file: SYSTEM_FILES) {
+        if (relative_path == system_file) {
+            return config.system_file_prefix + relative_path;
+        }
+    }
+    return config.data_file_prefix + "/" + relative_path;
+}
+
+static void log_restore_copy_files(ApplierInstance *applier, const std::vector<std::string> &files) {
+    const auto &config = applier->config;
+    auto start_time = std::chrono::steady_clock::now();
+    size_t n_cloned = 0;
+    for (const auto &relative_path: files) {
+        auto src_path = config.restore_snapshot + "/" + relative_path;
+        auto dst_path = log_restore_destination(config, relative_path);
+        int src_fd = open(src_path.c_str(), O_RDONLY);
+        int dst_fd = -1;
+        if (src_fd >= 0 && MakeParentDirectories(dst_path)) {
+            dst_fd = open(dst_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        bool cloned = false;
+        if (dst_fd < 0 || CloneFile(src_fd, dst_fd, SNAPSHOT_COPY_CHUNK, nullptr, nullptr, &cloned) != 0
+            || fsync(dst_fd) != 0) {
+            LogFatal(COMPONENT_INIT, "can not copy %s to %s: %s", src_path.c_str(), dst_path.c_str(), strerror(errno));
+        }
+        n_cloned += cloned;
+        close(src_fd);
+        close(dst_fd);
+    }
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                                            - start_time).count();
+    LogEvent(COMPONENT_INIT, "log group %d copied %zu files (%zu cloned) from snapshot %s, %lld ms",
+             applier->group_no, files.size(), n_cloned, config.restore_snapshot.c_str(),
+             static_cast<long long>(elapsed_ms));
+}
+
+// 恢复到的lsn，Restore_Lsn为0时是归档的结尾
+static lsn_t log_restore_target(ApplierInstance *applier) {
+    const auto &config = applier->config;
+    auto last_lsn = applier->redo_archive.LastLsn();
+    if (config.restore_lsn == 0) {
+        return last_lsn;
+    }
+    if (config.restore_lsn > last_lsn) {
+        LogFatal(COMPONENT_INIT, "redo archive %s ends at lsn %" PRIu64 ", before Restore_Lsn %" PRIu64,
+                 config.redo_archive_path.c_str(), last_lsn, config.restore_lsn);
+    }
+    return config.restore_lsn;
+}
+
+lsn_t log_restore_prepare(ApplierInstance *applier, bool *need_replay) {
+    const auto &config = applier->config;
+    *need_replay = false;
+    lsn_t marker_lsn = 0;
+    auto state = log_restore_read_marker(config, &marker_lsn);
+    if (state == RestoreState::RESTORED) {
+        LogEvent(COMPONENT_INIT, "log group %d was restored to lsn %" PRIu64 " from snapshot %s",
+                 applier->group_no, marker_lsn, config.restore_snapshot.c_str());
+        return marker_lsn;
+    }
+
+    std::vector<std::string> files;
+    auto snapshot_lsn = log_restore_read_snapshot(config.restore_snapshot, &files);
+    if (state != RestoreState::NONE && marker_lsn != snapshot_lsn) {
+        LogFatal(COMPONENT_INIT, "data directory %s is being restored from a snapshot at lsn %" PRIu64
+                 ", not %s", config.data_file_prefix.c_str(), marker_lsn, config.restore_snapshot.c_str());
+    }
+    if (config.restore_lsn != 0 && config.restore_lsn < snapshot_lsn) {
+        LogFatal(COMPONENT_INIT, "Restore_Lsn %" PRIu64 " is before the lsn %" PRIu64 " of snapshot %s",
+                 config.restore_lsn, snapshot_lsn, config.restore_snapshot.c_str());
+    }
+    if (state == RestoreState::NONE) {
+        // 不是上次拷贝了一半的文件不能覆盖
+        for (const auto &relative_path: files) {
+            auto dst_path = log_restore_destination(config, relative_path);
+            if (access(dst_path.c_str(), F_OK) == 0) {
+                LogFatal(COMPONENT_INIT, "can not restore snapshot %s, %s already exists",
+                         config.restore_snapshot.c_str(), dst_path.c_str());
+            }
+        }
+        if (!MakeParentDirectories(log_restore_marker_path(config))) {
+            LogFatal(COMPONENT_INIT, "can not create data directory %s: %s", config.data_file_prefix.c_str(),
+                     strerror(errno));
+        }
+        log_restore_write_marker(config, RestoreState::COPYING, snapshot_lsn);
+    }
+    if (state != RestoreState::COPIED) {
+        log_restore_copy_files(applier, files);
+        log_restore_write_marker(config, RestoreState::COPIED, snapshot_lsn);
+    }
+
+    applier->redo_archive.Load();
+    auto target_lsn = log_restore_target(applier);
+    if (target_lsn <= snapshot_lsn) {
+        LogWarn(COMPONENT_INIT, "log group %d: redo archive %s has no logs after snapshot lsn %" PRIu64,
+                applier->group_no, config.redo_archive_path.c_str(), snapshot_lsn);
+        log_restore_write_marker(config, RestoreState::RESTORED, snapshot_lsn);
+        return snapshot_lsn;
+    }
+    RedoArchiveFrame frame;
+    if (applier->redo_archive.ReadFrame(snapshot_lsn, &frame) != 0) {
+        LogFatal(COMPONENT_INIT, "redo archive %s has no logs at snapshot lsn %" PRIu64,
+                 config.redo_archive_path.c_str(), snapshot_lsn);
+    }
+    *need_replay = true;
+    // 快照的lsn可能在一个mtr的中间，从frame的开头解析，快照中已经有的log按page lsn跳过
+    return frame.start_lsn;
+}
+
+// [begin, end)从lsn开始，返回其中结尾不晚于target_lsn的最后一个mtr的结尾，mtr没有结束的log不apply
+static const byte *log_restore_cut(const byte *begin, const byte *end, lsn_t lsn, lsn_t target_lsn,
+                                   lsn_t *cut_lsn) {
+    const byte *cut = begin;
+    *cut_lsn = lsn;
+    for (const byte *ptr = begin; ptr < end;) {
+        LOG_TYPE type;
+        space_id_t space_id;
+        page_id_t page_id;
+        byte *body = nullptr;
+        bool is_single = false, is_multi_end = false;
+        auto len = ParseSingleLogRecord(type, ptr, end, space_id, page_id, &body, is_single, is_multi_end);
+        if (len == 0) {
+            break;
+        }
+        ptr += len;
+        lsn = recv_calc_lsn_on_data_add(lsn, len);
+        if (lsn > target_lsn) {
+            break;
+        }
+        if (is_single || is_multi_end) {
+            cut = ptr;
+            *cut_lsn = lsn;
+        }
+    }
+    return cut;
+}
+
+// 和log writer一样把log写进log buf，窗口满了就等log applier，恢复时没有log要溢出到ib_logfile
+static void log_restore_feed(ApplierInstance *applier, const byte *log, size_t len) {
+    auto &log_group = applier->log_group;
+    while (len > 0) {
+        auto chunk = std::min(len, RESTORE_FEED_SIZE);
+        PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+        while (log_group.written_capacity < chunk) {
+            pthread_cond_wait(&applier->log_write_condition, &applier->log_group_mutex);
+        }
+        PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
+
+        std::memcpy(log_group.log_buf + log_group.written_isn % log_group.log_ring_size, log, chunk);
+        log_group.written_offset = (log_group.written_offset + chunk) % log_group.log_buf_size;
+
+        PTHREAD_MUTEX_lock(&applier->log_group_mutex);
+        log_group.written_capacity -= chunk;
+        log_group.need_to_parse += chunk;
+        log_group.written_isn += chunk;
+        log_group.filled_isn += chunk;
+        pthread_cond_signal(&applier->log_parse_condition);
+        PTHREAD_MUTEX_unlock(&applier->log_group_mutex);
+        log += chunk;
+        len -= chunk;
+    }
+}
+
+lsn_t log_restore(ApplierInstance *applier, lsn_t start_lsn) {
+    const auto &config = applier->config;
+    auto &archive = applier->redo_archive;
+    auto start_time = std::chrono::steady_clock::now();
+    auto target_lsn = log_restore_target(applier);
+
+    // apply这一个frame的同时，读下一个frame并解压
+    RedoArchiveFrame frames[2];
+    int current = 0;
+    auto pending = std::async(std::launch::async, &RedoArchive::ReadFrame, &archive, start_lsn, &frames[current]);
+    lsn_t lsn = start_lsn;
+    size_t restored = 0;
+    for (;;) {
+        if (pending.get() != 0) {
+            LogFatal(COMPONENT_INIT, "redo archive %s has no logs at lsn %" PRIu64 ", can not restore to %" PRIu64,
+                     config.redo_archive_path.c_str(), lsn, target_lsn);
+        }
+        const auto &frame = frames[current];
+        bool last = frame.end_lsn >= target_lsn;
+        current ^= 1;
+        if (!last) {
+            pending = std::async(std::launch::async, &RedoArchive::ReadFrame, &archive, frame.end_lsn,
+                                 &frames[current]);
+        }
+
+        const byte *begin = frame.data.data() + recv_calc_data_len(frame.start_lsn, lsn);
+        const byte *end = frame.data.data() + frame.data.size();
+        if (last) {
+            end = log_restore_cut(begin, end, lsn, target_lsn, &lsn);
+        } else {
+            lsn = frame.end_lsn;
+        }
+        log_restore_feed(applier, begin, end - begin);
+        restored += end - begin;
+        if (last) {
+            break;
+        }
+    }
+
+    auto scanned_time = std::chrono::steady_clock::now();
+    wait_until_parse_done(applier->group_no);
+    applier->apply_index.SealAndWaitApplied();
+    applier->buffer_pool.SyncDataFiles();
+    applier->page_lsn_map.Checkpoint(&applier->buffer_pool);
+    log_restore_write_marker(config, RestoreState::RESTORED, lsn);
+    auto end_time = std::chrono::steady_clock::now();
+
+    auto ms = [](auto duration) {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    };
+    LogEvent(COMPONENT_INIT, "log group %d restored %zu bytes log from lsn %" PRIu64 " to lsn %" PRIu64
+             ", read %ld ms, total %ld ms", applier->group_no, restored, start_lsn, lsn,
+             ms(scanned_time - start_time), ms(end_time - start_time));
+    return lsn;
+}
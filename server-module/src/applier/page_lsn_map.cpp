@@ -0,0 +1,174 @@
+#include <unistd.h>
+#include <memory>
+#include "applier/page_lsn_map.h"
+#include "applier/buffer_pool.h"
+#include "applier/log_log.h"
+#include "applier/applier_instance.h"
+#include "applier/utility.h"
+#include "rocksdb/db.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+PageLsnMap::PageLsnMap() {
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_mutex_init(&checkpoint_lock_, nullptr);
+}
+
+PageLsnMap::~PageLsnMap() {
+    if (db_ != nullptr) {
+        db_->Close();
+        delete db_;
+    }
+    pthread_mutex_destroy(&lock_);
+    pthread_mutex_destroy(&checkpoint_lock_);
+}
+
+std::string PageLsnMap::ChunkKey(space_id_t space_id, uint32_t chunk_no) {
+    std::string key(8, '\0');
+    auto *buf = reinterpret_cast<byte *>(key.data());
+    mach_write_to_4(buf, space_id);
+    mach_write_to_4(buf + 4, chunk_no);
+    return key;
+}
+
+bool PageLsnMap::Open(const std::string &path) {
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    auto status = rocksdb::DB::Open(options, path, &db_);
+    if (!status.ok()) {
+        LogCrit(COMPONENT_INIT, "can not open page lsn map %s: %s", path.c_str(), status.ToString().c_str());
+        db_ = nullptr;
+        return false;
+    }
+
+    PthreadMutexGuard guard(lock_);
+    size_t n_chunks = 0;
+    std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(rocksdb::ReadOptions()));
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        auto key = iter->key();
+        auto value = iter->value();
+        if (key.size() != 8 || value.size() != PAGE_LSN_MAP_CHUNK_PAGES * sizeof(lsn_t)) {
+            continue;
+        }
+        auto *key_buf = reinterpret_cast<const byte *>(key.data());
+        auto *value_buf = reinterpret_cast<const byte *>(value.data());
+        auto &lsns = spaces_[mach_read_from_4(key_buf)];
+        size_t first_page = static_cast<size_t>(mach_read_from_4(key_buf + 4)) * PAGE_LSN_MAP_CHUNK_PAGES;
+        if (lsns.size() < first_page + PAGE_LSN_MAP_CHUNK_PAGES) {
+            lsns.resize(first_page + PAGE_LSN_MAP_CHUNK_PAGES, 0);
+        }
+        for (size_t i = 0; i < PAGE_LSN_MAP_CHUNK_PAGES; ++i) {
+            lsns[first_page + i] = mach_read_from_8(value_buf + i * sizeof(lsn_t));
+        }
+        n_chunks++;
+    }
+    LogEvent(COMPONENT_INIT, "page lsn map loaded %zu chunks of %zu spaces", n_chunks, spaces_.size());
+    return true;
+}
+
+lsn_t PageLsnMap::Get(space_id_t space_id, page_id_t page_id) {
+    PthreadMutexGuard guard(lock_);
+    auto iter = spaces_.find(space_id);
+    if (iter == spaces_.end() || page_id >= iter->second.size()) {
+        return 0;
+    }
+    return iter->second[page_id];
+}
+
+void PageLsnMap::Update(space_id_t space_id, page_id_t page_id, lsn_t lsn) {
+    PthreadMutexGuard guard(lock_);
+    auto &lsns = spaces_[space_id];
+    if (page_id >= lsns.size()) {
+        lsns.resize((page_id / PAGE_LSN_MAP_CHUNK_PAGES + 1) * PAGE_LSN_MAP_CHUNK_PAGES, 0);
+    }
+    if (lsns[page_id] == lsn) {
+        return;
+    }
+    lsns[page_id] = lsn;
+    dirty_chunks_.insert((static_cast<uint64_t>(space_id) << 32) | (page_id / PAGE_LSN_MAP_CHUNK_PAGES));
+}
+
+void PageLsnMap::DropSpace(space_id_t space_id) {
+    // 不能和checkpoint交错，否则checkpoint会把删掉的chunk再写回去
+    PthreadMutexGuard checkpoint_guard(checkpoint_lock_);
+    {
+        PthreadMutexGuard guard(lock_);
+        spaces_.erase(space_id);
+        for (auto iter = dirty_chunks_.begin(); iter != dirty_chunks_.end();) {
+            iter = static_cast<space_id_t>(*iter >> 32) == space_id ? dirty_chunks_.erase(iter) : std::next(iter);
+        }
+    }
+    if (db_ == nullptr) {
+        return;
+    }
+    auto begin = ChunkKey(space_id, 0);
+    auto end = ChunkKey(space_id, UINT32_MAX);
+    rocksdb::WriteBatch batch;
+    batch.DeleteRange(begin, end);
+    batch.Delete(end);
+    auto status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LogCrit(COMPONENT_FSAL, "drop space %u from page lsn map failed: %s", space_id, status.ToString().c_str());
+    }
+}
+
+void PageLsnMap::Checkpoint(BufferPool *buffer_pool) {
+    if (db_ == nullptr) {
+        return;
+    }
+    // 两次checkpoint不能交错，否则旧的快照可能覆盖新的
+    PthreadMutexGuard checkpoint_guard(checkpoint_lock_);
+    rocksdb::WriteBatch batch;
+    std::vector<uint64_t> chunks;
+    {
+        PthreadMutexGuard guard(lock_);
+        if (dirty_chunks_.empty()) {
+            return;
+        }
+        std::string value(PAGE_LSN_MAP_CHUNK_PAGES * sizeof(lsn_t), '\0');
+        auto *value_buf = reinterpret_cast<byte *>(value.data());
+        for (auto chunk: dirty_chunks_) {
+            auto space_id = static_cast<space_id_t>(chunk >> 32);
+            auto chunk_no = static_cast<uint32_t>(chunk);
+            const auto &lsns = spaces_[space_id];
+            for (size_t i = 0; i < PAGE_LSN_MAP_CHUNK_PAGES; ++i) {
+                mach_write_to_8(value_buf + i * sizeof(lsn_t), lsns[chunk_no * PAGE_LSN_MAP_CHUNK_PAGES + i]);
+            }
+            batch.Put(ChunkKey(space_id, chunk_no), value);
+            chunks.push_back(chunk);
+        }
+        dirty_chunks_.clear();
+    }
+
+    // 快照中的lsn对应的page都已经写进了数据文件，先让它们落盘，再持久化lsn
+    buffer_pool->SyncDataFiles();
+    rocksdb::WriteOptions write_options;
+    write_options.sync = true;
+    auto status = db_->Write(write_options, &batch);
+    if (!status.ok()) {
+        LogCrit(COMPONENT_FSAL, "page lsn map checkpoint failed: %s", status.ToString().c_str());
+        PthreadMutexGuard guard(lock_);
+        dirty_chunks_.insert(chunks.begin(), chunks.end());
+    }
+}
+
+static pthread_t page_lsn_map_thread_id;
+
+static void *page_lsn_map_routine(void *) {
+    for (;;) {
+        usleep(PAGE_LSN_MAP_CHECKPOINT_INTERVAL_MS * 1000);
+        for (auto &applier: appliers) {
+            applier->page_lsn_map.Checkpoint(&applier->buffer_pool);
+        }
+    }
+}
+
+void page_lsn_map_thread_start() {
+    START_THREAD("page lsn map checkpoint", &page_lsn_map_thread_id, page_lsn_map_routine, nullptr);
+}
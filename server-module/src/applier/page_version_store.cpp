@@ -0,0 +1,234 @@
+#include <unistd.h>
+#include <cstring>
+#include "applier/page_version_store.h"
+#include "applier/log_apply.h"
+#include "applier/applier_instance.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+PageVersionStore::PageVersionStore(ApplyIndex *apply_index) : apply_index_(apply_index) {
+    pthread_mutex_init(&lock_, nullptr);
+}
+
+PageVersionStore::~PageVersionStore() {
+    pthread_mutex_destroy(&lock_);
+}
+
+uint64_t PageVersionStore::RegisterView(lsn_t lsn) {
+    PthreadMutexGuard guard(lock_);
+    if (!views_enabled_) {
+        // 压缩过的log链丢掉了horizon之前的中间版本
+        views_horizon_ = apply_index_->DisableCompaction();
+        views_enabled_ = true;
+        LogEvent(COMPONENT_FSAL, "read views enabled from lsn %" PRIu64, views_horizon_);
+    }
+    // 取出过的log已经apply到page上，只有更老的read view让它们的镜像保留了下来
+    if (lsn < views_horizon_ || (lsn < oldest_view_lsn_ && lsn < apply_index_->ExtractedLsn())) {
+        if (views_.empty()) {
+            DisableViewsLocked();
+        }
+        return 0;
+    }
+    auto view_id = next_view_id_++;
+    views_[view_id] = {lsn, std::chrono::steady_clock::now()};
+    RefreshOldestLocked();
+    return view_id;
+}
+
+bool PageVersionStore::UpdateView(uint64_t view_id, lsn_t lsn) {
+    PthreadMutexGuard guard(lock_);
+    auto iter = views_.find(view_id);
+    if (iter == views_.end()) {
+        return false;
+    }
+    // 只读节点的回放只会向前推进
+    iter->second.lsn = std::max(iter->second.lsn, lsn);
+    iter->second.refreshed = std::chrono::steady_clock::now();
+    RefreshOldestLocked();
+    return true;
+}
+
+void PageVersionStore::ReleaseView(uint64_t view_id) {
+    PthreadMutexGuard guard(lock_);
+    views_.erase(view_id);
+    RefreshOldestLocked();
+    if (views_.empty() && views_enabled_) {
+        DisableViewsLocked();
+    }
+}
+
+void PageVersionStore::Retain(const PageAddress &page_address, const Page &page, const std::list<LogEntry> &chain) {
+    if (!views_enabled_ || chain.empty()) {
+        return;
+    }
+    PthreadMutexGuard guard(lock_);
+    auto iter = histories_.find(page_address);
+    if (iter == histories_.end()) {
+        if (chain.back().log_start_lsn_ < oldest_view_lsn_) {
+            return;
+        }
+        iter = histories_.emplace(page_address, PageHistory()).first;
+        // 压缩表空间的page只占压缩之后的大小
+        iter->second.base = std::make_unique<Page>(page);
+        iter->second.memory_usage = page.GetPhysicalSize();
+        memory_usage_ += page.GetPhysicalSize();
+    }
+    // 镜像之后apply的log必须全部保留，否则从镜像重放出来的page会缺少修改
+    auto &history = iter->second;
+    for (const auto &log: chain) {
+        // log body可能指向log buffer，拷贝一份
+        history.logs.emplace_back(log.type_, log.space_id_, log.page_id_, log.log_start_lsn_,
+                                  log.log_len_, log.log_body_start_ptr_, log.log_body_end_ptr_);
+        auto log_size = history.logs.back().MemorySize();
+        history.memory_usage += log_size;
+        memory_usage_ += log_size;
+    }
+}
+
+PageVersionStore::ReadResult PageVersionStore::Read(const PageAddress &page_address, const Page &current,
+                                                    lsn_t lsn, byte *dest_buf) {
+    PthreadMutexGuard guard(lock_);
+    auto iter = histories_.find(page_address);
+    if (iter == histories_.end()) {
+        return current.GetLSN() <= lsn ? ReadResult::CURRENT : ReadResult::TOO_OLD;
+    }
+    const auto &history = iter->second;
+    if (history.base->GetLSN() > lsn) {
+        return ReadResult::TOO_OLD;
+    }
+    Page page(*history.base);
+    for (const auto &log: history.logs) {
+        if (log.log_start_lsn_ >= lsn) {
+            break;
+        }
+        if (page.GetLSN() > log.log_start_lsn_) {
+            continue;
+        }
+        if (log_apply_apply_one_log(&page, log)) {
+            page.WritePageLSN(log.log_start_lsn_ + log.log_len_);
+            page.WriteCheckSum(BUF_NO_CHECKSUM_MAGIC);
+        }
+    }
+    std::memcpy(dest_buf, page.GetData(), page.GetPhysicalSize());
+    return ReadResult::MATERIALISED;
+}
+
+std::vector<page_id_t> PageVersionStore::SpacePages(space_id_t space_id) {
+    PthreadMutexGuard guard(lock_);
+    std::vector<page_id_t> res;
+    for (const auto &item: histories_) {
+        if (item.first.SpaceId() == space_id) {
+            res.push_back(item.first.PageId());
+        }
+    }
+    return res;
+}
+
+void PageVersionStore::DropSpace(space_id_t space_id) {
+    PthreadMutexGuard guard(lock_);
+    for (auto iter = histories_.begin(); iter != histories_.end();) {
+        if (iter->first.SpaceId() == space_id) {
+            memory_usage_ -= iter->second.memory_usage;
+            iter = histories_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void PageVersionStore::Purge() {
+    PthreadMutexGuard guard(lock_);
+    auto now = std::chrono::steady_clock::now();
+    for (auto iter = views_.begin(); iter != views_.end();) {
+        if (now - iter->second.refreshed > std::chrono::seconds(PAGE_VERSION_VIEW_TIMEOUT_S)) {
+            LogEvent(COMPONENT_FSAL, "read view %" PRIu64 " at lsn %" PRIu64 " expired",
+                     iter->first, iter->second.lsn);
+            iter = views_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    RefreshOldestLocked();
+
+    for (;;) {
+        auto oldest = oldest_view_lsn_.load();
+        for (auto iter = histories_.begin(); iter != histories_.end();) {
+            RollForwardLocked(&iter->second, oldest);
+            if (iter->second.logs.empty()) {
+                // 镜像之后没有log了，buffer pool中的page就是它
+                memory_usage_ -= iter->second.memory_usage;
+                iter = histories_.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        if (memory_usage_ <= PAGE_VERSION_MEMORY_BUDGET || views_.empty()) {
+            break;
+        }
+        // 保留的版本太多，放弃最老的read view
+        auto victim = std::min_element(views_.begin(), views_.end(), [](const auto &a, const auto &b) {
+            return a.second.lsn < b.second.lsn;
+        });
+        LogCrit(COMPONENT_FSAL, "page versions use %zu bytes, dropping read view %" PRIu64 " at lsn %" PRIu64,
+                memory_usage_, victim->first, victim->second.lsn);
+        views_.erase(victim);
+        RefreshOldestLocked();
+    }
+    if (views_.empty() && views_enabled_) {
+        DisableViewsLocked();
+    }
+}
+
+void PageVersionStore::RefreshOldestLocked() {
+    lsn_t oldest = LSN_MAX;
+    for (const auto &[view_id, view]: views_) {
+        oldest = std::min(oldest, view.lsn);
+    }
+    oldest_view_lsn_ = oldest;
+}
+
+void PageVersionStore::DisableViewsLocked() {
+    views_enabled_ = false;
+    views_horizon_ = LSN_MAX;
+    histories_.clear();
+    memory_usage_ = 0;
+    apply_index_->EnableCompaction();
+    LogEvent(COMPONENT_FSAL, "last read view released, read views disabled");
+}
+
+void PageVersionStore::RollForwardLocked(PageHistory *history, lsn_t lsn) {
+    auto *page = history->base.get();
+    while (!history->logs.empty() && history->logs.front().log_start_lsn_ < lsn) {
+        const auto &log = history->logs.front();
+        if (page->GetLSN() <= log.log_start_lsn_ && log_apply_apply_one_log(page, log)) {
+            page->WritePageLSN(log.log_start_lsn_ + log.log_len_);
+            page->WriteCheckSum(BUF_NO_CHECKSUM_MAGIC);
+        }
+        auto log_size = log.MemorySize();
+        history->memory_usage -= log_size;
+        memory_usage_ -= log_size;
+        history->logs.pop_front();
+    }
+}
+
+static pthread_t page_version_purge_thread_id;
+
+static void *page_version_purge_routine(void *) {
+    for (;;) {
+        usleep(PAGE_VERSION_PURGE_INTERVAL_MS * 1000);
+        for (auto &applier: appliers) {
+            applier->page_version_store.Purge();
+        }
+    }
+}
+
+void page_version_purge_thread_start() {
+    START_THREAD("page version purge", &page_version_purge_thread_id, page_version_purge_routine, nullptr);
+}
@@ -59,6 +59,13 @@ void rec_set_info_bits_new(byte*	rec, uint32_t bits) {
 }
 
 
+void rec_set_info_bits_old(byte*	rec, uint32_t bits) {
+  assert(rec_info_bits_valid(bits));
+  rec_set_bit_field_1(rec, bits, REC_OLD_INFO_BITS,
+                      REC_INFO_BITS_MASK, REC_INFO_BITS_SHIFT);
+}
+
+
 /******************************************************//**
 The following function retrieves the status bits of a new-style record.
 @return status bits */
@@ -0,0 +1,375 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zstd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include "applier/redo_archive.h"
+#include "applier/applier_instance.h"
+#include "applier/log_log.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+static constexpr const char *REDO_ARCHIVE_SEGMENT_SUFFIX = ".redo";
+// start_lsn(8) end_lsn(8) raw_len(4) comp_len(4)
+static constexpr size_t REDO_ARCHIVE_FRAME_HEADER_SIZE = 24;
+
+struct RedoArchiveFrameHeader {
+    lsn_t start_lsn;
+    lsn_t end_lsn;
+    uint32_t raw_len;
+    uint32_t comp_len;
+};
+
+/**
+ * 读出segment中offset处的frame头，frame写了一半或者不属于这个segment时返回false
+ * @param start_lsn frame应当从这里开始
+ */
+static bool redo_archive_read_header(int fd, size_t offset, size_t size, lsn_t start_lsn,
+                                     RedoArchiveFrameHeader *header) {
+    byte buf[REDO_ARCHIVE_FRAME_HEADER_SIZE];
+    if (offset + sizeof(buf) > size || pread(fd, buf, sizeof(buf), offset) != static_cast<ssize_t>(sizeof(buf))) {
+        return false;
+    }
+    header->start_lsn = mach_read_from_8(buf);
+    header->end_lsn = mach_read_from_8(buf + 8);
+    header->raw_len = mach_read_from_4(buf + 16);
+    header->comp_len = mach_read_from_4(buf + 20);
+    return header->start_lsn == start_lsn && header->end_lsn > header->start_lsn && header->raw_len != 0
+           && header->raw_len == recv_calc_data_len(header->start_lsn, header->end_lsn)
+           && offset + sizeof(buf) + header->comp_len <= size;
+}
+
+static bool redo_archive_write_all(int fd, const byte *buf, size_t size) {
+    while (size > 0) {
+        auto n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+RedoArchive::RedoArchive(const LogGroupConfig &config) :
+        path_(config.redo_archive_path),
+        enabled_(config.redo_archive),
+        max_size_(config.redo_archive_max_size) {
+    pthread_mutex_init(&queue_mutex_, nullptr);
+    pthread_cond_init(&queue_cond_, nullptr);
+    pthread_cond_init(&drained_cond_, nullptr);
+    pthread_mutex_init(&segment_mutex_, nullptr);
+}
+
+RedoArchive::~RedoArchive() {
+    if (segment_fd_ >= 0) {
+        close(segment_fd_);
+    }
+    if (read_fd_ >= 0) {
+        close(read_fd_);
+    }
+    ZSTD_freeCCtx(cctx_);
+    pthread_mutex_destroy(&queue_mutex_);
+    pthread_cond_destroy(&queue_cond_);
+    pthread_cond_destroy(&drained_cond_);
+    pthread_mutex_destroy(&segment_mutex_);
+}
+
+void RedoArchive::Start(ApplierInstance *applier) {
+    applier_ = applier;
+    if (!Enabled()) {
+        return;
+    }
+    Load();
+    next_lsn_ = LastLsn();
+    cctx_ = ZSTD_createCCtx();
+    if (cctx_ == nullptr) {
+        LogFatal(COMPONENT_INIT, "can not create zstd context for redo archive");
+    }
+    START_THREAD("redo archive", &archive_thread_id_, ArchiveRoutine, this);
+    LogEvent(COMPONENT_INIT, "log group %d: redo archive in %s from lsn %" PRIu64 " to %" PRIu64,
+             applier->group_no, path_.c_str(), FirstLsn(), next_lsn_);
+}
+
+std::string RedoArchive::SegmentPath(lsn_t start_lsn) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%020" PRIu64 "%s", start_lsn, REDO_ARCHIVE_SEGMENT_SUFFIX);
+    return path_ + "/" + name;
+}
+
+void RedoArchive::Load() {
+    if (Enabled() && mkdir(path_.c_str(), 0755) != 0 && errno != EEXIST) {
+        LogFatal(COMPONENT_INIT, "can not create redo archive directory %s: %s", path_.c_str(), strerror(errno));
+    }
+    DIR *dir = opendir(path_.c_str());
+    if (dir == nullptr) {
+        LogFatal(COMPONENT_INIT, "can not open redo archive directory %s: %s", path_.c_str(), strerror(errno));
+    }
+    std::map<lsn_t, size_t> files;
+    size_t suffix_len = std::strlen(REDO_ARCHIVE_SEGMENT_SUFFIX);
+    while (auto *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() <= suffix_len
+            || name.compare(name.size() - suffix_len, suffix_len, REDO_ARCHIVE_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        char *end;
+        lsn_t start_lsn = strtoull(name.c_str(), &end, 10);
+        struct stat st {};
+        if (end != name.c_str() + name.size() - suffix_len || stat(SegmentPath(start_lsn).c_str(), &st) != 0) {
+            continue;
+        }
+        files[start_lsn] = st.st_size;
+    }
+    closedir(dir);
+
+    // 每个frame写完之后都fdatasync过，只有segment结尾的frame可能是写了一半的，截掉它
+    PthreadMutexGuard guard(segment_mutex_);
+    segments_.clear();
+    for (const auto &[start_lsn, size]: files) {
+        auto path = SegmentPath(start_lsn);
+        int fd = open(path.c_str(), Enabled() ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            LogFatal(COMPONENT_INIT, "can not open redo archive segment %s: %s", path.c_str(), strerror(errno));
+        }
+        size_t offset = 0;
+        lsn_t lsn = start_lsn;
+        RedoArchiveFrameHeader header {};
+        while (redo_archive_read_header(fd, offset, size, lsn, &header)) {
+            offset += REDO_ARCHIVE_FRAME_HEADER_SIZE + header.comp_len;
+            lsn = header.end_lsn;
+        }
+        if (offset != size) {
+            LogWarn(COMPONENT_INIT, "redo archive segment %s: %zu bytes of an incomplete frame at the end",
+                    path.c_str(), size - offset);
+            if (Enabled() && ftruncate(fd, offset) != 0) {
+                LogFatal(COMPONENT_INIT, "can not truncate %s: %s", path.c_str(), strerror(errno));
+            }
+        }
+        close(fd);
+        if (offset == 0) {
+            if (Enabled()) {
+                unlink(path.c_str());
+            }
+            continue;
+        }
+        segments_[start_lsn] = {lsn, offset};
+    }
+}
+
+lsn_t RedoArchive::FirstLsn() {
+    PthreadMutexGuard guard(segment_mutex_);
+    return segments_.empty() ? 0 : segments_.begin()->first;
+}
+
+lsn_t RedoArchive::LastLsn() {
+    PthreadMutexGuard guard(segment_mutex_);
+    return segments_.empty() ? 0 : segments_.rbegin()->second.end_lsn;
+}
+
+void RedoArchive::Append(lsn_t start_lsn, lsn_t end_lsn, const byte *log, size_t len) {
+    if (!Enabled() || end_lsn <= next_lsn_) {
+        return;
+    }
+    // 重启之后从checkpoint重新解析，已经归档的部分不再追加；next_lsn_总是在log的边界上
+    if (start_lsn < next_lsn_) {
+        auto skip = recv_calc_data_len(start_lsn, next_lsn_);
+        log += skip;
+        len -= skip;
+        start_lsn = next_lsn_;
+    } else if (start_lsn > next_lsn_ && next_lsn_ != 0) {
+        LogWarn(COMPONENT_FSAL, "log group %d: redo archive misses logs from lsn %" PRIu64 " to %" PRIu64,
+                applier_->group_no, next_lsn_, start_lsn);
+    }
+
+    PthreadMutexGuard guard(queue_mutex_);
+    // 归档线程跟不上时让log parser等待，而不是丢掉log
+    while (pending_bytes_ >= REDO_ARCHIVE_QUEUE_BYTES) {
+        pthread_cond_signal(&queue_cond_);
+        pthread_cond_wait(&drained_cond_, &queue_mutex_);
+    }
+    if (pending_.empty() || pending_.back().end_lsn != start_lsn
+        || pending_.back().data.size() >= REDO_ARCHIVE_FRAME_SIZE) {
+        pending_.emplace_back();
+        pending_.back().start_lsn = start_lsn;
+        pending_.back().data.reserve(REDO_ARCHIVE_FRAME_SIZE);
+    }
+    auto &frame = pending_.back();
+    frame.data.insert(frame.data.end(), log, log + len);
+    frame.end_lsn = end_lsn;
+    pending_bytes_ += len;
+    next_lsn_ = end_lsn;
+    if (pending_bytes_ >= REDO_ARCHIVE_FRAME_SIZE) {
+        pthread_cond_signal(&queue_cond_);
+    }
+}
+
+void *RedoArchive::ArchiveRoutine(void *arg) {
+    auto *archive = static_cast<RedoArchive *>(arg);
+    std::vector<RedoArchiveFrame> frames;
+    for (;;) {
+        {
+            PthreadMutexGuard guard(archive->queue_mutex_);
+            if (archive->pending_bytes_ < REDO_ARCHIVE_FRAME_SIZE) {
+                struct timespec deadline {};
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                auto nsec = deadline.tv_nsec + static_cast<long>(REDO_ARCHIVE_FLUSH_MS) * 1000 * 1000;
+                deadline.tv_sec += nsec / 1000000000L;
+                deadline.tv_nsec = nsec % 1000000000L;
+                pthread_cond_timedwait(&archive->queue_cond_, &archive->queue_mutex_, &deadline);
+            }
+            frames.swap(archive->pending_);
+            archive->pending_bytes_ = 0;
+            pthread_cond_broadcast(&archive->drained_cond_);
+        }
+        for (const auto &frame: frames) {
+            archive->WriteFrame(frame);
+        }
+        frames.clear();
+    }
+    return nullptr;
+}
+
+void RedoArchive::OpenSegment(lsn_t start_lsn) {
+    if (segment_fd_ >= 0) {
+        close(segment_fd_);
+    }
+    // 同名的文件只可能是写失败之后留下的空segment
+    auto path = SegmentPath(start_lsn);
+    segment_fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (segment_fd_ < 0) {
+        LogCrit(COMPONENT_FSAL, "can not create redo archive segment %s: %s", path.c_str(), strerror(errno));
+        return;
+    }
+    segment_lsn_ = start_lsn;
+    segment_size_ = 0;
+    written_lsn_ = start_lsn;
+}
+
+void RedoArchive::WriteFrame(const RedoArchiveFrame &frame) {
+    // 前面的frame丢了的时候从新的segment开始，segment中的frame总是连续的
+    if (segment_fd_ < 0 || frame.start_lsn != written_lsn_ || segment_size_ >= REDO_ARCHIVE_SEGMENT_SIZE) {
+        OpenSegment(frame.start_lsn);
+        if (segment_fd_ < 0) {
+            return;
+        }
+    }
+    auto bound = ZSTD_compressBound(frame.data.size());
+    compress_buf_.resize(REDO_ARCHIVE_FRAME_HEADER_SIZE + bound);
+    auto comp_len = ZSTD_compressCCtx(cctx_, compress_buf_.data() + REDO_ARCHIVE_FRAME_HEADER_SIZE, bound,
+                                      frame.data.data(), frame.data.size(), REDO_ARCHIVE_ZSTD_LEVEL);
+    if (ZSTD_isError(comp_len)) {
+        LogCrit(COMPONENT_FSAL, "can not compress redo archive frame at lsn %" PRIu64 ": %s, logs to lsn %" PRIu64
+                " are lost", frame.start_lsn, ZSTD_getErrorName(comp_len), frame.end_lsn);
+        written_lsn_ = 0;
+        return;
+    }
+    auto *header = compress_buf_.data();
+    mach_write_to_8(header, frame.start_lsn);
+    mach_write_to_8(header + 8, frame.end_lsn);
+    mach_write_to_4(header + 16, frame.data.size());
+    mach_write_to_4(header + 20, comp_len);
+    auto size = REDO_ARCHIVE_FRAME_HEADER_SIZE + comp_len;
+    if (!redo_archive_write_all(segment_fd_, header, size) || fdatasync(segment_fd_) != 0) {
+        LogCrit(COMPONENT_FSAL, "can not write redo archive segment %s: %s, logs from lsn %" PRIu64 " to %" PRIu64
+                " are lost", SegmentPath(segment_lsn_).c_str(), strerror(errno), frame.start_lsn, frame.end_lsn);
+        if (ftruncate(segment_fd_, segment_size_) != 0) {
+            close(segment_fd_);
+            segment_fd_ = -1;
+        }
+        written_lsn_ = 0;
+        return;
+    }
+    segment_size_ += size;
+    written_lsn_ = frame.end_lsn;
+
+    PthreadMutexGuard guard(segment_mutex_);
+    segments_[segment_lsn_] = {written_lsn_, segment_size_};
+    if (max_size_ == 0) {
+        return;
+    }
+    size_t total_size = 0;
+    for (const auto &[lsn, segment]: segments_) {
+        total_size += segment.size;
+    }
+    while (total_size > max_size_ && segments_.size() > 1) {
+        auto oldest = segments_.begin();
+        unlink(SegmentPath(oldest->first).c_str());
+        total_size -= oldest->second.size;
+        segments_.erase(oldest);
+    }
+}
+
+int RedoArchive::ReadFrame(lsn_t lsn, RedoArchiveFrame *frame) {
+    lsn_t segment_lsn;
+    Segment segment {};
+    {
+        PthreadMutexGuard guard(segment_mutex_);
+        if (segments_.empty() || lsn >= segments_.rbegin()->second.end_lsn) {
+            return 1;
+        }
+        auto iter = segments_.upper_bound(lsn);
+        if (iter == segments_.begin()) {
+            return -1;
+        }
+        --iter;
+        if (lsn >= iter->second.end_lsn) {
+            return -1;
+        }
+        segment_lsn = iter->first;
+        segment = iter->second;
+    }
+
+    if (read_fd_ < 0 || read_segment_lsn_ != segment_lsn || read_lsn_ > lsn) {
+        if (read_fd_ >= 0) {
+            close(read_fd_);
+        }
+        read_fd_ = open(SegmentPath(segment_lsn).c_str(), O_RDONLY);
+        if (read_fd_ < 0) {
+            LogCrit(COMPONENT_FSAL, "can not open redo archive segment %s: %s", SegmentPath(segment_lsn).c_str(),
+                    strerror(errno));
+            return -1;
+        }
+        posix_fadvise(read_fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        read_segment_lsn_ = segment_lsn;
+        read_offset_ = 0;
+        read_lsn_ = segment_lsn;
+    }
+    RedoArchiveFrameHeader header {};
+    while (redo_archive_read_header(read_fd_, read_offset_, segment.size, read_lsn_, &header)) {
+        auto data_offset = read_offset_ + REDO_ARCHIVE_FRAME_HEADER_SIZE;
+        if (lsn >= header.end_lsn) {
+            read_offset_ = data_offset + header.comp_len;
+            read_lsn_ = header.end_lsn;
+            continue;
+        }
+        std::vector<byte> comp(header.comp_len);
+        frame->data.resize(header.raw_len);
+        if (pread(read_fd_, comp.data(), comp.size(), data_offset) != static_cast<ssize_t>(comp.size())
+            || ZSTD_decompress(frame->data.data(), frame->data.size(), comp.data(), comp.size())
+               != header.raw_len) {
+            LogCrit(COMPONENT_FSAL, "can not read redo archive frame at lsn %" PRIu64 " in %s", header.start_lsn,
+                    SegmentPath(segment_lsn).c_str());
+            return -1;
+        }
+        frame->start_lsn = header.start_lsn;
+        frame->end_lsn = header.end_lsn;
+        return 0;
+    }
+    LogCrit(COMPONENT_FSAL, "redo archive segment %s is damaged at offset %zu", SegmentPath(segment_lsn).c_str(),
+            read_offset_);
+    return -1;
+}
@@ -0,0 +1,338 @@
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "applier/applier_instance.h"
+#include "applier/interface.h"
+#include "applier/utility.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "common_utils.h"
+#include "log.h"
+#ifdef __cplusplus
+}
+#endif
+
+// 生成到一半的快照目录，完成之后rename成快照的名字
+static constexpr const char *SNAPSHOT_INCOMPLETE_SUFFIX = ".incomplete";
+// 改写这么多个page推进一次read view
+static constexpr size_t SNAPSHOT_REFRESH_PAGES = 4096;
+
+// 同一时间只做一个快照
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// start_snapshot启动的快照，在后台线程中生成，NFS worker不等它
+struct SnapshotJob {
+    int group;
+    lsn_t lsn;
+    std::string name;
+    bool done;
+    int rc;
+    struct snapshot_result result;
+};
+
+static pthread_mutex_t snapshot_jobs_mutex = PTHREAD_MUTEX_INITIALIZER; // protect the following
+static std::map<uint64_t, SnapshotJob> snapshot_jobs;
+static uint64_t snapshot_next_job_id = 1;
+static bool snapshot_job_running = false;
+
+struct SnapshotContext {
+    ApplierInstance *applier;
+    lsn_t lsn;
+    uint64_t view_id;
+    std::string dir;            // 正在生成的快照目录
+    std::vector<byte> page_buf;
+    FILE *info;
+    struct snapshot_result *result;
+};
+
+// 快照的名字是snapshot_path下的一个目录名
+static bool snapshot_valid_name(const char *name) {
+    auto len = strnlen(name, NAME_MAX + 1);
+    return len > 0 && len <= NAME_MAX - strlen(SNAPSHOT_INCOMPLETE_SUFFIX) && strchr(name, '/') == nullptr
+           && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+static int snapshot_remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    remove(path);
+    return 0;
+}
+
+static void snapshot_remove_dir(const std::string &dir) {
+    nftw(dir.c_str(), snapshot_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// 数据文件在快照中的位置，和它相对于数据目录的位置一样
+static std::string snapshot_relative_path(const LogGroupConfig &config, const std::string &filename) {
+    for (auto prefix: {config.data_file_prefix + "/", config.system_file_prefix}) {
+        if (filename.compare(0, prefix.size(), prefix) == 0) {
+            return filename.substr(prefix.size());
+        }
+    }
+    return filename.substr(filename.rfind('/') + 1);
+}
+
+// read view不推进会过期，拷贝大文件时要定期推进
+static bool snapshot_refresh_view(const SnapshotContext &ctx) {
+    return ctx.applier->page_version_store.UpdateView(ctx.view_id, ctx.lsn);
+}
+
+static bool snapshot_copy_progress(void *arg) {
+    return snapshot_refresh_view(*static_cast<const SnapshotContext *>(arg));
+}
+
+/**
+ * 拷贝一个表空间的文件，然后把其中和lsn上不一样的page改写成lsn上的版本。
+ * 这样的page只可能是：拷贝开始时还有log没有写回的page，拷贝期间被写回的page，以及lsn之后被修改过的page，
+ * 最后这种在read view登记之后都保留了镜像
+ * @return 和create_snapshot一样
+ */
+static int snapshot_copy_space(SnapshotContext &ctx, space_id_t space_id) {
+    auto *applier = ctx.applier;
+    auto &buffer_pool = applier->buffer_pool;
+    auto filename = buffer_pool.BeginCapture(space_id);
+    if (filename.empty()) {
+        return 0;
+    }
+    auto pages = applier->apply_index.PendingPages(space_id);
+    auto relative_path = snapshot_relative_path(applier->config, filename);
+    auto dst_path = ctx.dir + "/" + relative_path;
+    int src_fd = open(filename.c_str(), O_RDONLY);
+    if (src_fd < 0) {
+        buffer_pool.EndCapture(space_id);
+        // 表空间刚被删除
+        return errno == ENOENT ? 0 : -1;
+    }
+    int dst_fd = -1;
+    if (MakeParentDirectories(dst_path)) {
+        dst_fd = open(dst_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    }
+    if (dst_fd < 0) {
+        LogCrit(COMPONENT_FSAL, "snapshot can not create %s: %s", dst_path.c_str(), strerror(errno));
+        close(src_fd);
+        buffer_pool.EndCapture(space_id);
+        return -1;
+    }
+    bool cloned = false;
+    auto rc = CloneFile(src_fd, dst_fd, SNAPSHOT_COPY_CHUNK, snapshot_copy_progress, &ctx, &cloned);
+    close(src_fd);
+    auto written = buffer_pool.EndCapture(space_id);
+    if (rc != 0) {
+        if (rc == -1) {
+            LogCrit(COMPONENT_FSAL, "snapshot can not copy %s: %s", filename.c_str(), strerror(errno));
+        }
+        close(dst_fd);
+        return rc;
+    }
+
+    pages.insert(pages.end(), written.begin(), written.end());
+    auto retained = applier->page_version_store.SpacePages(space_id);
+    pages.insert(pages.end(), retained.begin(), retained.end());
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    auto page_size = buffer_pool.GetPageSize(space_id);
+    auto *page_buf = reinterpret_cast<char *>(ctx.page_buf.data());
+    size_t n_patched = 0;
+    for (auto page_id: pages) {
+        rc = apply_and_copy_page_as_of(applier->group_no, page_buf, space_id, page_id, ctx.lsn);
+        if (rc == -2) {
+            break;
+        }
+        // page不存在，或者表空间已经被删除
+        if (rc != 0) {
+            rc = 0;
+            continue;
+        }
+        if (pwrite(dst_fd, page_buf, page_size, static_cast<off_t>(page_id) * page_size) != page_size) {
+            LogCrit(COMPONENT_FSAL, "snapshot can not write %s: %s", dst_path.c_str(), strerror(errno));
+            rc = -1;
+            break;
+        }
+        if (++n_patched % SNAPSHOT_REFRESH_PAGES == 0 && !snapshot_refresh_view(ctx)) {
+            rc = -2;
+            break;
+        }
+    }
+    if (rc == 0 && fsync(dst_fd) != 0) {
+        LogCrit(COMPONENT_FSAL, "snapshot can not sync %s: %s", dst_path.c_str(), strerror(errno));
+        rc = -1;
+    }
+    close(dst_fd);
+    if (rc != 0) {
+        return rc;
+    }
+    fprintf(ctx.info, "%u %s\n", space_id, relative_path.c_str());
+    ctx.result->n_files++;
+    ctx.result->n_cloned += cloned ? 1 : 0;
+    ctx.result->n_patched += n_patched;
+    return snapshot_refresh_view(ctx) ? 0 : -2;
+}
+
+/**
+ * 登记lsn上的read view，等log parser解析到lsn。
+ * 登记之前已经apply的log都早于登记之后解析到的lsn，lsn不早于它时，lsn之后的修改都会保留镜像
+ * @return 成功返回0，其余和create_snapshot一样
+ */
+static int snapshot_register_view(SnapshotContext &ctx, lsn_t lsn) {
+    int group = ctx.applier->group_no;
+    auto parsed_lsn = wait_until_parse_done(group);
+    if (lsn != 0 && lsn < parsed_lsn) {
+        return -2;
+    }
+    ctx.view_id = register_read_view(group, lsn != 0 ? lsn : parsed_lsn);
+    // 登记的同时page还在被apply，刚解析到的lsn也可能已经被越过了，换新的lsn重试
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SNAPSHOT_LAG_WAIT_MS);
+    while (lsn == 0 && ctx.view_id == 0 && std::chrono::steady_clock::now() < deadline) {
+        parsed_lsn = wait_until_parse_done(group);
+        ctx.view_id = register_read_view(group, parsed_lsn);
+    }
+    if (ctx.view_id == 0) {
+        return -2;
+    }
+    parsed_lsn = wait_until_parse_done(group);
+    if (lsn == 0) {
+        ctx.lsn = parsed_lsn;
+        update_read_view(group, ctx.view_id, ctx.lsn);
+        return 0;
+    }
+    ctx.lsn = lsn;
+    if (lsn < parsed_lsn) {
+        return -2;
+    }
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SNAPSHOT_LAG_WAIT_MS);
+    while (wait_until_parse_done(group) < lsn) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return -3;
+        }
+        usleep(1000);
+    }
+    return 0;
+}
+
+int create_snapshot(int group, uint64_t lsn, const char *name, struct snapshot_result *result) {
+    auto *applier = get_applier(group);
+    if (applier == nullptr || !snapshot_valid_name(name)) {
+        return -5;
+    }
+    PthreadMutexGuard guard(snapshot_mutex);
+    const auto &snapshot_path = applier->config.snapshot_path;
+    auto dir = snapshot_path + "/" + name;
+    struct stat st {};
+    if (stat(dir.c_str(), &st) == 0) {
+        return -4;
+    }
+    if (mkdir(snapshot_path.c_str(), 0755) != 0 && errno != EEXIST) {
+        LogCrit(COMPONENT_FSAL, "can not create snapshot directory %s: %s", snapshot_path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    std::memset(result, 0, sizeof(*result));
+    SnapshotContext ctx {applier, 0, 0, dir + SNAPSHOT_INCOMPLETE_SUFFIX, std::vector<byte>(DATA_PAGE_SIZE),
+                         nullptr, result};
+    // 上次没有完成的快照
+    snapshot_remove_dir(ctx.dir);
+    auto info_path = ctx.dir + "/" + SNAPSHOT_INFO_FILE;
+    if (mkdir(ctx.dir.c_str(), 0755) != 0 || (ctx.info = fopen(info_path.c_str(), "w")) == nullptr) {
+        LogCrit(COMPONENT_FSAL, "can not create snapshot %s: %s", ctx.dir.c_str(), strerror(errno));
+        snapshot_remove_dir(ctx.dir);
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto rc = snapshot_register_view(ctx, lsn);
+    if (rc == 0) {
+        fprintf(ctx.info, "lsn %" PRIu64 "\n", ctx.lsn);
+        // lsn之后创建的表空间也在里面，它们的page在lsn上还不存在，会被写成全0
+        for (const auto &tablespace: applier->buffer_pool.Tablespaces()) {
+            rc = snapshot_copy_space(ctx, tablespace.first);
+            if (rc != 0) {
+                break;
+            }
+        }
+    }
+    if (ctx.view_id != 0) {
+        release_read_view(group, ctx.view_id);
+    }
+    if (fclose(ctx.info) != 0 && rc == 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(ctx.dir.c_str(), dir.c_str()) != 0) {
+        LogCrit(COMPONENT_FSAL, "can not rename snapshot %s: %s", ctx.dir.c_str(), strerror(errno));
+        rc = -1;
+    }
+    if (rc != 0) {
+        LogWarn(COMPONENT_FSAL, "log group %d: snapshot %s at lsn %" PRIu64 " failed with %d",
+                group, name, ctx.lsn, rc);
+        snapshot_remove_dir(ctx.dir);
+        return rc;
+    }
+    result->lsn = ctx.lsn;
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                                            - start).count();
+    LogEvent(COMPONENT_FSAL, "log group %d: snapshot %s at lsn %" PRIu64 ", %u files (%u cloned), %" PRIu64
+             " pages rewritten, %lld ms", group, name, result->lsn, result->n_files, result->n_cloned,
+             result->n_patched, static_cast<long long>(elapsed_ms));
+    return 0;
+}
+
+static void *snapshot_job_routine(void *arg) {
+    auto job_id = reinterpret_cast<uintptr_t>(arg);
+    SnapshotJob job;
+    {
+        PthreadMutexGuard guard(snapshot_jobs_mutex);
+        job = snapshot_jobs[job_id];
+    }
+    job.rc = create_snapshot(job.group, job.lsn, job.name.c_str(), &job.result);
+    PthreadMutexGuard guard(snapshot_jobs_mutex);
+    auto &finished = snapshot_jobs[job_id];
+    finished.rc = job.rc;
+    finished.result = job.result;
+    finished.done = true;
+    snapshot_job_running = false;
+    return nullptr;
+}
+
+int start_snapshot(int group, uint64_t lsn, const char *name, uint64_t *job_id) {
+    if (get_applier(group) == nullptr || !snapshot_valid_name(name)) {
+        return -5;
+    }
+    PthreadMutexGuard guard(snapshot_jobs_mutex);
+    if (snapshot_job_running) {
+        return -6;
+    }
+    *job_id = snapshot_next_job_id++;
+    snapshot_jobs[*job_id] = {group, lsn, name, false, 0, {}};
+    // 轮询的客户端只关心最近的快照
+    while (snapshot_jobs.size() > SNAPSHOT_JOBS_KEPT) {
+        snapshot_jobs.erase(snapshot_jobs.begin());
+    }
+    snapshot_job_running = true;
+    pthread_t thread_id;
+    START_THREAD("snapshot", &thread_id, snapshot_job_routine, reinterpret_cast<void *>(static_cast<uintptr_t>(*job_id)));
+    pthread_detach(thread_id);
+    LogEvent(COMPONENT_FSAL, "log group %d: snapshot %s started as job %" PRIu64, group, name, *job_id);
+    return 0;
+}
+
+int get_snapshot_status(int group, uint64_t job_id, struct snapshot_result *result) {
+    PthreadMutexGuard guard(snapshot_jobs_mutex);
+    auto iter = snapshot_jobs.find(job_id);
+    if (iter == snapshot_jobs.end() || iter->second.group != group) {
+        return -7;
+    }
+    if (!iter->second.done) {
+        return 1;
+    }
+    *result = iter->second.result;
+    return iter->second.rc;
+}
@@ -1,4 +1,11 @@
 #include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
 #include <cassert>
 #include "applier/utility.h"
@@ -369,4 +376,72 @@ lsn_t recv_calc_lsn_on_data_add(
                * (LOG_BLOCK_HDR_SIZE + LOG_BLOCK_TRL_SIZE);
 
     return lsn + lsn_len;
-}
\ No newline at end of file
+}
+
+uint64_t recv_calc_data_len(lsn_t start_lsn, lsn_t end_lsn) {
+    // block中header之后的偏移量，lsn总是落在block的header和trailer之间
+    auto data_offset = [](lsn_t lsn) {
+        return lsn / OS_FILE_LOG_BLOCK_SIZE * (OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE)
+               + lsn % OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE;
+    };
+    return data_offset(end_lsn) - data_offset(start_lsn);
+}
+
+bool MakeParentDirectories(const std::string &path) {
+    for (auto pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        if (mkdir(path.substr(0, pos).c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 不能copy_file_range时用pread/pwrite拷贝，一次这么多
+static constexpr size_t CLONE_FILE_IO_SIZE = 1024 * 1024;
+
+int CloneFile(int src_fd, int dst_fd, size_t chunk_size, bool (*progress)(void *arg), void *arg, bool *cloned) {
+    *cloned = ioctl(dst_fd, FICLONE, src_fd) == 0;
+    if (*cloned) {
+        return 0;
+    }
+    struct stat st {};
+    if (fstat(src_fd, &st) != 0) {
+        return -1;
+    }
+    // copy_file_range在同一个文件系统上也可能共享数据块，不能用时退回到pread/pwrite
+    bool copy_range = true;
+    std::vector<char> buf;
+    off_t offset = 0;
+    while (offset < st.st_size) {
+        auto chunk_end = std::min<off_t>(st.st_size, offset + chunk_size);
+        while (offset < chunk_end) {
+            ssize_t n;
+            if (copy_range) {
+                loff_t src_offset = offset, dst_offset = offset;
+                n = copy_file_range(src_fd, &src_offset, dst_fd, &dst_offset, chunk_end - offset, 0);
+                if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                    copy_range = false;
+                    continue;
+                }
+            } else {
+                buf.resize(CLONE_FILE_IO_SIZE);
+                n = pread(src_fd, buf.data(), std::min<off_t>(buf.size(), chunk_end - offset), offset);
+                if (n > 0 && pwrite(dst_fd, buf.data(), n, offset) != n) {
+                    return -1;
+                }
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            // 文件被截短了，拷贝到这里为止
+            if (n <= 0) {
+                return n == 0 ? 0 : -1;
+            }
+            offset += n;
+        }
+        if (progress != nullptr && !progress(arg)) {
+            return -2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+#include <cstring>
+#include <list>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include <boost/filesystem.hpp>
+
+#include "applier/log_log.h"
+#include "applier/log_apply.h"
+#include "applier/buffer_pool.h"
+#include "applier/utility.h"
+
+/*
+ * Round trips through the applier's ApplyIndex:
+ *  - chains spilled to RocksDB come back from Search unchanged and in lsn order
+ *  - applying compacted chains gives the same page as applying every log
+ *  - each apply policy hands the scheduler the pages it should apply
+ */
+
+namespace {
+
+  static constexpr space_id_t space_id = 7;
+  static constexpr page_id_t n_pages = 4;
+  static constexpr uint32_t n_logs = 4000;
+  /* byte writes land in a small region so that they overlap and compact */
+  static constexpr uint32_t region_start = 128;
+  static constexpr uint32_t region_len = 96;
+
+  struct GenLog {
+    LOG_TYPE type;
+    page_id_t page_id;
+    lsn_t lsn;
+    std::vector<byte> body;
+  };
+
+  /* MLOG_1BYTE/2BYTES/4BYTES with values below 0x80, whose compressed
+   * form is the value itself, MLOG_WRITE_STRING, and now and then a
+   * bodyless MLOG_COMP_PAGE_CREATE or MLOG_INIT_FILE_PAGE2 that lets
+   * compaction drop whole runs of earlier logs */
+  std::vector<GenLog> generate_logs(uint32_t seed)
+  {
+    std::mt19937 rng(seed);
+    std::vector<GenLog> logs;
+    lsn_t lsn = 8192;
+
+    for (uint32_t i = 0; i < n_logs; ++i) {
+      GenLog log;
+      log.page_id = rng() % n_pages;
+      log.lsn = lsn;
+      uint32_t kind = rng() % 64;
+      if (kind < 2) {
+	log.type = kind == 0 ? MLOG_COMP_PAGE_CREATE : MLOG_INIT_FILE_PAGE2;
+	lsn += 7;
+	logs.push_back(std::move(log));
+	continue;
+      }
+      uint32_t len = 1 + rng() % 16;
+      uint32_t offset = region_start + rng() % (region_len - len);
+      switch (kind % 4) {
+      case 0:
+	log.type = MLOG_1BYTE;
+	break;
+      case 1:
+	log.type = MLOG_2BYTES;
+	offset &= ~1U;
+	break;
+      case 2:
+	log.type = MLOG_4BYTES;
+	offset &= ~3U;
+	break;
+      default:
+	log.type = MLOG_WRITE_STRING;
+	break;
+      }
+      log.body.resize(2);
+      mach_write_to_2(log.body.data(), offset);
+      if (log.type == MLOG_WRITE_STRING) {
+	log.body.resize(4 + len);
+	mach_write_to_2(log.body.data() + 2, len);
+	for (uint32_t j = 0; j < len; ++j)
+	  log.body[4 + j] = static_cast<byte>(rng());
+      } else {
+	log.body.push_back(static_cast<byte>(rng() % 0x80));
+      }
+      lsn += log.body.size() + 7;
+      logs.push_back(std::move(log));
+    }
+    return logs;
+  }
+
+  LogEntry make_entry(GenLog &log)
+  {
+    return LogEntry(log.type, space_id, log.page_id, log.lsn,
+		    log.body.size() + 7, log.body.data(),
+		    log.body.data() + log.body.size());
+  }
+
+  /* everything Search returns for one page, in lsn order */
+  std::list<LogEntry> search_page(ApplyIndex &index, page_id_t page_id)
+  {
+    PageAddress page_address(space_id, page_id);
+    std::vector<PageAddress> pages {page_address};
+    std::list<LogEntry> res;
+
+    index.BeginRead(pages);
+    for (auto &chain : index.Search(page_address)) {
+      res.splice(res.end(), *chain);
+      index.EndApply(page_address);
+    }
+    index.EndRead(pages);
+    return res;
+  }
+
+  /* same order and skip rule as log_apply_do_apply */
+  void apply_chain(Page *page, const std::list<LogEntry> &chain)
+  {
+    for (const auto &log : chain) {
+      if (page->GetLSN() > log.log_start_lsn_)
+	continue;
+      if (log_apply_apply_one_log(page, log)) {
+	page->WritePageLSN(log.log_start_lsn_ + log.log_len_);
+	page->WriteCheckSum(BUF_NO_CHECKSUM_MAGIC);
+      }
+    }
+  }
+
+  class ApplyIndexSpill : public ::testing::Test {
+
+    virtual void SetUp() {
+      spill_path = boost::filesystem::temp_directory_path() /
+	boost::filesystem::unique_path("apply_index_spill_%%%%%%%%");
+    }
+
+    virtual void TearDown() {
+      boost::filesystem::remove_all(spill_path);
+    }
+
+  protected:
+    boost::filesystem::path spill_path;
+  };
+
+} /* namespace */
+
+TEST_F(ApplyIndexSpill, REFILL_ROUND_TRIP)
+{
+  auto logs = generate_logs(1);
+  /* a 1 byte budget spills every chain outside the front segment */
+  ApplyIndex index(1, 4096);
+
+  index.DisableCompaction();
+  ASSERT_TRUE(index.OpenSpillStore(spill_path.string()));
+
+  size_t in_memory = 0;
+  for (auto &log : logs) {
+    auto entry = make_entry(log);
+    in_memory += entry.MemorySize();
+    index.InsertBack(std::move(entry));
+  }
+  EXPECT_LT(index.MemoryUsage(), in_memory / 2);
+
+  for (page_id_t page_id = 0; page_id < n_pages; ++page_id) {
+    auto chain = search_page(index, page_id);
+    auto iter = chain.begin();
+    for (const auto &log : logs) {
+      if (log.page_id != page_id)
+	continue;
+      ASSERT_NE(iter, chain.end());
+      EXPECT_EQ(iter->type_, log.type);
+      EXPECT_EQ(iter->log_start_lsn_, log.lsn);
+      EXPECT_EQ(iter->log_len_, log.body.size() + 7);
+      ASSERT_EQ(static_cast<size_t>(iter->log_body_end_ptr_ -
+				    iter->log_body_start_ptr_),
+		log.body.size());
+      EXPECT_EQ(std::memcmp(iter->log_body_start_ptr_, log.body.data(),
+			    log.body.size()), 0);
+      ++iter;
+    }
+    EXPECT_EQ(iter, chain.end());
+  }
+  EXPECT_EQ(index.MemoryUsage(), 0U);
+}
+
+TEST(ApplyIndexCompaction, SAME_PAGE_AS_UNCOMPACTED)
+{
+  auto logs = generate_logs(2);
+  ApplyIndex compacted(SIZE_MAX, 1024 * 1024);
+  ApplyIndex full(SIZE_MAX, 1024 * 1024);
+
+  full.DisableCompaction();
+  size_t n_page_creates = 0;
+  size_t n_page_inits = 0;
+  for (auto &log : logs) {
+    n_page_creates += log.type == MLOG_COMP_PAGE_CREATE;
+    n_page_inits += log.type == MLOG_INIT_FILE_PAGE2;
+    compacted.InsertBack(make_entry(log));
+    full.InsertBack(make_entry(log));
+  }
+  EXPECT_GT(n_page_creates, 0U);
+  EXPECT_GT(n_page_inits, 0U);
+
+  size_t n_compacted = 0;
+  size_t n_full = 0;
+  for (page_id_t page_id = 0; page_id < n_pages; ++page_id) {
+    auto compacted_chain = search_page(compacted, page_id);
+    auto full_chain = search_page(full, page_id);
+    n_compacted += compacted_chain.size();
+    n_full += full_chain.size();
+
+    Page compacted_page;
+    Page full_page;
+    compacted_page.Reset();
+    full_page.Reset();
+    apply_chain(&compacted_page, compacted_chain);
+    apply_chain(&full_page, full_chain);
+    EXPECT_EQ(compacted_page.GetLSN(), full_page.GetLSN());
+    EXPECT_EQ(std::memcmp(compacted_page.GetData(), full_page.GetData(),
+			  DATA_PAGE_SIZE), 0) << "page " << page_id;
+  }
+  EXPECT_EQ(n_full, n_logs);
+  EXPECT_LT(n_compacted, n_full);
+}
+
+namespace {
+
+  /* n one byte writes to page_id, lsn is advanced past them */
+  void insert_writes(ApplyIndex &index, std::vector<GenLog> &keep,
+		     page_id_t page_id, uint32_t n, lsn_t *lsn)
+  {
+    for (uint32_t i = 0; i < n; ++i) {
+      GenLog log;
+      log.type = MLOG_1BYTE;
+      log.page_id = page_id;
+      log.lsn = *lsn;
+      log.body.resize(2);
+      /* different offsets, so that compaction keeps every log */
+      mach_write_to_2(log.body.data(), region_start + i % region_len);
+      log.body.push_back(static_cast<byte>(i % 0x80));
+      *lsn += log.body.size() + 7;
+      keep.push_back(std::move(log));
+      index.InsertBack(make_entry(keep.back()));
+    }
+  }
+
+  /* one scheduler batch: the pages the policy applies now, deferred
+   * pages it drains, both extracted the way the apply workers do */
+  std::vector<PageAddress> schedule_batch(ApplyIndex &index,
+					  std::vector<PageAddress> *drain)
+  {
+    size_t log_len = 0;
+    auto task = log_apply_policy_filter(index, index.ExtractFrontHint(&log_len),
+					drain);
+
+    for (const auto &page_address : task) {
+      if (index.ExtractFront(page_address) != nullptr)
+	index.EndApply(page_address);
+    }
+    for (const auto &page_address : *drain) {
+      if (index.ExtractDeferred(page_address) != nullptr)
+	index.EndApply(page_address);
+    }
+    return task;
+  }
+
+  class ApplyPolicySwitch : public ::testing::Test {
+
+    virtual void TearDown() {
+      apply_policy = APPLY_POLICY;
+      apply_hybrid_chain_logs = APPLY_HYBRID_CHAIN_LOGS;
+      apply_lazy_memory_percent = APPLY_LAZY_MEMORY_PERCENT;
+    }
+  };
+
+} /* namespace */
+
+TEST_F(ApplyPolicySwitch, PAGES_APPLIED_WHEN_POLICY_SAYS)
+{
+  PageAddress hot(space_id, 0);
+  PageAddress cold(space_id, 1);
+  PageAddress other(space_id, 2);
+  std::vector<GenLog> logs;
+  std::vector<PageAddress> drain;
+  lsn_t lsn = 8192;
+  /* every segment holds exactly one batch below */
+  ApplyIndex index(SIZE_MAX, 10 * 72);
+
+  apply_hybrid_chain_logs = 64;
+  logs.reserve(1000);
+
+  /* lazy: nothing is applied in the background */
+  apply_policy = ApplyPolicy::LAZY;
+  insert_writes(index, logs, hot.PageId(), 70, &lsn);
+  insert_writes(index, logs, cold.PageId(), 2, &lsn);
+  EXPECT_TRUE(schedule_batch(index, &drain).empty());
+  EXPECT_TRUE(drain.empty());
+  EXPECT_EQ(index.DeferredPages(SIZE_MAX).size(), 2U);
+
+  /* hybrid: only the page with a long chain is applied */
+  apply_policy = ApplyPolicy::HYBRID;
+  insert_writes(index, logs, hot.PageId(), 70, &lsn);
+  insert_writes(index, logs, cold.PageId(), 2, &lsn);
+  auto task = schedule_batch(index, &drain);
+  ASSERT_EQ(task.size(), 1U);
+  EXPECT_EQ(task[0], hot);
+  EXPECT_TRUE(drain.empty());
+  auto deferred = index.DeferredPages(SIZE_MAX);
+  ASSERT_EQ(deferred.size(), 1U);
+  EXPECT_EQ(deferred[0], cold);
+
+  /* eager: the batch and everything deferred before it */
+  apply_policy = ApplyPolicy::EAGER;
+  insert_writes(index, logs, other.PageId(), 72, &lsn);
+  task = schedule_batch(index, &drain);
+  ASSERT_EQ(task.size(), 1U);
+  EXPECT_EQ(task[0], other);
+  ASSERT_EQ(drain.size(), 1U);
+  EXPECT_EQ(drain[0], cold);
+  EXPECT_TRUE(index.DeferredPages(SIZE_MAX).empty());
+
+  /* lazy, but the apply index is above its memory threshold */
+  apply_policy = ApplyPolicy::LAZY;
+  index.SetMemoryBudget(1);
+  insert_writes(index, logs, cold.PageId(), 72, &lsn);
+  task = schedule_batch(index, &drain);
+  ASSERT_EQ(task.size(), 1U);
+  EXPECT_EQ(task[0], cold);
+  EXPECT_EQ(index.MemoryUsage(), 0U);
+}
+
+int main(int argc, char *argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+#include <list>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "applier/log_log.h"
+#include "applier/page_version_store.h"
+#include "applier/utility.h"
+
+/*
+ * Read view registration against the applier's ApplyIndex:
+ *  - a view below what was already applied is refused, unless an older
+ *    view kept the page images it needs
+ *  - compaction stops while there are views and resumes after the last
+ *    one is released
+ */
+
+namespace {
+
+  static constexpr space_id_t space_id = 7;
+
+  struct GenLog {
+    page_id_t page_id;
+    lsn_t lsn;
+    std::vector<byte> body;
+  };
+
+  /* n MLOG_1BYTE writes to the same offset of page_id, each one
+   * overwrites the one before; lsn is advanced past them */
+  void insert_writes(ApplyIndex &index, std::list<GenLog> &keep,
+		     page_id_t page_id, uint32_t n, lsn_t *lsn)
+  {
+    for (uint32_t i = 0; i < n; ++i) {
+      GenLog log;
+      log.page_id = page_id;
+      log.lsn = *lsn;
+      log.body.resize(2);
+      mach_write_to_2(log.body.data(), 128);
+      log.body.push_back(static_cast<byte>(i % 0x80));
+      *lsn += log.body.size() + 7;
+      keep.push_back(std::move(log));
+      auto &back = keep.back();
+      index.InsertBack(LogEntry(MLOG_1BYTE, space_id, back.page_id,
+				back.lsn, back.body.size() + 7,
+				back.body.data(),
+				back.body.data() + back.body.size()));
+    }
+  }
+
+  /* extract the page's logs the way a data page reader does, returns
+   * how many there were */
+  size_t apply_page(ApplyIndex &index, page_id_t page_id)
+  {
+    PageAddress page_address(space_id, page_id);
+    std::vector<PageAddress> pages {page_address};
+    size_t n = 0;
+
+    index.BeginRead(pages);
+    for (auto &chain : index.Search(page_address)) {
+      n += chain->size();
+      index.EndApply(page_address);
+    }
+    index.EndRead(pages);
+    return n;
+  }
+
+} /* namespace */
+
+TEST(PageVersionStoreViews, REGISTER_BELOW_APPLIED)
+{
+  std::list<GenLog> logs;
+  lsn_t lsn = 8192;
+  ApplyIndex index(SIZE_MAX, 1024 * 1024);
+  PageVersionStore store(&index);
+
+  /* nothing applied yet, any lsn can be served */
+  auto pinned = store.RegisterView(lsn);
+  ASSERT_NE(pinned, 0U);
+  EXPECT_TRUE(store.ViewsEnabled());
+
+  lsn_t middle = lsn + 10;
+  insert_writes(index, logs, 0, 4, &lsn);
+  EXPECT_EQ(apply_page(index, 0), 4U);
+  EXPECT_EQ(index.ExtractedLsn(), lsn);
+
+  /* the older view kept the images from before the apply */
+  auto pinned_middle = store.RegisterView(middle);
+  EXPECT_NE(pinned_middle, 0U);
+  store.ReleaseView(pinned_middle);
+  store.ReleaseView(pinned);
+
+  /* nobody kept them any more */
+  EXPECT_EQ(store.RegisterView(middle), 0U);
+  auto current = store.RegisterView(lsn);
+  EXPECT_NE(current, 0U);
+  EXPECT_EQ(store.OldestViewLsn(), lsn);
+  store.ReleaseView(current);
+}
+
+TEST(PageVersionStoreViews, LAST_RELEASE_RESUMES_COMPACTION)
+{
+  std::list<GenLog> logs;
+  lsn_t lsn = 8192;
+  ApplyIndex index(SIZE_MAX, 1024 * 1024);
+  PageVersionStore store(&index);
+
+  insert_writes(index, logs, 0, 4, &lsn);
+  EXPECT_EQ(apply_page(index, 0), 1U);
+
+  auto view = store.RegisterView(lsn);
+  ASSERT_NE(view, 0U);
+  EXPECT_TRUE(store.ViewsEnabled());
+  insert_writes(index, logs, 1, 4, &lsn);
+  EXPECT_EQ(apply_page(index, 1), 4U);
+
+  store.ReleaseView(view);
+  EXPECT_FALSE(store.ViewsEnabled());
+  EXPECT_EQ(store.OldestViewLsn(), LSN_MAX);
+  lsn_t compacting = lsn;
+  insert_writes(index, logs, 2, 4, &lsn);
+  EXPECT_EQ(apply_page(index, 2), 1U);
+
+  /* the next view starts after the logs compaction dropped */
+  EXPECT_EQ(store.RegisterView(compacting), 0U);
+  EXPECT_FALSE(store.ViewsEnabled());
+  view = store.RegisterView(lsn);
+  EXPECT_NE(view, 0U);
+  store.ReleaseView(view);
+  EXPECT_FALSE(store.ViewsEnabled());
+}
+
+int main(int argc, char *argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
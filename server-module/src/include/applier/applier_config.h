@@ -1,6 +1,8 @@
 #ifndef NFS_GANESHA_SRC_INCLUDE_APPLIER_CONFIG_H_
 #define NFS_GANESHA_SRC_INCLUDE_APPLIER_CONFIG_H_
 #include <cinttypes>
+#include <string>
+#include <vector>
 using page_id_t = uint32_t;
 using space_id_t = uint32_t;
 using frame_id_t = uint32_t;
@@ -10,73 +12,75 @@ using byte = unsigned char;
 using trx_id_t = uint64_t;
 using roll_ptr_t = uint64_t;
 
-static constexpr const size_t APPLY_BATCH_SIZE = 8 * 1024 * 1024; // 8M
-static constexpr const char * LOG_PATH_PREFIX = "/home/hkc/testLogOffL-srv/data/";
+// 什么时候把log apply到page上，和LOGDB { Apply_Policy }中的LOGDB_APPLY_*一一对应
+enum class ApplyPolicy : uint8_t {
+    EAGER,  // log apply scheduler apply所有的page
+    LAZY,   // 只在page被读取，或者ApplyIndex内存紧张的时候apply
+    HYBRID, // 和LAZY一样，但是积压的log超过阈值的page由log apply scheduler apply
+};
+// 下面是没有读配置之前的默认值，和LOGDB配置块中的默认值一样
+static constexpr ApplyPolicy APPLY_POLICY = ApplyPolicy::EAGER;
+static constexpr uint32_t APPLY_HYBRID_CHAIN_LOGS = 64;
+static constexpr size_t APPLY_HYBRID_CHAIN_BYTES = 16 * 1024;
+// LAZY和HYBRID下，ApplyIndex的内存超过上限的这个百分比之后，log apply scheduler开始apply推迟的page
+static constexpr uint32_t APPLY_LAZY_MEMORY_PERCENT = 50;
+static constexpr uint32_t APPLY_LAZY_DRAIN_PAGES = 4096; // 每一批最多额外apply这么多个推迟的page
+// 有data page reader正在apply page时，log apply worker每处理一个page之前最多让出这么久
+static constexpr uint32_t APPLY_READER_YIELD_US = 100;
+// ApplyIndex中log占用的内存超过上限之后，把冷的page log链溢出到本地的RocksDB
+// 溢出之后降到上限的这个比例以下，避免每插入一条log都溢出一次
+static constexpr double APPLY_INDEX_SPILL_LOW_WATER = 0.9;
+// 最近被读过的这么多个page的log链不会被溢出
+static constexpr const size_t APPLY_INDEX_RECENT_READS = 4096;
+// 只读节点的read view超过这么久没有推进就被回收
+static constexpr uint32_t PAGE_VERSION_VIEW_TIMEOUT_S = 60;
+static constexpr uint32_t PAGE_VERSION_PURGE_INTERVAL_MS = 1000;
+// 保留的page镜像和log的内存上限，超过之后回收最老的read view
+static constexpr size_t PAGE_VERSION_MEMORY_BUDGET = 512UL * 1024 * 1024; // 512M
+// 存储节点上点查时B-tree最多这么多层，和InnoDB的BTR_MAX_LEVELS一样，超过说明索引描述和page对不上
+static constexpr uint32_t BTR_MAX_LEVELS = 100;
+// 存储节点上扫描时一次请求最多读这么多个叶子page，之后返回游标让计算节点接着扫描
+static constexpr uint32_t SCAN_MAX_LEAF_PAGES = 1024;
+// 行级变更流按这个大小切分segment文件，超过Change_Feed_Max_Size之后删掉最老的segment
+static constexpr size_t CHANGE_FEED_SEGMENT_SIZE = 64UL * 1024 * 1024; // 64M
+// log parser交给feed线程、还没有处理的log的内存上限，超过之后丢掉变更并产生GAP事件，不阻塞解析
+static constexpr size_t CHANGE_FEED_QUEUE_BYTES = 64UL * 1024 * 1024; // 64M
+// feed线程空闲时也这样定期推进自己的read view，必须小于PAGE_VERSION_VIEW_TIMEOUT_S
+static constexpr uint32_t CHANGE_FEED_VIEW_REFRESH_MS = 1000;
+// 文件系统不支持reflink时，快照按这个大小分段拷贝文件，每段之间推进read view
+static constexpr size_t SNAPSHOT_COPY_CHUNK = 64UL * 1024 * 1024; // 64M
+// 快照的lsn还没有被解析时最多等这么久，之后让调用者重试
+static constexpr uint32_t SNAPSHOT_LAG_WAIT_MS = 10000;
+// 快照目录中记录lsn和每个文件对应的表空间，恢复快照时按它拷贝文件
+static constexpr const char *SNAPSHOT_INFO_FILE = "logdb_snapshot";
+// 后台生成的快照保留这么多个的结果，供SNAPSHOTSTATUS查询
+static constexpr size_t SNAPSHOT_JOBS_KEPT = 16;
+// redo归档攒够这么多log压缩成一个frame，不够时最多等REDO_ARCHIVE_FLUSH_MS
+static constexpr size_t REDO_ARCHIVE_FRAME_SIZE = 4UL * 1024 * 1024; // 4M
+static constexpr uint32_t REDO_ARCHIVE_FLUSH_MS = 1000;
+// 归档按这个大小切分segment文件，超过Redo_Archive_Max_Size之后删掉最老的segment
+static constexpr size_t REDO_ARCHIVE_SEGMENT_SIZE = 256UL * 1024 * 1024; // 256M
+// 交给归档线程、还没有压缩的log的上限，超过之后log parser等归档线程，归档中不能有空洞
+static constexpr size_t REDO_ARCHIVE_QUEUE_BYTES = 64UL * 1024 * 1024; // 64M
+static constexpr int REDO_ARCHIVE_ZSTD_LEVEL = 1;
+// 持久化的page lsn map，重启之后用它跳过已经落盘的log
+static constexpr uint32_t PAGE_LSN_MAP_CHUNK_PAGES = 1024;
+static constexpr uint32_t PAGE_LSN_MAP_CHECKPOINT_INTERVAL_MS = 1000;
 static constexpr const char * LOG_FILES_BASE_NAME = "ib_logfile";
-static constexpr int LOG_FILE_NUMBER = 2;
-static constexpr int APPLIER_THREAD = 1;
-#define SYSBENCH
-#ifdef SYSBENCH
-static constexpr const char * DATA_FILE_PREFIX = "/home/hkc/testLogOffL-srv/data/sbtest"; // don't suffix by '/'
-static constexpr const char * DATA_FILES[] = {"sbtest1.ibd",
-                                              "sbtest2.ibd",
-                                              "sbtest3.ibd",
-                                              "sbtest4.ibd",
-                                              "sbtest5.ibd",
-                                              "sbtest6.ibd",
-                                              "sbtest7.ibd",
-                                              "sbtest8.ibd",
-                                              "sbtest9.ibd",
-                                              "sbtest10.ibd",
-                                              "sbtest11.ibd",
-                                              "sbtest12.ibd",
-                                              "sbtest13.ibd",
-                                              "sbtest14.ibd",
-                                              "sbtest15.ibd",
-                                              "sbtest16.ibd",
-                                              "sbtest17.ibd",
-                                              "sbtest18.ibd",
-                                              "sbtest19.ibd",
-                                              "sbtest20.ibd",
-                                              "sbtest21.ibd",
-                                              "sbtest22.ibd",
-                                              "sbtest23.ibd",
-                                              "sbtest24.ibd",
-                                              "sbtest25.ibd",
-                                              "sbtest26.ibd",
-                                              "sbtest27.ibd",
-                                              "sbtest28.ibd",
-                                              "sbtest29.ibd",
-                                              "sbtest30.ibd",
-                                              "sbtest31.ibd",
-                                              "sbtest32.ibd",
-                                              "sbtest33.ibd",
-                                              "sbtest34.ibd",
-                                              "sbtest35.ibd",
-                                              "sbtest36.ibd",
-                                              "sbtest37.ibd",
-                                              "sbtest38.ibd",
-                                              "sbtest39.ibd",
-                                              "sbtest40.ibd",
+// 系统表空间和undo表空间，它们的page也从log生成，计算节点不再刷这些文件
+static constexpr const char * SYSTEM_FILES[] = {"ibdata1",
+                                                "undo001",
+                                                "undo002",
 };
-#endif
 
-#ifdef TPCC
-static constexpr const char * DATA_FILE_PREFIX = "/home/hkc/testLogOffL-srv/data/tpcc"; // don't suffix by '/'
-static constexpr const char * DATA_FILES[] = {
-        "customer.ibd",
-        "district.ibd",
-        "history.ibd",
-        "item.ibd",
-        "new_orders.ibd",
-        "order_line.ibd",
-        "orders.ibd",
-        "stock.ibd",
-        "warehouse.ibd"
-};
-#endif
+static constexpr size_t PER_LOG_FILE_SIZE = 2UL * 1024 * 1024 * 1204; // 2G
 
-static constexpr uint32_t PER_LOG_FILE_SIZE = 2UL * 1024 * 1024 * 1204; // 2G
+// 内存中redo log窗口(Log_Buf_Window_Size)使用超过这个比例之后，log writer每次写入都会被延迟一小段时间，越满延迟越长
+static constexpr double LOG_BUF_BACKPRESSURE_RATIO = 0.75;
+static constexpr uint32_t LOG_BUF_BACKPRESSURE_MAX_DELAY_US = 1000;
+// 溢出的log在ib_logfile中一直不是这次写入的内容时，每LOG_REFILL_RETRY_US重试一次，最多重试这么多次
+static constexpr uint32_t LOG_REFILL_RETRY_US = 1000;
+static constexpr uint32_t LOG_REFILL_MAX_RETRIES = 10000;
 // log block size in bytes
 static constexpr size_t LOG_BLOCK_SIZE = 512;
 
@@ -92,11 +96,64 @@ static constexpr uint32_t FIRST_LOG_BLOCK_HDR_NO = 18;
 static constexpr uint32_t N_LOG_METADATA_BLOCKS = 4;
 static constexpr uint32_t N_LOG_METADATA_BLOCK_BYTES = N_LOG_METADATA_BLOCKS * LOG_BLOCK_SIZE;
 static constexpr lsn_t LOG_START_LSN = 8716;
+static constexpr lsn_t LSN_MAX = UINT64_MAX;
 
 
 static constexpr uint32_t N_BLOCKS_IN_A_PAGE = DATA_PAGE_SIZE / LOG_BLOCK_SIZE;
 
-static constexpr uint32_t BUFFER_POOL_SIZE = 80 * 1024; // buffer pool size in data_page_size 128MB
+// buffer pool中的page地址按最近访问的顺序dump到Buffer_Pool_Dump_Path，重启之后在后台把它们读回来
+static constexpr uint32_t BUFFER_POOL_DUMP_INTERVAL_S = 300;
+static constexpr uint32_t BUFFER_POOL_LOAD_THREADS = 4;
+static constexpr uint32_t BUFFER_POOL_LOAD_READ_PAGES = 64; // 一次最多读这么多个连续的page
+// 启动时用这么多个线程读数据文件的第一个page，建立表空间目录
+static constexpr uint32_t TABLESPACE_LOAD_THREADS = 8;
+
+// 每个log group启动时先从共享的buffer pool中分到这么多个frame，之后按需要每次多拿BUFFER_POOL_GROW_PAGES个
+static constexpr uint32_t BUFFER_POOL_MIN_PAGES = 1024;
+static constexpr uint32_t BUFFER_POOL_GROW_PAGES = 64;
+
+// 每个log group最多这么多个apply线程，和LOGDB_MAX_APPLIER_THREADS一致
+static constexpr int APPLIER_THREADS_MAX = 64;
+// 没有配置Applier_Threads时，所有log group一共用CPU核数的这个比例，log parser和NFS worker也要用CPU
+static constexpr double APPLIER_THREADS_AUTO_CPU_RATIO = 0.5;
+// 没有配置Buffer_Pool_Size时用物理内存的这个比例
+static constexpr double BUFFER_POOL_AUTO_MEMORY_RATIO = 0.4;
+// 没有配置Apply_Index_Memory_Budget时，所有log group一共用物理内存的这个比例
+static constexpr double APPLY_INDEX_AUTO_MEMORY_RATIO = 0.1;
+
+// 匹配所有export的log group
+static constexpr uint16_t ANY_EXPORT = UINT16_MAX;
+// 一个log group对应一个MySQL实例：它的ib_logfile、数据目录，以及存储节点为它保存的状态，由LOGDB {}配置块生成
+struct LogGroupConfig {
+    uint16_t export_id;               // 计算节点通过这个export读写这个实例的文件
+    std::string log_path_prefix;      // ib_logfile所在的目录，suffix by '/'
+    std::string system_file_prefix;   // 数据目录，log中的文件名相对于它，suffix by '/'
+    std::string data_file_prefix;     // 这个目录下的.ibd由存储节点生成，don't suffix by '/'
+    std::string page_lsn_map_path;
+    std::string apply_index_spill_path;
+    std::string buffer_pool_dump_path;
+    std::string snapshot_path;        // 每个快照是其中的一个目录，和数据文件在同一个文件系统上时可以reflink
+    int log_file_number;
+    size_t apply_batch_size;          // APPLY_BATCH_SIZE必须能被log per file size整除
+    // 内存中redo log窗口的大小，和ib_logfile的大小无关。apply跟不上时，超出窗口的log不再拷贝到内存，
+    // 之后再从ib_logfile中读回来
+    size_t log_buf_window_size;
+    // 下面的可以在运行时调整
+    int applier_threads;              // 1个scheduler，其余是worker
+    uint32_t buffer_pool_pages;       // 最多占用共享buffer pool中的这么多个frame，0表示不单独限制
+    size_t apply_index_memory_budget;
+    // 行级变更流，change_feed_tables为空时不生成
+    std::string change_feed_path;                // segment文件和socket所在的目录
+    std::vector<std::string> change_feed_tables; // 选中的表的.ibd文件的完整路径
+    size_t change_feed_max_size;
+    // redo归档，恢复的log group从redo_archive_path读归档，自己不归档
+    bool redo_archive;
+    std::string redo_archive_path;
+    size_t redo_archive_max_size;                // 0表示不删除
+    // 不为空时这个log group不跟随ib_logfile，而是把这个快照恢复到数据目录，再apply归档中的redo到restore_lsn
+    std::string restore_snapshot;
+    lsn_t restore_lsn;                           // 0表示归档的结尾
+};
 
 // redo log 相关的偏移量
 static constexpr uint32_t LOG_BLOCK_HDR_NO = 0;
@@ -235,6 +292,18 @@ static constexpr uint32_t FIL_PAGE_ENCRYPTED_RTREE = 17;	/*!< Encrypted R-tree p
 static constexpr uint32_t FIL_PAGE_TYPE_LAST = FIL_PAGE_TYPE_UNKNOWN;
 
 static constexpr uint32_t FIL_PAGE_TYPE = 24;
+static constexpr uint32_t FIL_PAGE_PREV = 8;
+static constexpr uint32_t FIL_PAGE_NEXT = 12;
+static constexpr uint32_t FIL_NULL = 0xFFFFFFFF;
+
+// 压缩表空间（ROW_FORMAT=COMPRESSED）相关的常量
+static constexpr uint32_t FSP_HEADER_OFFSET = FIL_PAGE_DATA;
+static constexpr uint32_t FSP_SPACE_FLAGS = 16;
+static constexpr uint32_t FSP_FLAGS_POS_ZIP_SSIZE = 1;
+static constexpr uint32_t FSP_FLAGS_MASK_ZIP_SSIZE = 15U << FSP_FLAGS_POS_ZIP_SSIZE;
+static constexpr uint32_t UNIV_ZIP_SIZE_MIN = 1024;
+// 压缩page上BLOB指针的大小
+static constexpr uint32_t BTR_EXTERN_FIELD_REF_SIZE = 20;
 
 
 // index type
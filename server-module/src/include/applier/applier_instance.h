@@ -0,0 +1,63 @@
+#pragma once
+#include <pthread.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "applier/applier_config.h"
+#include "applier/log_log.h"
+#include "applier/buffer_pool.h"
+#include "applier/change_feed.h"
+#include "applier/page_lsn_map.h"
+#include "applier/page_version_store.h"
+#include "applier/redo_archive.h"
+
+/**
+ * 一个log group的applier，对应一个MySQL实例（一个export）。
+ * 每个实例有自己的log buf、log parser、ApplyIndex、log apply线程和表空间目录，实例之间互不干扰，
+ * 只有buffer pool的frame是所有实例共享的，每个实例最多用到buffer_pool.Capacity()个。
+ * config是启动时的配置，apply线程数、buffer pool和ApplyIndex的上限在运行时可以调整
+ */
+class ApplierInstance {
+public:
+    ApplierInstance(int group_no, const LogGroupConfig &config);
+    ~ApplierInstance();
+
+    const int group_no;
+    const LogGroupConfig config;
+
+    log_group_t log_group {};
+    log_parser_t log_parser {};
+    pthread_mutex_t log_group_mutex {};
+    pthread_cond_t log_parse_condition {}; // 每次log writer 写入，导致产生足够多的log，就会产生这个条件变量来唤醒log parser
+    pthread_cond_t log_write_condition {}; // 每次log applier 完成，释放出空间，就会产生这个条件变量来唤醒log writer
+    pthread_cond_t log_parsed_condition {}; // log parser每解析完一批就广播，唤醒等待解析的读请求
+
+    // log writer拷贝log时用，同一个log group的写入是串行的，一次写入不能超过COPY_BUF_SIZE
+    static constexpr size_t COPY_BUF_SIZE = 8 << 10 << 10; // 8M
+    pthread_mutex_t log_writer_mutex {};
+    std::unique_ptr<unsigned char[]> copy_buf;
+
+    ApplyIndex apply_index;
+    FlushHintQueue flush_hint_queue {};
+    // 按APPLIER_THREADS_MAX分配，只有前applier_threads个在工作，log apply scheduler在两批log之间增减worker
+    std::vector<log_applier_t> log_appliers;
+    std::atomic<int> applier_threads;
+
+    DataPageGroup data_page_group {};
+    PageLsnMap page_lsn_map {};
+    BufferPool buffer_pool;
+    PageVersionStore page_version_store;
+    ChangeFeed change_feed;
+    RedoArchive redo_archive;
+};
+
+// 按LOGDB {}中Log_Group的顺序，下标就是log group的编号
+extern std::vector<std::unique_ptr<ApplierInstance>> appliers;
+
+// group不存在时返回nullptr
+inline ApplierInstance *get_applier(int group) {
+    if (group < 0 || group >= static_cast<int>(appliers.size())) {
+        return nullptr;
+    }
+    return appliers[group].get();
+}
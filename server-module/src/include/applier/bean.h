@@ -44,8 +44,14 @@ public:
         other.log_body_start_ptr_ = nullptr;
         log_body_end_ptr_ = other.log_body_end_ptr_;
         other.log_body_end_ptr_ = nullptr;
-//        allocated_ = other.allocated_;
-//        other.allocated_ = false;
+        // log body的所有权也要转移，否则它永远不会被释放
+        allocated_ = other.allocated_;
+        other.allocated_ = false;
+    }
+
+    // 这条log在内存中占用的空间，包括log body和list节点
+    size_t MemorySize() const {
+        return sizeof(LogEntry) + 2 * sizeof(void *) + (log_body_end_ptr_ - log_body_start_ptr_);
     }
 
     LogEntry& operator=(const LogEntry& other) = delete;
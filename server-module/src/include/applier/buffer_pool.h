@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
 #include <list>
 #include <memory>
 #include <string>
@@ -29,14 +32,20 @@ public:
     PageReaderWriter() = default;
 
     ~PageReaderWriter() {
-        if (stream_.use_count() == 0 && stream_->is_open()) {
+        if (stream_.use_count() == 1 && stream_->is_open()) {
             stream_->close();
         }
     };
 
-    explicit PageReaderWriter(std::string &file_name)
-            : file_name_(file_name),
-              stream_(std::make_shared<std::fstream>(file_name_, std::ios::binary | std::ios::out | std::ios::in)) {}
+    explicit PageReaderWriter(const std::string &file_name) : file_name_(file_name) {}
+
+    // 第一次读写的时候才打开文件，打开失败时返回的stream不是open状态
+    std::shared_ptr<std::fstream> Stream() {
+        if (stream_ == nullptr) {
+            stream_ = std::make_shared<std::fstream>(file_name_, std::ios::binary | std::ios::out | std::ios::in);
+        }
+        return stream_;
+    }
 
     std::string file_name_{};
     std::shared_ptr<std::fstream> stream_{};
@@ -45,6 +54,14 @@ public:
 
 // 前置声明
 class BufferPool;
+class PageLsnMap;
+struct DataPageGroup;
+
+// 表空间flags中记录的page在磁盘上的大小，压缩表空间是zip size
+inline uint32_t fsp_flags_get_page_size(uint32_t flags) {
+    uint32_t zip_ssize = (flags & FSP_FLAGS_MASK_ZIP_SSIZE) >> FSP_FLAGS_POS_ZIP_SSIZE;
+    return zip_ssize == 0 ? DATA_PAGE_SIZE : (UNIV_ZIP_SIZE_MIN >> 1) << zip_ssize;
+}
 
 class Page {
 public:
@@ -115,22 +132,67 @@ public:
 
     void PageLock() { mutex_.lock(); }
 
+    bool TryPageLock() { return mutex_.try_lock(); }
+
     void PageUnLock() { mutex_.unlock(); }
 
     void SetDirty(bool is_dirty) { dirty_ = is_dirty; }
+
+    // page在磁盘上的大小，压缩表空间的page在data_的前面这么多字节中保存压缩之后的page
+    [[nodiscard]] uint32_t GetPhysicalSize() const { return physical_size_; }
+
+    [[nodiscard]] bool IsCompressed() const { return physical_size_ < DATA_PAGE_SIZE; }
 private:
+    // buffer pool缩小时释放frame的内存，frame再被分配出去之前重新申请
+    void ReleaseData() {
+        delete[] data_;
+        data_ = nullptr;
+    }
+    void AllocateData() {
+        if (data_ == nullptr) {
+            data_ = new unsigned char[DATA_PAGE_SIZE];
+        }
+    }
+
     byte *data_{nullptr};
+    uint32_t physical_size_ {DATA_PAGE_SIZE};
     bool dirty_ {false};
     std::mutex mutex_{};
     State state_{State::INVALID};
 };
 
+/**
+ * 一个log group的buffer pool。frame按需要从所有log group共享的Buffer_Pool_Size个frame中分配，
+ * 每个log group最多用到自己的上限，到了上限或者共享的frame用完之后淘汰自己的page。
+ * 上限和共享的frame数都可以在运行时调整，调小之后淘汰page，把frame的内存还给系统
+ */
 class BufferPool {
 public:
-    BufferPool();
+    BufferPool(const LogGroupConfig &config, DataPageGroup *data_page_group, PageLsnMap *page_lsn_map);
 
     ~BufferPool();
 
+    /**
+     * 建立表空间目录：数据目录下所有的.ibd文件，以及系统表空间和undo表空间。
+     * 用多个线程并行读每个文件的第一个page，读完才返回；文件在第一次读写page的时候才打开
+     */
+    void LoadTablespaces();
+
+    /**
+     * 登记一个表空间，MLOG_FILE_CREATE2创建的表空间从这里加入，之后它的log就会被apply
+     * @param page_size page在磁盘上的大小，压缩表空间是压缩之后的大小
+     */
+    void CreateTablespace(space_id_t space_id, const std::string &filename, uint32_t page_size);
+
+    // MLOG_FILE_RENAME2，已经打开的文件rename之后还可以继续读写，只需要换掉文件名
+    void RenameTablespace(space_id_t space_id, const std::string &filename);
+
+    // MLOG_TRUNCATE，丢掉buffer pool中这个表空间的所有page，不写回
+    void DiscardTablespacePages(space_id_t space_id);
+
+    // MLOG_FILE_DELETE，丢掉所有page，关闭文件，从目录中删掉
+    void DropTablespace(space_id_t space_id);
+
     // 在buffer pool中新建一个page
     Page *NewPage(space_id_t space_id, page_id_t page_id);
 
@@ -142,40 +204,144 @@ public:
 
     bool WriteBackLock(space_id_t space_id, page_id_t page_id);
 
-    std::string GetFilename(space_id_t space_id) const {
-        try {
-            return space_id_2_file_name_.at(space_id).file_name_;
-        } catch (std::exception &e) {
-            return "";
+    // 表空间中page在磁盘上的大小，压缩表空间是压缩之后的大小
+    uint32_t GetPageSize(space_id_t space_id) {
+        pthread_rwlock_rdlock(&catalog_lock_);
+        auto iter = space_id_2_page_size_.find(space_id);
+        auto page_size = iter == space_id_2_page_size_.end() ? DATA_PAGE_SIZE : iter->second;
+        pthread_rwlock_unlock(&catalog_lock_);
+        return page_size;
+    }
+
+    std::string GetFilename(space_id_t space_id) {
+        std::string filename;
+        pthread_rwlock_rdlock(&catalog_lock_);
+        if (auto iter = space_id_2_file_name_.find(space_id); iter != space_id_2_file_name_.end()) {
+            filename = iter->second.file_name_;
         }
+        pthread_rwlock_unlock(&catalog_lock_);
+        return filename;
     }
 
     void CopyPage(void *dest_buf, space_id_t space_id, page_id_t page_id);
 
+    // 把已经写回的page刷到磁盘上
+    void SyncDataFiles();
+
+    // 所有表空间的space id和文件名
+    std::vector<std::pair<space_id_t, std::string>> Tablespaces();
+
+    /**
+     * 快照开始拷贝一个表空间的文件之前调用：把已经写回的page交给文件系统，之后写回的page都记下来
+     * @return 数据文件名，表空间已经被删除时返回空串
+     */
+    std::string BeginCapture(space_id_t space_id);
+
+    // 拷贝完之后调用，返回BeginCapture之后写回过的page
+    std::vector<page_id_t> EndCapture(space_id_t space_id);
+
+    // 按最近访问的顺序返回buffer pool中所有page的地址，最近访问的在前
+    std::vector<std::pair<space_id_t, page_id_t>> ResidentPages();
+
+    /**
+     * 预热时把从磁盘读到的page放进buffer pool，放在LRU的尾部，不会淘汰已有的page
+     * @return page已经在buffer pool中、没有空闲的frame、或者读到之后磁盘上的page又被写过时返回false
+     */
+    bool LoadPage(space_id_t space_id, page_id_t page_id, const byte *data);
+
+    // 最多能用多少个frame
+    uint32_t Capacity() const;
+
+    // 已经分配了多少个frame
+    uint32_t AllocatedFrames();
+
+    /**
+     * 调整这个log group最多能用的frame数，调小时淘汰page直到不超过新的上限
+     * @param max_frames 0表示只受所有log group共享的frame数限制
+     */
+    void Resize(uint32_t max_frames);
+
+    // 上限不变，淘汰page直到只剩frames个frame，共享的frame数调小时用
+    void Shrink(uint32_t frames);
+
 private:
     std::list<frame_id_t> lru_list_;
 
     // [space_id, page_id] -> iterator 快速定位1个page在 LRU 中的位置
     std::unordered_map<space_id_t, std::unordered_map<page_id_t, std::list<frame_id_t>::iterator>> hash_map_;
-    Page *buffer_;
+    // 已经分配的frame，只在尾部增加，已有的Page地址不变
+    std::deque<Page> buffer_;
+    std::atomic<uint32_t> max_frames_; // 0表示不单独限制
+    uint32_t allocated_frames_ {0}; // buffer_中还持有内存的frame
+    std::vector<frame_id_t> retired_frames_ {}; // 缩小时释放了内存的frame，增长时先用它们
     // 数据目录的path
     std::string data_path_;
+    // 系统表空间和undo表空间所在的目录
+    std::string system_file_path_;
+    DataPageGroup *data_page_group_;
+    PageLsnMap *page_lsn_map_;
     // space_id -> file name的映射表
     std::unordered_map<uint32_t, PageReaderWriter> space_id_2_file_name_;
+    // space_id -> page在磁盘上的大小，只记录压缩表空间
+    std::unordered_map<uint32_t, uint32_t> space_id_2_page_size_;
+    // 保护上面两个表空间目录。修改目录时先拿lock_再拿它，拿着lock_读目录时不需要它
+    pthread_rwlock_t catalog_lock_;
+
+    // 正在做快照的表空间 -> BeginCapture之后写回的page
+    std::unordered_map<space_id_t, std::unordered_set<page_id_t>> captures_ {};
 
     // 指示buffer_中哪个frame是可以用的
     std::list<frame_id_t> free_list_;
 
     std::vector<PageAddressLru> frame_id_2_page_address_;
 
-    // 按照LRU规则淘汰一些页面
-    void Evict(int n);
+    // 登记到映射表和DataPageGroup中，调用时必须持有lock_
+    void RegisterTablespaceLocked(space_id_t space_id, const std::string &filename, uint32_t page_size);
+
+    // 把这个表空间的page从buffer pool中拿掉，不写回，调用时必须持有lock_。有page正在被使用时返回false
+    bool DiscardTablespacePagesLocked(space_id_t space_id);
 
+    // 从共享的frame中多拿一些放进free_list_，到了上限或者共享的frame用完时返回false，调用时必须持有lock_
+    bool GrowLocked();
+
+    // 淘汰page，释放free_list_中的frame，直到只剩frames个，调用时必须持有lock_
+    void ShrinkLocked(uint32_t frames);
+
+    // 按照LRU规则淘汰一些页面，page都在被使用、一个也没有淘汰时返回false，调用时必须持有lock_
+    bool Evict(int n);
+
+    // 保证free_list_中至少有一个frame，page都在被使用时返回false，调用时必须持有lock_
+    bool ReserveFrameLocked();
+
+    // 调用时必须持有lock_，free_list_不能为空
+    Page *NewPageLocked(space_id_t space_id, page_id_t page_id);
     Page *ReadPageFromDisk(space_id_t space_id, page_id_t page_id);
 
+    // 写回之后调用，调用时必须持有lock_
+    void CaptureLocked(space_id_t space_id, page_id_t page_id) {
+        if (!captures_.empty()) {
+            if (auto iter = captures_.find(space_id); iter != captures_.end()) {
+                iter->second.insert(page_id);
+            }
+        }
+    }
+
     pthread_mutex_t lock_;
 
 };
 
-extern BufferPool buffer_pool;
+// 把buffer pool中的page地址写到dump_path
+bool buffer_pool_dump(BufferPool *buffer_pool, const char *dump_path);
+
+/**
+ * 设置所有log group共享的frame数，启动时在创建log group之前调用。
+ * 已经分配的frame超过新的值时，各个log group按比例淘汰page，每个log group最少保留BUFFER_POOL_MIN_PAGES个
+ */
+void buffer_pool_set_total_frames(uint32_t total_frames);
+
+// 启动定期dump所有log group的buffer pool的线程
+void buffer_pool_dump_thread_start();
+
+// 在后台用多个线程把上次dump的page读回buffer pool，不等待读完
+void buffer_pool_load_start(BufferPool *buffer_pool, const char *dump_path);
 
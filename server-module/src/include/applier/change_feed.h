@@ -0,0 +1,153 @@
+#pragma once
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "applier/applier_config.h"
+#include "applier/bean.h"
+#include "applier/buffer_pool.h"
+#include "applier/log_log.h"
+
+class ApplierInstance;
+
+// 事件的类型，和事件一起写到segment文件中
+enum class ChangeType : uint8_t {
+    INSERT = 1,
+    UPDATE = 2,
+    DELETE = 3,
+    GAP = 4,    // 这个lsn之后、下一个事件之前的修改可能缺失
+};
+
+// 修改前或者修改后的一行，rec和LOOKUP返回的记录一样，前extra_size字节是null位图、变长列的长度和记录头
+struct ChangeRow {
+    std::vector<byte> rec {};
+    uint32_t extra_size {0};
+    uint32_t key_len {0};     // 记录中主键的字节数
+    bool Exists() const {return !rec.empty();}
+};
+
+struct ChangeEvent {
+    lsn_t lsn {0};            // 产生这个事件的log的lsn，INSERT和DELETE合并成的UPDATE用INSERT的lsn
+    ChangeType type {ChangeType::GAP};
+    space_id_t space_id {0};
+    page_id_t page_no {0};
+    std::vector<uint16_t> field_lens {}; // 索引的列描述，格式见lookup_record
+    uint32_t n_uniq {0};
+    ChangeRow before {};
+    ChangeRow after {};
+    uint64_t index_id {0};    // 不写出，feed线程用来认出同一个索引的page
+};
+
+// 一个mtr中选中的表上按记录修改的log，以及这个mtr修改过的这些表的page
+struct ChangeMtr {
+    lsn_t start_lsn {0};
+    std::vector<LogEntry> logs {};
+    std::vector<PageAddress> pages {};
+    bool gap {false};         // log parser丢掉了start_lsn开始的变更
+    size_t memory_usage {0};
+};
+
+/**
+ * 从redo生成选中的表的行级变更流，代替计算节点上基于binlog的CDC。
+ * log parser在把log插入ApplyIndex的同一遍解析中，把这些表上按记录修改的log
+ * （MLOG_COMP_REC_INSERT、MLOG_COMP_REC_UPDATE_IN_PLACE、MLOG_COMP_REC_CLUST_DELETE_MARK、MLOG_COMP_REC_DELETE）
+ * 按mtr交给feed线程。redo中没有完整的行，feed线程用自己的read view读出log之前的page，
+ * 在拷贝上apply这条log得到之后的page，从两个镜像中取出聚簇索引上修改前后的记录：
+ * 之前不存在或者被标记删除、之后存在的是INSERT，反过来是DELETE，前后都存在的是UPDATE。
+ * 同一个mtr中同一个主键的DELETE和INSERT合并成UPDATE，页分裂合并时搬到别的page上的记录不产生事件。
+ *
+ * 事件按lsn写到Change_Feed_Path下的segment文件中，文件名是其中第一个事件的lsn，整数都是大端：
+ *   len(4) lsn(8) type(1) space_id(4) page_no(4) n_fields(2) n_uniq(2) field_lens(2 * n_fields) before after
+ *   before和after是 extra_size(2) rec_len(2) rec(rec_len)，rec_len为0表示没有这一行
+ *   len是len之后的字节数，GAP事件只有lsn和type
+ * 消费者可以直接读segment文件，也可以连接Change_Feed_Path/feed.sock，发送8字节大端的游标，
+ * 之后收到lsn大于游标的事件，读完之后继续收到新的事件。游标为0表示从保留的最早的事件开始。
+ *
+ * 事件是物理的：没有提交的概念，记录中带着DB_TRX_ID，回滚表现为反向的事件；
+ * 前后都不可见的修改（比如purge）不产生事件；外部存储的BLOB列只有记录中的前缀和BLOB指针。
+ * feed落后太多、read view被回收、重启之后page已经比log新，或者游标早于保留的segment时产生GAP事件，
+ * 消费者应当重新做一次全量快照
+ */
+class ChangeFeed {
+public:
+    explicit ChangeFeed(const LogGroupConfig &config);
+    ~ChangeFeed();
+
+    bool Enabled() const {return !tables_.empty();}
+
+    // log parser启动之前调用：恢复segment文件，登记read view，启动feed线程和socket线程
+    void Start(ApplierInstance *applier);
+
+    // 下面三个只在log parser线程中调用
+    // 一条要插入ApplyIndex的page log，选中的表上的log被记下来
+    void Capture(const LogEntry &log);
+    /**
+     * 一个mtr的log都已经交给了Capture
+     * @param lsn 不晚于下一个mtr开始的lsn，feed线程空闲时把read view推进到这里
+     */
+    void CommitMtr(lsn_t lsn);
+    // 表空间被创建、改名或者删除之后重新判断它是否被选中
+    void SpaceChanged(space_id_t space_id);
+
+private:
+    static void *FeedRoutine(void *arg);
+    static void *ListenRoutine(void *arg);
+    static void *ClientRoutine(void *arg);
+
+    bool Selected(space_id_t space_id);
+    // 把mtr中的log变成事件追加到events，log之前的page已经被回收时追加GAP事件
+    void Materialise(const ChangeMtr &mtr, std::vector<ChangeEvent> *events);
+    // 页分裂合并时搬动的记录在mtr开始之前就在这个mtr修改过的page上，丢掉events中从first开始的这些INSERT
+    void DropMovedRows(const ChangeMtr &mtr, std::vector<ChangeEvent> *events, size_t first);
+    // 推进read view，read view已经被回收时重新登记
+    void RefreshView(lsn_t lsn);
+
+    void LoadSegments();
+    void Append(const std::vector<ChangeEvent> &events);
+    // 把编码好的事件写到当前的segment，写失败时丢掉它们，下一个事件之前写GAP
+    void Flush(std::vector<byte> *buf, lsn_t first_lsn, lsn_t last_lsn);
+    void OpenSegment(lsn_t first_lsn);
+    std::string SegmentPath(lsn_t first_lsn) const;
+    // 把lsn大于cursor的事件发给一个socket连接，直到连接断开
+    void Serve(int fd, lsn_t cursor);
+
+    const std::string path_;
+    const std::unordered_set<std::string> tables_;
+    const size_t max_size_;
+    ApplierInstance *applier_ {nullptr};
+
+    // log parser线程使用
+    std::unordered_map<space_id_t, bool> selected_ {};
+    ChangeMtr pending_ {};
+    lsn_t lost_lsn_ {0}; // 队列满了之后丢掉的第一个mtr
+
+    pthread_mutex_t queue_mutex_ {};
+    pthread_cond_t queue_cond_ {};
+    std::deque<ChangeMtr> queue_ {};
+    size_t queue_bytes_ {0};
+    std::atomic<lsn_t> safe_lsn_ {0};
+
+    // feed线程使用
+    pthread_t feed_thread_id_ {0};
+    uint64_t view_id_ {0};
+    std::vector<byte> page_buf_;
+    Page after_page_ {};
+    int segment_fd_ {-1};
+    lsn_t segment_lsn_ {0};
+    size_t segment_size_ {0};
+    lsn_t gap_lsn_ {0}; // 从这里开始的事件没有写出来，下一个事件之前先写GAP
+    bool last_gap_ {false}; // 写出的最后一个事件是GAP
+
+    // 保护segment目录，feed线程追加之后唤醒等待新事件的socket连接
+    pthread_mutex_t segment_mutex_ {};
+    pthread_cond_t appended_cond_ {};
+    std::map<lsn_t, size_t> segments_ {}; // 第一个事件的lsn -> 文件大小
+    lsn_t last_lsn_ {0};                  // 最后一个写出的事件
+
+    pthread_t listen_thread_id_ {0};
+    int listen_fd_ {-1};
+};
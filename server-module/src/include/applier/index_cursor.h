@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include "applier/applier_config.h"
+#include "applier/bean.h"
+#include "applier/interface.h"
+
+/**
+ * 在存储节点上读一个COMPACT格式的B-tree索引，供点查和扫描使用。
+ * 和InnoDB的btr_cur_search_to_nth_level一样，从根page开始，每一层先在page directory上二分，
+ * 再在slot内顺序查找，非叶子层沿着node pointer向下。
+ * page通过apply_and_copy_page(_as_of)拿到，游标只持有当前page的一份拷贝，不持有latch，
+ * 所以lsn为0时沿着FIL_PAGE_NEXT读到的相邻page不是同一时刻的，需要一致的结果时要指定lsn。
+ * key的每一列按字节比较，对整数列和二进制排序规则的字符串列是准确的
+ */
+class IndexCursor {
+public:
+    // 返回值和lookup_record一样
+    static constexpr int NO_PAGE = -1;
+    static constexpr int TOO_OLD = -2;
+    static constexpr int NOT_FOUND = -3;
+    static constexpr int BAD_INDEX = -4;
+
+    IndexCursor(int group, space_id_t space_id, page_id_t root_page_no, lsn_t lsn);
+
+    /**
+     * @param field_lens 索引的列描述，格式见lookup_record
+     * @return 列描述不合法或者是压缩表空间时返回false
+     */
+    bool Init(const uint16_t *field_lens, uint32_t n_fields, uint32_t n_uniq);
+
+    /**
+     * 从根page开始定位到叶子page上不大于key的最后一条记录，key比所有记录都小时定位到infimum
+     * @param key 索引的前n_key列，n_key为0时定位到最左边叶子page的infimum
+     * @param strict 为true时定位到小于key的最后一条记录，用于从前缀相同的第一条记录开始扫描
+     * @param cmp 返回key和定位到的记录比较的结果
+     * @return 成功返回0
+     */
+    int Search(const lookup_key_field *key, uint32_t n_key, bool strict, int *cmp);
+
+    /**
+     * 在当前叶子page上移动到下一条记录，最后一条用户记录之后是supremum
+     * @return 成功返回0，记录和列描述对不上返回BAD_INDEX
+     */
+    int Next();
+
+    /**
+     * 当前记录是supremum时，沿着FIL_PAGE_NEXT读下一个叶子page，定位到它的infimum
+     * @param last 没有下一个page时被设为true
+     */
+    int NextPage(bool *last);
+
+    // 比较key和当前记录的前n_key列，当前记录必须是用户记录
+    int Compare(const lookup_key_field *key, uint32_t n_key) const;
+
+    bool IsSupremum() const;
+    bool IsInfimum() const;
+    byte *Rec() const {return rec_;}
+    // 当前记录的偏移量，Search和Next定位到用户记录时计算
+    const RecordInfo &RecInfo() const {return rec_info_;}
+    uint32_t NFields() const {return n_fields_;}
+    uint32_t NUniq() const {return n_uniq_;}
+    page_id_t PageNo() const {return page_no_;}
+    // 已经读过的page数，包括非叶子page
+    uint32_t NPagesRead() const {return n_pages_read_;}
+
+private:
+    static constexpr uint32_t ANY_LEVEL = UINT32_MAX;
+
+    int ReadPage(page_id_t page_no, uint32_t expected_level);
+    bool RecInPage(const byte *rec) const;
+    bool CalculateOffsets(byte *rec);
+    bool CmpRec(byte *rec, bool leaf, int *cmp);
+    byte *SlotRec(uint32_t slot_no) const;
+    bool SearchPage(bool leaf, bool strict, int *cmp);
+
+    int group_;
+    space_id_t space_id_;
+    page_id_t root_page_no_;
+    lsn_t lsn_;
+    RecordInfo rec_info_ {};
+    uint32_t n_fields_ {0};
+    uint32_t n_uniq_ {0};
+    const lookup_key_field *key_ {nullptr};
+    uint32_t n_key_ {0};
+
+    std::vector<byte> buf_;
+    byte *page_ {nullptr};
+    page_id_t page_no_ {0};
+    uint64_t index_id_ {0};
+    uint32_t level_ {0};
+    byte *rec_ {nullptr};
+    uint32_t n_steps_ {0}; // 在当前page上Next的次数，超过记录数说明记录链表坏了
+    uint32_t n_pages_read_ {0};
+};
@@ -1,6 +1,8 @@
 #ifndef APPLIER_APPLIER_H_
 #define APPLIER_APPLIER_H_
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,26 +11,137 @@ extern "C" {
 // forward declaratio
 struct fsal_obj_handle;
 
+#define LOGDB_MAX_LOG_GROUPS 16
+#define LOGDB_MAX_APPLIER_THREADS 64
+#define LOGDB_ANY_EXPORT 0xFFFF
+// LOGDB { Apply_Policy }
+#define LOGDB_APPLY_EAGER 0
+#define LOGDB_APPLY_LAZY 1
+#define LOGDB_APPLY_HYBRID 2
+
+/*
+ * LOGDB {} 配置块，由support/logdb_read_conf.c解析。
+ * 线程数、buffer pool和ApplyIndex的内存上限可以在重新加载配置或者通过DBus修改，其余的要重启才生效
+ */
+
+// LOGDB { Log_Group {} }，一个MySQL实例，没有配置的路径和大小使用LOGDB块中的值
+struct logdb_group_param {
+    uint16_t export_id;                 // 计算节点通过这个export读写这个实例，LOGDB_ANY_EXPORT匹配所有export
+    char *log_path;                     // ib_logfile所在的目录
+    char *system_file_path;             // 数据目录，log中的文件名相对于它
+    char *data_file_path;               // 这个目录下的.ibd由存储节点生成
+    char *page_lsn_map_path;
+    char *apply_index_spill_path;
+    char *buffer_pool_dump_path;
+    uint32_t log_file_number;
+    uint32_t applier_threads;           // 0表示使用LOGDB块中的值
+    uint32_t buffer_pool_pages;         // 0表示只受整个节点的Buffer_Pool_Size限制
+    uint64_t apply_index_memory_budget; // 0表示使用LOGDB块中的值
+    char *change_feed_path;
+    char *change_feed_tables;
+    char *snapshot_path;
+    char *redo_archive_path;
+    // 不为NULL时这个log group不跟随ib_logfile，用这个快照和redo_archive_path中的归档恢复到restore_lsn
+    char *restore_snapshot;
+    uint64_t restore_lsn;               // 0表示恢复到归档的结尾
+};
+
+struct logdb_param {
+    uint16_t export_id;                 // 没有Log_Group子块时那个log group的export
+    uint32_t applier_threads;           // 每个log group的apply线程数，0表示按CPU核数自动选择
+    uint32_t buffer_pool_size;          // 所有log group共享的frame数，0表示按物理内存自动选择
+    uint64_t apply_index_memory_budget; // 每个log group的上限，0表示按物理内存自动选择
+    uint64_t apply_batch_size;
+    // 所有log group共用的apply policy，LOGDB_APPLY_*，HYBRID下log数或者字节数达到阈值的page仍然由后台apply
+    uint32_t apply_policy;
+    uint32_t apply_hybrid_chain_logs;
+    uint64_t apply_hybrid_chain_bytes;
+    uint32_t apply_lazy_memory_percent; // LAZY和HYBRID下ApplyIndex的内存超过上限的这个百分比之后后台apply推迟的page
+    uint64_t log_buf_window_size;       // 每个log group在内存中保留的redo log窗口
+    uint32_t log_file_number;
+    char *log_path;
+    char *system_file_path;
+    char *data_file_path;
+    char *page_lsn_map_path;
+    char *apply_index_spill_path;
+    char *buffer_pool_dump_path;
+    // 行级变更流的目录，以及逗号分隔的表名，比如"sbtest/sbtest1, sbtest/sbtest2"，没有表名时不生成
+    char *change_feed_path;
+    char *change_feed_tables;
+    uint64_t change_feed_max_size;      // 每个log group保留的segment文件的总大小
+    char *snapshot_path;                // 快照所在的目录
+    // 把解析过的redo压缩归档到redo_archive_path，用来做PITR
+    bool redo_archive;
+    char *redo_archive_path;
+    uint64_t redo_archive_max_size;     // 每个log group保留的归档的总大小，0表示不删除
+    // 没有Log_Group子块时只有一个log group，使用上面的路径，匹配所有export
+    uint32_t n_groups;
+    struct logdb_group_param groups[LOGDB_MAX_LOG_GROUPS];
+};
+
+extern struct logdb_param logdb_param;
+
+/**
+ * 重新加载配置之后调用，调整线程数、buffer pool和ApplyIndex的内存上限
+ * @param param 新的配置，log group按顺序和启动时的配置对应
+ */
+extern void update_applier_param(const struct logdb_param *param);
+/**
+ * 调整一个log group的apply线程数，下一批log开始apply之前生效
+ * @return 成功返回0，group不存在返回-1
+ */
+extern int set_applier_threads(int group, uint32_t threads);
+/**
+ * 调整一个log group最多能用的frame数，0表示只受整个节点的上限限制
+ * @return 成功返回0，group不存在返回-1
+ */
+extern int set_log_group_buffer_pool(int group, uint32_t pages);
+// 调整所有log group共享的frame数，0表示按物理内存自动选择，缩小时各个log group按比例淘汰page
+extern void set_buffer_pool_size(uint32_t pages);
+/**
+ * 切换所有log group的apply policy，下一批log开始生效，切回EAGER时之前推迟的page逐批apply
+ * @return 成功返回0，policy不是LOGDB_APPLY_*返回-1
+ */
+extern int set_apply_policy(uint32_t policy);
+
+/*
+ * 每个MySQL实例是一个log group，下面的函数都用group指明是哪一个，
+ * 除了is_*_file_in_*，group必须是存在的log group
+ */
+
+/**
+ * @return export对应的log group，没有时返回-1
+ */
+extern int get_export_log_group(uint16_t export_id);
+/**
+ * @return log group的export，匹配所有export时返回LOGDB_ANY_EXPORT，group不存在时返回-1
+ */
+extern int get_log_group_export(int group);
+/**
+ * @return log group的数量，log group从0开始编号
+ */
+extern int get_log_group_number(void);
+
 /**
  * check if the specific file is a log file
  * @param filename
  * @return if is a log file, return the its index in log group, or return -1 if not.
  */
-extern int is_log_file_in_name(const char *filename);
+extern int is_log_file_in_name(int group, const char *filename);
 
-extern int is_ibd_file_in_name(const char *filename);
-extern int is_ibd_file_in_handle(const struct fsal_obj_handle *handle);
+extern int is_ibd_file_in_name(int group, const char *filename);
+extern int is_ibd_file_in_handle(int group, const struct fsal_obj_handle *handle);
 /**
  * check if the specific file is a log file
  * @param handle vfs_file_handle_t
  * @return if is a log file, return the its index in log group, or return -1 if not.
  */
-extern int is_log_file_in_handle(const struct fsal_obj_handle *handle);
+extern int is_log_file_in_handle(int group, const struct fsal_obj_handle *handle);
 
-extern void register_log_file_handle(int index, struct fsal_obj_handle *handle);
-extern void register_ibd_file_handle(struct fsal_obj_handle *handle, int space_id);
+extern void register_log_file_handle(int group, int index, struct fsal_obj_handle *handle);
+extern void register_ibd_file_handle(int group, struct fsal_obj_handle *handle, int space_id);
 extern void init_applier_module(void);
-extern void wait_until_apply_done(int space_id, uint64_t offset, size_t io_amount);
+extern void wait_until_apply_done(int group, int space_id, uint64_t offset, size_t io_amount);
 /**
  * 把 log writer 写的日志拷贝到log group的buf里面去
  * @param log_file_index log writer要写第几个log文件
@@ -36,9 +149,192 @@ extern void wait_until_apply_done(int space_id, uint64_t offset, size_t io_amoun
  * @param iov
  * @param iov_count
  */
-extern void copy_log_to_buf(int log_file_index, size_t offset, struct iovec iov[], int iov_count);
+extern void copy_log_to_buf(int group, int log_file_index, size_t offset, struct iovec iov[], int iov_count);
 
-extern void copy_page_to_buf(char *dest_buf, uint32_t space_id, uint32_t start_page_id, int n_pages);
+extern void copy_page_to_buf(int group, char *dest_buf, uint32_t space_id, uint32_t start_page_id, int n_pages);
+/**
+ * @return 表空间中page在磁盘上的大小，压缩表空间是压缩之后的大小，其它的是DATA_PAGE_SIZE
+ */
+extern uint32_t get_space_page_size(int group, uint32_t space_id);
+/**
+ * @return 表空间的page由这个log group重新生成返回1，否则返回0，这时计算节点应当直接读文件
+ */
+extern int is_space_regenerated(int group, uint32_t space_id);
+
+/**
+ * 等待log parser解析完当前所有已经写入的log，供page server批量读page之前调用一次
+ * @return log parser已经解析到的lsn
+ */
+extern uint64_t wait_until_parse_done(int group);
+/**
+ * apply某一个page上所有尚未apply的log，然后把page拷贝到dest_buf，拷贝的长度是get_space_page_size
+ * @param dest_buf 至少DATA_PAGE_SIZE大小
+ * @return 成功返回0，表空间不存在或者page不存在返回-1
+ */
+extern int apply_and_copy_page(int group, char *dest_buf, uint32_t space_id, uint32_t page_id);
+/**
+ * 和apply_and_copy_page一样，但是拷贝的是lsn上的page，供只读计算节点使用
+ * @param lsn 只读节点回放到的lsn，应当不早于它登记的read view
+ * @return 成功返回0，表空间不存在或者page不存在返回-1，这个lsn上的page已经被回收返回-2
+ */
+extern int apply_and_copy_page_as_of(int group, char *dest_buf, uint32_t space_id, uint32_t page_id, uint64_t lsn);
+#define LOOKUP_SQL_NULL 0xFFFFFFFFU
+#define LOOKUP_MAX_KEY_FIELDS 16
+
+// 点查key中的一列，和它在记录中保存的格式一样，比如INT是符号位取反的大端整数，len为LOOKUP_SQL_NULL表示SQL NULL
+struct lookup_key_field {
+    const void *data;
+    uint32_t len;
+};
+
+struct lookup_result {
+    uint32_t page_no;    // 记录所在的叶子page
+    uint32_t rec_len;    // 记录在dest_buf中的长度
+    uint32_t extra_size; // 记录的origin在dest_buf中的偏移，前面是null位图、变长列的长度和记录头
+};
+
+/**
+ * 在存储节点上从根page开始遍历B-tree，找到key对应的叶子记录，计算节点不用再逐层读page。
+ * key的每一列按字节比较，对整数列和二进制排序规则的字符串列是准确的，其它排序规则要用读page的方式。
+ * 标记删除的记录也会返回，是否可见由调用者根据DB_TRX_ID判断
+ * @param root_page_no 索引的根page
+ * @param field_lens 索引的列描述，和redo中的一样：最高位表示NOT NULL，其余是0或者0x7fff表示变长列，否则是定长列的长度
+ * @param n_uniq 唯一确定一条记录的列数，key正好有这么多列
+ * @param lsn 0表示最新的page，否则和apply_and_copy_page_as_of一样读这个lsn上的page
+ * @param dest_buf 至少DATA_PAGE_SIZE大小，返回记录的extra字节和数据
+ * @return 找到返回0，表空间或者page不存在返回-1，lsn上的page已经被回收返回-2，没有这个key返回-3，
+ *         列描述和page对不上或者是压缩表空间返回-4
+ */
+extern int lookup_record(int group, uint32_t space_id, uint32_t root_page_no,
+                         const uint16_t *field_lens, uint32_t n_fields, uint32_t n_uniq,
+                         const struct lookup_key_field *key, uint64_t lsn,
+                         char *dest_buf, struct lookup_result *result);
+
+enum scan_op {
+    SCAN_OP_EQ = 0,
+    SCAN_OP_NE = 1,
+    SCAN_OP_LT = 2,
+    SCAN_OP_LE = 3,
+    SCAN_OP_GT = 4,
+    SCAN_OP_GE = 5,
+    SCAN_OP_IS_NULL = 6,
+    SCAN_OP_IS_NOT_NULL = 7,
+};
+
+// 列 op value，比较的是定长列，value和列在记录中保存的格式一样，长度等于列的长度；IS_NULL和IS_NOT_NULL不看value
+struct scan_predicate {
+    uint32_t field_no;
+    enum scan_op op;
+    struct lookup_key_field value;
+};
+
+// 扫描返回的一列，data指向page中的记录，只在回调中有效
+struct scan_value {
+    const void *data;
+    uint32_t len;      // SQL NULL时是LOOKUP_SQL_NULL
+    uint32_t external; // 非0表示列存在外部的BLOB page上，data是记录中保存的部分，最后20字节是BLOB指针
+};
+
+/**
+ * 每一行满足条件的记录调用一次
+ * @return 返回0继续扫描，非0表示放不下这一行了，扫描在这一行之前停止；第一行必须接受
+ */
+typedef int (*scan_row_callback)(void *arg, const struct scan_value *values, uint32_t n_values);
+
+struct scan_request {
+    uint32_t space_id;
+    uint32_t root_page_no;
+    const uint16_t *field_lens;         // 和lookup_record一样
+    uint32_t n_fields;
+    uint32_t n_uniq;
+    const struct lookup_key_field *start_key; // 前n_uniq列的前缀，n_start_key为0表示从第一条记录开始
+    uint32_t n_start_key;
+    uint32_t start_inclusive;
+    const struct lookup_key_field *end_key;   // 扫描到不大于end_key的最后一条记录，n_end_key为0表示扫描到最后
+    uint32_t n_end_key;
+    const struct scan_predicate *predicates;  // 同时满足的条件
+    uint32_t n_predicates;
+    const uint32_t *columns;            // 返回的列，n_columns为0表示返回所有的列
+    uint32_t n_columns;
+    uint64_t lsn;                       // 和lookup_record一样
+};
+
+struct scan_result {
+    char *key_buf;                      // 调用者提供，至少DATA_PAGE_SIZE大小，next_key的数据保存在这里
+    struct lookup_key_field next_key[LOOKUP_MAX_KEY_FIELDS];
+    uint32_t n_next_key;                // 最后处理完的记录的前n_uniq列，0表示没有处理过任何记录
+    uint32_t n_pages;                   // 读过的page数
+    uint32_t eof;                       // 非0表示已经扫描到了end_key或者最后一条记录
+};
+
+/**
+ * 在存储节点上按key的顺序扫描索引的叶子page，只把满足条件的记录中需要的列返回给计算节点。
+ * 标记删除的记录被跳过，没有MVCC，需要一致的结果时指定lsn。
+ * 一次调用最多读SCAN_MAX_LEAF_PAGES个叶子page，eof为0时用next_key作为start_key、start_inclusive为0继续扫描
+ * @return 成功返回0，表空间或者page不存在返回-1，lsn上的page已经被回收返回-2，
+ *         列描述、条件和page对不上，或者是压缩表空间返回-4
+ */
+extern int scan_index(int group, const struct scan_request *req, scan_row_callback callback, void *arg,
+                      struct scan_result *result);
+struct snapshot_result {
+    uint64_t lsn;       // 快照中的page都是这个lsn上的版本
+    uint32_t n_files;
+    uint32_t n_cloned;  // 用reflink克隆的文件，其余的是拷贝的
+    uint64_t n_patched; // 克隆之后改写成lsn上的版本的page
+};
+
+/**
+ * 在Snapshot_Path/name下生成所有表空间在lsn上的一致的快照，apply和log写入不停。
+ * 文件用reflink克隆，文件系统不支持时分段拷贝；之后把克隆中和lsn上不一样的page
+ * （还有log没有写回的、拷贝期间被写回的、lsn之后被修改的）改写成lsn上的版本，它们由read view保留。
+ * 快照目录中的logdb_snapshot文件记录lsn和每个文件的space id
+ * @param lsn 0表示现在解析到的lsn，否则不能早于现在解析到的lsn，会等log parser解析到它
+ * @return 成功返回0，IO失败返回-1，lsn上的page已经无法保留返回-2，lsn还没有被解析返回-3，
+ *         快照已经存在返回-4，log group不存在或者名字不合法返回-5
+ */
+extern int create_snapshot(int group, uint64_t lsn, const char *name, struct snapshot_result *result);
+/**
+ * 在后台线程中执行create_snapshot，同一时间只有一个快照在生成
+ * @param[out] job_id 用get_snapshot_status查询结果，从1开始
+ * @return 成功返回0，log group不存在或者名字不合法返回-5，已经有快照在生成返回-6
+ */
+extern int start_snapshot(int group, uint64_t lsn, const char *name, uint64_t *job_id);
+/**
+ * 查询start_snapshot启动的快照，只保留最近SNAPSHOT_JOBS_KEPT个的结果
+ * @return 还在生成返回1，job不存在或者不属于这个log group返回-7，其余和create_snapshot一样
+ */
+extern int get_snapshot_status(int group, uint64_t job_id, struct snapshot_result *result);
+/**
+ * 只读计算节点登记自己回放到的lsn，存储节点会保留这个lsn之后被修改的page的旧版本
+ * @return view id，lsn早于存储节点开始保留旧版本的位置时返回0，调用者应该等回放推进之后重试
+ */
+extern uint64_t register_read_view(int group, uint64_t lsn);
+/**
+ * 推进read view
+ * @return 成功返回0，read view已经过期或者被回收返回-1
+ */
+extern int update_read_view(int group, uint64_t view_id, uint64_t lsn);
+extern void release_read_view(int group, uint64_t view_id);
+/**
+ * @return 表空间中最后一条已解析log的结束lsn，计算节点缓存的page只要不早于它就没有过期
+ */
+extern uint64_t get_space_lsn(int group, uint32_t space_id);
+
+// 计算节点刷脏页时发来的提示
+struct page_flush_hint {
+    uint32_t space_id;
+    uint32_t page_id;
+    uint64_t lsn; // page被刷出时的FIL_PAGE_LSN
+};
+/**
+ * 把一批flush hint交给log apply hint线程，这些page会被优先materialise
+ * @return 最后一个hint的序号，用于 wait_flush_hints_done
+ */
+extern uint64_t push_flush_hints(int group, const struct page_flush_hint *hints, int n_hints);
+/**
+ * 等待序号不大于seq的flush hint全部materialise，之后计算节点就可以安全地推进checkpoint
+ */
+extern void wait_flush_hints_done(int group, uint64_t seq);
 #ifdef __cplusplus
 }
 #endif
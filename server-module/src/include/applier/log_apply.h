@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <unordered_map>
 #include <list>
 #include <string>
@@ -7,7 +8,34 @@
 #include "applier/log_log.h"
 #include "applier/applier_config.h"
 
-// 启动applier线程，n_thread指明有多少applier线程，其中1个scheduler，1个worker
-void log_apply_thread_start(int n_thread);
+class ApplierInstance;
 
-void log_apply_do_apply(const PageAddress &page_address, std::list<LogEntry> *log_entry_list);
+// 启动一个log group的applier线程，log_appliers中的第一个是scheduler，其余是worker，worker的数量跟着applier_threads变化
+void log_apply_thread_start(ApplierInstance *applier);
+
+// 当前的apply policy和它的阈值，所有log group共用，来自LOGDB配置块，重新加载配置或者通过DBus修改
+extern std::atomic<ApplyPolicy> apply_policy;
+extern std::atomic<uint32_t> apply_hybrid_chain_logs;
+extern std::atomic<size_t> apply_hybrid_chain_bytes;
+extern std::atomic<uint32_t> apply_lazy_memory_percent;
+
+/**
+ * log apply scheduler每一批调用一次，按照apply policy挑出这一批要apply的page，剩下的推迟到被读取的时候再apply
+ * @param pages front segment中的page
+ * @param drain 返回之前被推迟，这一批要一起apply的page
+ */
+std::vector<PageAddress> log_apply_policy_filter(ApplyIndex &apply_index, std::vector<PageAddress> pages,
+                                                 std::vector<PageAddress> *drain);
+
+// 把一条log apply到page上，不修改page lsn
+bool log_apply_apply_one_log(Page *page, const LogEntry &log);
+
+// 把一条page的log链apply到log group的buffer pool中的page上，从ApplyIndex取走的每一条log链都要交给它
+void log_apply_do_apply(ApplierInstance *applier, const PageAddress &page_address,
+                        std::list<LogEntry> *log_entry_list);
+
+/**
+ * data page reader读page之前调用，把page上所有尚未apply的log apply到buffer pool中的page上。
+ * 登记之后log apply worker不会再取走这个page的log，先等worker写回已经取走的log链，再自己apply剩下的
+ */
+void log_apply_read_page(ApplierInstance *applier, const PageAddress &page_address);
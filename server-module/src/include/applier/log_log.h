@@ -6,9 +6,11 @@
 #include <pthread.h>
 #include <memory>
 #include <list>
+#include <deque>
 #include <unordered_map>
 #include <atomic>
 #include <unordered_set>
+#include <algorithm>
 #include "applier/applier_config.h"
 #include "applier/bean.h"
 #include "applier/hash_util.h"
@@ -67,28 +69,29 @@ struct log_parser_t {
     pthread_t thread_id {0};
     size_t round {0};
 
-    unsigned char *parse_buf {nullptr}; // 要么指向parse_buf_back，要么指向log_group的log_buf
+    // 指向log_group的log_buf，log_buf是首尾相连映射的，跨过环尾的一批log也是连续的
+    unsigned char *parse_buf {nullptr};
 
-    // 如果当前需要解析的一批log，在log buf中出现首尾相连的情况，
-    // 为了保证parse buf是连续的，就必须把首尾两端log拷贝到parse_buf_back中
-    std::unique_ptr<unsigned char[]> parse_buf_back {std::unique_ptr<unsigned char[]>(new unsigned char [PER_LOG_FILE_SIZE * LOG_FILE_NUMBER])};
-
-    int log_dispatch_number_table[APPLIER_THREAD] {}; // 记录当前已经分配给每一个log applier的log数量
+    int log_dispatch_number_table[APPLIER_THREADS_MAX] {}; // 记录当前已经分配给每一个log applier的log数量
 
     std::unordered_map<PageAddress, int> log_dispatch_trace_table {}; // 记录某一个space id, page id被分配到了哪一个log applier
 
     size_t parsed_lsn;
 };
 
-extern log_parser_t log_parser;
-
 using apply_task_bucket = std::unordered_map<PageAddress, std::list<LogEntry>>;
 
+class ApplierInstance;
+
 struct log_applier_t {
 public:
     log_applier_t();
+    ApplierInstance *applier {nullptr}; // 属于哪个log group
+    int index {0}; // 在log group的log_appliers中的位置，0是scheduler
     // logs need to be applied
     std::vector<PageAddress> logs {};
+    // 之前被推迟apply，这一批要apply的page
+    std::vector<PageAddress> deferred_logs {};
 
     pthread_t thread_id {0};
 
@@ -96,6 +99,8 @@ public:
 
     std::atomic_bool need_process {false}; // 当前线程是不是有任务等待被处理
 
+    std::atomic_bool need_exit {false}; // apply线程数调小了，这个worker退出
+
     pthread_mutex_t mutex {}; // 保护自己
 
     pthread_cond_t need_process_cond {}; // log apply scheduler通知log apply worker起来干活
@@ -103,28 +108,30 @@ public:
 
 struct fsal_obj_handle;
 
+// 一个log group中由存储节点生成的表空间，以及它们的文件名和handle
 struct DataPageGroup {
 public:
-    static DataPageGroup &Get();
+    DataPageGroup() { pthread_rwlock_init(&rw_lock_, nullptr); }
+    ~DataPageGroup() { pthread_rwlock_destroy(&rw_lock_); }
     void Insert(const std::string &filename, space_id_t space_id);
     void Insert(const struct fsal_obj_handle* handle, space_id_t space_id);
+    // 表空间换了文件名，已经登记的handle不变
+    void Rename(space_id_t space_id, const std::string &filename);
+    // 表空间被删掉了，它的文件名和handle都不再是data page
+    void Erase(space_id_t space_id);
     int Exist(const std::string &filename);
     int Exist(const struct fsal_obj_handle* handle);
     bool Exist(space_id_t space_id);
 private:
-    DataPageGroup() { pthread_rwlock_init(&rw_lock_, nullptr); }
-    ~DataPageGroup() { pthread_rwlock_destroy(&rw_lock_); }
     std::unordered_map<std::string, space_id_t> filename2space_id_ {};
     std::unordered_map<const struct fsal_obj_handle*, space_id_t> handle2space_id_ {};
     std::unordered_set<space_id_t> space_id_ {};
     pthread_rwlock_t rw_lock_ {};
 };
 
-extern std::vector<log_applier_t> log_appliers;
-
 struct apply_task {
     apply_task() {
-        for (int i = 0; i < APPLIER_THREAD; ++i) {
+        for (int i = 0; i < APPLIER_THREADS_MAX; ++i) {
             log_hash.emplace_back(std::make_unique<apply_task_bucket>());
         }
     }
@@ -140,84 +147,250 @@ private:
     pthread_mutex_t &lock_;
 };
 
+namespace rocksdb {
+class DB;
+}
+
+// ApplyIndex放不下的冷log链，按(space id, page id, lsn)存到本地的RocksDB。
+// 里面的内容只在进程运行期间有意义，重启之后index会从redo log重新构建，所以打开时会清空
+class LogSpillStore {
+public:
+    LogSpillStore() = default;
+    ~LogSpillStore();
+    bool Open(const std::string &path);
+    bool Opened() const {return db_ != nullptr;}
+    // 写出一个page的log链
+    bool Put(const std::list<LogEntry> &logs);
+    // 读回一个page在[first_lsn, last_lsn]之间的log，按lsn顺序追加到logs，并从RocksDB中删掉
+    void Take(const PageAddress &page_address, lsn_t first_lsn, lsn_t last_lsn, std::list<LogEntry> *logs);
+private:
+    rocksdb::DB *db_ {nullptr};
+};
+
+/**
+ * 插入一条log之前压缩这个page的log链，返回释放的内存
+ * 1. MLOG_COMP_PAGE_CREATE会重建index page，之前的record操作，以及被它覆盖的区域上的按字节写的log都没有用了
+ * 2. 按字节写的log（MLOG_nBYTES, MLOG_WRITE_STRING）会覆盖之前写同一区域的log，只越过链尾连续的按字节写的log，
+ *    因为其它的log可能读到这些字节
+ * MLOG_INIT_FILE_PAGE2会清空整个page，由ApplyIndex丢掉所有segment中这个page的log
+ */
+size_t compact_log_chain(std::list<LogEntry> *chain, const LogEntry &next);
+
+// 一个page从上一次被apply之后插入的log
+struct PageChainStats {
+    uint32_t n_logs {0};
+    size_t log_bytes {0};
+};
+
 class ApplyIndex {
 public:
     class IndexSegment {
     public:
         using log_list = std::unique_ptr<std::list<LogEntry>>;
     public:
-        IndexSegment() = default;
+        // 不指定上限的segment永远不会满，用来放推迟apply的log
+        explicit IndexSegment(size_t log_len_limit = SIZE_MAX) : log_len_limit_(log_len_limit) {}
         ~IndexSegment() = default;
-        bool Insert(LogEntry &&log) {
+        bool Insert(LogEntry &&log, bool compact) {
             // 已经满了
             if (total_log_len_ >= log_len_limit_) {
                 return false;
             }
             auto log_len = log.log_len_;
+            memory_usage_ += log.MemorySize();
             PageAddress page_address(log.space_id_, log.page_id_);
             if (index_segment_.find(page_address) == index_segment_.end()) {
                 auto [iter, success] = index_segment_.insert(std::make_pair(page_address, std::make_unique<std::list<LogEntry>>()));
                 assert(success);
                 iter->second->push_back(std::move(log));
             } else {
-                index_segment_[page_address]->push_back(std::move(log));
+                auto &chain = index_segment_[page_address];
+                if (compact) {
+                    memory_usage_ -= compact_log_chain(chain.get(), log);
+                }
+                chain->push_back(std::move(log));
             }
+            // total_log_len_不减去被压缩掉的log，log buf中的空间要等整个segment apply完才释放
             total_log_len_ += log_len;
             return true;
         }
         bool Full() const {
             return total_log_len_ >= log_len_limit_;
         }
-        log_list ExtractLog(const PageAddress &page_address) {
+        // 不再接收新的log，让log apply scheduler可以调度一个没写满的segment
+        void Seal() {
+            log_len_limit_ = total_log_len_;
+        }
+        // 溢出的log一定比内存中同一个page的log旧，先读回溢出的部分，再接上内存中的部分
+        log_list ExtractLog(const PageAddress &page_address, LogSpillStore *spill_store) {
+            log_list res {nullptr};
+            if (auto spilled = spilled_.find(page_address); spilled != spilled_.end()) {
+                res = std::make_unique<std::list<LogEntry>>();
+                spill_store->Take(page_address, spilled->second.first, spilled->second.second, res.get());
+                spilled_.erase(spilled);
+            }
             auto iter = index_segment_.find(page_address);
             if (iter == index_segment_.end()) {
-                return {nullptr};
+                return res;
+            }
+            memory_usage_ -= ChainMemorySize(*iter->second);
+            if (res == nullptr) {
+                res = std::move(iter->second);
+            } else {
+                res->splice(res->end(), *iter->second);
             }
-            log_list res = std::move(iter->second);
             index_segment_.erase(iter);
             return res;
         }
-        bool Empty() const {return index_segment_.empty();}
+        // 把不在hot中的log链写到spill_store，直到释放了至少target字节，返回实际释放的字节数
+        size_t Spill(LogSpillStore *spill_store, const std::unordered_set<PageAddress> &hot, size_t target) {
+            size_t freed = 0;
+            for (auto iter = index_segment_.begin(); iter != index_segment_.end() && freed < target;) {
+                if (hot.find(iter->first) != hot.end() || !spill_store->Put(*iter->second)) {
+                    ++iter;
+                    continue;
+                }
+                auto first_lsn = iter->second->front().log_start_lsn_;
+                auto last_lsn = iter->second->back().log_start_lsn_;
+                auto [spilled, inserted] = spilled_.emplace(iter->first, std::make_pair(first_lsn, last_lsn));
+                if (!inserted) {
+                    spilled->second.second = last_lsn;
+                }
+                auto chain_size = ChainMemorySize(*iter->second);
+                memory_usage_ -= chain_size;
+                freed += chain_size;
+                iter = index_segment_.erase(iter);
+            }
+            return freed;
+        }
+        // 把一个page的log链移到dest的链尾，dest中的log必须比这里的旧
+        bool MoveTo(const PageAddress &page_address, IndexSegment *dest, LogSpillStore *spill_store) {
+            bool moved = false;
+            if (auto spilled = spilled_.find(page_address); spilled != spilled_.end()) {
+                auto dest_chain = dest->index_segment_.find(page_address);
+                if (dest_chain == dest->index_segment_.end()) {
+                    auto [dest_spilled, inserted] = dest->spilled_.emplace(page_address, spilled->second);
+                    if (!inserted) {
+                        dest_spilled->second.second = spilled->second.second;
+                    }
+                } else {
+                    // 溢出的log必须比内存中的旧，dest在内存中已经有更旧的log了，只能读回来接在后面
+                    std::list<LogEntry> logs;
+                    spill_store->Take(page_address, spilled->second.first, spilled->second.second, &logs);
+                    dest->memory_usage_ += ChainMemorySize(logs);
+                    dest_chain->second->splice(dest_chain->second->end(), logs);
+                }
+                spilled_.erase(spilled);
+                moved = true;
+            }
+            if (auto iter = index_segment_.find(page_address); iter != index_segment_.end()) {
+                auto chain_size = ChainMemorySize(*iter->second);
+                memory_usage_ -= chain_size;
+                dest->memory_usage_ += chain_size;
+                auto &dest_chain = dest->index_segment_[page_address];
+                if (dest_chain == nullptr) {
+                    dest_chain = std::make_unique<std::list<LogEntry>>();
+                }
+                dest_chain->splice(dest_chain->end(), *iter->second);
+                index_segment_.erase(iter);
+                moved = true;
+            }
+            return moved;
+        }
+        bool Empty() const {return index_segment_.empty() && spilled_.empty();}
         std::vector<PageAddress> Hint(size_t *log_len) {
             std::vector<PageAddress> res;
             for (const auto &item: index_segment_) {
                 res.push_back(item.first);
             }
+            for (const auto &item: spilled_) {
+                if (index_segment_.find(item.first) == index_segment_.end()) {
+                    res.push_back(item.first);
+                }
+            }
             if (log_len != nullptr) {
                 *log_len = total_log_len_;
             }
             return res;
         }
+        size_t MemoryUsage() const {return memory_usage_;}
     private:
+        static size_t ChainMemorySize(const std::list<LogEntry> &logs) {
+            size_t size = 0;
+            for (const auto &log: logs) {
+                size += log.MemorySize();
+            }
+            return size;
+        }
         size_t total_log_len_ {0};
-        size_t log_len_limit_ {APPLY_BATCH_SIZE}; // 一个index segment最多存储这么长的log
+        size_t log_len_limit_; // 一个index segment最多存储这么长的log
+        size_t memory_usage_ {0}; // 留在内存中的log占用的空间
         std::unordered_map<PageAddress, log_list> index_segment_ {};
+        // 溢出到RocksDB的page，以及溢出的log的第一条和最后一条的lsn
+        std::unordered_map<PageAddress, std::pair<lsn_t, lsn_t>> spilled_ {};
     };
 public:
-    ApplyIndex() {
+    // batch_size是一个index segment最多存储的log长度，也就是log apply scheduler一批apply的log
+    ApplyIndex(size_t memory_budget, size_t batch_size) : memory_budget_(memory_budget), batch_size_(batch_size) {
         pthread_mutex_init(&lock_, nullptr);
         pthread_cond_init(&index_not_empty_cond_, nullptr);
         pthread_cond_init(&front_full_cond_, nullptr);
+        pthread_cond_init(&front_deleted_cond_, nullptr);
+        pthread_cond_init(&applied_cond_, nullptr);
     }
     ~ApplyIndex() {
         pthread_mutex_destroy(&lock_);
         pthread_cond_destroy(&index_not_empty_cond_);
         pthread_cond_destroy(&front_full_cond_);
+        pthread_cond_destroy(&front_deleted_cond_);
+        pthread_cond_destroy(&applied_cond_);
+    }
+    // 打开溢出用的RocksDB，失败时index只放在内存中
+    bool OpenSpillStore(const std::string &path) {
+        PthreadMutexGuard guard(lock_);
+        return spill_store_.Open(path);
     }
     void InsertBack(LogEntry &&log) {
         PthreadMutexGuard guard(lock_);
+        auto log_end_lsn = log.log_start_lsn_ + log.log_len_;
+        auto &space_lsn = space_lsn_[log.space_id_];
+        space_lsn = std::max(space_lsn, log_end_lsn);
         if (index_.empty()) {
-            index_.push_back(std::make_unique<IndexSegment>());
+            index_.push_back(std::make_unique<IndexSegment>(batch_size_));
             pthread_cond_signal(&index_not_empty_cond_);
         }
         if (index_.back()->Full()) {
-            index_.push_back(std::make_unique<IndexSegment>());
+            index_.push_back(std::make_unique<IndexSegment>(batch_size_));
         }
-        index_.back()->Insert(std::move(log));
+        if (log.type_ == MLOG_INIT_FILE_PAGE2 && compact_chains_) {
+            // page会被清空，之前所有的log都没有用了
+            PageAddress page_address(log.space_id_, log.page_id_);
+            ExtractLogLocked(&deferred_, page_address);
+            for (auto &item: index_) {
+                ExtractLogLocked(item.get(), page_address);
+            }
+            page_stats_.erase(page_address);
+            compacted_lsn_ = log_end_lsn;
+        }
+        auto &stats = page_stats_[PageAddress(log.space_id_, log.page_id_)];
+        stats.n_logs++;
+        stats.log_bytes += log.log_len_;
+        auto &back = index_.back();
+        auto before = back->MemoryUsage();
+        auto log_size = log.MemorySize();
+        back->Insert(std::move(log), compact_chains_);
+        if (back->MemoryUsage() < before + log_size) {
+            // 被这条log覆盖的log被丢掉了
+            compacted_lsn_ = log_end_lsn;
+        }
+        memory_usage_ = memory_usage_ - before + back->MemoryUsage();
         if (index_.back()->Full()) {
             // 唤醒log applier scheduler
             pthread_cond_signal(&front_full_cond_);
         }
+        if (memory_usage_ > std::max(memory_budget_.load(), next_spill_usage_)) {
+            SpillCold();
+        }
     }
 
     IndexSegment::log_list ExtractFront(const PageAddress &page_address) {
@@ -228,9 +401,76 @@ public:
             pthread_cond_wait(&index_not_empty_cond_, &lock_);
         }
 
-        auto res = index_.front()->ExtractLog(page_address);
+        // 有data page reader在等这个page，留给它自己apply
+        if (reading_pages_.find(page_address) != reading_pages_.end()) {
+            DeleteFrontSegment();
+            return nullptr;
+        }
+
+        // 推迟apply的log比front中的旧
+        auto res = ExtractLogLocked(&deferred_, page_address);
+        auto front_logs = ExtractLogLocked(index_.front().get(), page_address);
+        if (res == nullptr) {
+            res = std::move(front_logs);
+        } else if (front_logs != nullptr) {
+            res->splice(res->end(), *front_logs);
+        }
+        page_stats_.erase(page_address);
+        if (res != nullptr) {
+            applying_[page_address]++;
+        }
+        DeleteFrontSegment();
+
+        return res;
+    }
+
+    // 不apply front中的这些page，把它们的log移到推迟apply的log里，等被读取的时候再apply
+    void DeferFront(const std::vector<PageAddress> &pages) {
+        PthreadMutexGuard guard(lock_);
+        if (index_.empty()) {
+            return;
+        }
+        auto &front = index_.front();
+        auto before = front->MemoryUsage() + deferred_.MemoryUsage();
+        for (const auto &page_address: pages) {
+            front->MoveTo(page_address, &deferred_, &spill_store_);
+        }
+        memory_usage_ = memory_usage_ - before + front->MemoryUsage() + deferred_.MemoryUsage();
         DeleteFrontSegment();
+    }
+
+    // 取出推迟apply的log，不会动index_
+    IndexSegment::log_list ExtractDeferred(const PageAddress &page_address) {
+        PthreadMutexGuard guard(lock_);
+        if (reading_pages_.find(page_address) != reading_pages_.end()) {
+            return nullptr;
+        }
+        auto res = ExtractLogLocked(&deferred_, page_address);
+        page_stats_.erase(page_address);
+        if (res != nullptr) {
+            applying_[page_address]++;
+        }
+        return res;
+    }
 
+    // 最多max_pages个推迟apply的page
+    std::vector<PageAddress> DeferredPages(size_t max_pages) {
+        PthreadMutexGuard guard(lock_);
+        auto res = deferred_.Hint(nullptr);
+        if (res.size() > max_pages) {
+            res.resize(max_pages);
+        }
+        return res;
+    }
+
+    std::vector<PageChainStats> ChainStats(const std::vector<PageAddress> &pages) {
+        PthreadMutexGuard guard(lock_);
+        std::vector<PageChainStats> res;
+        res.reserve(pages.size());
+        for (const auto &page_address: pages) {
+            auto iter = page_stats_.find(page_address);
+            res.push_back(iter == page_stats_.end() ? PageChainStats() : iter->second);
+        }
         return res;
     }
 
@@ -247,7 +487,12 @@ public:
             pthread_cond_wait(&front_full_cond_, &lock_);
         }
 
-        return index_.front()->Hint(log_len);
+        auto res = index_.front()->Hint(log_len);
+        // 所有的log都已经被data page reader抽走了，不会再有ExtractFront来删除它
+        if (res.empty()) {
+            DeleteFrontSegment();
+        }
+        return res;
 
     }
 
@@ -258,34 +503,295 @@ public:
 
         if (index_.front()->Empty()) {
             index_.erase(index_.begin());
+            pthread_cond_broadcast(&front_deleted_cond_);
+            if (!index_.empty() && index_.front()->Full()) {
+                pthread_cond_signal(&front_full_cond_);
+            }
+        }
+    }
+
+    // 把最后一个segment封住，然后等待到目前为止插入的log全部被apply
+    void SealAndWaitApplied() {
+        PthreadMutexGuard guard(lock_);
+        if (index_.empty()) {
+            return;
+        }
+        auto *last = index_.back().get();
+        last->Seal();
+        pthread_cond_signal(&front_full_cond_);
+        auto is_last = [last](const auto &segment) {return segment.get() == last;};
+        while (std::find_if(index_.begin(), index_.end(), is_last) != index_.end()) {
+            pthread_cond_wait(&front_deleted_cond_, &lock_);
         }
     }
 
+    /**
+     * 取出一个page所有还没有apply的log链，调用之前必须BeginRead这个page。
+     * 先等已经被取走的log链写回，否则page_lsn已经推进，后面的log会被跳过，或者读到还没有apply的page
+     */
     std::vector<IndexSegment::log_list> Search(const PageAddress &page_address) {
         PthreadMutexGuard guard(lock_);
-        // wait until index_ is not empty
+        TouchRecentRead(page_address);
+        while (applying_.find(page_address) != applying_.end()) {
+            pthread_cond_wait(&applied_cond_, &lock_);
+        }
         std::vector<IndexSegment::log_list> res;
+        if (auto logs = ExtractLogLocked(&deferred_, page_address); logs != nullptr) {
+            res.push_back(std::move(logs));
+        }
         for (auto &item: index_) {
-            if (auto logs = item->ExtractLog(page_address); logs != nullptr) {
+            if (auto logs = ExtractLogLocked(item.get(), page_address); logs != nullptr) {
                 res.push_back(std::move(logs));
             }
         }
+        page_stats_.erase(page_address);
+        if (!res.empty()) {
+            applying_[page_address] += res.size();
+        }
+        // log apply worker让出了这个page，front中最后一个page可能是在这里被取走的
+        if (!index_.empty() && index_.front()->Full()) {
+            DeleteFrontSegment();
+        }
+        return res;
+    }
+
+    /**
+     * data page reader在等待page之前登记，log apply worker不会再取走这些page的log，
+     * 由reader自己通过Search来apply，reader不会排在后台apply的后面
+     */
+    void BeginRead(const std::vector<PageAddress> &pages) {
+        PthreadMutexGuard guard(lock_);
+        for (const auto &page_address: pages) {
+            reading_pages_[page_address]++;
+        }
+        active_readers_++;
+    }
+
+    void EndRead(const std::vector<PageAddress> &pages) {
+        PthreadMutexGuard guard(lock_);
+        for (const auto &page_address: pages) {
+            if (auto iter = reading_pages_.find(page_address); iter != reading_pages_.end() && --iter->second == 0) {
+                reading_pages_.erase(iter);
+            }
+        }
+        active_readers_--;
+    }
+
+    // 表空间被删除或者truncate，丢掉它所有还没有apply的log，包括推迟apply的和溢出的，返回丢掉的log链的数量
+    size_t DropSpace(space_id_t space_id) {
+        PthreadMutexGuard guard(lock_);
+        size_t n_chains = 0;
+        auto drop = [&](IndexSegment *segment) {
+            for (const auto &page_address: segment->Hint(nullptr)) {
+                if (page_address.SpaceId() == space_id && ExtractLogLocked(segment, page_address) != nullptr) {
+                    n_chains++;
+                }
+            }
+        };
+        drop(&deferred_);
+        for (auto &item: index_) {
+            drop(item.get());
+        }
+        for (auto iter = page_stats_.begin(); iter != page_stats_.end();) {
+            iter = iter->first.SpaceId() == space_id ? page_stats_.erase(iter) : std::next(iter);
+        }
+        // front中可能只剩下这个表空间的log
+        if (!index_.empty() && index_.front()->Full()) {
+            DeleteFrontSegment();
+        }
+        return n_chains;
+    }
+
+    // 取走的一条log链已经apply并且写回，每条取走的log链调用一次
+    void EndApply(const PageAddress &page_address) {
+        PthreadMutexGuard guard(lock_);
+        if (auto iter = applying_.find(page_address); iter != applying_.end() && --iter->second == 0) {
+            applying_.erase(iter);
+            pthread_cond_broadcast(&applied_cond_);
+        }
+    }
+
+    // 表空间中还有log没有写回磁盘的page：还在index中的，以及log已经被取走、正在apply的
+    std::vector<page_id_t> PendingPages(space_id_t space_id) {
+        PthreadMutexGuard guard(lock_);
+        std::vector<page_id_t> res;
+        for (const auto &item: page_stats_) {
+            if (item.first.SpaceId() == space_id) {
+                res.push_back(item.first.PageId());
+            }
+        }
+        for (const auto &item: applying_) {
+            if (item.first.SpaceId() == space_id) {
+                res.push_back(item.first.PageId());
+            }
+        }
         return res;
     }
+
+    /**
+     * 只读节点要读中间版本的page，从这里开始不再丢掉被覆盖的log
+     * @return 之前压缩log链时丢掉的log只影响早于这个lsn的中间版本
+     */
+    lsn_t DisableCompaction() {
+        PthreadMutexGuard guard(lock_);
+        compact_chains_ = false;
+        return compacted_lsn_;
+    }
+    // 最后一个read view释放之后重新开始压缩
+    void EnableCompaction() {compact_chains_ = true;}
+    // 取出过的log中最大的结束lsn，更晚的log还没有被apply过
+    lsn_t ExtractedLsn() {
+        PthreadMutexGuard guard(lock_);
+        return extracted_lsn_;
+    }
+
+    // 正在读page的data page reader的数量，log apply worker看到不为0时会让出CPU
+    uint32_t ActiveReaders() const {return active_readers_.load();}
+
+    // 某个表空间最后一条被解析的log的结束lsn，没有log时返回0
+    lsn_t SpaceLsn(space_id_t space_id) {
+        PthreadMutexGuard guard(lock_);
+        auto iter = space_lsn_.find(space_id);
+        return iter == space_lsn_.end() ? 0 : iter->second;
+    }
+
+    // 留在内存中的log占用的空间
+    size_t MemoryUsage() {
+        PthreadMutexGuard guard(lock_);
+        return memory_usage_;
+    }
+
+    // 超过之后把冷的log链溢出到RocksDB
+    size_t MemoryBudget() const {return memory_budget_.load();}
+    // 调小之后，下一次插入log时溢出
+    void SetMemoryBudget(size_t memory_budget) {
+        PthreadMutexGuard guard(lock_);
+        memory_budget_ = memory_budget;
+        next_spill_usage_ = 0;
+    }
 private:
+    IndexSegment::log_list ExtractLogLocked(IndexSegment *segment, const PageAddress &page_address) {
+        auto before = segment->MemoryUsage();
+        auto res = segment->ExtractLog(page_address, &spill_store_);
+        memory_usage_ = memory_usage_ - before + segment->MemoryUsage();
+        if (res != nullptr && !res->empty()) {
+            extracted_lsn_ = std::max(extracted_lsn_, res->back().log_start_lsn_ + res->back().log_len_);
+        }
+        return res;
+    }
+
+    // 记住最近被读过的page，它们很可能马上又会被读，不溢出它们的log
+    void TouchRecentRead(const PageAddress &page_address) {
+        if (!recent_reads_.insert(page_address).second) {
+            return;
+        }
+        recent_read_order_.push_back(page_address);
+        if (recent_read_order_.size() > APPLY_INDEX_RECENT_READS) {
+            recent_reads_.erase(recent_read_order_.front());
+            recent_read_order_.pop_front();
+        }
+    }
+
+    // 从最新的index segment开始溢出，它们离被apply最远；最前面的segment马上要被apply，不溢出
+    void SpillCold();
+
     pthread_cond_t index_not_empty_cond_ {};
     pthread_cond_t front_full_cond_ {};
-    pthread_mutex_t lock_ {}; // protect index_
+    pthread_cond_t front_deleted_cond_ {};
+    pthread_cond_t applied_cond_ {}; // 某个page取走的log链全部写回
+    pthread_mutex_t lock_ {}; // protect all members
     std::list<std::unique_ptr<IndexSegment>> index_ {};
+    std::unordered_map<space_id_t, lsn_t> space_lsn_ {}; // 计算节点用它来判断本地缓存的page是否过期
+    IndexSegment deferred_ {}; // 被apply policy推迟apply的log，比index_中所有的log都旧
+    std::unordered_map<PageAddress, PageChainStats> page_stats_ {};
+    std::unordered_map<PageAddress, uint32_t> reading_pages_ {}; // data page reader正在等待的page
+    std::unordered_map<PageAddress, uint32_t> applying_ {}; // 已经取走还没有写回的log链的数量
+    std::atomic<uint32_t> active_readers_ {0};
+    std::atomic<bool> compact_chains_ {true};
+    lsn_t compacted_lsn_ {0}; // 最后一条导致别的log被丢掉的log的结束lsn
+    lsn_t extracted_lsn_ {0};
+    size_t memory_usage_ {0};
+    std::atomic<size_t> memory_budget_;
+    const size_t batch_size_;
+    size_t next_spill_usage_ {0}; // 上一次溢出没能降到低水位时，等内存再涨一些才重试
+    LogSpillStore spill_store_ {};
+    std::unordered_set<PageAddress> recent_reads_ {};
+    std::deque<PageAddress> recent_read_order_ {};
+};
+
+// 计算节点刷脏页时发来的提示：某个page已经到达了某个lsn
+struct FlushHint {
+    space_id_t space_id_;
+    page_id_t page_id_;
+    lsn_t lsn_;
+};
+
+// 计算节点刷出去的page很快会被读到，也决定了它的checkpoint能不能推进，
+// log apply hint线程优先把这些page materialise，不等它们所在的index segment被调度
+class FlushHintQueue {
+public:
+    FlushHintQueue() {
+        pthread_mutex_init(&lock_, nullptr);
+        pthread_cond_init(&not_empty_cond_, nullptr);
+        pthread_cond_init(&done_cond_, nullptr);
+    }
+    ~FlushHintQueue() {
+        pthread_mutex_destroy(&lock_);
+        pthread_cond_destroy(&not_empty_cond_);
+        pthread_cond_destroy(&done_cond_);
+    }
+    // 返回最后一个hint的序号
+    uint64_t Push(const std::vector<FlushHint> &hints) {
+        PthreadMutexGuard guard(lock_);
+        for (const auto &hint: hints) {
+            hints_.push_back(hint);
+        }
+        pushed_seq_ += hints.size();
+        pthread_cond_signal(&not_empty_cond_);
+        return pushed_seq_;
+    }
+    // 取走当前所有的hint，seq返回其中最后一个hint的序号
+    std::vector<FlushHint> PopAll(uint64_t *seq) {
+        PthreadMutexGuard guard(lock_);
+        while (hints_.empty()) {
+            pthread_cond_wait(&not_empty_cond_, &lock_);
+        }
+        std::vector<FlushHint> res(hints_.begin(), hints_.end());
+        hints_.clear();
+        *seq = pushed_seq_;
+        return res;
+    }
+    void Done(uint64_t seq) {
+        PthreadMutexGuard guard(lock_);
+        done_seq_ = seq;
+        pthread_cond_broadcast(&done_cond_);
+    }
+    // 等待序号不大于seq的hint全部materialise
+    void WaitDone(uint64_t seq) {
+        PthreadMutexGuard guard(lock_);
+        while (done_seq_ < seq) {
+            pthread_cond_wait(&done_cond_, &lock_);
+        }
+    }
+private:
+    pthread_mutex_t lock_ {}; // protect all members
+    pthread_cond_t not_empty_cond_ {};
+    pthread_cond_t done_cond_ {};
+    std::list<FlushHint> hints_ {};
+    uint64_t pushed_seq_ {0};
+    uint64_t done_seq_ {0};
+};
+
+// log writer的一次写入因为窗口满了没有拷贝到log_buf，记录下它在ib_logfile中的位置
+struct spilled_log_t {
+    int log_file_index;
+    size_t offset; // 在log file中的偏移量，block对齐，已经跳过了元数据块
+    size_t n_blocks;
+    size_t written_offset; // 这次写入开始时的written_offset，用来去掉重复写的部分
+    size_t len; // 掐头去尾之后的长度
+    uint32_t first_block_no; // 第一个block的LOG_BLOCK_HDR_NO，用来确认ib_logfile中已经是这次写入的内容
 };
 
-//extern pthread_mutex_t log_apply_task_mutex;
-extern pthread_cond_t log_apply_condition; // 每次log parser 解析之后产生apply task，就会产生这个条件变量来唤醒log applier
-//extern std::list<std::unique_ptr<apply_task>> apply_task_requests;
-extern ApplyIndex apply_index;
-extern pthread_mutex_t log_group_mutex;
-extern pthread_cond_t log_parse_condition; // 每次log writer 写入，导致产生足够多的log，就会产生这个条件变量来唤醒log parser
-extern pthread_cond_t log_write_condition; // 每次log applier 完成，释放出空间，就会产生这个条件变量来唤醒log writer
 struct log_group_t {
     int log_file_number;
     size_t per_file_size; // in bytes
@@ -325,19 +831,29 @@ struct log_group_t {
 //    std::atomic<size_t> need_to_apply;
 
     unsigned char *log_meta_buf;
-    uint32_t log_meta_buf_size;
+    size_t log_meta_buf_size;
 
     unsigned char *log_buf; // 不包括log 的元数据块
 
-    uint32_t log_buf_size;
+    size_t log_buf_size; // 去掉元数据块和block的header、trailer之后整个log group的大小，written_offset等按它回绕
+
+    // log_buf是一个环，第isn个字节放在 log_buf[isn % log_ring_size]。
+    // 同一个memfd被连续映射了两次，log_buf[i]和log_buf[i + log_ring_size]是同一个字节，
+    // 所以从环中任意位置开始、长度不超过log_ring_size的一段log在内存中都是连续的
+    size_t log_ring_size;
+
+    // log_buf中已经有数据的位置，不超过written_isn。两者不相等时，[filled_isn, written_isn)
+    // 这一段log因为窗口满了没有拷贝进来，记录在spilled_logs中，由log parser从ib_logfile读回
+    std::atomic<size_t> filled_isn;
+    std::deque<struct spilled_log_t> spilled_logs; // 由log_group_mutex保护
+
+    std::vector<int> log_fds; // 只读打开的ib_logfile，用来读回溢出的log
 
-    uint32_t log_buf_size_per_file; // 每一个log file需要多大的log buf，不包括log 的元数据块还有log block内的header和trail
+    size_t log_buf_size_per_file; // 每一个log file需要多大的log buf，不包括log 的元数据块还有log block内的header和trail
 
     bool first_written;
 };
 
-extern log_group_t log_group;
-
 /**
  * find the max checkpoint no and its correspond lsn and its offset in log group
  * @param checkpoint_lsn
@@ -346,5 +862,31 @@ extern log_group_t log_group;
  */
 void find_max_checkpoint(const unsigned char *log_meta_buf, size_t *checkpoint_lsn, size_t *checkpoint_no, size_t *checkpoint_offset);
 
-size_t log_group_off_to_log_buf_off(size_t log_group_off);
+size_t log_group_off_to_log_buf_off(const log_group_t &log_group, size_t log_group_off);
+
+/**
+ * 把一个memfd连续映射两次，得到首尾相连的环
+ * @param size 环的大小，必须是系统页大小的整数倍
+ * @return 映射出的 2 * size 字节的起始地址，失败时返回nullptr
+ */
+unsigned char *log_ring_map(size_t size);
+
+/**
+ * 把一段连续的log block掐头去尾，拷贝written_offset之后的部分
+ * @param log_group_offset 第一个block在log group中的偏移量
+ * @param written_offset log_buf中已经写到的位置，在它之前的是重复写入的部分
+ * @param dest 目标地址，为nullptr时只计算长度
+ * @param max_len 最多拷贝这么多字节
+ * @param n_used 返回用到了几个block
+ * @return 拷贝的长度
+ */
+size_t strip_log_blocks(const log_group_t &log_group, const unsigned char *blocks, size_t n_blocks,
+                        size_t log_group_offset, size_t written_offset, unsigned char *dest, size_t max_len, size_t *n_used);
+
+/**
+ * 从ib_logfile中读回一段溢出的log，拷贝到log_buf中filled_isn的位置
+ * @return 成功返回0；ib_logfile中还是上一轮的内容（写入还没有落盘）或者读失败返回1，稍后需要重试；
+ *         已经被下一轮的log覆盖返回-1，这段log再也读不回来了
+ */
+int log_refill_spilled(const log_group_t &log_group, const spilled_log_t &spilled);
 #endif
@@ -8,8 +8,10 @@
 #include "applier/buffer_pool.h"
 #include "applier/log_log.h"
 
+class ApplierInstance;
 
-void log_parse_thread_start(void );
+// 启动一个log group的log parser线程
+void log_parse_thread_start(ApplierInstance *applier);
 
 
 /** Tries to parse a single log record.
@@ -95,6 +97,13 @@ bool ApplyCompRecSecondDeleteMark(const LogEntry &log, Page *page);
 
 bool ApplyCompRecDelete(const LogEntry &log, Page *page);
 
+/**
+ * 解析MLOG_COMP_REC_INSERT、MLOG_COMP_REC_CLUST_DELETE_MARK、MLOG_COMP_REC_UPDATE_IN_PLACE和MLOG_COMP_REC_DELETE中的
+ * 索引信息和记录的页内偏移量，MLOG_COMP_REC_INSERT的偏移量是新记录前面那一条记录
+ * @return 其它类型的log或者log格式不对时返回false
+ */
+bool ParseCompRecOffset(const LogEntry &log, RecordInfo &rec_info, uint32_t &offset);
+
 bool ApplyCompListEndCopyCreated(const LogEntry &log, Page *page);
 
 bool ApplyCompPageReorganize(const LogEntry &log, Page *page);
@@ -102,4 +111,35 @@ bool ApplyCompPageReorganize(const LogEntry &log, Page *page);
 bool ApplyCompListDelete(const LogEntry &log, Page *page);
 
 bool ApplyIBufBitmapInit(const LogEntry &log, Page *page);
+
+// undo page上的log，undo表空间和系统表空间中的undo page由此生成
+bool ApplyUndoInsert(const LogEntry &log, Page *page);
+
+bool ApplyUndoEraseEnd(const LogEntry &log, Page *page);
+
+bool ApplyUndoInit(const LogEntry &log, Page *page);
+
+bool ApplyUndoHdrDiscard(const LogEntry &log, Page *page);
+
+/**
+ * Apply MLOG_UNDO_HDR_CREATE 和 MLOG_UNDO_HDR_REUSE
+ */
+bool ApplyUndoHdrCreateOrReuse(const LogEntry &log, Page *page);
+
+/**
+ * Apply MLOG_REC_MIN_MARK 和 MLOG_COMP_REC_MIN_MARK
+ */
+bool ApplyRecMinMark(const LogEntry &log, Page *page);
+
+// 压缩page上的log，page中保存的是压缩之后的page
+bool ApplyZipWriteNodePtr(const LogEntry &log, Page *page);
+
+bool ApplyZipWriteBlobPtr(const LogEntry &log, Page *page);
+
+bool ApplyZipWriteHeader(const LogEntry &log, Page *page);
+
+/**
+ * Apply MLOG_ZIP_PAGE_COMPRESS，log中带着整个压缩之后的page
+ */
+bool ApplyZipPageCompress(const LogEntry &log, Page *page);
 #endif
@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+#include "applier/applier_config.h"
+
+class ApplierInstance;
+
+/**
+ * 存储节点启动时自己做崩溃恢复：从checkpoint开始顺序扫描ib_logfile，把checkpoint之后的log
+ * 交给log parser和log applier，等它们全部apply完成之后返回。
+ * 必须在log parser和log applier线程启动之后、开始接收NFS请求之前调用
+ * @param applier 要恢复的log group，每个log group各自恢复
+ * @param fds 每个log文件的fd
+ * @return 恢复的log的长度（去掉block头尾之后）
+ */
+size_t log_recovery(ApplierInstance *applier, const std::vector<int> &fds);
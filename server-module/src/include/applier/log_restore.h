@@ -0,0 +1,26 @@
+#pragma once
+#include "applier/applier_config.h"
+
+class ApplierInstance;
+
+/**
+ * 时间点恢复：配置了Restore_Snapshot的log group不跟随ib_logfile，而是把快照拷贝到自己的数据目录，
+ * 再把Redo_Archive_Path中快照之后的归档交给log parser和log applier，apply到Restore_Lsn为止，
+ * 和崩溃恢复走同一条并行的解析和apply路径。
+ * 数据目录中的logdb_restore记录恢复进度，拷贝或者apply到一半重启之后接着做，完成之后重启不再重复
+ */
+
+/**
+ * 加载表空间之前调用：拷贝快照中的文件，找到解析的起点
+ * @param need_replay 返回是否还要apply归档
+ * @return log parser开始的lsn：要apply归档时是快照lsn所在的归档frame的开头，否则是已经恢复到的lsn
+ */
+lsn_t log_restore_prepare(ApplierInstance *applier, bool *need_replay);
+
+/**
+ * 从start_lsn开始把归档交给log parser，直到Restore_Lsn之前最后一个完整的mtr，等它们全部apply并落盘之后返回。
+ * 必须在log parser和log applier线程启动之后、开始接收NFS请求之前调用
+ * @param start_lsn log_restore_prepare的返回值
+ * @return 恢复到的lsn
+ */
+lsn_t log_restore(ApplierInstance *applier, lsn_t start_lsn);
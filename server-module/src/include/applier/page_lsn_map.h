@@ -0,0 +1,52 @@
+#pragma once
+#include <pthread.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "applier/applier_config.h"
+
+namespace rocksdb {
+class DB;
+}
+
+class BufferPool;
+
+/**
+ * 每个page在磁盘上的lsn。buffer pool写回或者读入page时更新，定期和数据文件一起持久化到RocksDB。
+ * log apply之前先查这里，一条page的log链如果全都早于磁盘上的page，就可以直接丢掉，不需要读page。
+ * 持久化之前会先fsync数据文件，所以RocksDB里的lsn永远不会超过磁盘上真正的page lsn。
+ */
+class PageLsnMap {
+public:
+    PageLsnMap();
+    ~PageLsnMap();
+
+    // 打开RocksDB，并把上次持久化的内容读到内存
+    bool Open(const std::string &path);
+
+    // 磁盘上的page lsn，不知道的时候返回0
+    lsn_t Get(space_id_t space_id, page_id_t page_id);
+
+    void Update(space_id_t space_id, page_id_t page_id, lsn_t lsn);
+
+    // 表空间被删除或者truncate之后，磁盘上的page都不在了，忘掉它们的lsn
+    void DropSpace(space_id_t space_id);
+
+    // fsync buffer_pool写过的数据文件，然后把变化过的部分写到RocksDB
+    void Checkpoint(BufferPool *buffer_pool);
+
+private:
+    // 同一个表空间中连续的PAGE_LSN_MAP_CHUNK_PAGES个page作为一个key存储
+    static std::string ChunkKey(space_id_t space_id, uint32_t chunk_no);
+
+    pthread_mutex_t lock_ {}; // protect spaces_ and dirty_chunks_
+    pthread_mutex_t checkpoint_lock_ {};
+    // space id -> 按page id索引的lsn，page id是连续分配的，数组比哈希表紧凑得多
+    std::unordered_map<space_id_t, std::vector<lsn_t>> spaces_ {};
+    std::unordered_set<uint64_t> dirty_chunks_ {}; // (space id << 32) | chunk no
+    rocksdb::DB *db_ {nullptr};
+};
+
+// 启动定期持久化所有log group的page lsn map的线程
+void page_lsn_map_thread_start();
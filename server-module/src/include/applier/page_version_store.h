@@ -0,0 +1,103 @@
+#pragma once
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "applier/applier_config.h"
+#include "applier/bean.h"
+#include "applier/buffer_pool.h"
+#include "applier/log_log.h"
+
+/**
+ * 给只读计算节点提供某个lsn上的page。
+ * 只读节点用read view登记自己回放到的lsn，只要存在read view，log apply在把page推进到
+ * 最老的read view之后时，会先保留page在这之前的镜像，以及之后apply的所有log，
+ * 读某个lsn上的page时从镜像开始重放早于这个lsn的log。
+ * read view推进、释放或者过期之后，镜像向前滚动，不再需要的镜像和log被回收。
+ */
+class PageVersionStore {
+public:
+    enum class ReadResult {
+        MATERIALISED, // 从保留的镜像重放出了这个lsn上的page
+        CURRENT,      // page在这个lsn之后没有被修改过，当前的page就是这个lsn上的page
+        TOO_OLD,      // 这个lsn上的page已经被回收了
+    };
+
+    explicit PageVersionStore(ApplyIndex *apply_index);
+    ~PageVersionStore();
+
+    bool ViewsEnabled() const {return views_enabled_.load();}
+
+    /**
+     * 登记一个read view，返回view id，id从1开始。第一个read view会让ApplyIndex停止压缩log链，
+     * 最后一个read view释放或者过期之后重新开始压缩。
+     * lsn上的page已经拿不到时返回0：lsn早于被压缩掉的log，
+     * 或者page已经apply到lsn之后，而且没有更老的read view保留它们的镜像
+     */
+    uint64_t RegisterView(lsn_t lsn);
+
+    // 推进read view，view已经过期或者被释放时返回false
+    bool UpdateView(uint64_t view_id, lsn_t lsn);
+
+    void ReleaseView(uint64_t view_id);
+
+    // 所有read view中最小的lsn，没有read view时返回LSN_MAX
+    lsn_t OldestViewLsn() const {return oldest_view_lsn_.load();}
+
+    /**
+     * log apply在apply一条log链之前调用，调用时必须持有page latch。
+     * page已经有镜像，或者log链会把page推进到最老的read view之后时，保留镜像和整条log链
+     * @param page 还没有apply这条log链的page
+     */
+    void Retain(const PageAddress &page_address, const Page &page, const std::list<LogEntry> &chain);
+
+    /**
+     * 调用时必须持有page latch，并且page上所有已经解析的log都已经apply
+     * @param current buffer pool中当前的page
+     * @param dest_buf 返回MATERIALISED时被填上lsn上的page
+     */
+    ReadResult Read(const PageAddress &page_address, const Page &current, lsn_t lsn, byte *dest_buf);
+
+    // 表空间中保留了镜像的page，read view之后被修改过的page都在其中
+    std::vector<page_id_t> SpacePages(space_id_t space_id);
+
+    // 表空间被删除或者truncate，丢掉它的page的镜像
+    void DropSpace(space_id_t space_id);
+
+    // 回收过期的read view，把镜像滚动到最老的read view
+    void Purge();
+
+private:
+    struct ReadView {
+        lsn_t lsn;
+        std::chrono::steady_clock::time_point refreshed;
+    };
+    // page的一个镜像，以及在镜像之后apply的log
+    struct PageHistory {
+        std::unique_ptr<Page> base {};
+        std::list<LogEntry> logs {};
+        size_t memory_usage {0};
+    };
+
+    // 调用时必须持有lock_
+    void RefreshOldestLocked();
+    // 没有read view了，丢掉所有镜像，ApplyIndex重新开始压缩log链，调用时必须持有lock_
+    void DisableViewsLocked();
+    // 把早于lsn的log重放到镜像上，调用时必须持有lock_
+    void RollForwardLocked(PageHistory *history, lsn_t lsn);
+
+    ApplyIndex *apply_index_;
+    pthread_mutex_t lock_ {}; // protect all members
+    std::unordered_map<uint64_t, ReadView> views_ {};
+    uint64_t next_view_id_ {1};
+    std::atomic<bool> views_enabled_ {false};
+    lsn_t views_horizon_ {LSN_MAX};
+    std::atomic<lsn_t> oldest_view_lsn_ {LSN_MAX};
+    std::unordered_map<PageAddress, PageHistory> histories_ {};
+    size_t memory_usage_ {0};
+};
+
+// 启动定期回收所有log group的read view和镜像的线程
+void page_version_purge_thread_start();
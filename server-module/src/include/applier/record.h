@@ -25,6 +25,7 @@ rec_set_bit_field_2(
 uint32_t rec_get_info_bits(const byte* rec, bool comp);
 
 void rec_set_info_bits_new(byte*	rec, uint32_t bits);
+void rec_set_info_bits_old(byte*	rec, uint32_t bits);
 
 uint32_t rec_get_info_and_status_bits(const byte*	rec);
 
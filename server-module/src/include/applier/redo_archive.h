@@ -0,0 +1,103 @@
+#pragma once
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "applier/applier_config.h"
+
+class ApplierInstance;
+struct ZSTD_CCtx_s;
+
+// 归档中的一段连续的log，data是去掉block头尾之后的log，从一条log的开头开始，到一条log的结尾结束
+struct RedoArchiveFrame {
+    lsn_t start_lsn {0};
+    lsn_t end_lsn {0};
+    std::vector<byte> data {};
+};
+
+/**
+ * 把log parser解析过的log压缩之后连续地保存下来，配合快照做任意lsn的时间点恢复。
+ * 在log parser而不是log writer处归档，内存中的log和溢出之后从ib_logfile读回的log都经过这里，
+ * 而且每一批都在log的边界上结束，恢复时可以从任意一个frame开始解析。
+ *
+ * log parser每解析完一批就把它追加到内存队列，归档线程攒够REDO_ARCHIVE_FRAME_SIZE
+ * 或者等了REDO_ARCHIVE_FLUSH_MS之后用zstd压缩成一个frame，追加到Redo_Archive_Path下的segment文件并fdatasync。
+ * segment文件名是其中第一个frame的start_lsn，超过REDO_ARCHIVE_SEGMENT_SIZE之后换一个，整数都是大端：
+ *   start_lsn(8) end_lsn(8) raw_len(4) comp_len(4) data(comp_len)
+ * 队列满了会让log parser等待，归档不会因为跟不上而丢失log；写失败的frame被丢掉，
+ * 之后的log写到新的segment中，两个segment之间的空洞之后不能恢复过去。
+ * 重启之后从checkpoint重新解析，已经归档的部分不再追加
+ */
+class RedoArchive {
+public:
+    explicit RedoArchive(const LogGroupConfig &config);
+    ~RedoArchive();
+
+    bool Enabled() const {return enabled_;}
+
+    // log parser启动之前调用：恢复segment文件，启动归档线程
+    void Start(ApplierInstance *applier);
+
+    /**
+     * 只在log parser线程中调用，归档一段解析过的log，log parser每解析REDO_ARCHIVE_FRAME_SIZE调用一次
+     * @param start_lsn log中第一条log的lsn
+     * @param end_lsn log中最后一条log之后的lsn
+     */
+    void Append(lsn_t start_lsn, lsn_t end_lsn, const byte *log, size_t len);
+
+    // 读出segment目录，截掉最后一个segment结尾不完整的frame；恢复时不启动归档线程，只调用这个
+    void Load();
+    // 归档中最早和最晚的lsn，没有归档时都是0
+    lsn_t FirstLsn();
+    lsn_t LastLsn();
+    /**
+     * 读出包含lsn的frame
+     * @return 成功返回0，lsn不早于归档的结尾返回1，lsn在空洞中、早于归档的开头或者读失败返回-1
+     */
+    int ReadFrame(lsn_t lsn, RedoArchiveFrame *frame);
+
+private:
+    struct Segment {
+        lsn_t end_lsn;
+        size_t size;
+    };
+
+    static void *ArchiveRoutine(void *arg);
+
+    // 压缩并写出一个frame，写失败时丢掉它
+    void WriteFrame(const RedoArchiveFrame &frame);
+    void OpenSegment(lsn_t start_lsn);
+    std::string SegmentPath(lsn_t start_lsn) const;
+
+    const std::string path_;
+    const bool enabled_;
+    const size_t max_size_;
+    ApplierInstance *applier_ {nullptr};
+
+    // log parser追加，归档线程取走，每一个都不超过REDO_ARCHIVE_FRAME_SIZE加一条log，写成一个frame
+    pthread_mutex_t queue_mutex_ {};
+    pthread_cond_t queue_cond_ {};   // 攒够了一个frame
+    pthread_cond_t drained_cond_ {}; // 归档线程取走了队列
+    std::vector<RedoArchiveFrame> pending_ {};
+    size_t pending_bytes_ {0};
+    lsn_t next_lsn_ {0};             // 已经交给归档线程的log的结尾
+
+    // 归档线程使用
+    pthread_t archive_thread_id_ {0};
+    int segment_fd_ {-1};
+    lsn_t segment_lsn_ {0};
+    size_t segment_size_ {0};
+    lsn_t written_lsn_ {0};          // 当前segment中最后一个frame的end_lsn
+    ZSTD_CCtx_s *cctx_ {nullptr};
+    std::vector<byte> compress_buf_ {};
+
+    // ReadFrame顺序读时从上一个frame之后接着找
+    int read_fd_ {-1};
+    lsn_t read_segment_lsn_ {0};
+    size_t read_offset_ {0};
+    lsn_t read_lsn_ {0};             // read_offset_处frame的start_lsn
+
+    // 保护segment目录
+    pthread_mutex_t segment_mutex_ {};
+    std::map<lsn_t, Segment> segments_ {}; // 第一个frame的start_lsn -> 最后一个frame的end_lsn和文件大小
+};
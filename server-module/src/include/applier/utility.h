@@ -161,3 +161,17 @@ mach_read_from_7(
 }
 
 lsn_t recv_calc_lsn_on_data_add(lsn_t lsn, uint64_t len);
+
+// recv_calc_lsn_on_data_add反过来，两个lsn之间去掉block头尾之后的log的字节数
+uint64_t recv_calc_data_len(lsn_t start_lsn, lsn_t end_lsn);
+
+// 创建path中最后一个'/'之前的所有目录
+bool MakeParentDirectories(const std::string &path);
+
+/**
+ * 文件系统支持时用reflink克隆整个文件，只复制元数据；否则按chunk_size分段拷贝，每段之后调用一次progress
+ * @param progress 可以为nullptr，返回false时停止拷贝
+ * @param cloned 返回是否是克隆的
+ * @return 成功返回0，IO失败返回-1，progress返回false时返回-2
+ */
+int CloneFile(int src_fd, int dst_fd, size_t chunk_size, bool (*progress)(void *arg), void *arg, bool *cloned);
@@ -64,6 +64,7 @@
 #cmakedefine _USE_NFS3 1
 #cmakedefine _USE_NLM 1
 #cmakedefine _USE_RQUOTA 1
+#cmakedefine _USE_LOGDB 1
 #cmakedefine USE_NFSACL3 1
 #cmakedefine DEBUG_SAL 1
 #cmakedefine _VALGRIND_MEMCHECK 1
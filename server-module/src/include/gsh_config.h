@@ -68,6 +68,9 @@ typedef enum protos {
 #ifdef USE_NFSACL3
 	P_NFSACL,		/*< NFSACL (for v3) */
 #endif
+#ifdef _USE_LOGDB
+	P_LOGDB,		/*< LOGDB page server (compute nodes) */
+#endif
 #ifdef RPC_VSOCK
 	P_NFS_VSOCK,		/*< NFS over vmware, qemu vmci sockets */
 #endif
@@ -93,6 +96,11 @@ typedef enum protos {
  */
 #define RQUOTA_PORT 875
 
+/**
+ * @brief Default LOGDB page server port.
+ */
+#define LOGDB_PORT 20049
+
 /**
  * @brief Default value for _9p_param.nb_worker
  */
@@ -377,6 +385,11 @@ typedef struct nfs_core_param {
 #ifdef USE_NFSACL3
 	/* Whether to support the POSIX ACL. Defaults to false. */
 	bool enable_NFSACL;
+#endif
+#ifdef _USE_LOGDB
+	/** Whether to serve batched page reads to compute nodes.
+	    Defaults to false and is settable with Enable_LOGDB. */
+	bool enable_LOGDB;
 #endif
 	/** Whether to collect NFS stats.  Defaults to true. */
 	bool enable_NFSSTATS;
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * The content of this file is a mix of rpcgen-generated
+ * and hand-edited program text.  It is not automatically
+ * generated by, e.g., build processes.
+ *
+ * This file is under version control.
+ */
+
+#ifndef _LOGDB_H_RPCGEN
+#define _LOGDB_H_RPCGEN
+
+#include "gsh_rpc.h"
+#include "extended_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOGDB_PAGE_SIZE 16384
+#define LOGDB_MAX_PAGES 32
+#define LOGDB_MAX_HINTS 1024
+#define LOGDB_MAX_INDEX_FIELDS 1023
+#define LOGDB_MAX_KEY_FIELDS 16
+#define LOGDB_MAX_KEY_LEN 3072
+#define LOGDB_MAX_SCAN_PREDICATES 16
+#define LOGDB_MAX_SCAN_VALUES 65536
+#define LOGDB_MAX_SCAN_BYTES 524288
+#define LOGDB_MAX_SNAPSHOT_NAME 255
+
+	enum logdb_stat {
+		LOGDB_OK = 0,
+		LOGDB_ERR_NOSPACE = 1,
+		LOGDB_ERR_TOOBIG = 2,
+		LOGDB_ERR_LAGGING = 3,
+		LOGDB_ERR_NOPAGE = 4,
+		LOGDB_ERR_IO = 5,
+		LOGDB_ERR_NOVIEW = 6,
+		LOGDB_ERR_TOOOLD = 7,
+		LOGDB_ERR_NOGROUP = 8,
+		LOGDB_ERR_NOTFOUND = 9,
+		LOGDB_ERR_BADINDEX = 10,
+		LOGDB_ERR_EXIST = 11,
+		LOGDB_ERR_BADNAME = 12,
+		LOGDB_ERR_BUSY = 13,
+	};
+	typedef enum logdb_stat logdb_stat;
+
+	struct logdb_getpages_args {
+		u_int group;
+		u_int space_id;
+		struct {
+			u_int page_nos_len;
+			u_int *page_nos_val;
+		} page_nos;
+		uint64_t min_lsn;
+	};
+	typedef struct logdb_getpages_args logdb_getpages_args;
+
+	struct logdb_page {
+		u_int page_no;
+		logdb_stat status;
+		struct {
+			u_int data_len;
+			char *data_val;
+		} data;
+	};
+	typedef struct logdb_page logdb_page;
+
+	struct logdb_getpages_res {
+		logdb_stat status;
+		uint64_t parsed_lsn;
+		struct {
+			u_int pages_len;
+			logdb_page *pages_val;
+		} pages;
+	};
+	typedef struct logdb_getpages_res logdb_getpages_res;
+
+	struct logdb_spacelsn_args {
+		u_int group;
+		u_int space_id;
+	};
+	typedef struct logdb_spacelsn_args logdb_spacelsn_args;
+
+	struct logdb_spacelsn_res {
+		logdb_stat status;
+		uint64_t parsed_lsn;
+		uint64_t space_lsn;
+	};
+	typedef struct logdb_spacelsn_res logdb_spacelsn_res;
+
+	struct logdb_flush_hint {
+		u_int space_id;
+		u_int page_no;
+		uint64_t lsn;
+	};
+	typedef struct logdb_flush_hint logdb_flush_hint;
+
+	struct logdb_flushhints_args {
+		u_int group;
+		struct {
+			u_int hints_len;
+			logdb_flush_hint *hints_val;
+		} hints;
+		bool_t sync;
+	};
+	typedef struct logdb_flushhints_args logdb_flushhints_args;
+
+	struct logdb_flushhints_res {
+		logdb_stat status;
+		uint64_t parsed_lsn;
+	};
+	typedef struct logdb_flushhints_res logdb_flushhints_res;
+
+	struct logdb_readview_args {
+		u_int group;
+		uint64_t view_id;
+		uint64_t lsn;
+	};
+	typedef struct logdb_readview_args logdb_readview_args;
+
+	struct logdb_readview_res {
+		logdb_stat status;
+		uint64_t view_id;
+		uint64_t parsed_lsn;
+	};
+	typedef struct logdb_readview_res logdb_readview_res;
+
+	struct logdb_key_field {
+		struct {
+			u_int data_len;
+			char *data_val;
+		} data;
+	};
+	typedef struct logdb_key_field logdb_key_field;
+
+	struct logdb_lookup_args {
+		u_int group;
+		u_int space_id;
+		u_int root_page_no;
+		u_int n_uniq;
+		struct {
+			u_int field_lens_len;
+			u_int *field_lens_val;
+		} field_lens;
+		struct {
+			u_int key_len;
+			logdb_key_field *key_val;
+		} key;
+		uint64_t lsn;
+	};
+	typedef struct logdb_lookup_args logdb_lookup_args;
+
+	struct logdb_lookup_res {
+		logdb_stat status;
+		uint64_t parsed_lsn;
+		u_int page_no;
+		u_int extra_size;
+		struct {
+			u_int record_len;
+			char *record_val;
+		} record;
+	};
+	typedef struct logdb_lookup_res logdb_lookup_res;
+
+	enum logdb_scan_op {
+		LOGDB_SCAN_EQ = 0,
+		LOGDB_SCAN_NE = 1,
+		LOGDB_SCAN_LT = 2,
+		LOGDB_SCAN_LE = 3,
+		LOGDB_SCAN_GT = 4,
+		LOGDB_SCAN_GE = 5,
+		LOGDB_SCAN_IS_NULL = 6,
+		LOGDB_SCAN_IS_NOT_NULL = 7,
+	};
+	typedef enum logdb_scan_op logdb_scan_op;
+
+	struct logdb_value {
+		bool_t null;
+		bool_t external;
+		struct {
+			u_int data_len;
+			char *data_val;
+		} data;
+	};
+	typedef struct logdb_value logdb_value;
+
+	struct logdb_scan_predicate {
+		u_int field_no;
+		logdb_scan_op op;
+		struct {
+			u_int value_len;
+			char *value_val;
+		} value;
+	};
+	typedef struct logdb_scan_predicate logdb_scan_predicate;
+
+	struct logdb_scan_args {
+		u_int group;
+		u_int space_id;
+		u_int root_page_no;
+		u_int n_uniq;
+		struct {
+			u_int field_lens_len;
+			u_int *field_lens_val;
+		} field_lens;
+		struct {
+			u_int start_key_len;
+			logdb_value *start_key_val;
+		} start_key;
+		bool_t start_inclusive;
+		struct {
+			u_int end_key_len;
+			logdb_value *end_key_val;
+		} end_key;
+		struct {
+			u_int predicates_len;
+			logdb_scan_predicate *predicates_val;
+		} predicates;
+		struct {
+			u_int columns_len;
+			u_int *columns_val;
+		} columns;
+		u_int max_bytes;
+		uint64_t lsn;
+	};
+	typedef struct logdb_scan_args logdb_scan_args;
+
+	struct logdb_scan_res {
+		logdb_stat status;
+		uint64_t parsed_lsn;
+		u_int n_columns;
+		struct {
+			u_int values_len;
+			logdb_value *values_val;
+		} values;
+		bool_t eof;
+		struct {
+			u_int next_key_len;
+			logdb_value *next_key_val;
+		} next_key;
+	};
+	typedef struct logdb_scan_res logdb_scan_res;
+
+	struct logdb_snapshot_args {
+		u_int group;
+		uint64_t lsn;
+		char *name;
+	};
+	typedef struct logdb_snapshot_args logdb_snapshot_args;
+
+	struct logdb_snapshot_res {
+		logdb_stat status;
+		uint64_t job_id;
+	};
+	typedef struct logdb_snapshot_res logdb_snapshot_res;
+
+	struct logdb_snapshotstatus_args {
+		u_int group;
+		uint64_t job_id;
+	};
+	typedef struct logdb_snapshotstatus_args logdb_snapshotstatus_args;
+
+	struct logdb_snapshotstatus_res {
+		logdb_stat status;
+		bool_t done;
+		uint64_t lsn;
+		u_int files;
+		u_int cloned_files;
+		uint64_t patched_pages;
+	};
+	typedef struct logdb_snapshotstatus_res logdb_snapshotstatus_res;
+
+#define LOGDBPROG 0x2000DB00
+#define LOGDB_V1 1
+
+#define LOGDBPROC_NULL 0
+#define LOGDBPROC_GETPAGES 1
+#define LOGDBPROC_SPACELSN 2
+#define LOGDBPROC_FLUSHHINTS 3
+#define LOGDBPROC_READVIEW 4
+#define LOGDBPROC_GETPAGESASOF 5
+#define LOGDBPROC_LOOKUP 6
+#define LOGDBPROC_SCAN 7
+#define LOGDBPROC_SNAPSHOT 8
+#define LOGDBPROC_SNAPSHOTSTATUS 9
+
+/* the xdr functions */
+
+	extern bool xdr_logdb_stat(XDR *, logdb_stat *);
+	extern bool xdr_logdb_getpages_args(XDR *, logdb_getpages_args *);
+	extern bool xdr_logdb_page(XDR *, logdb_page *);
+	extern bool xdr_logdb_getpages_res(XDR *, logdb_getpages_res *);
+	extern bool xdr_logdb_spacelsn_args(XDR *, logdb_spacelsn_args *);
+	extern bool xdr_logdb_spacelsn_res(XDR *, logdb_spacelsn_res *);
+	extern bool xdr_logdb_flush_hint(XDR *, logdb_flush_hint *);
+	extern bool xdr_logdb_flushhints_args(XDR *, logdb_flushhints_args *);
+	extern bool xdr_logdb_flushhints_res(XDR *, logdb_flushhints_res *);
+	extern bool xdr_logdb_readview_args(XDR *, logdb_readview_args *);
+	extern bool xdr_logdb_readview_res(XDR *, logdb_readview_res *);
+	extern bool xdr_logdb_key_field(XDR *, logdb_key_field *);
+	extern bool xdr_logdb_lookup_args(XDR *, logdb_lookup_args *);
+	extern bool xdr_logdb_lookup_res(XDR *, logdb_lookup_res *);
+	extern bool xdr_logdb_scan_op(XDR *, logdb_scan_op *);
+	extern bool xdr_logdb_value(XDR *, logdb_value *);
+	extern bool xdr_logdb_scan_predicate(XDR *, logdb_scan_predicate *);
+	extern bool xdr_logdb_scan_args(XDR *, logdb_scan_args *);
+	extern bool xdr_logdb_scan_res(XDR *, logdb_scan_res *);
+	extern bool xdr_logdb_snapshot_args(XDR *, logdb_snapshot_args *);
+	extern bool xdr_logdb_snapshot_res(XDR *, logdb_snapshot_res *);
+	extern bool xdr_logdb_snapshotstatus_args(XDR *,
+						  logdb_snapshotstatus_args *);
+	extern bool xdr_logdb_snapshotstatus_res(XDR *,
+						 logdb_snapshotstatus_res *);
+
+#ifdef __cplusplus
+}
+#endif
+#endif				/* !_LOGDB_H_RPCGEN */
@@ -148,6 +148,15 @@ extern struct config_block krb5_param;
 #endif
 extern struct config_block version4_param;
 
+/* in logdb_read_conf.c */
+int logdb_set_param_from_conf(config_file_t parse_tree,
+			      struct config_error_type *err_type);
+int reread_logdb_config(config_file_t parse_tree,
+			struct config_error_type *err_type);
+#ifdef USE_DBUS
+extern struct gsh_dbus_interface logdb_interface;
+#endif
+
 /* in nfs_admin_thread.c */
 
 extern bool admin_shutdown;
@@ -125,5 +125,8 @@ enum xprt_stat nfs_rpc_valid_RQUOTA(struct svc_req *);
 #ifdef USE_NFSACL3
 enum xprt_stat nfs_rpc_valid_NFSACL(struct svc_req *);
 #endif
+#ifdef _USE_LOGDB
+enum xprt_stat nfs_rpc_valid_LOGDB(struct svc_req *);
+#endif
 
 #endif				/* !NFS_INIT_H */
@@ -49,6 +49,7 @@
 #include "nfs4.h"
 #include "nlm4.h"
 #include "nfsacl.h"
+#include "logdb.h"
 
 /* ------------------------------ Typedefs and structs----------------------- */
 
@@ -104,6 +105,16 @@ typedef union nfs_arg__ {
 	/* NFSACL */
 	getaclargs arg_getacl;
 	setaclargs arg_setacl;
+
+	/* LOGDB */
+	logdb_getpages_args arg_logdb_getpages;
+	logdb_spacelsn_args arg_logdb_spacelsn;
+	logdb_flushhints_args arg_logdb_flushhints;
+	logdb_readview_args arg_logdb_readview;
+	logdb_lookup_args arg_logdb_lookup;
+	logdb_scan_args arg_logdb_scan;
+	logdb_snapshot_args arg_logdb_snapshot;
+	logdb_snapshotstatus_args arg_logdb_snapshotstatus;
 } nfs_arg_t;
 
 struct COMPOUND4res_extended {
@@ -161,6 +172,16 @@ typedef union nfs_res__ {
 	/* NFSACL */
 	getaclres res_getacl;
 	setaclres res_setacl;
+
+	/* LOGDB */
+	logdb_getpages_res res_logdb_getpages;
+	logdb_spacelsn_res res_logdb_spacelsn;
+	logdb_flushhints_res res_logdb_flushhints;
+	logdb_readview_res res_logdb_readview;
+	logdb_lookup_res res_logdb_lookup;
+	logdb_scan_res res_logdb_scan;
+	logdb_snapshot_res res_logdb_snapshot;
+	logdb_snapshotstatus_res res_logdb_snapshotstatus;
 } nfs_res_t;
 
 /* flags related to the behaviour of the requests
@@ -69,6 +69,9 @@ extern const nfs_function_desc_t rquota2_func_desc[];
 #ifdef USE_NFSACL3
 extern const nfs_function_desc_t nfsacl_func_desc[];
 #endif
+#ifdef _USE_LOGDB
+extern const nfs_function_desc_t logdb1_func_desc[];
+#endif
 
 
 #ifdef _USE_NFS3
@@ -151,6 +154,31 @@ int nfsacl_setacl(nfs_arg_t *, struct svc_req *, nfs_res_t *);
  *  */
 #endif
 
+#ifdef _USE_LOGDB
+int logdb_Null(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_getpages(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_spacelsn(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_flushhints(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_readview(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_getpagesasof(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_lookup(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_scan(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+int logdb_snapshot(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+int logdb_snapshotstatus(nfs_arg_t *, struct svc_req *, nfs_res_t *);
+
+/* @}
+ *  * -- End of LOGDB protocol functions. --
+ *  */
+#endif
+
 int nfs_null(nfs_arg_t *, struct svc_req *, nfs_res_t *);
 
 #ifdef _USE_NFS3
@@ -496,6 +524,19 @@ void nfsacl_getacl_Free(nfs_res_t *);
 void nfsacl_setacl_Free(nfs_res_t *);
 #endif
 
+#ifdef _USE_LOGDB
+void logdb_Null_Free(nfs_res_t *);
+void logdb_getpages_Free(nfs_res_t *);
+void logdb_spacelsn_Free(nfs_res_t *);
+void logdb_flushhints_Free(nfs_res_t *);
+void logdb_readview_Free(nfs_res_t *);
+void logdb_getpagesasof_Free(nfs_res_t *);
+void logdb_lookup_Free(nfs_res_t *);
+void logdb_scan_Free(nfs_res_t *);
+void logdb_snapshot_Free(nfs_res_t *);
+void logdb_snapshotstatus_Free(nfs_res_t *);
+#endif
+
 void nfs_null_free(nfs_res_t *);
 
 #ifdef _USE_NFS3
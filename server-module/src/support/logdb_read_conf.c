@@ -0,0 +1,549 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * @file logdb_read_conf.c
+ * @brief LOGDB applier configuration parameter tables.
+ *
+ * The LOGDB block describes where the applier finds the redo logs and
+ * data files of each MySQL instance and how much memory and CPU it may
+ * use.  Apply threads, buffer pool sizes, the apply index memory
+ * budget and the apply policy are picked up again on SIGHUP and can be
+ * changed over DBus, the apply policy thresholds only on SIGHUP;
+ * everything else is only read at startup.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "abstract_mem.h"
+#include "nfs_core.h"
+#include "config_parsing.h"
+#include "applier/interface.h"
+#ifdef USE_DBUS
+#include "gsh_dbus.h"
+#endif
+
+#include <string.h>
+
+/* the storage node's own state, and below it the copy of the MySQL data
+ * directory it regenerates */
+#define LOGDB_STATE_DIR "/var/lib/logdb/"
+#define LOGDB_DATA_DIR LOGDB_STATE_DIR "data/"
+/* at least two segments, the one being written and the one before it */
+#define CHANGE_FEED_MIN_SIZE (128ULL * 1024 * 1024)
+/* room for a few apply batches, smaller windows spill all the time */
+#define LOG_BUF_WINDOW_MIN_SIZE (64ULL * 1024 * 1024)
+
+/** Applier configuration, settable in the LOGDB stanza. */
+
+struct logdb_param logdb_param;
+
+static void logdb_group_free(struct logdb_group_param *group)
+{
+	gsh_free(group->log_path);
+	gsh_free(group->system_file_path);
+	gsh_free(group->data_file_path);
+	gsh_free(group->page_lsn_map_path);
+	gsh_free(group->apply_index_spill_path);
+	gsh_free(group->buffer_pool_dump_path);
+	gsh_free(group->change_feed_path);
+	gsh_free(group->change_feed_tables);
+	gsh_free(group->snapshot_path);
+	gsh_free(group->redo_archive_path);
+	gsh_free(group->restore_snapshot);
+	memset(group, 0, sizeof(*group));
+}
+
+static void logdb_param_free(struct logdb_param *param)
+{
+	uint32_t i;
+
+	for (i = 0; i < param->n_groups; i++)
+		logdb_group_free(&param->groups[i]);
+	gsh_free(param->log_path);
+	gsh_free(param->system_file_path);
+	gsh_free(param->data_file_path);
+	gsh_free(param->page_lsn_map_path);
+	gsh_free(param->apply_index_spill_path);
+	gsh_free(param->buffer_pool_dump_path);
+	gsh_free(param->change_feed_path);
+	gsh_free(param->change_feed_tables);
+	gsh_free(param->snapshot_path);
+	gsh_free(param->redo_archive_path);
+	memset(param, 0, sizeof(*param));
+}
+
+static struct config_item_list apply_policies[] = {
+	CONFIG_LIST_TOK("eager", LOGDB_APPLY_EAGER),
+	CONFIG_LIST_TOK("lazy", LOGDB_APPLY_LAZY),
+	CONFIG_LIST_TOK("hybrid", LOGDB_APPLY_HYBRID),
+	CONFIG_LIST_EOL
+};
+
+/* Paths and sizes left out of a Log_Group block come from the LOGDB block */
+
+static struct config_item logdb_group_params[] = {
+	CONF_ITEM_UI16("Export_Id", 0, UINT16_MAX, LOGDB_ANY_EXPORT,
+		       logdb_group_param, export_id),
+	CONF_ITEM_PATH("Log_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, log_path),
+	CONF_ITEM_PATH("System_File_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, system_file_path),
+	CONF_ITEM_PATH("Data_File_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, data_file_path),
+	CONF_ITEM_PATH("Page_Lsn_Map_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, page_lsn_map_path),
+	CONF_ITEM_PATH("Apply_Index_Spill_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, apply_index_spill_path),
+	CONF_ITEM_PATH("Buffer_Pool_Dump_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, buffer_pool_dump_path),
+	CONF_ITEM_UI32("Log_File_Number", 0, 100, 0,
+		       logdb_group_param, log_file_number),
+	CONF_ITEM_UI32("Applier_Threads", 0, LOGDB_MAX_APPLIER_THREADS, 0,
+		       logdb_group_param, applier_threads),
+	CONF_ITEM_UI32("Buffer_Pool_Pages", 0, UINT32_MAX, 0,
+		       logdb_group_param, buffer_pool_pages),
+	CONF_ITEM_UI64("Apply_Index_Memory_Budget", 0, UINT64_MAX, 0,
+		       logdb_group_param, apply_index_memory_budget),
+	CONF_ITEM_PATH("Change_Feed_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, change_feed_path),
+	CONF_ITEM_STR("Change_Feed_Tables", 1, 65536, NULL,
+		      logdb_group_param, change_feed_tables),
+	CONF_ITEM_PATH("Snapshot_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, snapshot_path),
+	CONF_ITEM_PATH("Redo_Archive_Path", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, redo_archive_path),
+	CONF_ITEM_PATH("Restore_Snapshot", 1, MAXPATHLEN, NULL,
+		       logdb_group_param, restore_snapshot),
+	CONF_ITEM_UI64("Restore_Lsn", 0, UINT64_MAX, 0,
+		       logdb_group_param, restore_lsn),
+	CONFIG_EOL
+};
+
+/**
+ * @brief Hand out the next free slot of the groups array
+ *
+ * Log_Group blocks are kept in the order they appear, the applier
+ * numbers its log groups the same way.
+ */
+
+static void *logdb_group_init(void *link_mem, void *self_struct)
+{
+	struct logdb_param *param;
+
+	assert(link_mem != NULL || self_struct != NULL);
+
+	if (link_mem == NULL) {
+		/* defaults of the LOGDB block, no groups yet */
+		param = container_of(self_struct, struct logdb_param, groups);
+		param->n_groups = 0;
+		return self_struct;
+	}
+	param = container_of(link_mem, struct logdb_param, groups);
+	if (self_struct == NULL) {
+		if (param->n_groups >= LOGDB_MAX_LOG_GROUPS) {
+			LogCrit(COMPONENT_CONFIG,
+				"At most %d Log_Group blocks are allowed",
+				LOGDB_MAX_LOG_GROUPS);
+			return NULL;
+		}
+		memset(&param->groups[param->n_groups], 0,
+		       sizeof(struct logdb_group_param));
+		return &param->groups[param->n_groups];
+	}
+	/* free resources case */
+	logdb_group_free(self_struct);
+	return NULL;
+}
+
+static int logdb_group_commit(void *node, void *link_mem, void *self_struct,
+			      struct config_error_type *err_type)
+{
+	struct logdb_param *param;
+
+	param = container_of(link_mem, struct logdb_param, groups);
+	assert(self_struct == &param->groups[param->n_groups]);
+	param->n_groups++;
+	return 0;
+}
+
+static struct config_item logdb_params[] = {
+	CONF_ITEM_UI16("Export_Id", 0, UINT16_MAX, LOGDB_ANY_EXPORT,
+		       logdb_param, export_id),
+	CONF_ITEM_UI32("Applier_Threads", 0, LOGDB_MAX_APPLIER_THREADS, 0,
+		       logdb_param, applier_threads),
+	CONF_ITEM_UI32("Buffer_Pool_Size", 0, UINT32_MAX, 0,
+		       logdb_param, buffer_pool_size),
+	CONF_ITEM_UI64("Apply_Index_Memory_Budget", 0, UINT64_MAX, 0,
+		       logdb_param, apply_index_memory_budget),
+	CONF_ITEM_UI64("Apply_Batch_Size", 1024 * 1024, UINT32_MAX,
+		       8 * 1024 * 1024,
+		       logdb_param, apply_batch_size),
+	CONF_ITEM_TOKEN("Apply_Policy", LOGDB_APPLY_EAGER, apply_policies,
+			logdb_param, apply_policy),
+	CONF_ITEM_UI32("Apply_Hybrid_Chain_Logs", 1, UINT32_MAX, 64,
+		       logdb_param, apply_hybrid_chain_logs),
+	CONF_ITEM_UI64("Apply_Hybrid_Chain_Bytes", 1, UINT64_MAX, 16 * 1024,
+		       logdb_param, apply_hybrid_chain_bytes),
+	CONF_ITEM_UI32("Apply_Lazy_Memory_Percent", 1, 100, 50,
+		       logdb_param, apply_lazy_memory_percent),
+	CONF_ITEM_UI64("Log_Buf_Window_Size", LOG_BUF_WINDOW_MIN_SIZE,
+		       UINT64_MAX, 512ULL * 1024 * 1024,
+		       logdb_param, log_buf_window_size),
+	CONF_ITEM_UI32("Log_File_Number", 1, 100, 2,
+		       logdb_param, log_file_number),
+	CONF_ITEM_PATH("Log_Path", 1, MAXPATHLEN, LOGDB_DATA_DIR,
+		       logdb_param, log_path),
+	CONF_ITEM_PATH("System_File_Path", 1, MAXPATHLEN, LOGDB_DATA_DIR,
+		       logdb_param, system_file_path),
+	CONF_ITEM_PATH("Data_File_Path", 1, MAXPATHLEN, LOGDB_STATE_DIR "data",
+		       logdb_param, data_file_path),
+	CONF_ITEM_PATH("Page_Lsn_Map_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "page_lsn_map",
+		       logdb_param, page_lsn_map_path),
+	CONF_ITEM_PATH("Apply_Index_Spill_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "apply_index_spill",
+		       logdb_param, apply_index_spill_path),
+	CONF_ITEM_PATH("Buffer_Pool_Dump_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "ib_buffer_pool",
+		       logdb_param, buffer_pool_dump_path),
+	CONF_ITEM_PATH("Change_Feed_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "change_feed",
+		       logdb_param, change_feed_path),
+	CONF_ITEM_STR("Change_Feed_Tables", 1, 65536, NULL,
+		      logdb_param, change_feed_tables),
+	CONF_ITEM_UI64("Change_Feed_Max_Size", CHANGE_FEED_MIN_SIZE, UINT64_MAX,
+		       4ULL * 1024 * 1024 * 1024,
+		       logdb_param, change_feed_max_size),
+	CONF_ITEM_PATH("Snapshot_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "snapshot",
+		       logdb_param, snapshot_path),
+	CONF_ITEM_BOOL("Redo_Archive", false,
+		       logdb_param, redo_archive),
+	CONF_ITEM_PATH("Redo_Archive_Path", 1, MAXPATHLEN,
+		       LOGDB_STATE_DIR "redo_archive",
+		       logdb_param, redo_archive_path),
+	CONF_ITEM_UI64("Redo_Archive_Max_Size", 0, UINT64_MAX, 0,
+		       logdb_param, redo_archive_max_size),
+	CONF_ITEM_BLOCK("Log_Group", logdb_group_params,
+			logdb_group_init, logdb_group_commit,
+			logdb_param, groups),
+	CONFIG_EOL
+};
+
+struct config_block logdb_param_blk = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.logdb",
+	.blk_desc.name = "LOGDB",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.flags = CONFIG_UNIQUE,
+	.blk_desc.u.blk.init = noop_conf_init,
+	.blk_desc.u.blk.params = logdb_params,
+	.blk_desc.u.blk.commit = noop_conf_commit
+};
+
+static int logdb_load_param(config_file_t parse_tree,
+			    struct logdb_param *param,
+			    struct config_error_type *err_type)
+{
+	(void) load_config_from_parse(parse_tree,
+				      &logdb_param_blk,
+				      param,
+				      true,
+				      err_type);
+	if (!config_error_is_harmless(err_type))
+		return -1;
+
+	/* Without Log_Group blocks there is a single log group using the
+	 * paths and the export of the LOGDB block.
+	 */
+	if (param->n_groups == 0) {
+		memset(&param->groups[0], 0, sizeof(struct logdb_group_param));
+		param->groups[0].export_id = param->export_id;
+		param->n_groups = 1;
+	}
+	return 0;
+}
+
+int logdb_set_param_from_conf(config_file_t parse_tree,
+			      struct config_error_type *err_type)
+{
+	if (logdb_load_param(parse_tree, &logdb_param, err_type) < 0) {
+		LogCrit(COMPONENT_INIT,
+			"Error while parsing LOGDB specific configuration");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Apply the runtime adjustable LOGDB parameters of a new config
+ *
+ * Called on SIGHUP.  Log groups are matched by position, settings that
+ * need a restart are reported by the applier and otherwise ignored.
+ */
+
+int reread_logdb_config(config_file_t parse_tree,
+			struct config_error_type *err_type)
+{
+	struct logdb_param param;
+
+	memset(&param, 0, sizeof(param));
+	if (logdb_load_param(parse_tree, &param, err_type) < 0) {
+		logdb_param_free(&param);
+		return -1;
+	}
+	update_applier_param(&param);
+
+	logdb_param.applier_threads = param.applier_threads;
+	logdb_param.buffer_pool_size = param.buffer_pool_size;
+	logdb_param.apply_index_memory_budget =
+		param.apply_index_memory_budget;
+	logdb_param.apply_policy = param.apply_policy;
+	logdb_param.apply_hybrid_chain_logs = param.apply_hybrid_chain_logs;
+	logdb_param.apply_hybrid_chain_bytes = param.apply_hybrid_chain_bytes;
+	logdb_param.apply_lazy_memory_percent =
+		param.apply_lazy_memory_percent;
+	logdb_param_free(&param);
+	return 0;
+}
+
+#ifdef USE_DBUS
+
+static bool logdb_dbus_get_u32(DBusMessageIter *args, uint32_t *value)
+{
+	if (args == NULL ||
+	    dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT32)
+		return false;
+	dbus_message_iter_get_basic(args, value);
+	dbus_message_iter_next(args);
+	return true;
+}
+
+#define GROUP_ARG		\
+{				\
+	.name = "group",	\
+	.type = "u",		\
+	.direction = "in"	\
+}
+
+/**
+ * @brief DBus method to change the apply threads of a log group
+ *
+ * @param[in]  args  log group, number of threads
+ * @param[out] reply status
+ */
+
+static bool logdb_dbus_set_applier_threads(DBusMessageIter *args,
+					   DBusMessage *reply,
+					   DBusError *error)
+{
+	char *errormsg = "Apply threads changed";
+	bool success = true;
+	DBusMessageIter iter;
+	uint32_t group, threads;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!logdb_dbus_get_u32(args, &group) ||
+	    !logdb_dbus_get_u32(args, &threads)) {
+		errormsg = "set_applier_threads takes 2 arguments: group, threads";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+	if (set_applier_threads(group, threads) < 0) {
+		errormsg = "No such log group";
+		success = false;
+		goto out;
+	}
+	LogEvent(COMPONENT_DBUS, "log group %u: %u apply threads",
+		 group, threads);
+ out:
+	gsh_dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_set_applier_threads = {
+	.name = "set_applier_threads",
+	.method = logdb_dbus_set_applier_threads,
+	.args = {GROUP_ARG,
+		 {
+		  .name = "threads",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief DBus method to cap the buffer pool of a log group
+ *
+ * @param[in]  args  log group, pages (0 removes the cap)
+ * @param[out] reply status
+ */
+
+static bool logdb_dbus_set_log_group_buffer_pool(DBusMessageIter *args,
+						 DBusMessage *reply,
+						 DBusError *error)
+{
+	char *errormsg = "Buffer pool changed";
+	bool success = true;
+	DBusMessageIter iter;
+	uint32_t group, pages;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!logdb_dbus_get_u32(args, &group) ||
+	    !logdb_dbus_get_u32(args, &pages)) {
+		errormsg = "set_log_group_buffer_pool takes 2 arguments: group, pages";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+	if (set_log_group_buffer_pool(group, pages) < 0) {
+		errormsg = "No such log group";
+		success = false;
+		goto out;
+	}
+	LogEvent(COMPONENT_DBUS, "log group %u: buffer pool limited to %u pages",
+		 group, pages);
+ out:
+	gsh_dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_set_log_group_buffer_pool = {
+	.name = "set_log_group_buffer_pool",
+	.method = logdb_dbus_set_log_group_buffer_pool,
+	.args = {GROUP_ARG,
+		 {
+		  .name = "pages",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief DBus method to resize the buffer pool shared by all log groups
+ *
+ * @param[in]  args  pages (0 sizes it from physical memory)
+ * @param[out] reply status
+ */
+
+static bool logdb_dbus_set_buffer_pool_size(DBusMessageIter *args,
+					    DBusMessage *reply,
+					    DBusError *error)
+{
+	char *errormsg = "Buffer pool size changed";
+	bool success = true;
+	DBusMessageIter iter;
+	uint32_t pages;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!logdb_dbus_get_u32(args, &pages)) {
+		errormsg = "set_buffer_pool_size takes 1 argument: pages";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+	set_buffer_pool_size(pages);
+	logdb_param.buffer_pool_size = pages;
+ out:
+	gsh_dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_set_buffer_pool_size = {
+	.name = "set_buffer_pool_size",
+	.method = logdb_dbus_set_buffer_pool_size,
+	.args = {{
+		  .name = "pages",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief DBus method to switch the apply policy of all log groups
+ *
+ * @param[in]  args  "eager", "lazy" or "hybrid"
+ * @param[out] reply status
+ */
+
+static bool logdb_dbus_set_apply_policy(DBusMessageIter *args,
+					DBusMessage *reply,
+					DBusError *error)
+{
+	char *errormsg = "Apply policy changed";
+	bool success = true;
+	DBusMessageIter iter;
+	struct config_item_list *tok;
+	char *name = NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args == NULL ||
+	    dbus_message_iter_get_arg_type(args) != DBUS_TYPE_STRING) {
+		errormsg = "set_apply_policy takes 1 argument: policy";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+	dbus_message_iter_get_basic(args, &name);
+	for (tok = apply_policies; tok->token != NULL; tok++) {
+		if (strcasecmp(tok->token, name) == 0)
+			break;
+	}
+	if (tok->token == NULL || set_apply_policy(tok->value) < 0) {
+		errormsg = "Apply policy must be eager, lazy or hybrid";
+		success = false;
+		goto out;
+	}
+	logdb_param.apply_policy = tok->value;
+	LogEvent(COMPONENT_DBUS, "apply policy %s", tok->token);
+ out:
+	gsh_dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_set_apply_policy = {
+	.name = "set_apply_policy",
+	.method = logdb_dbus_set_apply_policy,
+	.args = {{
+		  .name = "policy",
+		  .type = "s",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method *logdb_methods[] = {
+	&method_set_applier_threads,
+	&method_set_log_group_buffer_pool,
+	&method_set_buffer_pool_size,
+	&method_set_apply_policy,
+	NULL
+};
+
+struct gsh_dbus_interface logdb_interface = {
+	.name = "org.ganesha.nfsd.logdb",
+	.props = NULL,
+	.methods = logdb_methods,
+	.signals = NULL
+};
+
+#endif				/* USE_DBUS */
@@ -122,6 +122,10 @@ static struct config_item core_params[] = {
 #ifdef _USE_RQUOTA
 	CONF_ITEM_UI16("Rquota_Port", 0, UINT16_MAX, RQUOTA_PORT,
 		       nfs_core_param, port[P_RQUOTA]),
+#endif
+#ifdef _USE_LOGDB
+	CONF_ITEM_UI16("LOGDB_Port", 0, UINT16_MAX, LOGDB_PORT,
+		       nfs_core_param, port[P_LOGDB]),
 #endif
 	CONF_ITEM_IP_ADDR("Bind_Addr", "0.0.0.0",
 			  nfs_core_param, bind_addr),
@@ -142,6 +146,10 @@ static struct config_item core_params[] = {
 #ifdef USE_NFSACL3
 	CONF_ITEM_UI32("NFSACL_Program", 1, INT32_MAX, NFSACLPROG,
 		       nfs_core_param, program[P_NFSACL]),
+#endif
+#ifdef _USE_LOGDB
+	CONF_ITEM_UI32("LOGDB_Program", 1, INT32_MAX, LOGDBPROG,
+		       nfs_core_param, program[P_LOGDB]),
 #endif
 	CONF_ITEM_DEPRECATED("Nb_Worker",
 			     "This parameter has been replaced with _9P { Nb_Worker}"
@@ -219,6 +227,10 @@ static struct config_item core_params[] = {
 #ifdef USE_NFSACL3
 	CONF_ITEM_BOOL("Enable_NFSACL", false,
 		       nfs_core_param, enable_NFSACL),
+#endif
+#ifdef _USE_LOGDB
+	CONF_ITEM_BOOL("Enable_LOGDB", false,
+		       nfs_core_param, enable_LOGDB),
 #endif
 	CONF_ITEM_BOOL("Enable_TCP_keepalive", true,
 		       nfs_core_param, enable_tcp_keepalive),